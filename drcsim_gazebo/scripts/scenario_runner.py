@@ -0,0 +1,422 @@
+#!/usr/bin/env python
+#
+# Copyright 2012 Open Source Robotics Foundation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+#
+# Runs drcsim scenarios in parallel, each in its own headless gzserver with
+# its own ROS master, and collects their reports in one.
+#
+# Every run is a roslaunch of a launch file of drcsim_gazebo that exits
+# once it wrote its report to the path given as its report arg, like
+# atlas_latency_benchmark.launch or atlas_load_generator.launch.  A run
+# gets, from the instance slot it runs in:
+#   ROS_MASTER_URI     http://localhost:<ros_port + slot>, its own roscore
+#   GAZEBO_MASTER_URI  http://localhost:<gazebo_port + slot>
+#   ROS_HOME, ROS_LOG_DIR  its directory under the output directory
+#   HOME               <its directory>/home, so that gazebo logs and
+#                      ~/.gazebo/scores of parallel runs don't mix; the
+#                      models of ~/.gazebo/models are still found through
+#                      GAZEBO_MODEL_PATH
+#   CPU affinity       cpus_per_instance cpus of its own, with taskset
+# and /vrc_score is recorded, for worlds that are scored.  The score files
+# VRCScoringPlugin wrote in ~/.gazebo/scores are copied to the directory of
+# the run.  Worlds that set <score_file> write it there instead, which
+# parallel runs of the same world share.
+#
+# The runs are described by a sweep file, e.g. config/vrc_final_sweep.yaml:
+#   launch: atlas_latency_benchmark.launch  # default for the runs
+#   timeout: 600                            # wall seconds per run
+#   args: {duration: 60}                    # roslaunch args of every run
+#   runs:
+#     - name: task1
+#       world_launch: vrc_final_task1.launch
+#       seeds: [0, 1]        # passed as seed:=, or repeat: 2 without seed
+#       args: {}             # on top of the args above
+# or on the command line:
+#   scenario_runner.py -j 8 --worlds vrc_final_task1.launch \
+#     vrc_final_task2.launch --arg duration:=60 --output /tmp/sweep
+#
+# The report, <output>/report.json, holds each run with its exit status,
+# its wall time, the report of its launch and its last VRCScore.
+
+import argparse
+import csv
+import json
+import multiprocessing
+import glob
+import os
+import shutil
+import signal
+import subprocess
+import sys
+import threading
+import time
+
+try:
+    import queue
+except ImportError:
+    import Queue as queue
+
+import yaml
+
+PKG = 'drcsim_gazebo'
+
+# processes of the runs in progress, stopped on an interrupt
+active = set()
+active_lock = threading.Lock()
+
+
+class Run(object):
+    """A roslaunch to run, and what came out of it."""
+
+    def __init__(self, index, name, launch, args, timeout):
+        self.index = index
+        self.name = name
+        self.launch = launch
+        self.args = args
+        self.timeout = timeout
+        self.directory = None
+        self.slot = None
+        self.cpus = []
+        self.returncode = None
+        self.timed_out = False
+        self.wall_time = 0.0
+        self.report = None
+        self.score = None
+        self.score_files = []
+
+    def to_dict(self):
+        return {'name': self.name, 'launch': self.launch, 'args': self.args,
+                'directory': self.directory, 'slot': self.slot,
+                'cpus': self.cpus, 'returncode': self.returncode,
+                'timed_out': self.timed_out, 'wall_time': self.wall_time,
+                'report': self.report, 'score': self.score,
+                'score_files': self.score_files}
+
+
+def parse_arg(text):
+    """Split a name:=value roslaunch arg."""
+    if ':=' not in text:
+        raise argparse.ArgumentTypeError('expected name:=value, got ' + text)
+    name, value = text.split(':=', 1)
+    return name, value
+
+
+def load_runs(options):
+    """List the runs of the sweep file or of the command line."""
+    if options.sweep:
+        with open(options.sweep) as f:
+            sweep = yaml.safe_load(f) or {}
+    else:
+        sweep = {'runs': [{'world_launch': w} for w in options.worlds]}
+    if options.launch:
+        sweep['launch'] = options.launch
+    if options.timeout:
+        sweep['timeout'] = options.timeout
+    common_args = dict(sweep.get('args') or {})
+    common_args.update(dict(options.arg))
+
+    runs = []
+    for entry in sweep.get('runs') or []:
+        args = dict(common_args)
+        args.update(entry.get('args') or {})
+        if 'world_launch' in entry:
+            args['world_launch'] = entry['world_launch']
+        name = entry.get('name') or \
+            os.path.splitext(entry.get('world_launch', 'run'))[0]
+        launch = entry.get('launch', sweep.get('launch',
+            'atlas_latency_benchmark.launch'))
+        timeout = float(entry.get('timeout', sweep.get('timeout', 600)))
+
+        seeds = entry.get('seeds')
+        repeat = int(entry.get('repeat', options.repeat))
+        for i in range(len(seeds) if seeds else repeat):
+            run_args = dict(args)
+            run_name = name
+            if seeds:
+                run_args['seed'] = seeds[i]
+                run_name += '_seed%s' % seeds[i]
+            elif repeat > 1:
+                run_name += '_%d' % i
+            runs.append(Run(len(runs), run_name, launch, run_args, timeout))
+    return runs
+
+
+def read_score(path):
+    """Last VRCScore of a rostopic echo -p, None if there was none."""
+    if not os.path.exists(path):
+        return None
+    header = None
+    last = None
+    with open(path) as f:
+        for row in csv.reader(f):
+            if not row:
+                continue
+            if row[0].startswith('%'):
+                header = [h.replace('field.', '') for h in row]
+            else:
+                last = row
+    if not header or not last:
+        return None
+    fields = dict(zip(header, last))
+    score = {}
+    for key in ['completion_score', 'falls', 'task_type']:
+        if key in fields:
+            score[key] = int(fields[key])
+    for key in ['sim_time_elapsed', 'wall_time_elapsed', 'sim_time']:
+        if key in fields:
+            score[key] = int(fields[key]) * 1e-9
+    score['message'] = fields.get('message', '')
+    return score
+
+
+def wait_for_master(uri, process):
+    """Wait for the roscore of a run, False if its roslaunch exited."""
+    import rosgraph
+    master = rosgraph.Master('/scenario_runner', master_uri=uri)
+    while process.poll() is None:
+        if master.is_online():
+            return True
+        time.sleep(0.5)
+    return False
+
+
+def stop(process, timeout=15.0):
+    """Interrupt a process group like roslaunch expects, then kill it."""
+    if process.poll() is not None:
+        return
+    try:
+        os.killpg(process.pid, signal.SIGINT)
+        end = time.time() + timeout
+        while process.poll() is None and time.time() < end:
+            time.sleep(0.1)
+        if process.poll() is None:
+            os.killpg(process.pid, signal.SIGKILL)
+    except OSError:
+        pass
+    process.wait()
+
+
+def execute(run, options, slot, cpus):
+    """Run a roslaunch in an instance slot, and collect its results."""
+    run.slot = slot
+    run.cpus = cpus
+    run.directory = os.path.join(options.output,
+                                 '%03d_%s' % (run.index, run.name))
+    if not os.path.isdir(run.directory):
+        os.makedirs(run.directory)
+    report_path = os.path.join(run.directory, 'report.json')
+    score_path = os.path.join(run.directory, 'vrc_score.csv')
+    ros_port = options.ros_port + slot
+    ros_uri = 'http://localhost:%d' % ros_port
+
+    env = dict(os.environ)
+    env['ROS_MASTER_URI'] = ros_uri
+    env['GAZEBO_MASTER_URI'] = 'http://localhost:%d' % \
+        (options.gazebo_port + slot)
+    env['ROS_HOME'] = run.directory
+    env['ROS_LOG_DIR'] = os.path.join(run.directory, 'log')
+    home = os.path.join(run.directory, 'home')
+    if not os.path.isdir(home):
+        os.makedirs(home)
+    env['HOME'] = home
+    models = os.path.join(os.path.expanduser('~'), '.gazebo', 'models')
+    if os.path.isdir(models):
+        paths = [p for p in env.get('GAZEBO_MODEL_PATH', '').split(':') if p]
+        env['GAZEBO_MODEL_PATH'] = ':'.join(paths + [models])
+
+    command = ['roslaunch', '-p', str(ros_port), PKG, run.launch,
+               'report:=' + report_path]
+    command += ['%s:=%s' % (k, v) for k, v in sorted(run.args.items())]
+    if cpus and options.taskset:
+        command = ['taskset', '-c', ','.join(str(c) for c in cpus)] + command
+
+    log = open(os.path.join(run.directory, 'roslaunch.log'), 'w')
+    start = time.time()
+    process = subprocess.Popen(command, env=env, stdout=log,
+                               stderr=subprocess.STDOUT,
+                               preexec_fn=os.setsid)
+    with active_lock:
+        active.add(process)
+    echo = None
+    score_file = None
+    try:
+        if wait_for_master(ros_uri, process):
+            score_file = open(score_path, 'w')
+            echo = subprocess.Popen(['rostopic', 'echo', '-p', '/vrc_score'],
+                                    env=env, stdout=score_file,
+                                    stderr=subprocess.STDOUT,
+                                    preexec_fn=os.setsid)
+            with active_lock:
+                active.add(echo)
+
+        while process.poll() is None:
+            if time.time() - start > run.timeout:
+                run.timed_out = True
+                stop(process)
+                break
+            time.sleep(0.5)
+    finally:
+        if echo:
+            stop(echo)
+        if score_file:
+            score_file.close()
+        stop(process)
+        log.close()
+        with active_lock:
+            active.discard(process)
+            active.discard(echo)
+
+    run.wall_time = time.time() - start
+    run.returncode = process.returncode
+    if os.path.exists(report_path):
+        try:
+            with open(report_path) as f:
+                run.report = json.load(f)
+        except ValueError:
+            run.report = None
+    run.score = read_score(score_path)
+    for path in sorted(glob.glob(os.path.join(home, '.gazebo', 'scores',
+                                              '*.score'))):
+        shutil.copy(path, run.directory)
+        run.score_files.append(os.path.join(run.directory,
+                                            os.path.basename(path)))
+
+
+def worker(runs, options, slot, cpus, lock):
+    """Run the queued runs, one at a time, in an instance slot."""
+    while True:
+        try:
+            run = runs.get_nowait()
+        except queue.Empty:
+            return
+        with lock:
+            print('[slot %d] starting %s' % (slot, run.name))
+        execute(run, options, slot, cpus)
+        with lock:
+            status = 'timed out' if run.timed_out else \
+                'exit %s' % run.returncode
+            print('[slot %d] finished %s, %s, %.0f s' %
+                  (slot, run.name, status, run.wall_time))
+
+
+def summary_line(run):
+    """One line of the summary table."""
+    def stat(key, field):
+        try:
+            return '%8.3f' % run.report[key][field]
+        except (KeyError, TypeError):
+            return '%8s' % '-'
+    completion = falls = '-'
+    if run.score:
+        completion = run.score.get('completion_score', '-')
+        falls = run.score.get('falls', '-')
+    status = 'timeout' if run.timed_out else str(run.returncode)
+    return '%-32s %7s %7.0f %s %s %6s %6s' % (
+        run.name[:32], status, run.wall_time, stat('rtf', 'mean'),
+        stat('command_age_ms', 'p99'), completion, falls)
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(
+        description='Run drcsim scenarios in parallel headless instances.')
+    parser.add_argument('sweep', nargs='?', help='sweep file, see above')
+    parser.add_argument('--worlds', nargs='+', default=[],
+                        help='world launch files, instead of a sweep file')
+    parser.add_argument('--launch', help='launch file of the runs')
+    parser.add_argument('--arg', type=parse_arg, action='append', default=[],
+                        help='roslaunch arg of every run, name:=value')
+    parser.add_argument('--repeat', type=int, default=1,
+                        help='runs of each entry without seeds')
+    parser.add_argument('--timeout', type=float,
+                        help='wall seconds before a run is stopped')
+    parser.add_argument('-j', '--jobs', type=int,
+                        help='instances in parallel')
+    parser.add_argument('--cpus-per-instance', type=int, default=4)
+    parser.add_argument('--no-taskset', dest='taskset',
+                        action='store_false', help="don't pin cpus")
+    parser.add_argument('--ros-port', type=int, default=11411)
+    parser.add_argument('--gazebo-port', type=int, default=12345)
+    parser.add_argument('--output', default='scenario_runner',
+                        help='directory of the runs and of report.json')
+    options = parser.parse_args(argv)
+    if not options.sweep and not options.worlds:
+        parser.error('a sweep file or --worlds is needed')
+
+    runs = load_runs(options)
+    if not runs:
+        parser.error('nothing to run')
+
+    cpu_count = multiprocessing.cpu_count()
+    per_instance = max(1, min(options.cpus_per_instance, cpu_count))
+    jobs = options.jobs or max(1, cpu_count // per_instance)
+    jobs = min(jobs, len(runs))
+    if jobs * per_instance > cpu_count:
+        print('warning: %d instances of %d cpus share %d cpus' %
+              (jobs, per_instance, cpu_count))
+
+    options.output = os.path.abspath(options.output)
+    if not os.path.isdir(options.output):
+        os.makedirs(options.output)
+
+    pending = queue.Queue()
+    for run in runs:
+        pending.put(run)
+    lock = threading.Lock()
+    threads = []
+    start = time.time()
+    for slot in range(jobs):
+        cpus = [(slot * per_instance + i) % cpu_count
+                for i in range(per_instance)]
+        thread = threading.Thread(target=worker,
+                                  args=(pending, options, slot, cpus, lock))
+        thread.daemon = True
+        thread.start()
+        threads.append(thread)
+    try:
+        for thread in threads:
+            while thread.is_alive():
+                thread.join(1.0)
+    except KeyboardInterrupt:
+        # the runs are in their own process groups, which didn't get it
+        while not pending.empty():
+            pending.get_nowait()
+        with active_lock:
+            processes = list(active)
+        for process in processes:
+            stop(process)
+        print('interrupted')
+        return 1
+
+    report = {'jobs': jobs, 'cpus_per_instance': per_instance,
+              'wall_time': time.time() - start,
+              'runs': [run.to_dict() for run in runs]}
+    report_path = os.path.join(options.output, 'report.json')
+    with open(report_path, 'w') as f:
+        json.dump(report, f, indent=2, sort_keys=True)
+
+    print('%-32s %7s %7s %8s %8s %6s %6s' % ('run', 'status', 'wall s',
+          'rtf', 'age p99', 'score', 'falls'))
+    for run in runs:
+        print(summary_line(run))
+    print('%d runs on %d instances in %.0f s, wrote %s' %
+          (len(runs), jobs, report['wall_time'], report_path))
+
+    failed = [r for r in runs if r.timed_out or r.returncode != 0]
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
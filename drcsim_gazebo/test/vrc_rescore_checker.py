@@ -0,0 +1,102 @@
+# Checks shared by the scoring tests: re-score the state log of the run
+# offline with vrc_rescore, and compare with what VRCScoringPlugin scored.
+
+import os
+import shutil
+import subprocess
+import tempfile
+import time
+
+# Both score files have a record at least every sim second, and the state
+# log is sampled, so records are compared within this many sim seconds.
+SIM_TIME_TOLERANCE = 1.0
+
+def read_score(fname):
+    # Records of a score file, as (simTime, completionScore, msg) tuples.
+    records = []
+    for line in open(fname, 'r'):
+        if line.startswith('#'):
+            continue
+        # wallTime,simTime,wallTimeElapsed,simTimeElapsed,
+        # completionScore,falls,"msg"
+        fields = line.strip().split(',', 6)
+        if len(fields) < 7:
+            # still being written
+            continue
+        records.append((float(fields[1]), int(fields[4]),
+                        fields[6].strip('"')))
+    return records
+
+def events_of(msg):
+    # Fall accelerations depend on the state log's sample rate
+    events = []
+    for e in msg.split('. '):
+        e = e.strip(' .')
+        if len(e) > 0 and not e.startswith('Damaging fall'):
+            events.append(e)
+    return events
+
+def score_at(records, sim_time):
+    # Completion score of the last record at or before sim_time
+    score = 0
+    for r in records:
+        if r[0] > sim_time:
+            break
+        score = r[1]
+    return score
+
+def rescore(test, logdir):
+    # Re-score the newest state log under logdir, and return its records.
+    logs = []
+    for root, dirs, files in os.walk(logdir):
+        if 'state.log' in files:
+            logs.append(os.path.join(root, 'state.log'))
+    test.assertTrue(len(logs) > 0, 'No state.log in ' + logdir)
+    log = max(logs, key=os.path.getmtime)
+    outdir = tempfile.mkdtemp()
+    try:
+        cmd = ['rosrun', 'drcsim_gazebo_ros_plugins', 'vrc_rescore',
+               '-o', outdir, log]
+        test.assertEqual(subprocess.call(cmd), 0,
+          'vrc_rescore failed on ' + log)
+        scores = os.listdir(outdir)
+        test.assertEqual(len(scores), 1)
+        return read_score(os.path.join(outdir, scores[0]))
+    finally:
+        shutil.rmtree(outdir)
+
+def assert_rescore(test, logdir, completion_score, timeout=30.0):
+    # The same rules applied to the state log must reach the same completion
+    # score, and agree with score.log line by line: each re-scored record
+    # has the completion score score.log had around its sim time, and its
+    # events are in score.log around that time.  The end of the log may not
+    # have been written out yet, so re-score until the score matches or
+    # timeout seconds passed.  Returns the events.
+    start = time.time()
+    while True:
+        records = rescore(test, logdir)
+        score = None
+        if len(records) > 0:
+            score = records[-1][1]
+        if score == completion_score or time.time() - start > timeout:
+            break
+        time.sleep(3.0)
+    test.assertEqual(score, completion_score,
+      'Re-scored completion score %s is not %d' % (score, completion_score))
+
+    scored = read_score(os.path.join(logdir, 'score.log'))
+    events = []
+    for sim_time, score, msg in records:
+        low = score_at(scored, sim_time - SIM_TIME_TOLERANCE)
+        high = score_at(scored, sim_time + SIM_TIME_TOLERANCE)
+        test.assertTrue(low <= score <= high,
+          'Re-scored completion score %d at sim time %.3f, score.log has '
+          '%d to %d around it' % (score, sim_time, low, high))
+        for e in events_of(msg):
+            test.assertTrue(any(e in r[2] and
+                                abs(r[0] - sim_time) <= SIM_TIME_TOLERANCE
+                                for r in scored),
+              'Re-scored event at sim time %.3f not in score.log: %s' %
+              (sim_time, e))
+            events.append(e)
+    return events
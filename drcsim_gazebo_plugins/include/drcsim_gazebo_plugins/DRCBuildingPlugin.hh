@@ -28,6 +28,8 @@
 #include <gazebo/common/Plugin.hh>
 #include <gazebo/common/Events.hh>
 
+#include "drcsim_gazebo_plugins/JointParamWriter.hh"
+
 namespace gazebo
 {
   /// \defgroup drc_plugin DRC Plugins
@@ -68,6 +70,12 @@ namespace gazebo
     private: physics::JointPtr doorJoint;
     private: physics::JointPtr handleJoint;
 
+    /// \brief Sets the door stops only when the latch changes
+    private: JointParamWriter doorJointParams;
+
+    /// \brief Whether the door is latched shut
+    private: bool doorLatched;
+
     private: common::PID doorPID;
     private: double doorState;
     private: double doorCmd;
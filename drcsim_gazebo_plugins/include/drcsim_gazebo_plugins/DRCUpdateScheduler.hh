@@ -0,0 +1,314 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_DRC_UPDATE_SCHEDULER_HH
+#define GAZEBO_DRC_UPDATE_SCHEDULER_HH
+
+#include <stdint.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <gazebo/common/Time.hh>
+#include <gazebo/common/UpdateInfo.hh>
+#include <gazebo/common/Events.hh>
+#include <gazebo/physics/physics.hh>
+
+namespace gazebo
+{
+  /// \addtogroup drc_plugin
+  /// \{
+
+  /// \brief What an update touches, so that the scheduler knows which
+  /// updates may run at the same time.  Two updates conflict when one
+  /// writes a resource the other reads or writes, or when either is
+  /// exclusive.
+  ///
+  /// Resources are names.  By convention a link is named by its scoped
+  /// name, and is written by an update that applies forces to it, e.g.
+  /// through Joint::SetForce, which pushes on both links of the joint.
+  /// Reading poses, velocities and joint angles needs no declaration: only
+  /// exclusive updates may change them, or change the world in any other
+  /// way (set poses, create joints, pause...).
+  class DRCUpdateAccess
+  {
+    /// \brief Constructor, of an update that touches nothing.
+    public: DRCUpdateAccess();
+
+    /// \brief Declare a resource read.
+    /// \param[in] _resource Name of the resource.
+    /// \return This access.
+    public: DRCUpdateAccess &Read(const std::string &_resource);
+
+    /// \brief Declare a resource written.
+    /// \param[in] _resource Name of the resource.
+    /// \return This access.
+    public: DRCUpdateAccess &Write(const std::string &_resource);
+
+    /// \brief Declare the links a joint applies forces to.
+    /// \param[in] _joint Joint, may be null.
+    /// \return This access.
+    public: DRCUpdateAccess &WriteJoint(physics::JointPtr _joint);
+
+    /// \brief Declare the links joints apply forces to.
+    /// \param[in] _joints Joints.
+    /// \return This access.
+    public: DRCUpdateAccess &WriteJoints(const physics::Joint_V &_joints);
+
+    /// \brief Declare that the update may change anything, it then never
+    /// runs with another update.
+    /// \return This access.
+    public: DRCUpdateAccess &Exclusive();
+
+    /// \brief Whether two updates may not run at the same time.
+    /// \param[in] _other Access of the other update.
+    /// \return true if they conflict.
+    public: bool ConflictsWith(const DRCUpdateAccess &_other) const;
+
+    /// \brief Resources read
+    private: std::set<std::string> reads;
+
+    /// \brief Resources written
+    private: std::set<std::string> writes;
+
+    /// \brief The update may change anything
+    private: bool exclusive;
+  };
+
+  class DRCUpdateScheduler;
+
+  /// \brief Keeps an update connected to the scheduler, disconnects it
+  /// when destroyed.
+  class DRCUpdateConnection
+  {
+    /// \brief Constructor, see DRCUpdateScheduler::Connect.
+    /// \param[in] _scheduler Scheduler of the update.
+    /// \param[in] _id Id of the update.
+    public: DRCUpdateConnection(
+      boost::shared_ptr<DRCUpdateScheduler> _scheduler, unsigned int _id);
+
+    /// \brief Destructor, disconnects the update.
+    public: virtual ~DRCUpdateConnection();
+
+    /// \brief Scheduler of the update, kept alive by its connections
+    private: boost::shared_ptr<DRCUpdateScheduler> scheduler;
+
+    /// \brief Id of the update
+    private: unsigned int id;
+  };
+
+  /// \def DRCUpdateConnectionPtr
+  /// \brief Shared pointer to a DRCUpdateConnection
+  typedef boost::shared_ptr<DRCUpdateConnection> DRCUpdateConnectionPtr;
+
+  /// \brief Runs the world update begin callbacks of the drcsim plugins,
+  /// the independent ones at the same time.
+  ///
+  /// Updates are split in levels, in the order they were connected: an
+  /// update goes in the level after the last level holding an update it
+  /// conflicts with, so that conflicting updates keep the order in which
+  /// they would have run as plain ConnectWorldUpdateBegin callbacks.  Each
+  /// level runs on the physics thread and a small pool of threads, which
+  /// take the updates of the level one by one, and all of a level finishes
+  /// before the next starts, and before physics resumes.
+  ///
+  /// The pool has DRC_UPDATE_THREADS threads, 0 by default, which runs
+  /// the updates one after another on the physics thread as before.  The
+  /// time the updates take is measured either way, and compared with the
+  /// time they would take one after another and with the critical path of
+  /// the levels, to report what running them in parallel saves or would
+  /// save.
+  class DRCUpdateScheduler
+  {
+    /// \brief Update callback, bind functions without arguments as well.
+    public: typedef boost::function<void (const common::UpdateInfo &)>
+            UpdateFunction;
+
+    /// \brief Time taken by the updates, summed over steps.
+    public: class Statistics
+    {
+      /// \brief Constructor
+      public: Statistics();
+
+      /// \brief Steps
+      public: uint64_t steps;
+
+      /// \brief Wall time of the updates of the steps, as run
+      public: common::Time elapsed;
+
+      /// \brief Sum of the wall time of each update, the time they take
+      /// one after another
+      public: common::Time serial;
+
+      /// \brief Sum over the levels of the longest update of the level,
+      /// the time they take in parallel without overhead
+      public: common::Time criticalPath;
+    };
+
+    /// \brief Destructor, stops the pool and reports the time saved.
+    public: virtual ~DRCUpdateScheduler();
+
+    /// \brief Run an update at each world update begin, in place of
+    /// event::Events::ConnectWorldUpdateBegin.
+    /// \param[in] _name Name of the update, in the reports.
+    /// \param[in] _update Callback.
+    /// \param[in] _access What the update touches.
+    /// \return Connection, the update runs until it is destroyed.
+    public: static DRCUpdateConnectionPtr Connect(const std::string &_name,
+      const UpdateFunction &_update, const DRCUpdateAccess &_access);
+
+    /// \brief Time taken by the updates since the scheduler was created.
+    /// \return Totals over all steps.
+    public: Statistics GetStatistics() const;
+
+    /// \brief Disconnect an update, see DRCUpdateConnection.
+    /// \param[in] _id Id of the update.
+    public: void Disconnect(unsigned int _id);
+
+    /// \brief Constructor, use Connect.
+    private: DRCUpdateScheduler();
+
+    /// \brief Add an update, it runs from the next step on.
+    /// \param[in] _name Name of the update.
+    /// \param[in] _update Callback.
+    /// \param[in] _access What the update touches.
+    /// \return Id of the update.
+    private: unsigned int Add(const std::string &_name,
+      const UpdateFunction &_update, const DRCUpdateAccess &_access);
+
+    /// \brief Run the updates, on the physics thread.
+    /// \param[in] _info Update info of the step.
+    private: void OnWorldUpdateBegin(const common::UpdateInfo &_info);
+
+    /// \brief Apply the connects and disconnects, and split the updates
+    /// in levels.
+    private: void Plan();
+
+    /// \brief Run the updates of the current level until none is left.
+    private: void RunLevel();
+
+    /// \brief Run one update and time it, on either path.  Exceptions are
+    /// logged, so that a failing update doesn't stop the others.
+    /// \param[in] _index Index of the update.
+    private: void RunUpdate(unsigned int _index);
+
+    /// \brief Wait for levels to run, on a thread of the pool.
+    private: void WorkerThread();
+
+    /// \brief Log the time taken and saved.
+    /// \param[in] _stats Time taken.
+    /// \param[in] _what What the statistics cover.
+    private: void Report(const Statistics &_stats,
+                         const std::string &_what) const;
+
+    /// \brief An update.
+    private: class Update
+    {
+      /// \brief Name of the update
+      public: std::string name;
+
+      /// \brief Callback
+      public: UpdateFunction function;
+
+      /// \brief What the update touches
+      public: DRCUpdateAccess access;
+
+      /// \brief Id of the update
+      public: unsigned int id;
+
+      /// \brief Level the update runs in
+      public: unsigned int level;
+
+      /// \brief Wall time of the last run
+      public: common::Time duration;
+
+      /// \brief Wall time of all runs
+      public: common::Time total;
+    };
+
+    /// \brief Protects pending, removed, nextId and the statistics
+    private: mutable boost::mutex connectMutex;
+
+    /// \brief Updates connected since the last step
+    private: std::vector<Update> pending;
+
+    /// \brief Ids of the updates disconnected since the last step
+    private: std::vector<unsigned int> removed;
+
+    /// \brief Id of the next update connected
+    private: unsigned int nextId;
+
+    /// \brief Updates, in the order they were connected
+    private: std::vector<Update> updates;
+
+    /// \brief Indices in updates of the updates of each level
+    private: std::vector<std::vector<unsigned int> > levels;
+
+    /// \brief Info of the step being run
+    private: common::UpdateInfo info;
+
+    /// \brief Protects the members below, shared with the pool
+    private: boost::mutex poolMutex;
+
+    /// \brief Signals a level to the pool
+    private: boost::condition workCondition;
+
+    /// \brief Signals the end of a level to the physics thread
+    private: boost::condition doneCondition;
+
+    /// \brief Level being run, null between levels
+    private: const std::vector<unsigned int> *level;
+
+    /// \brief Index in level of the next update to run
+    private: unsigned int next;
+
+    /// \brief Updates of the level not finished yet
+    private: unsigned int remaining;
+
+    /// \brief Incremented for each level given to the pool
+    private: uint64_t generation;
+
+    /// \brief The pool should exit
+    private: bool stop;
+
+    /// \brief Threads of the pool
+    private: boost::thread_group pool;
+
+    /// \brief Number of threads of the pool
+    private: unsigned int threadCount;
+
+    /// \brief Time taken since the scheduler was created
+    private: Statistics total;
+
+    /// \brief Time taken since the last report
+    private: Statistics window;
+
+    /// \brief Wall time of the last report
+    private: common::Time lastReport;
+
+    /// \brief Connection to the world update begin event
+    private: event::ConnectionPtr updateConnection;
+  };
+  /// \}
+}
+#endif
@@ -17,6 +17,7 @@
 #ifndef GAZEBO_DRC_VEHICLE_PLUGIN_HH
 #define GAZEBO_DRC_VEHICLE_PLUGIN_HH
 
+#include <set>
 #include <string>
 
 #include <boost/thread.hpp>
@@ -27,6 +28,9 @@
 #include <gazebo/common/Time.hh>
 #include <gazebo/common/Plugin.hh>
 #include <gazebo/common/Events.hh>
+
+#include "drcsim_gazebo_plugins/DRCUpdateScheduler.hh"
+#include "drcsim_gazebo_plugins/JointParamWriter.hh"
 #include <gazebo/common/PID.hh>
 
 namespace gazebo
@@ -72,8 +76,8 @@ namespace gazebo
     private: physics::WorldPtr world;
     private: physics::ModelPtr model;
 
-    /// Pointer to the update event connection.
-    private: event::ConnectionPtr updateConnection;
+    /// Connection of UpdateStates to the update scheduler.
+    private: DRCUpdateConnectionPtr updateConnection;
 
     /// \brief Sets DRC Vehicle control inputs, the vehicle internal model
     ///        will decide the overall motion of the vehicle.
@@ -239,6 +243,18 @@ namespace gazebo
     ///        joint limits.
     public: double GetBrakePedalPercent();
 
+    /// \brief Returns whether the kinematic model is driving the vehicle.
+    public: bool IsKinematic();
+
+    /// \brief Returns the sim time the kinematic model has driven the
+    ///        vehicle so far (seconds).
+    public: double GetKinematicTime();
+
+    /// \brief Allow or forbid the kinematic model.  Forbidding it hands
+    ///        the vehicle back to full dynamics at the next update.
+    /// \param[in] _enabled true to allow the kinematic model.
+    public: void SetKinematicEnabled(bool _enabled);
+
     /// Default plugin init call.
     public: virtual void Init();
 
@@ -247,6 +263,38 @@ namespace gazebo
     private: math::Vector3 get_collision_position(physics::LinkPtr _link,
                                                   unsigned int _id);
 
+    /// \brief Switch between full dynamics and the kinematic bicycle
+    /// model, checked at a fixed rate.
+    /// \param[in] _curTime Current simulation time.
+    private: void UpdateKinematicMode(const common::Time &_curTime);
+
+    /// \brief Check whether the kinematic model may drive the vehicle:
+    /// steering nearly straight, moving, level, no other model within
+    /// kinematicClearance and the ground under the wheels unchanged.
+    /// \param[in] _entering true when checking to start the kinematic
+    /// model; records the ground heights and the models to ignore.
+    /// \return true if the kinematic model may be used.
+    private: bool CanUseKinematicModel(bool _entering);
+
+    /// \brief Find the height of the ground under a wheel.
+    /// \param[in] _wheel The wheel link.
+    /// \param[in] _radius The wheel radius.
+    /// \param[out] _height Height of the ground.
+    /// \return false if there's no ground within reach.
+    private: bool GetGroundHeight(physics::LinkPtr _wheel, double _radius,
+                                  double &_height);
+
+    /// \brief Make the chassis and wheels kinematic, or dynamic again.
+    /// Pedals, steering wheel and anything riding follow through joints
+    /// and contacts either way.
+    /// \param[in] _kinematic true to start the kinematic model.
+    private: void SetKinematic(bool _kinematic);
+
+    /// \brief Integrate the kinematic bicycle model and set the chassis
+    /// and wheel velocities.
+    /// \param[in] _dt Time step.
+    private: void UpdateKinematic(double _dt);
+
     /// \brief Transport node used for publishing visual messages.
     private: transport::NodePtr node;
 
@@ -374,6 +422,64 @@ namespace gazebo
     private: double blWheelState;
     private: double brWheelState;
 
+    /// \brief Set stops and stop_cfm on the wheel joints only when they
+    /// change
+    private: JointParamWriter flWheelParams;
+    private: JointParamWriter frWheelParams;
+    private: JointParamWriter blWheelParams;
+    private: JointParamWriter brWheelParams;
+
+    /// \brief Whether the kinematic model may be used, from
+    /// <kinematic_mode> or the DRC_VEHICLE_KINEMATIC environment variable,
+    /// then SetKinematicEnabled
+    private: bool kinematicEnabled;
+
+    /// \brief Whether the kinematic model is driving the vehicle
+    private: bool kinematic;
+
+    /// \brief Sim time driven by the kinematic model (s)
+    private: double kinematicTime;
+
+    /// \brief Distance from other models within which full dynamics are
+    /// used (m)
+    private: double kinematicClearance;
+
+    /// \brief Steered wheel angle above which full dynamics are used (rad)
+    private: double kinematicMaxSteer;
+
+    /// \brief Change in ground height under a wheel that ends the
+    /// kinematic model (m)
+    private: double kinematicGroundTolerance;
+
+    /// \brief Forward speed of the kinematic model (m/s)
+    private: double kinematicSpeed;
+
+    /// \brief Mass driven by the kinematic model (kg)
+    private: double kinematicMass;
+
+    /// \brief Chassis link
+    private: physics::LinkPtr chassisLink;
+
+    /// \brief Forward direction in the chassis frame
+    private: math::Vector3 chassisForward;
+
+    /// \brief Links made kinematic: chassis, steering knuckles, wheels
+    private: physics::Link_V kinematicLinks;
+
+    /// \brief Models that overlapped the vehicle when the kinematic model
+    /// started, e.g. the ground and a rider
+    private: std::set<std::string> kinematicIgnoredModels;
+
+    /// \brief Ground height under each wheel (fl, fr, bl, br) when the
+    /// kinematic model started
+    private: double kinematicGroundHeight[4];
+
+    /// \brief Ray used to find the ground under the wheels
+    private: physics::RayShapePtr groundRay;
+
+    /// \brief Time the kinematic mode was last checked
+    private: common::Time kinematicCheckTime;
+
     /// PID gains
     private: double fLwheelSteeringPgain;
     private: double fRwheelSteeringPgain;
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef GAZEBO_JOINT_PARAM_WRITER_HH
+#define GAZEBO_JOINT_PARAM_WRITER_HH
+
+#include <map>
+#include <string>
+#include <utility>
+
+#include <gazebo/physics/physics.hh>
+
+namespace gazebo
+{
+  /// \addtogroup drc_plugin
+  /// \{
+
+  /// \brief Sets joint limits, damping and physics engine parameters
+  /// (stop_cfm, stop_erp, ...), but only when the value changes.  Each of
+  /// these calls can make the physics engine rebuild the joint's
+  /// constraint data, so plugins that set them from their update loop
+  /// should go through a writer instead of calling the joint directly.
+  class JointParamWriter
+  {
+    /// \brief Constructor
+    public: JointParamWriter();
+
+    /// \brief Constructor
+    /// \param[in] _joint Joint to write to.
+    public: explicit JointParamWriter(physics::JointPtr _joint);
+
+    /// \brief Set the joint to write to, and forget the values written.
+    /// \param[in] _joint Joint to write to.
+    public: void SetJoint(physics::JointPtr _joint);
+
+    /// \brief Get the joint written to.
+    public: physics::JointPtr GetJoint() const;
+
+    /// \brief Set the upper limit of an axis.
+    /// \param[in] _index Axis index.
+    /// \param[in] _angle Limit.
+    public: void SetHighStop(unsigned int _index, const math::Angle &_angle);
+
+    /// \brief Set the lower limit of an axis.
+    /// \param[in] _index Axis index.
+    /// \param[in] _angle Limit.
+    public: void SetLowStop(unsigned int _index, const math::Angle &_angle);
+
+    /// \brief Set the viscous damping of an axis.
+    /// \param[in] _index Axis index.
+    /// \param[in] _damping Damping coefficient.
+    public: void SetDamping(unsigned int _index, double _damping);
+
+    /// \brief Set a physics engine parameter of an axis, see
+    /// Joint::SetParam.
+    /// \param[in] _key Parameter name, e.g. "stop_cfm".
+    /// \param[in] _index Axis index.
+    /// \param[in] _value Parameter value.
+    public: void SetParam(const std::string &_key, unsigned int _index,
+                          double _value);
+
+    /// \brief Forget the values written, so the next write of each goes
+    /// through.  Use when something else may have changed the joint.
+    public: void Reset();
+
+    /// \brief Number of writes passed on to the joint.
+    public: unsigned int GetWriteCount() const;
+
+    /// \brief Number of writes dropped because the value didn't change.
+    public: unsigned int GetSuppressedCount() const;
+
+    /// \brief Record a value, and check whether it changed.
+    /// \param[in] _key Name of the value.
+    /// \param[in] _index Axis index.
+    /// \param[in] _value New value.
+    /// \return true if the value should be written to the joint.
+    private: bool Update(const std::string &_key, unsigned int _index,
+                         double _value);
+
+    /// \brief Joint to write to
+    private: physics::JointPtr joint;
+
+    /// \brief Last value written for each name and axis
+    private: std::map<std::pair<std::string, unsigned int>, double> values;
+
+    /// \brief Number of writes passed on to the joint
+    private: unsigned int writeCount;
+
+    /// \brief Number of writes dropped
+    private: unsigned int suppressedCount;
+  };
+  /// \}
+}
+#endif
@@ -25,6 +25,7 @@ DRCBuildingPlugin::DRCBuildingPlugin()
 {
   this->doorCmd = 0;
   this->handleCmd = 0;
+  this->doorLatched = true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -69,8 +70,10 @@ void DRCBuildingPlugin::Load(physics::ModelPtr _parent,
     return;
   }
 
-  this->doorJoint->SetHighStop(0, 0);
-  this->doorJoint->SetLowStop(0, 0);
+  this->doorJointParams.SetJoint(this->doorJoint);
+  this->doorJointParams.SetHighStop(0, 0);
+  this->doorJointParams.SetLowStop(0, 0);
+  this->doorLatched = true;
 
   this->doorPID.Init(200, 1, 20, 10, -10, 50, -50);
   this->handlePID.Init(80, 1, 1, 3, -3, 5, -5);
@@ -108,18 +111,24 @@ void DRCBuildingPlugin::UpdateStates()
     // simulate door latch/lock
     if ((fabs(this->handleState) < 0.02) && (fabs(this->doorState)   < 0.02))
     {
-      this->doorJoint->SetHighStop(0, 0);
-      this->doorJoint->SetLowStop(0, 0);
+      this->doorJointParams.SetHighStop(0, 0);
+      this->doorJointParams.SetLowStop(0, 0);
+      // Snap the door shut as it latches; the stops hold it there after
+      if (!this->doorLatched)
+      {
 #if GAZEBO_MAJOR_VERSION >= 4
-      this->doorJoint->SetPosition(0, 0);
+        this->doorJoint->SetPosition(0, 0);
 #else
-      this->doorJoint->SetAngle(0, 0);
+        this->doorJoint->SetAngle(0, 0);
 #endif
+        this->doorLatched = true;
+      }
     }
     else
     {
-      this->doorJoint->SetHighStop(0, 1.5708);
-      this->doorJoint->SetLowStop(0, -1.5708);
+      this->doorJointParams.SetHighStop(0, 1.5708);
+      this->doorJointParams.SetLowStop(0, -1.5708);
+      this->doorLatched = false;
     }
 
     this->lastTime = curTime;
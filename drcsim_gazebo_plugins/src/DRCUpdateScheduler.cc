@@ -0,0 +1,440 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/weak_ptr.hpp>
+#include <gazebo/common/Console.hh>
+
+#include "drcsim_gazebo_plugins/DRCUpdateScheduler.hh"
+
+using namespace gazebo;
+
+namespace
+{
+  /// \brief The scheduler, alive while updates are connected
+  boost::weak_ptr<DRCUpdateScheduler> instance;
+
+  /// \brief Protects instance
+  boost::mutex instanceMutex;
+
+  /// \brief Most threads in the pool
+  const int MAX_THREADS = 32;
+
+  /// \brief Wall seconds between reports in the log
+  const double REPORT_PERIOD = 10.0;
+}
+
+/////////////////////////////////////////////////
+DRCUpdateAccess::DRCUpdateAccess()
+  : exclusive(false)
+{
+}
+
+/////////////////////////////////////////////////
+DRCUpdateAccess &DRCUpdateAccess::Read(const std::string &_resource)
+{
+  this->reads.insert(_resource);
+  return *this;
+}
+
+/////////////////////////////////////////////////
+DRCUpdateAccess &DRCUpdateAccess::Write(const std::string &_resource)
+{
+  this->writes.insert(_resource);
+  return *this;
+}
+
+/////////////////////////////////////////////////
+DRCUpdateAccess &DRCUpdateAccess::WriteJoint(physics::JointPtr _joint)
+{
+  if (!_joint)
+    return *this;
+  if (_joint->GetParent())
+    this->Write(_joint->GetParent()->GetScopedName());
+  if (_joint->GetChild())
+    this->Write(_joint->GetChild()->GetScopedName());
+  return *this;
+}
+
+/////////////////////////////////////////////////
+DRCUpdateAccess &DRCUpdateAccess::WriteJoints(
+  const physics::Joint_V &_joints)
+{
+  for (unsigned int i = 0; i < _joints.size(); ++i)
+    this->WriteJoint(_joints[i]);
+  return *this;
+}
+
+/////////////////////////////////////////////////
+DRCUpdateAccess &DRCUpdateAccess::Exclusive()
+{
+  this->exclusive = true;
+  return *this;
+}
+
+/////////////////////////////////////////////////
+bool DRCUpdateAccess::ConflictsWith(const DRCUpdateAccess &_other) const
+{
+  if (this->exclusive || _other.exclusive)
+    return true;
+
+  for (std::set<std::string>::const_iterator iter = this->writes.begin();
+       iter != this->writes.end(); ++iter)
+  {
+    if (_other.writes.count(*iter) || _other.reads.count(*iter))
+      return true;
+  }
+  for (std::set<std::string>::const_iterator iter = this->reads.begin();
+       iter != this->reads.end(); ++iter)
+  {
+    if (_other.writes.count(*iter))
+      return true;
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////
+DRCUpdateConnection::DRCUpdateConnection(
+  boost::shared_ptr<DRCUpdateScheduler> _scheduler, unsigned int _id)
+  : scheduler(_scheduler), id(_id)
+{
+}
+
+/////////////////////////////////////////////////
+DRCUpdateConnection::~DRCUpdateConnection()
+{
+  this->scheduler->Disconnect(this->id);
+}
+
+/////////////////////////////////////////////////
+DRCUpdateScheduler::Statistics::Statistics()
+  : steps(0)
+{
+}
+
+/////////////////////////////////////////////////
+DRCUpdateScheduler::DRCUpdateScheduler()
+  : nextId(0), level(NULL), next(0), remaining(0), generation(0),
+    stop(false), threadCount(0)
+{
+  const char *threads = getenv("DRC_UPDATE_THREADS");
+  if (threads)
+    this->threadCount = std::max(0, std::min(atoi(threads), MAX_THREADS));
+
+  for (unsigned int i = 0; i < this->threadCount; ++i)
+  {
+    this->pool.create_thread(
+      boost::bind(&DRCUpdateScheduler::WorkerThread, this));
+  }
+
+  this->lastReport = common::Time::GetWallTime();
+  this->updateConnection = event::Events::ConnectWorldUpdateBegin(
+    boost::bind(&DRCUpdateScheduler::OnWorldUpdateBegin, this, _1));
+}
+
+/////////////////////////////////////////////////
+DRCUpdateScheduler::~DRCUpdateScheduler()
+{
+  event::Events::DisconnectWorldUpdateBegin(this->updateConnection);
+
+  {
+    boost::mutex::scoped_lock lock(this->poolMutex);
+    this->stop = true;
+    this->workCondition.notify_all();
+  }
+  this->pool.join_all();
+
+  this->Report(this->total, "total");
+  for (unsigned int i = 0; i < this->updates.size() &&
+       this->total.steps > 0; ++i)
+  {
+    gzmsg << "  " << this->updates[i].name << ", level "
+          << this->updates[i].level << ": "
+          << this->updates[i].total.Double() / this->total.steps * 1e6
+          << " us per step" << std::endl;
+  }
+}
+
+/////////////////////////////////////////////////
+DRCUpdateConnectionPtr DRCUpdateScheduler::Connect(const std::string &_name,
+  const UpdateFunction &_update, const DRCUpdateAccess &_access)
+{
+  boost::shared_ptr<DRCUpdateScheduler> scheduler;
+  {
+    boost::mutex::scoped_lock lock(instanceMutex);
+    scheduler = instance.lock();
+    if (!scheduler)
+    {
+      scheduler.reset(new DRCUpdateScheduler());
+      instance = scheduler;
+    }
+  }
+
+  unsigned int id = scheduler->Add(_name, _update, _access);
+  return DRCUpdateConnectionPtr(new DRCUpdateConnection(scheduler, id));
+}
+
+/////////////////////////////////////////////////
+DRCUpdateScheduler::Statistics DRCUpdateScheduler::GetStatistics() const
+{
+  boost::mutex::scoped_lock lock(this->connectMutex);
+  return this->total;
+}
+
+/////////////////////////////////////////////////
+unsigned int DRCUpdateScheduler::Add(const std::string &_name,
+  const UpdateFunction &_update, const DRCUpdateAccess &_access)
+{
+  boost::mutex::scoped_lock lock(this->connectMutex);
+  Update update;
+  update.name = _name;
+  update.function = _update;
+  update.access = _access;
+  update.id = this->nextId++;
+  update.level = 0;
+  this->pending.push_back(update);
+  return update.id;
+}
+
+/////////////////////////////////////////////////
+void DRCUpdateScheduler::Disconnect(unsigned int _id)
+{
+  boost::mutex::scoped_lock lock(this->connectMutex);
+  this->removed.push_back(_id);
+}
+
+/////////////////////////////////////////////////
+void DRCUpdateScheduler::Plan()
+{
+  {
+    boost::mutex::scoped_lock lock(this->connectMutex);
+    if (this->pending.empty() && this->removed.empty())
+      return;
+
+    this->updates.insert(this->updates.end(), this->pending.begin(),
+                         this->pending.end());
+    this->pending.clear();
+    for (unsigned int i = 0; i < this->removed.size(); ++i)
+    {
+      for (std::vector<Update>::iterator iter = this->updates.begin();
+           iter != this->updates.end(); ++iter)
+      {
+        if (iter->id == this->removed[i])
+        {
+          this->updates.erase(iter);
+          break;
+        }
+      }
+    }
+    this->removed.clear();
+  }
+
+  // each update goes after the last update it conflicts with
+  this->levels.clear();
+  for (unsigned int i = 0; i < this->updates.size(); ++i)
+  {
+    unsigned int level = 0;
+    for (unsigned int j = 0; j < i; ++j)
+    {
+      if (this->updates[i].access.ConflictsWith(this->updates[j].access))
+        level = std::max(level, this->updates[j].level + 1);
+    }
+    this->updates[i].level = level;
+    if (level >= this->levels.size())
+      this->levels.resize(level + 1);
+    this->levels[level].push_back(i);
+  }
+
+  gzlog << "DRCUpdateScheduler: " << this->updates.size() << " updates in "
+        << this->levels.size() << " levels, " << this->threadCount
+        << " threads" << std::endl;
+  for (unsigned int i = 0; i < this->updates.size(); ++i)
+  {
+    gzlog << "  " << this->updates[i].name << ", level "
+          << this->updates[i].level << std::endl;
+  }
+}
+
+/////////////////////////////////////////////////
+void DRCUpdateScheduler::OnWorldUpdateBegin(const common::UpdateInfo &_info)
+{
+  this->Plan();
+
+  common::Time start = common::Time::GetWallTime();
+  common::Time serial, criticalPath;
+  this->info = _info;
+
+  for (unsigned int l = 0; l < this->levels.size(); ++l)
+  {
+    const std::vector<unsigned int> &updatesOfLevel = this->levels[l];
+    if (this->threadCount == 0 || updatesOfLevel.size() == 1)
+    {
+      for (unsigned int i = 0; i < updatesOfLevel.size(); ++i)
+        this->RunUpdate(updatesOfLevel[i]);
+    }
+    else
+    {
+      {
+        boost::mutex::scoped_lock lock(this->poolMutex);
+        this->level = &updatesOfLevel;
+        this->next = 0;
+        this->remaining = updatesOfLevel.size();
+        ++this->generation;
+        this->workCondition.notify_all();
+      }
+
+      // the physics thread takes updates like the pool
+      this->RunLevel();
+
+      boost::mutex::scoped_lock lock(this->poolMutex);
+      while (this->remaining > 0)
+        this->doneCondition.wait(lock);
+      this->level = NULL;
+    }
+
+    common::Time longest;
+    for (unsigned int i = 0; i < updatesOfLevel.size(); ++i)
+    {
+      const common::Time &duration = this->updates[updatesOfLevel[i]].duration;
+      serial += duration;
+      if (duration > longest)
+        longest = duration;
+    }
+    criticalPath += longest;
+  }
+
+  common::Time end = common::Time::GetWallTime();
+  {
+    boost::mutex::scoped_lock lock(this->connectMutex);
+    Statistics *stats[2] = {&this->total, &this->window};
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+      ++stats[i]->steps;
+      stats[i]->elapsed += end - start;
+      stats[i]->serial += serial;
+      stats[i]->criticalPath += criticalPath;
+    }
+  }
+
+  if ((end - this->lastReport).Double() >= REPORT_PERIOD)
+  {
+    this->Report(this->window, "last period");
+    this->window = Statistics();
+    this->lastReport = end;
+  }
+}
+
+/////////////////////////////////////////////////
+void DRCUpdateScheduler::RunLevel()
+{
+  while (true)
+  {
+    unsigned int index;
+    {
+      boost::mutex::scoped_lock lock(this->poolMutex);
+      if (!this->level || this->next >= this->level->size())
+        return;
+      index = (*this->level)[this->next++];
+    }
+
+    this->RunUpdate(index);
+
+    boost::mutex::scoped_lock lock(this->poolMutex);
+    if (--this->remaining == 0)
+      this->doneCondition.notify_all();
+  }
+}
+
+/////////////////////////////////////////////////
+void DRCUpdateScheduler::RunUpdate(unsigned int _index)
+{
+  Update &update = this->updates[_index];
+  common::Time updateStart = common::Time::GetWallTime();
+  try
+  {
+    update.function(this->info);
+  }
+  catch(std::exception &_e)
+  {
+    gzerr << "Update " << update.name << " failed: " << _e.what()
+          << std::endl;
+  }
+  update.duration = common::Time::GetWallTime() - updateStart;
+  update.total += update.duration;
+}
+
+/////////////////////////////////////////////////
+void DRCUpdateScheduler::WorkerThread()
+{
+  boost::mutex::scoped_lock lock(this->poolMutex);
+  uint64_t seen = this->generation;
+  while (true)
+  {
+    while (!this->stop && this->generation == seen)
+      this->workCondition.wait(lock);
+    if (this->stop)
+      return;
+    seen = this->generation;
+
+    lock.unlock();
+    this->RunLevel();
+    lock.lock();
+  }
+}
+
+/////////////////////////////////////////////////
+void DRCUpdateScheduler::Report(const Statistics &_stats,
+  const std::string &_what) const
+{
+  if (_stats.steps == 0 || _stats.serial.Double() <= 0.0)
+    return;
+
+  double steps = _stats.steps;
+  double elapsed = _stats.elapsed.Double();
+  double serial = _stats.serial.Double();
+  double criticalPath = _stats.criticalPath.Double();
+
+  std::ostringstream stream;
+  stream << "DRCUpdateScheduler " << _what << ": " << _stats.steps
+         << " steps, " << this->updates.size() << " updates in "
+         << this->levels.size() << " levels, per step the updates took "
+         << elapsed / steps * 1e6 << " us, "
+         << serial / steps * 1e6 << " us one after another, critical path "
+         << criticalPath / steps * 1e6 << " us, ";
+  if (this->threadCount > 0)
+  {
+    stream << "saved " << 100.0 * (1.0 - elapsed / serial) << "% with "
+           << this->threadCount << " threads";
+  }
+  else
+  {
+    stream << "up to " << 100.0 * (1.0 - criticalPath / serial)
+           << "% to save with DRC_UPDATE_THREADS";
+  }
+
+  if (_what == "total")
+    gzmsg << stream.str() << std::endl;
+  else
+    gzlog << stream.str() << std::endl;
+}
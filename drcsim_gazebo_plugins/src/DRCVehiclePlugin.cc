@@ -16,9 +16,13 @@
 */
 
 #include <math.h>
+#include <stdlib.h>
+#include <algorithm>
 #include <gazebo/common/common.hh>
 #include <gazebo/physics/Base.hh>
 #include <gazebo/physics/CylinderShape.hh>
+#include <gazebo/physics/PhysicsEngine.hh>
+#include <gazebo/physics/RayShape.hh>
 #include <gazebo/physics/SphereShape.hh>
 #include <gazebo/transport/transport.hh>
 
@@ -72,13 +76,33 @@ DRCVehiclePlugin::DRCVehiclePlugin()
   this->fRwheelSteeringIgain = 0;
   this->fLwheelSteeringDgain = 0;
   this->fRwheelSteeringDgain = 0;
+
+  this->kinematicEnabled = false;
+  this->kinematic = false;
+  this->kinematicTime = 0;
+  this->kinematicClearance = 3.0;
+  this->kinematicMaxSteer = 0.05;
+  this->kinematicGroundTolerance = 0.02;
+  this->kinematicSpeed = 0;
+  this->kinematicMass = 0;
+  for (unsigned int i = 0; i < 4; ++i)
+    this->kinematicGroundHeight[i] = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Whether two axis aligned boxes overlap
+static bool BoxesOverlap(const math::Box &_a, const math::Box &_b)
+{
+  return _a.min.x <= _b.max.x && _a.max.x >= _b.min.x &&
+         _a.min.y <= _b.max.y && _a.max.y >= _b.min.y &&
+         _a.min.z <= _b.max.z && _a.max.z >= _b.min.z;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // Destructor
 DRCVehiclePlugin::~DRCVehiclePlugin()
 {
-  event::Events::DisconnectWorldUpdateBegin(this->updateConnection);
+  this->updateConnection.reset();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -663,30 +687,63 @@ void DRCVehiclePlugin::Load(physics::ModelPtr _parent,
   else
     this->fRwheelSteeringDgain = paramDefault;
 
+  // Kinematic bicycle model, used on long straight stretches of road
+  if (_sdf->HasElement("kinematic_mode"))
+    this->kinematicEnabled = _sdf->Get<bool>("kinematic_mode");
+  const char *kinematicEnv = getenv("DRC_VEHICLE_KINEMATIC");
+  if (kinematicEnv)
+    this->kinematicEnabled = std::string(kinematicEnv) == "1";
+
+  paramName = "kinematic_clearance";
+  paramDefault = 3.0;
+  if (_sdf->HasElement(paramName))
+    this->kinematicClearance = _sdf->Get<double>(paramName);
+  else
+    this->kinematicClearance = paramDefault;
+
+  paramName = "kinematic_max_steer";
+  paramDefault = 0.05;
+  if (_sdf->HasElement(paramName))
+    this->kinematicMaxSteer = _sdf->Get<double>(paramName);
+  else
+    this->kinematicMaxSteer = paramDefault;
+
+  paramName = "kinematic_ground_tolerance";
+  paramDefault = 0.02;
+  if (_sdf->HasElement(paramName))
+    this->kinematicGroundTolerance = _sdf->Get<double>(paramName);
+  else
+    this->kinematicGroundTolerance = paramDefault;
+
   this->UpdateHandWheelRatio();
 
+  this->flWheelParams.SetJoint(this->flWheelJoint);
+  this->frWheelParams.SetJoint(this->frWheelJoint);
+  this->blWheelParams.SetJoint(this->blWheelJoint);
+  this->brWheelParams.SetJoint(this->brWheelJoint);
+
   // Simulate braking using joint stops with stop_erp = 0
-  this->flWheelJoint->SetHighStop(0, 0);
-  this->frWheelJoint->SetHighStop(0, 0);
-  this->blWheelJoint->SetHighStop(0, 0);
-  this->brWheelJoint->SetHighStop(0, 0);
+  this->flWheelParams.SetHighStop(0, 0);
+  this->frWheelParams.SetHighStop(0, 0);
+  this->blWheelParams.SetHighStop(0, 0);
+  this->brWheelParams.SetHighStop(0, 0);
 
-  this->flWheelJoint->SetLowStop(0, 0);
-  this->frWheelJoint->SetLowStop(0, 0);
-  this->blWheelJoint->SetLowStop(0, 0);
-  this->brWheelJoint->SetLowStop(0, 0);
+  this->flWheelParams.SetLowStop(0, 0);
+  this->frWheelParams.SetLowStop(0, 0);
+  this->blWheelParams.SetLowStop(0, 0);
+  this->brWheelParams.SetLowStop(0, 0);
 
   // stop_erp == 0 means no position correction torques will act
-  this->flWheelJoint->SetParam("stop_erp", 0, 0.0);
-  this->frWheelJoint->SetParam("stop_erp", 0, 0.0);
-  this->blWheelJoint->SetParam("stop_erp", 0, 0.0);
-  this->brWheelJoint->SetParam("stop_erp", 0, 0.0);
+  this->flWheelParams.SetParam("stop_erp", 0, 0.0);
+  this->frWheelParams.SetParam("stop_erp", 0, 0.0);
+  this->blWheelParams.SetParam("stop_erp", 0, 0.0);
+  this->brWheelParams.SetParam("stop_erp", 0, 0.0);
 
   // stop_cfm == 10 means the joints will initially have small damping
-  this->flWheelJoint->SetParam("stop_cfm", 0, 10.0);
-  this->frWheelJoint->SetParam("stop_cfm", 0, 10.0);
-  this->blWheelJoint->SetParam("stop_cfm", 0, 10.0);
-  this->brWheelJoint->SetParam("stop_cfm", 0, 10.0);
+  this->flWheelParams.SetParam("stop_cfm", 0, 10.0);
+  this->frWheelParams.SetParam("stop_cfm", 0, 10.0);
+  this->blWheelParams.SetParam("stop_cfm", 0, 10.0);
+  this->brWheelParams.SetParam("stop_cfm", 0, 10.0);
 
   // Update wheel radius for each wheel from SDF collision objects
   //  assumes that wheel link is child of joint (and not parent of joint)
@@ -728,6 +785,43 @@ void DRCVehiclePlugin::Load(physics::ModelPtr _parent,
   // gzerr << wheelbaseLength << " " << frontTrackWidth
   //       << " " << backTrackWidth << "\n";
 
+  // The kinematic model moves the chassis, steering knuckles and wheels;
+  // assumes the steering joints' parent is the chassis
+  this->chassisLink = this->flWheelSteeringJoint->GetParent();
+  physics::LinkPtr movingLinks[7] = {this->chassisLink,
+    this->flWheelSteeringJoint->GetChild(),
+    this->frWheelSteeringJoint->GetChild(),
+    this->flWheelJoint->GetChild(), this->frWheelJoint->GetChild(),
+    this->blWheelJoint->GetChild(), this->brWheelJoint->GetChild()};
+  for (unsigned int i = 0; i < 7; ++i)
+  {
+    if (movingLinks[i] && std::find(this->kinematicLinks.begin(),
+          this->kinematicLinks.end(), movingLinks[i]) ==
+        this->kinematicLinks.end())
+      this->kinematicLinks.push_back(movingLinks[i]);
+  }
+  if (this->chassisLink)
+  {
+    physics::Link_V links = this->chassisLink->GetModel()->GetLinks();
+    for (physics::Link_V::iterator li = links.begin(); li != links.end(); ++li)
+      this->kinematicMass += (*li)->GetInertial()->GetMass();
+    this->chassisForward = this->chassisLink->GetWorldPose().rot
+      .RotateVectorReverse(frontAxlePos - backAxlePos).Normalize();
+  }
+  // set up even when disabled, the model may be enabled later, see
+  // SetKinematicEnabled
+  if (this->chassisLink)
+  {
+    this->groundRay = boost::dynamic_pointer_cast<physics::RayShape>(
+      this->world->GetPhysicsEngine()->CreateShape("ray",
+        physics::CollisionPtr()));
+  }
+  if (this->kinematicEnabled && (!this->chassisLink || !this->groundRay))
+  {
+    gzwarn << "Unable to set up the vehicle's kinematic model\n";
+    this->kinematicEnabled = false;
+  }
+
   // initialize controllers for car
   /// \TODO: move PID parameters into SDF
   this->gasPedalPID.Init(800, 0, 0, 0, 0,
@@ -751,11 +845,11 @@ void DRCVehiclePlugin::Load(physics::ModelPtr _parent,
                                 0, 0, this->steeredWheelForce,
                                 -this->steeredWheelForce);
 
-  // New Mechanism for Updating every World Cycle
-  // Listen to the update event. This event is broadcast every
-  // simulation iteration.
-  this->updateConnection = event::Events::ConnectWorldUpdateBegin(
-      boost::bind(&DRCVehiclePlugin::UpdateStates, this));
+  // Update every World Cycle.  UpdateStates may make the vehicle
+  // kinematic and set its velocities, nothing runs with it.
+  this->updateConnection = DRCUpdateScheduler::Connect("DRCVehiclePlugin",
+      boost::bind(&DRCVehiclePlugin::UpdateStates, this),
+      DRCUpdateAccess().Exclusive());
 
   this->lastTime = this->world->GetSimTime();
   this->handBrakeTime = this->lastTime;
@@ -848,6 +942,24 @@ void DRCVehiclePlugin::UpdateStates()
     double brakeCmd = this->brakePedalPID.Update(brakeError, dt);
     this->brakePedalJoint->SetForce(0, brakeCmd);
 
+    if (this->kinematicEnabled)
+      this->UpdateKinematicMode(curTime);
+    else if (this->kinematic)
+    {
+      gzlog << "Vehicle kinematic model disabled, switching to full "
+            << "dynamics\n";
+      this->SetKinematic(false);
+    }
+
+    // The kinematic model replaces the steering and wheel torques
+    if (this->kinematic)
+    {
+      this->UpdateKinematic(dt);
+      this->kinematicTime += dt;
+      this->lastTime = curTime;
+      return;
+    }
+
     // PID (position) steering joints based on steering position
     // Ackermann steering geometry here
     //  \TODO provide documentation for these equations
@@ -914,24 +1026,24 @@ void DRCVehiclePlugin::UpdateStates()
 
     // Lock wheels if high braking applied at low speed
     if (brakePercent > 0.7 && fabs(this->flWheelState) < smoothingSpeed)
-      this->flWheelJoint->SetParam("stop_cfm", 0, 0.0);
+      this->flWheelParams.SetParam("stop_cfm", 0, 0.0);
     else
-      this->flWheelJoint->SetParam("stop_cfm", 0, 1.0);
+      this->flWheelParams.SetParam("stop_cfm", 0, 1.0);
 
     if (brakePercent > 0.7 && fabs(this->frWheelState) < smoothingSpeed)
-      this->frWheelJoint->SetParam("stop_cfm", 0, 0.0);
+      this->frWheelParams.SetParam("stop_cfm", 0, 0.0);
     else
-      this->frWheelJoint->SetParam("stop_cfm", 0, 1.0);
+      this->frWheelParams.SetParam("stop_cfm", 0, 1.0);
 
     if (brakePercent > 0.7 && fabs(this->blWheelState) < smoothingSpeed)
-      this->blWheelJoint->SetParam("stop_cfm", 0, 0.0);
+      this->blWheelParams.SetParam("stop_cfm", 0, 0.0);
     else
-      this->blWheelJoint->SetParam("stop_cfm", 0, 1.0);
+      this->blWheelParams.SetParam("stop_cfm", 0, 1.0);
 
     if (brakePercent > 0.7 && fabs(this->brWheelState) < smoothingSpeed)
-      this->brWheelJoint->SetParam("stop_cfm", 0, 0.0);
+      this->brWheelParams.SetParam("stop_cfm", 0, 0.0);
     else
-      this->brWheelJoint->SetParam("stop_cfm", 0, 1.0);
+      this->brWheelParams.SetParam("stop_cfm", 0, 1.0);
 
     this->flWheelJoint->SetForce(0, flGasTorque + flBrakeTorque);
     this->frWheelJoint->SetForce(0, frGasTorque + frBrakeTorque);
@@ -953,10 +1065,273 @@ void DRCVehiclePlugin::UpdateStates()
   else if (dt < 0)
   {
     // has time been reset?
+    this->SetKinematic(false);
+    this->kinematicCheckTime = curTime;
     this->lastTime = curTime;
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool DRCVehiclePlugin::IsKinematic()
+{
+  return this->kinematic;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+double DRCVehiclePlugin::GetKinematicTime()
+{
+  return this->kinematicTime;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void DRCVehiclePlugin::SetKinematicEnabled(bool _enabled)
+{
+  if (_enabled && (!this->chassisLink || !this->groundRay))
+  {
+    gzwarn << "Unable to set up the vehicle's kinematic model\n";
+    return;
+  }
+  this->kinematicEnabled = _enabled;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void DRCVehiclePlugin::UpdateKinematicMode(const common::Time &_curTime)
+{
+  // The checks look at every model and cast rays, so don't run every step
+  if ((_curTime - this->kinematicCheckTime).Double() < 0.1)
+    return;
+  this->kinematicCheckTime = _curTime;
+
+  if (this->kinematic)
+  {
+    if (!this->CanUseKinematicModel(false))
+    {
+      gzlog << "Vehicle switching to full dynamics\n";
+      this->SetKinematic(false);
+    }
+  }
+  else if (this->CanUseKinematicModel(true))
+  {
+    gzlog << "Vehicle switching to kinematic model\n";
+    this->SetKinematic(true);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool DRCVehiclePlugin::CanUseKinematicModel(bool _entering)
+{
+  if (this->keyState != ON)
+    return false;
+
+  // Nearly straight
+  if (fabs(this->handWheelState * this->steeringRatio) >
+      this->kinematicMaxSteer)
+    return false;
+
+  // Moving; starting and stopping are left to full dynamics, for the
+  // wheel locks
+  math::Pose chassisPose = this->chassisLink->GetWorldPose();
+  math::Vector3 forward = chassisPose.rot.RotateVector(this->chassisForward);
+  double speed = this->kinematicSpeed;
+  if (!this->kinematic)
+    speed = this->chassisLink->GetWorldLinearVel().Dot(forward);
+  if (fabs(speed) < (_entering ? 1.0 : 0.5))
+    return false;
+
+  // Settled on its wheels
+  if (_entering)
+  {
+    math::Vector3 linVel = this->chassisLink->GetWorldLinearVel();
+    math::Vector3 angVel = this->chassisLink->GetWorldAngularVel();
+    if (fabs(angVel.x) > 0.1 || fabs(angVel.y) > 0.1 || fabs(linVel.z) > 0.1)
+      return false;
+  }
+
+  // Clear of other models.  Models that contain the vehicle's footprint
+  // (the ground) or are contained in it (a rider) when the kinematic model
+  // starts are ignored.
+  math::Box box = this->model->GetBoundingBox();
+  math::Vector3 margin(this->kinematicClearance, this->kinematicClearance,
+                       this->kinematicClearance);
+  math::Box clearBox(box.min - margin, box.max + margin);
+  std::set<std::string> ignoredModels;
+  physics::Model_V models = this->world->GetModels();
+  for (physics::Model_V::iterator mi = models.begin(); mi != models.end();
+       ++mi)
+  {
+    if (*mi == this->model)
+      continue;
+
+    std::string name = (*mi)->GetName();
+    if (!_entering && this->kinematicIgnoredModels.count(name) > 0)
+      continue;
+
+    math::Box other = (*mi)->GetBoundingBox();
+    if (_entering && BoxesOverlap(box, other))
+    {
+      bool ground = other.min.x <= box.min.x && other.max.x >= box.max.x &&
+                    other.min.y <= box.min.y && other.max.y >= box.max.y;
+      bool rider = other.min.x >= box.min.x && other.max.x <= box.max.x &&
+                   other.min.y >= box.min.y && other.max.y <= box.max.y;
+      if (ground || rider)
+      {
+        ignoredModels.insert(name);
+        continue;
+      }
+    }
+
+    if (BoxesOverlap(clearBox, other))
+      return false;
+  }
+
+  // Same ground under the wheels
+  physics::LinkPtr wheels[4] = {this->flWheelJoint->GetChild(),
+    this->frWheelJoint->GetChild(), this->blWheelJoint->GetChild(),
+    this->brWheelJoint->GetChild()};
+  double radii[4] = {this->flWheelRadius, this->frWheelRadius,
+    this->blWheelRadius, this->brWheelRadius};
+  double heights[4];
+  for (unsigned int i = 0; i < 4; ++i)
+  {
+    if (!this->GetGroundHeight(wheels[i], radii[i], heights[i]))
+      return false;
+    if (!_entering && fabs(heights[i] - this->kinematicGroundHeight[i]) >
+        this->kinematicGroundTolerance)
+      return false;
+  }
+
+  if (_entering)
+  {
+    for (unsigned int i = 0; i < 4; ++i)
+      this->kinematicGroundHeight[i] = heights[i];
+    this->kinematicIgnoredModels = ignoredModels;
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool DRCVehiclePlugin::GetGroundHeight(physics::LinkPtr _wheel,
+                                       double _radius, double &_height)
+{
+  // The ray starts at the wheel center, so skip past the vehicle itself
+  std::string prefix = this->model->GetScopedName() + "::";
+  math::Vector3 start = this->get_collision_position(_wheel, 0);
+  double reach = _radius + 0.3;
+  for (unsigned int i = 0; i < 3 && reach > 0; ++i)
+  {
+    double dist;
+    std::string entity;
+    this->groundRay->SetPoints(start, start - math::Vector3(0, 0, reach));
+    this->groundRay->GetIntersection(dist, entity);
+    if (entity.empty() || dist > reach)
+      return false;
+
+    if (entity.compare(0, prefix.size(), prefix) != 0)
+    {
+      _height = start.z - dist;
+      return true;
+    }
+
+    start.z -= dist + 0.001;
+    reach -= dist + 0.001;
+  }
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void DRCVehiclePlugin::SetKinematic(bool _kinematic)
+{
+  if (_kinematic == this->kinematic)
+    return;
+
+  if (_kinematic)
+  {
+    math::Vector3 forward = this->chassisLink->GetWorldPose().rot
+      .RotateVector(this->chassisForward);
+    this->kinematicSpeed = this->chassisLink->GetWorldLinearVel().Dot(forward);
+  }
+
+  for (physics::Link_V::iterator li = this->kinematicLinks.begin();
+       li != this->kinematicLinks.end(); ++li)
+  {
+    (*li)->SetKinematic(_kinematic);
+  }
+  this->kinematic = _kinematic;
+
+  // The links keep the velocities last set on them, so full dynamics pick
+  // up where the kinematic model left off
+  if (_kinematic)
+    this->UpdateKinematic(0.0);
+  else
+  {
+    this->flWheelSteeringPID.Reset();
+    this->frWheelSteeringPID.Reset();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void DRCVehiclePlugin::UpdateKinematic(double _dt)
+{
+  // Longitudinal: the gas and brake torques of all four wheels, acting on
+  // the whole vehicle through the back wheel radius
+  double radius = this->blWheelRadius;
+  double gasTorque = 0;
+  if (fabs(this->kinematicSpeed) < this->maxSpeed)
+  {
+    gasTorque = this->GetGasPedalPercent() * this->GetGasTorqueMultiplier() *
+      2 * (this->frontTorque + this->backTorque);
+  }
+  double brakePercent = math::clamp(this->GetBrakePedalPercent() +
+    this->GetHandBrakePercent(), this->minBrakePercent, 1.0);
+  double smoothingSpeed = 0.5;
+  double brakeTorque = -brakePercent *
+    2 * (this->frontBrakeTorque + this->backBrakeTorque) *
+    math::clamp(this->kinematicSpeed / radius / smoothingSpeed, -1.0, 1.0);
+  if (radius > 0 && this->kinematicMass > 0)
+  {
+    this->kinematicSpeed += (gasTorque + brakeTorque) /
+      (radius * this->kinematicMass) * _dt;
+  }
+
+  // Lateral: bicycle model about the back axle
+  double yawRate = this->kinematicSpeed *
+    tan(this->handWheelState * this->steeringRatio) / this->wheelbaseLength;
+
+  math::Vector3 up(0, 0, 1);
+  math::Vector3 forward = this->chassisLink->GetWorldPose().rot
+    .RotateVector(this->chassisForward);
+  forward.z = 0;
+  forward.Normalize();
+  math::Vector3 linVel = forward * this->kinematicSpeed;
+  math::Vector3 angVel = up * yawRate;
+  math::Vector3 backAxlePos =
+    (this->get_collision_position(this->blWheelJoint->GetChild(), 0) +
+     this->get_collision_position(this->brWheelJoint->GetChild(), 0)) / 2;
+
+  for (physics::Link_V::iterator li = this->kinematicLinks.begin();
+       li != this->kinematicLinks.end(); ++li)
+  {
+    math::Vector3 arm = (*li)->GetWorldCoGPose().pos - backAxlePos;
+    (*li)->SetLinearVel(linVel + angVel.Cross(arm));
+    (*li)->SetAngularVel(angVel);
+  }
+
+  // Spin the wheels so they roll without slipping
+  physics::JointPtr wheelJoints[4] = {this->flWheelJoint, this->frWheelJoint,
+    this->blWheelJoint, this->brWheelJoint};
+  double radii[4] = {this->flWheelRadius, this->frWheelRadius,
+    this->blWheelRadius, this->brWheelRadius};
+  for (unsigned int i = 0; i < 4; ++i)
+  {
+    math::Vector3 axis = wheelJoints[i]->GetGlobalAxis(0);
+    double rolling = axis.Cross(up).Dot(forward);
+    if (fabs(rolling) < 0.5 || radii[i] <= 0)
+      continue;
+    wheelJoints[i]->GetChild()->SetAngularVel(
+      angVel + axis * (this->kinematicSpeed / (radii[i] * rolling)));
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // function that extracts the radius of a cylinder or sphere collision shape
 // the function returns zero otherwise
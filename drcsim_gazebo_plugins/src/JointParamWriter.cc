@@ -0,0 +1,117 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "drcsim_gazebo_plugins/JointParamWriter.hh"
+
+namespace gazebo
+{
+////////////////////////////////////////////////////////////////////////////////
+JointParamWriter::JointParamWriter()
+  : writeCount(0), suppressedCount(0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+JointParamWriter::JointParamWriter(physics::JointPtr _joint)
+  : joint(_joint), writeCount(0), suppressedCount(0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void JointParamWriter::SetJoint(physics::JointPtr _joint)
+{
+  this->joint = _joint;
+  this->values.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+physics::JointPtr JointParamWriter::GetJoint() const
+{
+  return this->joint;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void JointParamWriter::SetHighStop(unsigned int _index,
+                                   const math::Angle &_angle)
+{
+  if (this->Update("high_stop", _index, _angle.Radian()))
+    this->joint->SetHighStop(_index, _angle);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void JointParamWriter::SetLowStop(unsigned int _index,
+                                  const math::Angle &_angle)
+{
+  if (this->Update("low_stop", _index, _angle.Radian()))
+    this->joint->SetLowStop(_index, _angle);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void JointParamWriter::SetDamping(unsigned int _index, double _damping)
+{
+  if (this->Update("damping", _index, _damping))
+    this->joint->SetDamping(_index, _damping);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void JointParamWriter::SetParam(const std::string &_key, unsigned int _index,
+                                double _value)
+{
+  // Keep engine parameters apart from the values above
+  if (this->Update("param:" + _key, _index, _value))
+    this->joint->SetParam(_key, _index, _value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void JointParamWriter::Reset()
+{
+  this->values.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned int JointParamWriter::GetWriteCount() const
+{
+  return this->writeCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned int JointParamWriter::GetSuppressedCount() const
+{
+  return this->suppressedCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool JointParamWriter::Update(const std::string &_key, unsigned int _index,
+                              double _value)
+{
+  if (!this->joint)
+    return false;
+
+  std::pair<std::string, unsigned int> id(_key, _index);
+  std::map<std::pair<std::string, unsigned int>, double>::iterator iter =
+    this->values.find(id);
+  if (iter != this->values.end() && math::equal(iter->second, _value))
+  {
+    ++this->suppressedCount;
+    return false;
+  }
+
+  this->values[id] = _value;
+  ++this->writeCount;
+  return true;
+}
+}
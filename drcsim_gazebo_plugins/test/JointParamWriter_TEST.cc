@@ -0,0 +1,122 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <gtest/gtest.h>
+
+#include <gazebo/gazebo.hh>
+#include <gazebo/physics/physics.hh>
+
+#include "drcsim_gazebo_plugins/JointParamWriter.hh"
+
+using namespace gazebo;
+
+/// \brief Hinge of the pendulum in TEST_WORLD_DIR/joint_param_writer.world
+static physics::JointPtr hinge;
+
+/////////////////////////////////////////////////
+TEST(JointParamWriter, SuppressesUnchangedValues)
+{
+  ASSERT_TRUE(hinge.get() != NULL);
+  JointParamWriter writer(hinge);
+
+  writer.SetDamping(0, 1.5);
+  EXPECT_EQ(writer.GetWriteCount(), 1u);
+  EXPECT_EQ(writer.GetSuppressedCount(), 0u);
+  EXPECT_DOUBLE_EQ(hinge->GetDamping(0), 1.5);
+
+  for (unsigned int i = 0; i < 3; ++i)
+    writer.SetDamping(0, 1.5);
+  EXPECT_EQ(writer.GetWriteCount(), 1u);
+  EXPECT_EQ(writer.GetSuppressedCount(), 3u);
+
+  writer.SetDamping(0, 2.0);
+  EXPECT_EQ(writer.GetWriteCount(), 2u);
+  EXPECT_DOUBLE_EQ(hinge->GetDamping(0), 2.0);
+
+  // the same value under another name is another parameter
+  writer.SetHighStop(0, math::Angle(2.0));
+  writer.SetLowStop(0, math::Angle(-2.0));
+  EXPECT_EQ(writer.GetWriteCount(), 4u);
+  EXPECT_DOUBLE_EQ(hinge->GetHighStop(0).Radian(), 2.0);
+  EXPECT_DOUBLE_EQ(hinge->GetLowStop(0).Radian(), -2.0);
+
+  writer.SetHighStop(0, math::Angle(2.0));
+  EXPECT_EQ(writer.GetWriteCount(), 4u);
+  EXPECT_EQ(writer.GetSuppressedCount(), 4u);
+}
+
+/////////////////////////////////////////////////
+TEST(JointParamWriter, ResetForcesWrites)
+{
+  ASSERT_TRUE(hinge.get() != NULL);
+  JointParamWriter writer(hinge);
+
+  writer.SetDamping(0, 0.5);
+  EXPECT_EQ(writer.GetWriteCount(), 1u);
+
+  // changed behind the writer's back, which doesn't notice
+  hinge->SetDamping(0, 3.0);
+  writer.SetDamping(0, 0.5);
+  EXPECT_EQ(writer.GetWriteCount(), 1u);
+  EXPECT_EQ(writer.GetSuppressedCount(), 1u);
+  EXPECT_DOUBLE_EQ(hinge->GetDamping(0), 3.0);
+
+  writer.Reset();
+  writer.SetDamping(0, 0.5);
+  EXPECT_EQ(writer.GetWriteCount(), 2u);
+  EXPECT_DOUBLE_EQ(hinge->GetDamping(0), 0.5);
+
+  // setting the joint forgets the values as well
+  hinge->SetDamping(0, 3.0);
+  writer.SetJoint(hinge);
+  writer.SetDamping(0, 0.5);
+  EXPECT_EQ(writer.GetWriteCount(), 3u);
+  EXPECT_DOUBLE_EQ(hinge->GetDamping(0), 0.5);
+}
+
+/////////////////////////////////////////////////
+TEST(JointParamWriter, NoJoint)
+{
+  JointParamWriter writer;
+  EXPECT_TRUE(writer.GetJoint().get() == NULL);
+
+  writer.SetDamping(0, 1.0);
+  writer.SetParam("stop_cfm", 0, 0.1);
+  EXPECT_EQ(writer.GetWriteCount(), 0u);
+  EXPECT_EQ(writer.GetSuppressedCount(), 0u);
+}
+
+/////////////////////////////////////////////////
+int main(int _argc, char **_argv)
+{
+  testing::InitGoogleTest(&_argc, _argv);
+
+  if (!gazebo::setupServer(_argc, _argv))
+    return 1;
+
+  physics::WorldPtr world =
+    gazebo::loadWorld(TEST_WORLD_DIR "/joint_param_writer.world");
+  if (world && world->GetModel("pendulum"))
+    hinge = world->GetModel("pendulum")->GetJoint("hinge");
+
+  int result = RUN_ALL_TESTS();
+
+  hinge.reset();
+  world.reset();
+  gazebo::shutdown();
+  return result;
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef _GAZEBO_ATLAS_COMMAND_LOG_HH_
+#define _GAZEBO_ATLAS_COMMAND_LOG_HH_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <ros/time.h>
+#include <ros/serialization.h>
+
+// Binary record of the commands AtlasPlugin receives, so that a run can be
+// replayed at the same steps without the controllers that sent them.
+// The file holds the magic "ATLASCMD", a uint32 version, then an entry per
+// command, in host byte order:
+//   uint32 sec, uint32 nsec  sim time of the first step that used it
+//   uint8 type               AtlasCommandLog::Type
+//   uint32 size              then size bytes of the ROS serialized message
+
+namespace gazebo
+{
+  /// \brief Records commands to, or replays them from, a file.
+  class AtlasCommandLog
+  {
+    /// \brief Kinds of command
+    public: enum Type
+    {
+      /// \brief atlas_msgs::AtlasCommand
+      ATLAS_COMMAND = 0,
+
+      /// \brief osrf_msgs::JointCommands
+      JOINT_COMMANDS = 1,
+
+      /// \brief atlas_msgs::AtlasSimInterfaceCommand
+      ASI_COMMAND = 2
+    };
+
+    /// \brief Constructor
+    public: AtlasCommandLog();
+
+    /// \brief Destructor, closes the file.
+    public: virtual ~AtlasCommandLog();
+
+    /// \brief Start recording.
+    /// \param[in] _path File to write, replaced if it exists.
+    /// \return False if the file can't be written.
+    public: bool OpenRecord(const std::string &_path);
+
+    /// \brief Start replaying.
+    /// \param[in] _path File written by a previous recording.
+    /// \return False if the file can't be read or is not a recording.
+    public: bool OpenReplay(const std::string &_path);
+
+    /// \brief Whether commands are being recorded.
+    public: bool IsRecording() const;
+
+    /// \brief Whether a replay was opened, even if it's done.
+    public: bool IsReplaying() const;
+
+    /// \brief Keep a command received, until the step that uses it is
+    /// known, see Flush.  Does nothing unless recording.
+    /// \param[in] _type Kind of command.
+    /// \param[in] _msg The command.
+    public: template<typename M>
+            void Push(Type _type, const M &_msg)
+    {
+      if (!this->IsRecording())
+        return;
+
+      uint32_t size = ros::serialization::serializationLength(_msg);
+      size_t offset = this->pending.size();
+      this->pending.resize(offset + ENTRY_HEADER_SIZE + size);
+
+      uint8_t type = static_cast<uint8_t>(_type);
+      memcpy(&this->pending[offset], &type, sizeof(type));
+      memcpy(&this->pending[offset + sizeof(type)], &size, sizeof(size));
+
+      ros::serialization::OStream stream(
+        &this->pending[offset + ENTRY_HEADER_SIZE], size);
+      ros::serialization::serialize(stream, _msg);
+    }
+
+    /// \brief Write the commands pushed so far, as used from a step.
+    /// \param[in] _time Sim time of the step.
+    public: void Flush(const ros::Time &_time);
+
+    /// \brief Next replayed command, if it is due.
+    /// \param[in] _time Sim time of the current step.
+    /// \param[out] _type Kind of command.
+    /// \param[out] _data Serialized command, see Deserialize.
+    /// \return True if a command recorded at or before _time was read.
+    public: bool Next(const ros::Time &_time, Type &_type,
+                      std::vector<uint8_t> &_data);
+
+    /// \brief Deserialize a replayed command.
+    /// \param[in] _data Serialized command from Next.
+    /// \param[out] _msg The command.
+    /// \return False if the data is not a valid message of that kind.
+    public: template<typename M>
+            static bool Deserialize(std::vector<uint8_t> &_data, M &_msg)
+    {
+      if (_data.empty())
+        return false;
+      try
+      {
+        ros::serialization::IStream stream(&_data[0], _data.size());
+        ros::serialization::deserialize(stream, _msg);
+      }
+      catch(ros::serialization::StreamOverrunException &_e)
+      {
+        return false;
+      }
+      return true;
+    }
+
+    /// \brief Stop recording or replaying.
+    public: void Close();
+
+    /// \brief Read the next entry of the replay.
+    private: void ReadEntry();
+
+    /// \brief Bytes of type and size ahead of each pushed command
+    private: static const size_t ENTRY_HEADER_SIZE = 5;
+
+    /// \brief File being recorded
+    private: std::ofstream out;
+
+    /// \brief File being replayed
+    private: std::ifstream in;
+
+    /// \brief Whether a replay was opened
+    private: bool replaying;
+
+    /// \brief Commands pushed since the last Flush, each as type, size
+    /// and message
+    private: std::vector<uint8_t> pending;
+
+    /// \brief Whether nextTime, nextType and nextData hold an entry
+    private: bool hasNext;
+
+    /// \brief Next entry of the replay
+    private: ros::Time nextTime;
+    private: Type nextType;
+    private: std::vector<uint8_t> nextData;
+  };
+}
+#endif
@@ -0,0 +1,284 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef _GAZEBO_ATLAS_CONTROL_KERNELS_HH_
+#define _GAZEBO_ATLAS_CONTROL_KERNELS_HH_
+
+// filter coefficients
+#define FIL_N_STEPS 2
+#define FIL_MAX_FILT_COEFF 10
+
+#include <vector>
+#include <stdint.h>
+
+// The per tick computations of AtlasPlugin that don't need gazebo, so
+// that they can be benchmarked without a server, see
+// atlas_kernels_benchmark.
+
+namespace gazebo
+{
+  /// \brief PID error terms of a joint
+  class AtlasPIDErrorTerms
+  {
+    /// \brief Constructor
+    public: AtlasPIDErrorTerms();
+
+    /// \brief Position error
+    public: double q_p;
+
+    /// \brief Derivative of the position error
+    public: double d_q_p_dt;
+
+    /// \brief Integral term weighted by k_i
+    public: double k_i_q_i;
+
+    /// \brief Velocity error
+    public: double qd_p;
+  };
+
+  /// \brief State, gains and command of a joint for AtlasPIDUpdate, as
+  /// they are in AtlasState and AtlasCommand.
+  class AtlasPIDInput
+  {
+    /// \brief Constructor
+    public: AtlasPIDInput();
+
+    /// \brief Commanded position, within the joint's range of motion
+    public: double positionTarget;
+
+    /// \brief Commanded velocity
+    public: double velocityTarget;
+
+    /// \brief Feed forward effort
+    public: double effortTarget;
+
+    /// \brief Joint position
+    public: double position;
+
+    /// \brief Joint velocity
+    public: double velocity;
+
+    /// \brief Position gains
+    public: double kpPosition;
+    public: double kiPosition;
+    public: double kdPosition;
+
+    /// \brief Velocity gain, applied as joint damping
+    public: double kpVelocity;
+
+    /// \brief Bounds of the integral term
+    public: double iEffortMin;
+    public: double iEffortMax;
+
+    /// \brief Weight of the PID output against the BDI controller output,
+    /// between 0 and 1
+    public: double kEffort;
+
+    /// \brief BDI controller output
+    public: double bdiEffort;
+
+    /// \brief Effort limit of the joint
+    public: double effortLimit;
+
+    /// \brief Joint damping of the model
+    public: double dampingModel;
+
+    /// \brief Upper bound of the joint damping
+    public: double dampingMax;
+  };
+
+  /// \brief Update the PID of a joint.
+  /// \param[in] _in State, gains and command of the joint.
+  /// \param[in] _dt Time since the last update.
+  /// \param[in,out] _terms The joint's error terms.
+  /// \param[out] _damping Joint damping to apply, for kp_velocity.
+  /// \return Effort to apply.
+  double AtlasPIDUpdate(const AtlasPIDInput &_in, double _dt,
+                        AtlasPIDErrorTerms &_terms, double &_damping);
+
+  /// \brief Low pass filter the joint positions or velocities.
+  /// \param[in] _coefA Filter coefficients a, FIL_N_STEPS of them.
+  /// \param[in] _coefB Filter coefficients b, FIL_N_STEPS of them.
+  /// \param[in,out] _in Past inputs of each joint.
+  /// \param[in,out] _out Past outputs of each joint.
+  /// \param[in,out] _aState Values to filter, replaced by filtered values.
+  /// \param[out] _jState Filtered values.
+  void AtlasFilterJoints(const double *_coefA, const double *_coefB,
+                         std::vector<std::vector<double> > &_in,
+                         std::vector<std::vector<double> > &_out,
+                         std::vector<float> &_aState,
+                         std::vector<double> &_jState);
+
+  /// \brief Moving window mean and variance of the age of AtlasCommand.
+  class AtlasCommandAgeStatistics
+  {
+    /// \brief Constructor
+    public: AtlasCommandAgeStatistics();
+
+    /// \brief Clear the statistics and set the window size.
+    /// \param[in] _size Number of samples in the window.
+    public: void Init(unsigned int _size);
+
+    /// \brief Add a sample.
+    /// \param[in] _age Age of the command in seconds.
+    public: void Update(double _age);
+
+    /// \brief Latest age.
+    public: double GetAge() const;
+
+    /// \brief Mean of the window.  Invalid until the window is full.
+    public: double GetMean() const;
+
+    /// \brief Variance of the window.  Invalid until the window is full.
+    public: double GetVariance() const;
+
+    /// \brief Weighted samples in the window
+    private: std::vector<double> buffer;
+
+    /// \brief delta * (age - mean) of each sample, for the incremental
+    /// variance
+    private: std::vector<double> delta2Buffer;
+
+    /// \brief Index of the oldest sample in the window
+    private: unsigned int index;
+
+    /// \brief Mean of the window
+    private: double mean;
+
+    /// \brief Sum of squared differences from the mean
+    private: double variance;
+
+    /// \brief Latest age
+    private: double age;
+  };
+
+  /// \brief Fixed memory histogram of latencies, in the manner of
+  /// HdrHistogram.  Samples are kept in microseconds with buckets whose
+  /// width grows with the value, so that every recorded value is known
+  /// within about 3%.  Record is O(1) and never allocates, so it can be
+  /// called from the physics update.
+  class AtlasLatencyHistogram
+  {
+    /// \brief Constructor
+    public: AtlasLatencyHistogram();
+
+    /// \brief Add a sample.  Negative samples count as 0, samples above
+    /// GetHighestTrackable count as GetHighestTrackable.
+    /// \param[in] _latency Latency in seconds.
+    public: void Record(double _latency);
+
+    /// \brief Remove all samples.
+    public: void Reset();
+
+    /// \brief Number of samples since the last reset.
+    public: uint64_t GetCount() const;
+
+    /// \brief Largest sample since the last reset, exact.
+    /// \return Latency in seconds, 0 if there are no samples.
+    public: double GetMax() const;
+
+    /// \brief Value under which a percentage of the samples fall.  The
+    /// upper bound of the bucket is returned, so this errs on the high side
+    /// and never exceeds GetMax.  Walks the buckets, don't call it per
+    /// sample.
+    /// \param[in] _percentile Between 0 and 100.
+    /// \return Latency in seconds, 0 if there are no samples.
+    public: double GetPercentile(double _percentile) const;
+
+    /// \brief Largest latency that is told apart from larger ones.
+    /// \return Latency in seconds.
+    public: static double GetHighestTrackable();
+
+    /// \brief Bucket of a value.
+    /// \param[in] _value Value in microseconds.
+    private: static unsigned int BucketIndex(uint64_t _value);
+
+    /// \brief Largest value that falls in a bucket.
+    /// \param[in] _index Index of the bucket.
+    /// \return Value in microseconds.
+    private: static uint64_t BucketUpperBound(unsigned int _index);
+
+    /// \brief Values below 2^SUB_BUCKET_BITS microseconds get a bucket
+    /// each, larger ones share 2^(SUB_BUCKET_BITS-1) buckets per power of
+    /// two.
+    private: static const unsigned int SUB_BUCKET_BITS = 6;
+
+    /// \brief Values are clamped below 2^MAX_VALUE_BITS microseconds,
+    /// a bit over two minutes.
+    private: static const unsigned int MAX_VALUE_BITS = 27;
+
+    /// \brief Number of buckets
+    private: static const unsigned int BUCKET_COUNT =
+      (MAX_VALUE_BITS - SUB_BUCKET_BITS + 2) << (SUB_BUCKET_BITS - 1);
+
+    /// \brief Samples in each bucket
+    private: uint32_t counts[BUCKET_COUNT];
+
+    /// \brief Number of samples
+    private: uint64_t count;
+
+    /// \brief Largest sample in microseconds
+    private: uint64_t max;
+  };
+
+  /// \brief Detects damaging falls from the vertical velocity of the head,
+  /// the condition the VRC scoring counts falls with.  A fall is an
+  /// acceleration over a threshold, after HOLD_OFF seconds without one.
+  class AtlasFallDetector
+  {
+    /// \brief Constructor
+    public: AtlasFallDetector();
+
+    /// \brief Forget past falls and velocities, the first HOLD_OFF
+    /// seconds are then never a fall.
+    public: void Reset();
+
+    /// \brief Set the acceleration above which a fall is detected.
+    /// \param[in] _threshold Acceleration in m/s^2.
+    public: void SetThreshold(double _threshold);
+
+    /// \brief Add a sample.
+    /// \param[in] _time Sim time in seconds.
+    /// \param[in] _velocity Vertical velocity of the head in m/s.
+    /// \return true if the sample is a fall.
+    public: bool Update(double _time, double _velocity);
+
+    /// \brief Acceleration computed by the last Update that wasn't held
+    /// off.
+    /// \return Acceleration in m/s^2.
+    public: double GetAcceleration() const;
+
+    /// \brief Seconds after a fall, or a reset, during which falls aren't
+    /// detected.  This also skips the robot being dropped at startup.
+    public: static const double HOLD_OFF;
+
+    /// \brief Acceleration above which a fall is detected
+    private: double threshold;
+
+    /// \brief Time of the last fall
+    private: double fallTime;
+
+    /// \brief Time of the last sample
+    private: double prevTime;
+
+    /// \brief Velocity of the last sample
+    private: double prevVelocity;
+
+    /// \brief Last acceleration computed
+    private: double acceleration;
+  };
+}
+#endif
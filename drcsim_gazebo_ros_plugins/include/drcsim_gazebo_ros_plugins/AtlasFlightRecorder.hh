@@ -0,0 +1,168 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef _GAZEBO_ATLAS_FLIGHT_RECORDER_HH_
+#define _GAZEBO_ATLAS_FLIGHT_RECORDER_HH_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+// Memory ring of the last seconds of fixed size frames, written to a file
+// in the background when triggered.  The file holds, in host byte order:
+//   char[8] "ATLASFDR", uint32 version
+//   uint32 frame size, uint32 frame count
+//   uint32 size, then the layout of a frame as text, given to Init
+//   uint32 size, then the reason of the dump
+//   the frames, oldest first
+
+namespace gazebo
+{
+  /// \brief Keeps the last frames in memory, dumps them when triggered.
+  class AtlasFlightRecorder
+  {
+    /// \brief Constructor, the recorder is disabled until Init.
+    public: AtlasFlightRecorder();
+
+    /// \brief Destructor, finishes the dump in progress, if any.
+    public: virtual ~AtlasFlightRecorder();
+
+    /// \brief Allocate the ring, and its spare for dumps, and start the
+    /// writer thread.
+    /// \param[in] _frameSize Size of a frame in bytes.
+    /// \param[in] _frames Number of frames kept.
+    /// \param[in] _postTriggerFrames Number of frames recorded after a
+    /// trigger before the dump starts.
+    /// \param[in] _directory Where dumps are written by default.
+    /// \param[in] _layout Description of a frame, saved with each dump.
+    public: void Init(size_t _frameSize, size_t _frames,
+                      size_t _postTriggerFrames, const std::string &_directory,
+                      const std::string &_layout);
+
+    /// \brief Whether Init was called with a non empty ring.
+    public: bool IsEnabled() const;
+
+    /// \brief Frame to fill for this step, valid until Commit.  Only call
+    /// this and Commit when enabled.
+    /// \return Pointer to GetFrameSize bytes.
+    public: uint8_t *NextFrame();
+
+    /// \brief Keep the frame filled, and start a dump if one was triggered
+    /// and its post trigger frames are recorded.  Never allocates.
+    /// \param[in] _time Sim time of the frame, names the dump.
+    public: void Commit(double _time);
+
+    /// \brief Request a dump, may be called from any thread.
+    /// \param[in] _reason Saved with the dump.
+    /// \param[in] _path File to write, or empty for a file named after the
+    /// sim time in the directory given to Init.
+    /// \param[out] _status Why a dump couldn't be requested.
+    /// \return false if disabled, or if a dump is already pending.
+    public: bool Trigger(const std::string &_reason, const std::string &_path,
+                         std::string &_status);
+
+    /// \brief Size of a frame in bytes
+    public: size_t GetFrameSize() const;
+
+    /// \brief Append a value to a frame being filled.
+    /// \param[in,out] _cursor Where to write, moved past the value.
+    /// \param[in] _value Value to append.
+    public: template<typename T>
+            static void Pack(uint8_t *&_cursor, const T &_value)
+    {
+      memcpy(_cursor, &_value, sizeof(T));
+      _cursor += sizeof(T);
+    }
+
+    /// \brief Write the dumps handed over by Commit.
+    private: void WriterThread();
+
+    /// \brief Write a dump.
+    /// \param[in] _path File to write.
+    /// \param[in] _reason Reason of the dump.
+    /// \param[in] _count Number of frames in the spare ring.
+    /// \param[in] _head Index after the newest frame of the spare ring.
+    private: void Write(const std::string &_path, const std::string &_reason,
+                        size_t _count, size_t _head);
+
+    /// \brief Frames being recorded
+    private: std::vector<uint8_t> ring;
+
+    /// \brief Frames being dumped, swapped with ring when a dump starts
+    private: std::vector<uint8_t> spare;
+
+    /// \brief Size of a frame
+    private: size_t frameSize;
+
+    /// \brief Capacity of the rings in frames
+    private: size_t frames;
+
+    /// \brief Index of the frame to fill next
+    private: size_t head;
+
+    /// \brief Number of frames in ring
+    private: size_t count;
+
+    /// \brief Frames recorded after a trigger before dumping
+    private: size_t postTriggerFrames;
+
+    /// \brief Default directory of the dumps
+    private: std::string directory;
+
+    /// \brief Layout saved with the dumps
+    private: std::string layout;
+
+    /// \brief Protects the members below
+    private: boost::mutex mutex;
+
+    /// \brief Signals the writer thread
+    private: boost::condition condition;
+
+    /// \brief A dump was requested and isn't written yet
+    private: bool triggered;
+
+    /// \brief Frames left to record before handing the dump over
+    private: size_t countdown;
+
+    /// \brief The spare ring holds a dump to write
+    private: bool dumpReady;
+
+    /// \brief Reason of the requested dump
+    private: std::string dumpReason;
+
+    /// \brief File of the requested dump
+    private: std::string dumpPath;
+
+    /// \brief Number of frames in the dump
+    private: size_t dumpCount;
+
+    /// \brief Index after the newest frame of the dump
+    private: size_t dumpHead;
+
+    /// \brief The writer thread should exit
+    private: bool stop;
+
+    /// \brief Writes the dumps
+    private: boost::thread *writerThread;
+  };
+}
+#endif
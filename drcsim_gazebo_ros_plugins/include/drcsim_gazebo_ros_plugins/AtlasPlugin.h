@@ -18,10 +18,6 @@
 #ifndef GAZEBO_ATLAS_PLUGIN_HH
 #define GAZEBO_ATLAS_PLUGIN_HH
 
-// filter coefficients
-#define FIL_N_STEPS 2
-#define FIL_MAX_FILT_COEFF 10
-
 #include <string>
 #include <vector>
 #include <map>
@@ -64,8 +60,11 @@
 
 #include <atlas_msgs/AtlasFilters.h>
 #include <atlas_msgs/ResetControls.h>
+#include <atlas_msgs/GetAtlasControllerState.h>
+#include <atlas_msgs/SetAtlasControllerState.h>
 #include <atlas_msgs/SetJointDamping.h>
 #include <atlas_msgs/GetJointDamping.h>
+#include <atlas_msgs/DumpFlightRecorder.h>
 #include <atlas_msgs/ControllerStatistics.h>
 
 // don't use these to control
@@ -83,6 +82,12 @@
 #include <atlas_msgs/Test.h>
 
 #include <gazebo_plugins/PubQueue.h>
+#include <drcsim_gazebo_plugins/DRCUpdateScheduler.hh>
+#include <drcsim_gazebo_plugins/JointParamWriter.hh>
+#include "drcsim_gazebo_ros_plugins/AtlasCommandLog.hh"
+#include "drcsim_gazebo_ros_plugins/AtlasControlKernels.hh"
+#include "drcsim_gazebo_ros_plugins/AtlasFlightRecorder.hh"
+#include "drcsim_gazebo_ros_plugins/ModelReadiness.hh"
 
 // AtlasSimInterface: header
 #if ATLAS_VERSION == 1
@@ -153,6 +158,24 @@ namespace gazebo
     private: bool GetJointDamping(atlas_msgs::GetJointDamping::Request &_req,
       atlas_msgs::GetJointDamping::Response &_res);
 
+    /// \brief ros service callback to capture controller internal states:
+    /// PID error terms, active servo command, joint state filter histories
+    /// and the AtlasSimInterface behavior.
+    /// \param[in] _req Incoming ros service request
+    /// \param[in] _res Outgoing ros service response
+    private: bool GetControllerState(
+      atlas_msgs::GetAtlasControllerState::Request &_req,
+      atlas_msgs::GetAtlasControllerState::Response &_res);
+
+    /// \brief ros service callback to restore controller internal states
+    /// captured by GetControllerState.  The BDI controller itself is
+    /// opaque, only its behavior and parameters are restored.
+    /// \param[in] _req Incoming ros service request
+    /// \param[in] _res Outgoing ros service response
+    private: bool SetControllerState(
+      atlas_msgs::SetAtlasControllerState::Request &_req,
+      atlas_msgs::SetAtlasControllerState::Response &_res);
+
     /// \brief: Load ROS related stuff
     private: void LoadROS();
 
@@ -174,8 +197,8 @@ namespace gazebo
     /// \brief pointer to gazebo Atlas model
     private: physics::ModelPtr model;
 
-    /// Pointer to the update event connections
-    private: event::ConnectionPtr updateConnection;
+    /// Connection of UpdateStates to the update scheduler
+    private: DRCUpdateConnectionPtr updateConnection;
     private: event::ConnectionPtr rContactUpdateConnection;
     private: event::ConnectionPtr lContactUpdateConnection;
 
@@ -296,6 +319,63 @@ namespace gazebo
     /// \brief enforce delay policy
     private: void EnforceSynchronizationDelay(const common::Time &_curTime);
 
+    ////////////////////////////////////////////////////////////////////////////
+    //                                                                        //
+    //  Command Record and Replay                                             //
+    //                                                                        //
+    ////////////////////////////////////////////////////////////////////////////
+    /// \brief Commands received by the callbacks above, recorded with the
+    /// step that first used them, or replayed at that step instead of
+    /// subscribing.  See atlas/command_record and atlas/command_replay.
+    private: AtlasCommandLog commandLog;
+
+    /// \brief Serialized command being replayed, reused
+    private: std::vector<uint8_t> replayData;
+
+    /// \brief Pass the replayed commands due at a step to the callbacks.
+    /// \param[in] _curTime Sim time of the step.
+    private: void ReplayCommands(const common::Time &_curTime);
+
+    ////////////////////////////////////////////////////////////////////////////
+    //                                                                        //
+    //  Flight Recorder                                                       //
+    //                                                                        //
+    //  To dump the last atlas/flight_recorder/duration seconds, run          //
+    //  rosservice call /atlas/dump_flight_recorder '{ reason: "test" }'      //
+    //                                                                        //
+    ////////////////////////////////////////////////////////////////////////////
+    /// \brief Last seconds of states, commands and behaviors, dumped on a
+    /// fall, on an AtlasSimInterface error or on request.
+    private: AtlasFlightRecorder flightRecorder;
+
+    /// \brief Falls that trigger a dump
+    private: AtlasFallDetector fallDetector;
+
+    /// \brief Link whose velocity tells falls, may be null
+    private: physics::LinkPtr headLink;
+
+    /// \brief AtlasSimInterface error code of the last step, a dump is
+    /// triggered when it leaves NO_ERRORS.
+    private: int32_t flightErrorCode;
+
+    /// \brief ros service to dump the flight recorder
+    private: ros::ServiceServer dumpFlightRecorderService;
+
+    /// \brief Read the flight recorder parameters and allocate it.
+    private: void InitFlightRecorder();
+
+    /// \brief Record a step, and trigger a dump on a fall or on an
+    /// AtlasSimInterface error.
+    /// \param[in] _curTime Sim time of the step.
+    private: void UpdateFlightRecorder(const common::Time &_curTime);
+
+    /// \brief ros service callback to dump the flight recorder
+    /// \param[in] _req Incoming ros service request
+    /// \param[in] _res Outgoing ros service response
+    private: bool DumpFlightRecorder(
+      atlas_msgs::DumpFlightRecorder::Request &_req,
+      atlas_msgs::DumpFlightRecorder::Response &_res);
+
     ////////////////////////////////////////////////////////////////////////////
     //                                                                        //
     //  BDI Controller AtlasSimInterface Internals                            //
@@ -319,6 +399,10 @@ namespace gazebo
     /// \brief internal copy of atlasSimInterfaceState
     private: atlas_msgs::AtlasSimInterfaceState asiState;
 
+    /// \brief last AtlasSimInterfaceCommand received, kept for
+    /// GetControllerState.
+    private: atlas_msgs::AtlasSimInterfaceCommand asiCommand;
+
     /// \brief helper functions converting behavior string to int
     private: std::map<std::string, int> behaviorMap;
 
@@ -373,17 +457,8 @@ namespace gazebo
     private: physics::Joint_V joints;
     private: std::vector<double> effortLimit;
 
-    /// \brief internal class for keeping track of PID states
-    private: class ErrorTerms
-      {
-        /// error term contributions to final control output
-        double q_p;
-        double d_q_p_dt;
-        double k_i_q_i;  // integral term weighted by k_i
-        double qd_p;
-        friend class AtlasPlugin;
-      };
-    private: std::vector<ErrorTerms> errorTerms;
+    /// \brief PID states of each joint
+    private: std::vector<AtlasPIDErrorTerms> errorTerms;
 
     private: boost::mutex mutex;
 
@@ -393,12 +468,22 @@ namespace gazebo
     /// \brief: for keeping track of internal controller update rates.
     private: common::Time lastControllerUpdateTime;
 
+    /// \brief Times the startup, up to the first controllable update
+    private: ModelReadinessPtr readiness;
+
+    /// \brief Whether the first controllable update was reported
+    private: bool controllableReported;
+
     /// \brief ros service to change joint damping
     private: ros::ServiceServer setJointDampingService;
 
     /// \brief ros service to retrieve joint damping
     private: ros::ServiceServer getJointDampingService;
 
+    /// \brief ros services to capture and restore controller states
+    private: ros::ServiceServer getControllerStateService;
+    private: ros::ServiceServer setControllerStateService;
+
     ////////////////////////////////////////////////////////////////////
     //                                                                //
     //  filters                                                       //
@@ -542,13 +627,26 @@ namespace gazebo
 
     // controls message age measure
     private: atlas_msgs::ControllerStatistics controllerStatistics;
-    private: std::vector<double> atlasCommandAgeBuffer;
-    private: std::vector<double> atlasCommandAgeDelta2Buffer;
-    private: unsigned int atlasCommandAgeBufferIndex;
+    private: AtlasCommandAgeStatistics atlasCommandAgeStatistics;
     private: double atlasCommandAgeBufferDuration;
-    private: double atlasCommandAgeMean;
-    private: double atlasCommandAgeVariance;
-    private: double atlasCommandAge;
+
+    /// \brief Command age and synchronization delay of each step in the
+    /// current window, summarized into controllerStatistics when the
+    /// window is complete.
+    private: AtlasLatencyHistogram commandAgeHistogram;
+    private: AtlasLatencyHistogram synchronizationDelayHistogram;
+
+    /// \brief Number of steps in a window of atlasCommandAgeBufferDuration
+    private: unsigned int latencyWindowTicks;
+
+    /// \brief Steps of the current window without a new AtlasCommand
+    private: unsigned int windowStaleTicks;
+
+    /// \brief Steps without a new AtlasCommand since Load
+    private: uint64_t staleTicks;
+
+    /// \brief Stamp of the AtlasCommand used by the previous step
+    private: ros::Time lastCommandStamp;
     private: void CalculateControllerStatistics(const common::Time &_curTime);
     private: void PublishConstrollerStatistics(const common::Time &_curTime);
 
@@ -562,10 +660,9 @@ namespace gazebo
     /// \brief Are cheats enabled?
     private: bool cheatsEnabled;
 
-    /// \brief current joint cfm damping coefficient.
-    /// store this value so we don't have to call Joint::SetDamping()
-    /// on every update if coefficient if not changing.
-    private: std::vector<double> lastJointCFMDamping;
+    /// \brief Sets joint cfm damping coefficients, so we don't call
+    /// Joint::SetDamping() on every update if a coefficient is not changing.
+    private: std::vector<JointParamWriter> jointParams;
 
     /// \brief current joint damping coefficient for the Model
     private: std::vector<double> jointDampingModel;
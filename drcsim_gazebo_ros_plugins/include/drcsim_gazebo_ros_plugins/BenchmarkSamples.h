@@ -0,0 +1,71 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef BENCHMARK_SAMPLES_H
+#define BENCHMARK_SAMPLES_H
+
+#include <math.h>
+
+#include <algorithm>
+#include <ostream>
+#include <vector>
+
+/// \brief Samples of one measure of a benchmark node, such as
+/// atlas_latency_benchmark, written in its JSON report.
+class BenchmarkSamples
+{
+  /// \brief Add a sample.
+  public: void Add(double _value)
+  {
+    this->values.push_back(_value);
+  }
+
+  /// \brief Write count, mean, min, percentiles and max as JSON members.
+  /// \param[in] _out Stream to write to.
+  public: void Write(std::ostream &_out) const
+  {
+    std::vector<double> sorted(this->values);
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0;
+    for (unsigned int i = 0; i < sorted.size(); ++i)
+      sum += sorted[i];
+
+    _out << "\"count\": " << sorted.size();
+    if (sorted.empty())
+      return;
+    _out << ", \"mean\": " << sum / sorted.size()
+         << ", \"min\": " << sorted.front()
+         << ", \"p50\": " << Percentile(sorted, 0.5)
+         << ", \"p99\": " << Percentile(sorted, 0.99)
+         << ", \"p999\": " << Percentile(sorted, 0.999)
+         << ", \"max\": " << sorted.back();
+  }
+
+  /// \brief Nearest rank percentile.
+  /// \param[in] _sorted Sorted samples, not empty.
+  /// \param[in] _p Percentile between 0 and 1.
+  private: static double Percentile(const std::vector<double> &_sorted,
+                                    double _p)
+  {
+    unsigned int rank = static_cast<unsigned int>(ceil(_p * _sorted.size()));
+    return _sorted[std::max(rank, 1u) - 1];
+  }
+
+  /// \brief All samples
+  public: std::vector<double> values;
+};
+
+#endif
@@ -0,0 +1,275 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef _GAZEBO_CONTACT_DEMUX_HH_
+#define _GAZEBO_CONTACT_DEMUX_HH_
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered/unordered_map.hpp>
+
+#include <gazebo/common/Events.hh>
+#include <gazebo/msgs/msgs.hh>
+#include <gazebo/physics/physics.hh>
+#include <gazebo/transport/TransportTypes.hh>
+
+namespace gazebo
+{
+  class ContactDemux;
+
+  /// \def ContactDemuxPtr
+  /// \brief Boost shared pointer to a ContactDemux object
+  typedef boost::shared_ptr<ContactDemux> ContactDemuxPtr;
+
+  /// \brief The contacts of one consumer in a contacts message.  Refers to
+  /// the contacts in the message instead of copying them.
+  class ContactView
+  {
+    /// \brief Constructor
+    /// \param[in] _msg The contacts message.
+    public: explicit ContactView(ConstContactsPtr _msg);
+
+    /// \brief The whole contacts message.
+    public: ConstContactsPtr GetMessage() const;
+
+    /// \brief Sim time of the contacts.
+    public: const msgs::Time &GetTime() const;
+
+    /// \brief Number of contacts in the view.  A contact between two of
+    /// the consumer's collisions is in the view twice, once for each.
+    public: unsigned int GetContactCount() const;
+
+    /// \brief Get a contact.
+    /// \param[in] _i Index in the view.
+    public: const msgs::Contact &GetContact(unsigned int _i) const;
+
+    /// \brief Whether the consumer's collision is collision1 of a contact,
+    /// so that its wrenches are body_1_wrench.
+    /// \param[in] _i Index in the view.
+    public: bool IsFirst(unsigned int _i) const;
+
+    /// \brief Which of the consumer's collisions is in a contact.
+    /// \param[in] _i Index in the view.
+    /// \return Index in the collisions passed to ContactDemux::Connect.
+    public: unsigned int GetCollision(unsigned int _i) const;
+
+    /// \brief Whether every contact in the message is in the view, in
+    /// which case the message can be used as it is.
+    public: bool IsComplete() const;
+
+    /// \brief Add a contact.
+    /// \param[in] _index Index in the message.
+    /// \param[in] _first Whether the collision is collision1.
+    /// \param[in] _collision Index in the consumer's collisions.
+    private: void Add(int _index, bool _first, unsigned int _collision);
+
+    /// \brief A contact in the view
+    private: struct Entry
+             {
+               /// \brief Index in the message
+               int index;
+
+               /// \brief Whether the collision is collision1
+               bool first;
+
+               /// \brief Index in the consumer's collisions
+               unsigned int collision;
+             };
+
+    /// \brief The contacts message
+    private: ConstContactsPtr msg;
+
+    /// \brief Contacts in the view, in message order
+    private: std::vector<Entry> entries;
+
+    /// \brief Number of distinct contacts in the view
+    private: int distinct;
+
+    friend class ContactDemux;
+  };
+
+  /// \brief World level contact service.  Subscribes once to the contact
+  /// manager, for the collisions of all its consumers, and hands each
+  /// consumer only its own contacts, as views of the shared message, at
+  /// the start of the next world update.
+  ///
+  /// Plugins get the demux of their world with Get, and keep the pointer
+  /// for as long as they are connected.
+  class ContactDemux
+  {
+    /// \brief Called with the contacts of a consumer, on the world update
+    /// thread.  May call Connect and Disconnect.
+    public: typedef boost::function<void (const ContactView &)> Callback;
+
+    /// \brief Destructor
+    public: virtual ~ContactDemux();
+
+    /// \brief Get the demux of a world, creating it if needed.
+    /// \param[in] _world The world.
+    /// \return The demux.
+    public: static ContactDemuxPtr Get(physics::WorldPtr _world);
+
+    /// \brief Start receiving the contacts of some collisions.
+    /// \param[in] _collisions Scoped collision names.
+    /// \param[in] _callback Called with each message's contacts of these
+    /// collisions.
+    /// \return Consumer ID, for Disconnect.
+    public: unsigned int Connect(const std::vector<std::string> &_collisions,
+                                 Callback _callback);
+
+    /// \brief Stop receiving contacts.
+    /// \param[in] _id Consumer ID returned by Connect.
+    public: void Disconnect(unsigned int _id);
+
+    /// \brief Number of contacts messages received from the contact
+    /// manager.
+    public: unsigned int GetMessageCount() const;
+
+    /// \brief Number of contacts received from the contact manager.
+    public: unsigned int GetContactCount() const;
+
+    /// \brief Number of contacts handed to consumers.
+    public: unsigned int GetDeliveredCount() const;
+
+    /// \brief Constructor, see Get.
+    /// \param[in] _world The world.
+    private: explicit ContactDemux(physics::WorldPtr _world);
+
+    /// \brief Callback for contact messages from the contact manager.
+    /// \param[in] _msg Gazebo contact message
+    private: void OnContacts(ConstContactsPtr &_msg);
+
+    /// \brief Update the subscription and hand out the contacts received.
+    private: void OnUpdate();
+
+    /// \brief Replace the contact manager filter with one for the current
+    /// consumers' collisions.
+    private: void Subscribe();
+
+    /// \brief Queue the contacts of a message for the consumers, in
+    /// deliveries.
+    /// \param[in] _msg Gazebo contact message
+    private: void Dispatch(ConstContactsPtr _msg);
+
+    /// \brief Get the ID of a collision, without copying its name.
+    /// \param[in] _name Scoped collision name.
+    /// \return The collision's ID, or -1 if no consumer ever had it.
+    private: int GetCollisionId(const std::string &_name) const;
+
+    /// \brief A collision of a consumer
+    private: struct Target
+             {
+               /// \brief Consumer ID
+               unsigned int consumer;
+
+               /// \brief Index in the consumer's collisions
+               unsigned int collision;
+             };
+
+    /// \brief A consumer
+    private: struct Consumer
+             {
+               /// \brief IDs of its collisions
+               std::vector<unsigned int> collisions;
+
+               /// \brief Where to send its contacts
+               Callback callback;
+             };
+
+    /// \brief Contacts of a consumer, handed to it once the lock is
+    /// released
+    private: struct Delivery
+             {
+               /// \brief Constructor
+               Delivery(unsigned int _consumer, const Callback &_callback,
+                        const ContactView &_view)
+                 : consumer(_consumer), callback(_callback), view(_view) {}
+
+               /// \brief Consumer ID
+               unsigned int consumer;
+
+               /// \brief Where to send the contacts
+               Callback callback;
+
+               /// \brief The contacts
+               ContactView view;
+             };
+
+    typedef std::vector<std::vector<Target> > Targets_V;
+    typedef std::list<ConstContactsPtr> ContactMsgs_L;
+
+    /// \brief The world
+    private: physics::WorldPtr world;
+
+    /// \brief Transport node used for subscribing to contact messages.
+    private: transport::NodePtr node;
+
+    /// \brief Subscription to the contact manager filter
+    private: transport::SubscriberPtr contactSub;
+
+    /// \brief Name of the current contact manager filter
+    private: std::string filterName;
+
+    /// \brief Number of filters made, to give each a new name
+    private: unsigned int filterCount;
+
+    /// \brief Whether the filter has to be replaced
+    private: bool filterChanged;
+
+    /// \brief Connection to the world update begin signal
+    private: event::ConnectionPtr updateConnection;
+
+    /// \brief Consumers by ID
+    private: std::map<unsigned int, Consumer> consumers;
+
+    /// \brief Next consumer ID
+    private: unsigned int nextId;
+
+    /// \brief Scoped names of the collisions consumers connected, by
+    /// collision ID.  IDs are kept after the consumers disconnect.
+    private: std::vector<std::string> collisionNames;
+
+    /// \brief Collision IDs, by hash of the collision name.  Names are
+    /// hashed once per message contact, and matched without copies.
+    private: boost::unordered_multimap<std::size_t, unsigned int>
+             collisionIds;
+
+    /// \brief Consumers' collisions, by collision ID
+    private: Targets_V targets;
+
+    /// \brief Messages received since the last update
+    private: ContactMsgs_L incomingContacts;
+
+    /// \brief Contacts dispatched in the current update
+    private: std::vector<Delivery> deliveries;
+
+    /// \brief Statistics
+    private: unsigned int messageCount;
+    private: unsigned int contactCount;
+    private: unsigned int deliveredCount;
+
+    /// \brief Protects consumers, collisions, targets, incomingContacts
+    /// and deliveries
+    private: mutable boost::mutex mutex;
+  };
+}
+#endif
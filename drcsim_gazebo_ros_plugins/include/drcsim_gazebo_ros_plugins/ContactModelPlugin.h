@@ -18,11 +18,7 @@
 #define _GAZEBO_CONTACT_MODEL_PLUGIN_H_
 
 #include <string>
-#include <list>
-
-#include <boost/thread.hpp>
-#include <boost/thread/mutex.hpp>
-#include <boost/unordered/unordered_set.hpp>
+#include <vector>
 
 #include <gazebo/physics/physics.hh>
 #include <gazebo/physics/Contact.hh>
@@ -30,6 +26,8 @@
 #include <gazebo/common/Plugin.hh>
 #include <gazebo/common/Events.hh>
 
+#include "drcsim_gazebo_ros_plugins/ContactDemux.hh"
+
 namespace gazebo
 {
   /// \brief Contact Model Plugin
@@ -54,33 +52,45 @@ namespace gazebo
     /// \brief Callback that receives the world's update begin signal.
     private: virtual void OnUpdate();
 
-    /// \brief Callback for contact messages from the physics engine.
-    /// \param[in] _msg Gazebo contact message
-    private: void OnContacts(ConstContactsPtr &_msg);
+    /// \brief Callback for this model's contacts from the contact demux.
+    /// \param[in] _view The contacts of the monitored collisions.
+    private: void OnContacts(const ContactView &_view);
+
+    /// \brief Publish one summed contact wrench per monitored link.
+    /// \param[in] _view The contacts of the monitored collisions.
+    private: void PublishSummary(const ContactView &_view);
 
     /// \brief Connection that maintains a link between the world's update
     /// begin signal and the OnUpdate callback.
     private: event::ConnectionPtr updateConnection;
 
-    /// \brief Transport node used for subscribing to contact messages.
+    /// \brief Transport node used for publishing contact messages.
     private: transport::NodePtr node;
 
-    /// \brief Subscription to contact messages from the physics engine
-    private: transport::SubscriberPtr contactSub;
+    /// \brief Contact demux of the world
+    private: ContactDemuxPtr contactDemux;
+
+    /// \brief Consumer ID from the contact demux
+    private: unsigned int contactDemuxId;
 
-    /// \brief Mutex to protect reads and writes.
-    private: mutable boost::mutex mutex;
+    /// \brief Whether connected to the contact demux
+    private: bool contactDemuxConnected;
 
     /// \brief Contacts message used to output contact data.
     private: msgs::Contacts contactsMsg;
 
-    typedef std::list<boost::shared_ptr<msgs::Contacts const> > ContactMsgs_L;
+    /// \brief Collisions this plugin monitors for contacts
+    private: std::vector<std::string> collisions;
 
-    /// \brief A list of incoming contact messages.
-    private: ContactMsgs_L incomingContacts;
+    /// \brief Index in links of each collision's link
+    private: std::vector<unsigned int> collisionLinks;
 
-    /// \brief Collisions this plugin monitors for contacts
-    private: boost::unordered_set<std::string> collisions;
+    /// \brief Links with monitored collisions
+    private: physics::Link_V links;
+
+    /// \brief Publish one summed wrench per link instead of the contacts,
+    /// from <summary>
+    private: bool summary;
 
     /// \brief Pointer to world.
     private: physics::WorldPtr world;
@@ -93,9 +103,6 @@ namespace gazebo
 
     /// \brief Model this plugin is attached to.
     private: physics::ModelPtr model;
-
-    /// \brief Custom contact filter created for this plugin.
-    private: std::string filterTopicName;
   };
 }
 #endif
@@ -22,8 +22,12 @@
 #include <ros/callback_queue.h>
 #include <ros/advertise_options.h>
 #include <ros/subscribe_options.h>
+#include <std_msgs/Bool.h>
 #include <std_msgs/Float64.h>
 #include <std_msgs/Int8.h>
+#include <atlas_msgs/VehicleCommand.h>
+#include <atlas_msgs/VehicleState.h>
+#include <gazebo_plugins/PubQueue.h>
 
 #include <drcsim_gazebo_plugins/DRCVehiclePlugin.hh>
 
@@ -76,6 +80,18 @@ namespace gazebo
     ///                 the desired percent.
     public: void SetBrakePedalPercent(const std_msgs::Float64::ConstPtr &_msg);
 
+    /// \brief Set all of the vehicle's controls at once.  The key,
+    ///        direction and hand brake are only changed when they differ
+    ///        from the previous command, so that a controller streaming
+    ///        commands doesn't override the robot working them by hand.
+    /// \param[in] _msg Desired control positions.
+    public: void SetVehicleCommand(
+                const atlas_msgs::VehicleCommand::ConstPtr &_msg);
+
+    /// \brief Allow or forbid the vehicle's kinematic model.
+    /// \param[in] _msg true to allow it.
+    public: void SetKinematicEnabled(const std_msgs::Bool::ConstPtr &_msg);
+
     /// Returns the ROS publish period (seconds).
     public: common::Time GetRosPublishPeriod();
 
@@ -91,20 +107,47 @@ namespace gazebo
     private: physics::WorldPtr world;
     private: physics::ModelPtr model;
 
-    /// Pointer to the publish event connection.
-    private: event::ConnectionPtr ros_publish_connection_;
+    /// Connection of RosPublishStates to the update scheduler.
+    private: DRCUpdateConnectionPtr ros_publish_connection_;
 
     // ros stuff
     private: ros::NodeHandle* rosNode;
     private: ros::CallbackQueue queue;
     private: void QueueThread();
     private: boost::thread callbackQueueThread;
+    private: ros::Publisher pubVehicleState;
+    private: PubQueue<atlas_msgs::VehicleState>::Ptr pubVehicleStateQueue;
+    private: ros::Subscriber subVehicleCmd;
+
+    /// \brief Publishes GetKinematicTime on <vehicle>/kinematic_mode/time.
+    private: ros::Publisher pubKinematicTime;
+    private: PubQueue<std_msgs::Float64>::Ptr pubKinematicTimeQueue;
+
+    /// \brief Subscribes to <vehicle>/kinematic_mode/enable.
+    private: ros::Subscriber subKinematicEnable;
+
+    /// \brief Previous combined command, for change detection.
+    private: atlas_msgs::VehicleCommand lastVehicleCmd;
+
+    /// \brief Whether a combined command has been received yet.
+    private: bool hasVehicleCmd;
+
+    /// \brief Whether the per-field <control>/state and <control>/cmd
+    ///        topics are advertised, from <per_field_topics>.
+    private: bool perFieldTopics;
+
     private: ros::Publisher pubBrakePedalState;
     private: ros::Publisher pubGasPedalState;
     private: ros::Publisher pubHandWheelState;
     private: ros::Publisher pubHandBrakeState;
     private: ros::Publisher pubKeyState;
     private: ros::Publisher pubDirectionState;
+    private: PubQueue<std_msgs::Float64>::Ptr pubBrakePedalStateQueue;
+    private: PubQueue<std_msgs::Float64>::Ptr pubGasPedalStateQueue;
+    private: PubQueue<std_msgs::Float64>::Ptr pubHandWheelStateQueue;
+    private: PubQueue<std_msgs::Float64>::Ptr pubHandBrakeStateQueue;
+    private: PubQueue<std_msgs::Int8>::Ptr pubKeyStateQueue;
+    private: PubQueue<std_msgs::Int8>::Ptr pubDirectionStateQueue;
     private: ros::Subscriber subBrakePedalCmd;
     private: ros::Subscriber subGasPedalCmd;
     private: ros::Subscriber subHandWheelCmd;
@@ -114,6 +157,9 @@ namespace gazebo
     private: common::Time rosPublishPeriod;
     private: common::Time lastRosPublishTime;
 
+    /// \brief Publishes the states off the world update thread.
+    private: PubMultiQueue* pmq;
+
     /// \brief Are cheats enabled?
     private: bool cheatsEnabled;
   };
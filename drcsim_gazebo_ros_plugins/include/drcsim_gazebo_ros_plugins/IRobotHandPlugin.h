@@ -33,6 +33,7 @@
 #include <gazebo/physics/physics.hh>
 
 #include <gazebo_plugins/PubQueue.h>
+#include <drcsim_gazebo_plugins/DRCUpdateScheduler.hh>
 
 #include <handle_msgs/HandleSensors.h>
 #include <handle_msgs/HandleControl.h>
@@ -81,8 +82,8 @@ class IRobotHandPlugin : public gazebo::ModelPlugin
   /// \brief HandleControl message (published by user)
   private: handle_msgs::HandleControl handleCommand;
 
-  /// \brief gazebo world update connection
-  private: gazebo::event::ConnectionPtr updateConnection;
+  /// \brief connection of UpdateStates to the update scheduler
+  private: gazebo::DRCUpdateConnectionPtr updateConnection;
 
   /// \brief keep track of controller update sim-time
   private: gazebo::common::Time lastControllerUpdateTime;
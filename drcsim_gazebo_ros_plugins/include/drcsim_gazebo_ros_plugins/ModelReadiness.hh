@@ -0,0 +1,149 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef _GAZEBO_MODEL_READINESS_HH_
+#define _GAZEBO_MODEL_READINESS_HH_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <gazebo/common/Events.hh>
+#include <gazebo/common/Time.hh>
+#include <gazebo/physics/physics.hh>
+
+namespace gazebo
+{
+  class ModelReadiness;
+
+  /// \def ModelReadinessPtr
+  /// \brief Boost shared pointer to a ModelReadiness object
+  typedef boost::shared_ptr<ModelReadiness> ModelReadinessPtr;
+
+  /// \brief World level readiness service.  Plugins wait for a model, some
+  /// of its links and the ROS node of gazebo, and are called back as soon
+  /// as all of them are available, instead of each polling for them.
+  ///
+  /// Waiters are checked when an entity is added to the world, and once a
+  /// second in case the entity was added without the event, at the start
+  /// of the next world update, so that the model is initialized and its
+  /// plugins loaded.  Startup latencies are logged, from the start of
+  /// gzserver and from the creation of the service, which is when the
+  /// first plugin of the world asks for it.
+  ///
+  /// Plugins get the service of their world with Get, and keep the pointer
+  /// for as long as they wait.
+  class ModelReadiness
+  {
+    /// \brief Called with the model once ready, on the world update thread,
+    /// before the world update begin callbacks connected after the service.
+    /// May call Connect and Disconnect.
+    public: typedef boost::function<void (physics::ModelPtr)> Callback;
+
+    /// \brief Never returned by Connect, for plugins that are not waiting.
+    public: static const unsigned int NO_WAITER = 0;
+
+    /// \brief Destructor
+    public: virtual ~ModelReadiness();
+
+    /// \brief Get the service of a world, creating it if needed.
+    /// \param[in] _world The world.
+    /// \return The service.
+    public: static ModelReadinessPtr Get(physics::WorldPtr _world);
+
+    /// \brief Wait for a model to be ready.  The callback is called once,
+    /// at the next world update if the model is ready already.
+    /// \param[in] _model Name of the model.
+    /// \param[in] _links Names of links of the model that must be loaded.
+    /// \param[in] _callback Called with the model once ready.
+    /// \return Waiter ID, for Disconnect, never NO_WAITER.
+    public: unsigned int Connect(const std::string &_model,
+                                 const std::vector<std::string> &_links,
+                                 Callback _callback);
+
+    /// \brief Stop waiting, does nothing once the callback was called or
+    /// with NO_WAITER.
+    /// \param[in] _id Waiter ID returned by Connect.
+    public: void Disconnect(unsigned int _id);
+
+    /// \brief Log the time since gazebo started, to measure startup
+    /// latency, e.g. of the first tick a robot is controllable.
+    /// \param[in] _what What happened.
+    public: void Report(const std::string &_what) const;
+
+    /// \brief Constructor, see Get.
+    /// \param[in] _world The world.
+    private: explicit ModelReadiness(physics::WorldPtr _world);
+
+    /// \brief Remember that an entity was added, to check the waiters.
+    /// \param[in] _name Name of the entity.
+    private: void OnAddEntity(const std::string &_name);
+
+    /// \brief Call back the waiters whose model is ready.
+    private: void OnUpdate();
+
+    /// \brief A plugin waiting for a model
+    private: struct Waiter
+             {
+               /// \brief Name of the model
+               std::string model;
+
+               /// \brief Links the model must have
+               std::vector<std::string> links;
+
+               /// \brief Called once the model is ready
+               Callback callback;
+
+               /// \brief Wall time of Connect
+               common::Time start;
+             };
+
+    /// \brief The world
+    private: physics::WorldPtr world;
+
+    /// \brief Connection to the entity added signal
+    private: event::ConnectionPtr addEntityConnection;
+
+    /// \brief Connection to the world update begin signal
+    private: event::ConnectionPtr updateConnection;
+
+    /// \brief Waiters by ID
+    private: std::map<unsigned int, Waiter> waiters;
+
+    /// \brief Next waiter ID
+    private: unsigned int nextId;
+
+    /// \brief Whether the waiters have to be checked at the next update
+    private: bool check;
+
+    /// \brief Wall time of the last check
+    private: common::Time lastCheck;
+
+    /// \brief Wall time the service was created
+    private: common::Time startTime;
+
+    /// \brief Whether waiters were held back because ROS isn't initialized
+    private: bool rosWarned;
+
+    /// \brief Protects waiters, nextId and check
+    private: mutable boost::mutex mutex;
+  };
+}
+#endif
@@ -19,6 +19,7 @@
 #define __MULTISENSE_SL_PLUGIN_HH_
 
 #include <string>
+#include <vector>
 
 #include <boost/thread.hpp>
 #include <boost/thread/mutex.hpp>
@@ -35,6 +36,7 @@
 #include <std_msgs/Bool.h>
 #include <std_msgs/Int32.h>
 #include <sensor_msgs/JointState.h>
+#include <atlas_msgs/SensorRateGovernor.h>
 
 #include <std_srvs/Empty.h>
 
@@ -52,6 +54,7 @@
 #include <gazebo/sensors/Sensor.hh>
 
 #include <gazebo_plugins/PubQueue.h>
+#include <drcsim_gazebo_plugins/DRCUpdateScheduler.hh>
 
 namespace gazebo
 {
@@ -72,8 +75,8 @@ namespace gazebo
     /// \brief Update the controller periodically via Events.
     protected: virtual void UpdateStates();
 
-    /// \brief Pointer to the update event connection
-    private: event::ConnectionPtr updateConnection;
+    /// \brief Connection of UpdateStates to the update scheduler
+    private: DRCUpdateConnectionPtr updateConnection;
 
     /// \brief Thread for loading and initializing ROS
     private: void LoadThread();
@@ -109,6 +112,11 @@ namespace gazebo
     private: void SetMultiCameraFrameRate(const std_msgs::Float64::ConstPtr
                                          &_msg);
 
+    /// \brief Apply multiCameraFrameRate to the camera.  With the rate
+    /// governor enabled the rate is only ever lowered here, so that the
+    /// governor's reduction isn't undone.
+    private: void UpdateMultiCameraRate();
+
     private: ros::Subscriber set_multi_camera_resolution_sub_;
 
     private: std::string rosNamespace;
@@ -119,9 +127,56 @@ namespace gazebo
     ///  1 - 1MP (1536*816) @ up to 30 fps
     ///  2 - 0.5MP (1024*544) @ up to 60 fps (default)
     ///  3 - VGA (640*480) @ up to 70 fps
+    /// Resolution changes are only recorded here and applied later by
+    /// ApplyMultiCameraResolution on the rendering thread.
     private: void SetMultiCameraResolution(
       const std_msgs::Int32::ConstPtr &_msg);
 
+    /// \brief Resize the cameras to the pending imager mode, if any.
+    /// Connected to the pre-render event, so it runs on the rendering
+    /// thread before the cameras are drawn, never concurrently with them.
+    private: void ApplyMultiCameraResolution();
+
+    /// \brief Imager mode requested over ros and not yet applied,
+    /// -1 if none.  Only the latest request is kept.
+    private: int pendingImagerMode;
+
+    /// \brief Protects pendingImagerMode.
+    private: boost::mutex resolutionMutex;
+
+    /// \brief Number of resolution changes applied, used to give each
+    /// reallocated render texture a unique name.
+    private: unsigned int resolutionChangeCount;
+
+    /// \brief Gazebo allocates the frame buffer of a camera at its first
+    /// frame and never resizes it, so a camera growing past that size
+    /// would overflow it.  Render the first frame of every camera at the
+    /// largest imager mode, so that the buffer fits every mode, then
+    /// restore the size from the sdf.  Runs from
+    /// ApplyMultiCameraResolution.
+    /// \return true once every camera has its frame buffer.
+    private: bool SizeMultiCameraFrameBuffers();
+
+    /// \brief Set the image size of a camera, and reallocate its render
+    /// texture at that size.  Only on the rendering thread.
+    /// \param[in] _camera The camera.
+    /// \param[in] _width Image width.
+    /// \param[in] _height Image height.
+    private: void ResizeMultiCamera(rendering::CameraPtr _camera,
+                                    unsigned int _width,
+                                    unsigned int _height);
+
+    /// \brief Image sizes from the sdf of the cameras, kept while they
+    /// render their first frame at the largest size.
+    private: std::vector<unsigned int> multiCameraSdfWidths;
+    private: std::vector<unsigned int> multiCameraSdfHeights;
+
+    /// \brief Whether every camera has its frame buffer at the largest size.
+    private: bool multiCameraBuffersSized;
+
+    /// \brief Connection to the pre-render event.
+    private: event::ConnectionPtr preRenderConnection;
+
     private: ros::Subscriber set_multi_camera_exposure_time_sub_;
     private: void SetMultiCameraExposureTime(const std_msgs::Float64::ConstPtr
                                             &_msg);
@@ -170,6 +225,97 @@ namespace gazebo
     private: double lastUpdateTime;
     private: double updateRate;
 
+    /// \brief Read rate governor parameters from the ros parameter server
+    /// (under <rosNamespace>/rate_governor) and advertise its topic.
+    private: void LoadRateGovernor();
+
+    /// \brief Called every simulation step; once per measurement window,
+    /// compare the real time factor against the target and step the
+    /// camera or laser update rate down or up within their limits.
+    /// \param[in] _curTime current simulation time
+    private: void UpdateRateGovernor(const common::Time &_curTime);
+
+    /// \brief Step the update rate of one sensor by a multiplicative factor,
+    /// clamped to the given limits.
+    /// \param[in] _sensor sensor to modify
+    /// \param[in] _rate current commanded rate, updated in place
+    /// \param[in] _factor multiplier applied to _rate
+    /// \param[in] _floor lowest allowed rate
+    /// \param[in] _ceiling highest allowed rate
+    /// \return the signed change in rate, 0 if already at a limit
+    private: double StepSensorRate(sensors::SensorPtr _sensor, double &_rate,
+                                   double _factor, double _floor,
+                                   double _ceiling);
+
+    /// \brief Callbacks counting completed sensor updates.
+    private: void OnCameraUpdated();
+    private: void OnLaserUpdated();
+
+    /// \brief Laser sensor, rate controlled by the governor.
+    private: sensors::SensorPtr laserSensor;
+
+    /// \brief Laser update rate commanded by the governor.
+    private: double laserUpdateRate;
+
+    /// \brief Connections to the sensors' updated events.
+    private: event::ConnectionPtr cameraUpdatedConnection;
+    private: event::ConnectionPtr laserUpdatedConnection;
+
+    /// \brief Sensor updates completed in the current window, incremented
+    /// from the sensor thread.
+    private: unsigned int cameraUpdateCount;
+    private: unsigned int laserUpdateCount;
+
+    /// \brief Protects the update counts, and the camera rate while the
+    /// governor or UpdateMultiCameraRate sets it.
+    private: boost::mutex governorMutex;
+
+    /// \brief Enable the rate governor (param rate_governor/enable).
+    private: bool governorEnabled;
+
+    /// \brief Real time factor the governor tries to hold.
+    private: double governorTargetRTF;
+
+    /// \brief No rate change while the real time factor is within
+    /// this band around the target.
+    private: double governorDeadband;
+
+    /// \brief Measurement window, in seconds of wall time.
+    private: double governorWindow;
+
+    /// \brief Multiplier applied to a rate when stepping it down; its
+    /// inverse is used when stepping back up.
+    private: double governorStepFactor;
+
+    /// \brief Camera rate limits.  The ceiling is further limited by
+    /// multiCameraFrameRate, so set_fps stays authoritative.
+    private: double cameraRateFloor;
+    private: double cameraRateCeiling;
+
+    /// \brief Laser rate limits.
+    private: double laserRateFloor;
+    private: double laserRateCeiling;
+
+    /// \brief Estimated real time factor lost per Hz of each sensor,
+    /// learned from the response to previous steps.
+    private: double cameraCost;
+    private: double laserCost;
+
+    /// \brief Sensor changed by the last decision (0 none, 1 camera,
+    /// 2 laser), its rate change and the real time factor before it, used
+    /// to update the cost estimates on the next window.
+    private: int lastGovernorStep;
+    private: double lastGovernorStepRate;
+    private: double lastGovernorRTF;
+
+    /// \brief Start of the current measurement window.
+    private: common::Time governorWindowStartSim;
+    private: common::Time governorWindowStartWall;
+
+    /// \brief Publisher of governor decisions.
+    private: ros::Publisher pubRateGovernor;
+    private: PubQueue<atlas_msgs::SensorRateGovernor>::Ptr pubRateGovernorQueue;
+
     // ros publish multi queue, prevents publish() blocking
     private: PubMultiQueue* pmq;
   };
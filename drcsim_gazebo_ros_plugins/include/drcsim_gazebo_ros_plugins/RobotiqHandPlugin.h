@@ -19,6 +19,7 @@
 
 #include <atlas_msgs/SModelRobotInput.h>
 #include <atlas_msgs/SModelRobotOutput.h>
+#include <drcsim_gazebo_plugins/DRCUpdateScheduler.hh>
 #include <gazebo_plugins/PubQueue.h>
 #include <ros/advertise_options.h>
 #include <ros/callback_queue.h>
@@ -224,8 +225,8 @@ class RobotiqHandPlugin : public gazebo::ModelPlugin
   /// \brief Original HandleControl message (published by user and unmodified).
   private: atlas_msgs::SModelRobotOutput userHandleCommand;
 
-  /// \brief gazebo world update connection.
-  private: gazebo::event::ConnectionPtr updateConnection;
+  /// \brief connection of UpdateStates to the update scheduler.
+  private: gazebo::DRCUpdateConnectionPtr updateConnection;
 
   /// \brief keep track of controller update sim-time.
   private: gazebo::common::Time lastControllerUpdateTime;
@@ -58,6 +58,9 @@
 #include <sensor_msgs/JointState.h>
 
 #include <gazebo_plugins/PubQueue.h>
+#include <drcsim_gazebo_plugins/DRCUpdateScheduler.hh>
+
+#include "drcsim_gazebo_ros_plugins/ContactDemux.hh"
 
 namespace gazebo
 {
@@ -88,14 +91,15 @@ namespace gazebo
     private: void CopyVectorIfValid(const std::vector<double> &from,
                                     std::vector<double> &to);
 
-    /// \brief Callback for contact messages
-    /// \param[in] _msg Gazebo contact message
-    private: void OnContacts(ConstContactsPtr &_msg);
+    /// \brief Callback for the hand's contacts from the contact demux
+    /// \param[in] _view Contacts of the finger and palm collisions
+    private: void OnContacts(const ContactView &_view);
 
-    typedef std::list<boost::shared_ptr<msgs::Contacts const> > ContactMsgs_L;
+    typedef std::list<ContactView> ContactMsgs_L;
 
     /// \brief Fill ROS tactile message using Gazebo contact message
-    /// \param [in] _incomingContacts Gazebo contact message
+    /// \param [in] _incomingContacts Contacts of the finger and palm
+    /// collisions
     /// \param[in] _tactileMsg ROS tactile message
     private: void FillTactileData(ContactMsgs_L _incomingContacts,
         sandia_hand_msgs::RawTactile *_tactileMsg);
@@ -114,8 +118,8 @@ namespace gazebo
     /// Which hand (left/right)
     private: std::string side;
 
-    /// Pointer to the update event connections
-    private: event::ConnectionPtr updateConnection;
+    /// Connection of UpdateStates to the update scheduler
+    private: DRCUpdateConnectionPtr updateConnection;
 
     /// Throttle update rate
     private: double lastStatusTime;
@@ -203,15 +207,15 @@ namespace gazebo
     // flag to indicate that stumps are in use
     private: bool hasStumps;
 
-    /// \brief Subscription to contact messages
-    private: transport::SubscriberPtr contactSub;
+    /// \brief Contact demux of the world
+    private: ContactDemuxPtr contactDemux;
+
+    /// \brief Consumer ID from the contact demux
+    private: unsigned int contactDemuxId;
 
     /// \brief Incoming Gazebo contact messages
     private: ContactMsgs_L incomingContacts;
 
-    /// \brief Transport node used for subscribing to contact sensor messages.
-    private: transport::NodePtr node;
-
     /// \brief Mutex to protect reads and writes.
     private: mutable boost::mutex contactMutex;
 
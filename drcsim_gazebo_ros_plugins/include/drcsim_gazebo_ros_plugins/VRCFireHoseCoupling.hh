@@ -0,0 +1,185 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef _GAZEBO_VRC_FIRE_HOSE_COUPLING_HH_
+#define _GAZEBO_VRC_FIRE_HOSE_COUPLING_HH_
+
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+
+#include <gazebo/math/Pose.hh>
+#include <gazebo/common/Event.hh>
+#include <gazebo/common/Time.hh>
+#include <gazebo/physics/physics.hh>
+
+namespace gazebo
+{
+  class VRCFireHoseCoupling;
+
+  /// \def VRCFireHoseCouplingPtr
+  /// \brief Boost shared pointer to a VRCFireHoseCoupling object
+  typedef boost::shared_ptr<VRCFireHoseCoupling> VRCFireHoseCouplingPtr;
+
+  /// \brief Geometry of the fire hose coupling and the standpipe spout, as
+  /// configured by the <drc_fire_hose> block of VRCPlugin, and the state
+  /// machine that decides when the coupling is threaded onto the spout.
+  ///
+  /// VRCPlugin registers its coupling by world name, and VRCScoringPlugin
+  /// finds it there, so that the pose math is done once per time step
+  /// by whichever plugin updates first.  VRCPlugin makes and removes the
+  /// real screw joint when notified of a change.
+  class VRCFireHoseCoupling
+  {
+    /// \brief Constructor
+    public: VRCFireHoseCoupling();
+
+    /// \brief Destructor
+    public: virtual ~VRCFireHoseCoupling();
+
+    /// \brief Find the links and read the parameters.
+    /// \param[in] _world Pointer to the world.
+    /// \param[in] _sdf The <drc_fire_hose> element.
+    /// \return false if the hose, standpipe or coupling collision is missing.
+    public: bool Load(physics::WorldPtr _world, sdf::ElementPtr _sdf);
+
+    /// \brief Whether Load succeeded.
+    public: bool IsLoaded() const;
+
+    /// \brief Make a coupling available to other plugins of a world.
+    /// Only a weak reference is kept, the coupling is unregistered when
+    /// its owner releases it.
+    /// \param[in] _worldName Name of the world.
+    /// \param[in] _coupling The coupling.
+    public: static void Register(const std::string &_worldName,
+                                 VRCFireHoseCouplingPtr _coupling);
+
+    /// \brief Find the coupling registered for a world.
+    /// \param[in] _worldName Name of the world.
+    /// \return The coupling, NULL if there's none.
+    public: static VRCFireHoseCouplingPtr Find(const std::string &_worldName);
+
+    /// \brief Check that the hose coupler is positioned within tolerance
+    /// to start threading, and that the valve is not opened.  The pose
+    /// checks are skipped while the coupling is far from the spout.
+    /// \param[in] _couplingPose World pose of the coupling link.
+    /// \return true if a screw joint should be made.
+    public: bool CanStartThread(const math::Pose &_couplingPose) const;
+
+    /// \brief Step the state machine: start threading when the coupling
+    /// is lined up, stop when it's unscrewed.  Does the work once per
+    /// simulation time, so every plugin can call it on each update.
+    /// When no screw joint has been set, the joint position is the
+    /// coupler travel along its x axis times the thread pitch, e.g. when
+    /// replaying a state log.
+    /// \param[in] _simTime Current simulation time.
+    /// \return true if the coupling is threaded.
+    public: bool Update(const common::Time &_simTime);
+
+    /// \brief Whether the coupling is threaded, as of the last Update.
+    public: bool IsThreaded() const;
+
+    /// \brief Coupler travel along its x axis since threading started,
+    /// as of the last Update.
+    public: double GetThreadTravel() const;
+
+    /// \brief Set the joint that holds the coupling while threaded; its
+    /// position is used to decide when the hose is unscrewed.
+    /// \param[in] _joint The screw joint.
+    public: void SetScrewJoint(physics::JointPtr _joint);
+
+    /// \brief Forget the threaded state without notifying, for when the
+    /// screw joint was removed by other means.
+    public: void Reset();
+
+    /// \brief Connect to threading changes.
+    /// \param[in] _subscriber Called with true when threading starts and
+    /// false when it stops.
+    /// \return The connection.
+    public: event::ConnectionPtr ConnectThreadChanged(
+                const boost::function<void (bool)> &_subscriber);
+
+    /// \brief Disconnect from threading changes.
+    /// \param[in] _connection The connection.
+    public: void DisconnectThreadChanged(event::ConnectionPtr _connection);
+
+    /// \brief The fire hose model
+    public: physics::ModelPtr GetFireHoseModel() const;
+
+    /// \brief The coupling link, on the hose
+    public: physics::LinkPtr GetCouplingLink() const;
+
+    /// \brief The spout link, on the standpipe
+    public: physics::LinkPtr GetSpoutLink() const;
+
+    /// \brief The valve joint, may be NULL
+    public: physics::JointPtr GetValveJoint() const;
+
+    /// \brief Screw joint thread pitch
+    public: double GetThreadPitch() const;
+
+    /// \brief The fire hose model
+    private: physics::ModelPtr fireHoseModel;
+
+    /// \brief The coupling link
+    private: physics::LinkPtr couplingLink;
+
+    /// \brief The spout link
+    private: physics::LinkPtr spoutLink;
+
+    /// \brief The valve joint
+    private: physics::JointPtr valveJoint;
+
+    /// \brief Screw joint thread pitch
+    private: double threadPitch;
+
+    /// \brief Pose of the coupling relative to the spout when lined up
+    private: math::Pose couplingRelativePose;
+
+    /// \brief offset of the coupling attachment_col end face from the
+    /// coupling link origin, along the link x axis.
+    private: double collisionSurfaceZOffset;
+
+    /// \brief Squared distance between the coupling and spout origins
+    /// beyond which threading can't start
+    private: double broadPhaseDistanceSquared;
+
+    /// \brief Whether the coupling is threaded
+    private: bool threaded;
+
+    /// \brief Pose of the coupling when threading started
+    private: math::Pose threadStartPose;
+
+    /// \brief Coupler travel along its x axis since threading started
+    private: double threadTravel;
+
+    /// \brief The screw joint, if one was made
+    private: physics::JointPtr screwJoint;
+
+    /// \brief Simulation time of the last Update
+    private: common::Time lastUpdateTime;
+
+    /// \brief Whether Update has run since Load or Reset
+    private: bool updated;
+
+    /// \brief Threading changes
+    private: event::EventT<void (bool)> threadChanged;
+
+    /// \brief Whether Load succeeded
+    private: bool isLoaded;
+  };
+}
+#endif
@@ -18,6 +18,7 @@
 #ifndef GAZEBO_VRC_PLUGIN_HH
 #define GAZEBO_VRC_PLUGIN_HH
 
+#include <deque>
 #include <map>
 #include <string>
 #include <vector>
@@ -28,12 +29,16 @@
 #include <ros/subscribe_options.h>
 #include <geometry_msgs/Twist.h>
 #include <geometry_msgs/Pose.h>
+#include <geometry_msgs/PoseArray.h>
 #include <std_msgs/String.h>
 #include <sensor_msgs/JointState.h>
 
 #include <atlas_msgs/AtlasCommand.h>
 #include <atlas_msgs/AtlasSimInterfaceCommand.h>
 #include <atlas_msgs/AtlasSimInterfaceState.h>
+#include <atlas_msgs/VRCSnapshot.h>
+#include <atlas_msgs/SaveSnapshot.h>
+#include <atlas_msgs/RestoreSnapshot.h>
 
 #include <boost/thread.hpp>
 #include <boost/thread/mutex.hpp>
@@ -45,6 +50,12 @@
 #include <gazebo/common/Plugin.hh>
 #include <gazebo/common/Events.hh>
 
+#include <gazebo_plugins/PubQueue.h>
+#include <drcsim_gazebo_plugins/DRCUpdateScheduler.hh>
+
+#include "drcsim_gazebo_ros_plugins/ModelReadiness.hh"
+#include "drcsim_gazebo_ros_plugins/VRCFireHoseCoupling.hh"
+
 namespace gazebo
 {
   class VRCPlugin : public WorldPlugin
@@ -63,6 +74,11 @@ namespace gazebo
     /// \brief Update the controller on every World::Update
     private: void UpdateStates();
 
+    /// \brief Called by the readiness service once the atlas model queued
+    /// for spawning is loaded, with its pin link.
+    /// \param[in] _model The atlas model.
+    private: void OnAtlasSpawned(physics::ModelPtr _model);
+
     ////////////////////////////////////////////////////////////////////////////
     //                                                                        //
     //   List of available actions                                            //
@@ -90,6 +106,36 @@ namespace gazebo
     /// \param[in] _cmd Pose command for the robot
     public: void SetRobotPose(const geometry_msgs::Pose::ConstPtr &_cmd);
 
+    /// \brief Move the robot kinematically along a list of waypoints.
+    /// The robot's links are made kinematic during the transit, which
+    /// freezes its joints and its controller while the rest of the world
+    /// keeps simulating, and the robot is moved
+    /// along the path at atlas/fast_travel/speed times
+    /// atlas/fast_travel/real_time_multiple, and the robot is set down and
+    /// the startup stand sequence re-run on arrival.
+    /// \param[in] _waypoints world poses of the pin link; only position x, y
+    /// and yaw are used.  A single pose is a plain goal.  An empty list
+    /// aborts a transit in progress where it is.
+    public: void SetRobotFastTravel(
+      const geometry_msgs::PoseArray::ConstPtr &_waypoints);
+
+    /// \brief ros service callback to capture the scenario: model, link and
+    /// joint states, robot pin state and AtlasPlugin controller internals.
+    /// The snapshot is kept in memory and optionally written to
+    /// _req.filename.
+    /// \param[in] _req Incoming ros service request
+    /// \param[in] _res Outgoing ros service response
+    public: bool SaveSnapshot(atlas_msgs::SaveSnapshot::Request &_req,
+      atlas_msgs::SaveSnapshot::Response &_res);
+
+    /// \brief ros service callback to put the scenario back into a
+    /// snapshot taken by SaveSnapshot, read from _req.filename if set.
+    /// Sim time is not rewound.
+    /// \param[in] _req Incoming ros service request
+    /// \param[in] _res Outgoing ros service response
+    public: bool RestoreSnapshot(atlas_msgs::RestoreSnapshot::Request &_req,
+      atlas_msgs::RestoreSnapshot::Response &_res);
+
     /// \brief sets robot's joint positions
     /// \param[in] _cmd configuration made of sensor_msgs::JointState message
     /// \todo: not yet implemented
@@ -194,6 +240,11 @@ namespace gazebo
     /// if links are aligned
     private: void CheckThreadStart();
 
+    /// \brief Make or remove the screw joint when the fire hose coupling
+    /// starts or stops threading.
+    /// \param[in] _threaded Whether the coupling is threaded.
+    private: void OnFireHoseThreadChanged(bool _threaded);
+
     /// \brief: thread out Load function with
     /// with anything that might be blocking.
     private: void DeferredLoad();
@@ -201,6 +252,78 @@ namespace gazebo
     /// \brief ROS callback queue thread
     private: void ROSQueueThread();
 
+    /// \brief Publish fake AtlasSimInterfaceState for cheats, throttled to
+    /// atlas/fake/atlas_sim_interface_state_rate.
+    private: void PublishFakeASIS();
+
+    /// \brief Advance a fast travel transit, called every update.
+    /// \sa SetRobotFastTravel
+    private: void UpdateFastTravel();
+
+    /// \brief Make all links of the robot kinematic, or dynamic again.
+    /// AtlasPlugin doesn't control a kinematic robot.
+    /// \param[in] _kinematic true to freeze the robot.
+    private: void SetAtlasKinematic(bool _kinematic);
+
+    /// \brief A snapshot capture or restore, run by UpdateSnapshotJob on
+    /// the world update thread for the thread that queued it.
+    private: struct SnapshotJob
+             {
+               /// \brief Restore snapshot, else capture into it.
+               bool restore;
+
+               /// \brief Restore of the startup snapshot, run while
+               /// startupSnapshotPending is set.
+               bool startup;
+
+               /// \brief Snapshot to restore, or captured.
+               atlas_msgs::VRCSnapshot snapshot;
+
+               /// \brief Reason for failure.
+               std::string status;
+
+               /// \brief Result, set once done.
+               bool success;
+               bool done;
+             };
+
+    /// \brief Queue a snapshot job and wait for UpdateSnapshotJob to run
+    /// it.  A paused world is stepped once for the job to run, except for
+    /// the startup snapshot, which waits for the world to be unpaused.
+    /// \param[in,out] _job The job.
+    /// \return the job's success.
+    private: bool RunSnapshotJob(SnapshotJob &_job);
+
+    /// \brief Run the queued snapshot job, if any, called every update.
+    private: void UpdateSnapshotJob();
+
+    /// \brief Capture the current scenario into _snapshot.  Only called
+    /// from the world update thread, which keeps the world still.
+    /// \param[out] _snapshot destination.
+    /// \param[out] _status reason for failure.
+    /// \return true on success.
+    private: bool CaptureSnapshot(atlas_msgs::VRCSnapshot &_snapshot,
+      std::string &_status);
+
+    /// \brief Put the scenario into _snapshot and mark robot startup done.
+    /// Only called from the world update thread.
+    /// \param[in] _snapshot snapshot to restore.
+    /// \param[out] _status reason for failure.
+    /// \return true on success.
+    private: bool ApplySnapshot(const atlas_msgs::VRCSnapshot &_snapshot,
+      std::string &_status);
+
+    /// \brief Snapshot file helpers.  Files hold the VRCSnapshot message
+    /// md5sum on the first line, followed by the serialized message.
+    private: bool WriteSnapshotFile(const std::string &_filename,
+      const atlas_msgs::VRCSnapshot &_snapshot, std::string &_status);
+    private: bool ReadSnapshotFile(const std::string &_filename,
+      atlas_msgs::VRCSnapshot &_snapshot, std::string &_status);
+
+    /// \brief Restore drc_world/startup_snapshot in place of the startup
+    /// sequence, once AtlasPlugin is up.  Runs in its own thread.
+    private: void RestoreStartupSnapshot();
+
     /// \brief Helper for pinning Atlas to the world.
     /// \param[in] _with_gravity Whether to enable gravity on the robot's
     /// links after pinning it.
@@ -314,13 +437,29 @@ namespace gazebo
 
       private: double startupHarnessDuration;
 
+      /// \brief Set when the startup sequence is re-run to stand the robot
+      /// up after a fast travel, skips robot_start_in_vehicle.
+      private: bool restartAfterFastTravel;
+
       private: ros::Subscriber subTrajectory;
       private: ros::Subscriber subPose;
       private: ros::Subscriber subConfiguration;
       private: ros::Subscriber subMode;
       private: ros::Subscriber subFakeASIC;
+      private: ros::Subscriber subFastTravel;
       /// \brief publisher of fake AtlasSimInterfaceState
       private: ros::Publisher pubFakeASIS;
+      private: PubQueue<atlas_msgs::AtlasSimInterfaceState>::Ptr
+        pubFakeASISQueue;
+
+      /// \brief fake AtlasSimInterfaceState publication rate in sim time Hz,
+      /// 0 publishes every update.
+      private: double fakeASISRate;
+      private: common::Time lastFakeASISTime;
+
+      /// \brief feet, resolved when the robot is spawned.
+      private: physics::LinkPtr lFootLink;
+      private: physics::LinkPtr rFootLink;
       /// \brief current requested (fake) behavior
       private: int currentBehavior;
       /// \brief current (fake) step being pursued
@@ -368,10 +507,20 @@ namespace gazebo
       /// \param[in] _sdf Pointer to sdf element.
       private: void Load(physics::WorldPtr _parent, sdf::ElementPtr _sdf);
 
+      /// \brief Simulate the full chain only while the robot is near the
+      /// hose; otherwise freeze the hose in its current shape once it
+      /// comes to rest.
+      /// \param[in] _robot The robot, may be NULL.
+      /// \param[in] _simTime Current simulation time.
+      private: void UpdateReducedOrder(physics::ModelPtr _robot,
+                                       const common::Time &_simTime);
+
+      /// \brief Freeze or unfreeze the hose links, keeping their poses.
+      /// \param[in] _reduced true to freeze.
+      private: void SetReducedOrder(bool _reduced);
+
       private: physics::ModelPtr fireHoseModel;
       private: physics::ModelPtr standpipeModel;
-      private: physics::ModelPtr valveModel;
-      private: physics::JointPtr valveJoint;
 
       /// joint for pinning a link to the world
       private: physics::JointPtr fixedJoint;
@@ -381,16 +530,34 @@ namespace gazebo
       private: physics::Link_V fireHoseLinks;
       /// screw joint
       private: physics::JointPtr screwJoint;
-      private: double threadPitch;
 
       /// Pointer to the update event connection
       private: event::ConnectionPtr updateConnection;
 
       private: physics::LinkPtr couplingLink;
-      private: physics::LinkPtr spoutLink;
-      private: math::Pose couplingRelativePose;
       private: math::Pose initialFireHosePose;
 
+      /// \brief Coupling geometry and threading state, shared with
+      /// VRCScoringPlugin
+      private: VRCFireHoseCouplingPtr coupling;
+
+      /// \brief Connection to coupling threading changes
+      private: event::ConnectionPtr threadConnection;
+
+      /// \brief Robot distance from the hose within which the full chain
+      /// is simulated, from <reduced_order_distance>; 0 to always simulate
+      /// it.
+      private: double reducedOrderDistance;
+
+      /// \brief Whether the hose links are frozen
+      private: bool reducedOrder;
+
+      /// \brief Bounding box of the frozen hose
+      private: math::Box reducedOrderBox;
+
+      /// \brief Last time the hose was checked for coming to rest
+      private: common::Time restCheckTime;
+
       /// \brief flag for successful initialization of fire hose, standpipe
       private: bool isInitialized;
 
@@ -502,14 +669,24 @@ namespace gazebo
     /// \brief Pointer to parent world.
     private: physics::WorldPtr world;
 
-    /// \brief Pointer to the update event connection
-    private: event::ConnectionPtr updateConnection;
+    /// \brief Connection of UpdateStates to the update scheduler
+    private: DRCUpdateConnectionPtr updateConnection;
+
+    /// \brief Calls OnAtlasSpawned while atlas is being spawned, and
+    /// times the startup from when this plugin loaded
+    private: ModelReadinessPtr readiness;
+
+    /// \brief Waiter ID of OnAtlasSpawned in readiness, NO_WAITER if none
+    private: unsigned int atlasReadyId;
 
     // default ros stuff
     private: ros::NodeHandle* rosNode;
     private: ros::CallbackQueue rosQueue;
     private: boost::thread callbackQueueThread;
 
+    /// \brief non-blocking publication off the update thread
+    private: PubMultiQueue* pmq;
+
     // ros subscribers for robot actions
     private: ros::Subscriber subRobotGrab;
     private: ros::Subscriber subRobotRelease;
@@ -526,6 +703,60 @@ namespace gazebo
 
     /// \brief time out when receiving fake teleop cmd_vel command
     private: double cmdVelTopicTimeout;
+
+    /// \brief Fast travel transit in progress.
+    private: bool fastTravelActive;
+
+    /// \brief Waypoints received over ros, picked up by UpdateFastTravel.
+    private: std::deque<math::Pose> fastTravelRequest;
+    private: bool fastTravelRequested;
+    private: boost::mutex fastTravelMutex;
+
+    /// \brief Remaining waypoints of the current transit.
+    private: std::deque<math::Pose> fastTravelWaypoints;
+
+    /// \brief Pin link pose at the start of the current path segment,
+    /// used to interpolate heading.
+    private: math::Pose fastTravelSegmentStart;
+
+    /// \brief Nominal transit speed in m/s, and how many times faster
+    /// than real time it is played back.
+    private: double fastTravelSpeed;
+    private: double fastTravelRealTimeMultiple;
+
+    /// \brief Wall time of the last transit step.
+    private: common::Time fastTravelLastWallTime;
+
+    /// \brief Scenario snapshot services.
+    private: ros::ServiceServer saveSnapshotService;
+    private: ros::ServiceServer restoreSnapshotService;
+
+    /// \brief Clients of the AtlasPlugin controller state services.
+    private: ros::ServiceClient getControllerStateClient;
+    private: ros::ServiceClient setControllerStateClient;
+
+    /// \brief Last snapshot saved.
+    private: atlas_msgs::VRCSnapshot snapshot;
+    private: bool haveSnapshot;
+    private: boost::mutex snapshotMutex;
+
+    /// \brief Snapshot file to start the robot from, skipping the startup
+    /// sequence, from the drc_world/startup_snapshot parameter.
+    private: std::string startupSnapshotFile;
+
+    /// \brief Set while the startup snapshot is being restored.
+    private: bool startupSnapshotPending;
+    private: boost::thread startupSnapshotThread;
+
+    /// \brief Snapshot job waiting for UpdateSnapshotJob, NULL if none.
+    private: SnapshotJob *snapshotJob;
+
+    /// \brief Protects snapshotJob and startupSnapshotPending, held while
+    /// a job runs.
+    private: boost::mutex snapshotJobMutex;
+
+    /// \brief Notified when a snapshot job is done.
+    private: boost::condition_variable snapshotJobDone;
   };
 /** \} */
 /// @}
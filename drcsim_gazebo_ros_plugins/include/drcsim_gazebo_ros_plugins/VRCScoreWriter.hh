@@ -0,0 +1,165 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef _GAZEBO_VRC_SCORE_WRITER_HH_
+#define _GAZEBO_VRC_SCORE_WRITER_HH_
+
+#include <deque>
+#include <fstream>
+#include <string>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/filesystem.hpp>
+
+#include <gazebo/common/Time.hh>
+
+namespace gazebo
+{
+  /// \brief Writes VRC score records to disk from a background thread, so
+  /// that file I/O never stalls the simulation.
+  ///
+  /// Records are handed over through a bounded queue.  Periodic records
+  /// are flushed in batches, at least once a second; forced records are
+  /// flushed right away, so scoring events reach the disk even if the
+  /// process dies afterwards.  Close() drains the queue and flushes.
+  ///
+  /// Optionally, forced records are also appended to a binary event log:
+  /// an 8 byte magic "VRCEVT1\n", then per event 4 doubles (wallTime,
+  /// simTime, wallTimeElapsed, simTimeElapsed), 2 int32 (completionScore,
+  /// falls), a uint16 message length and the message bytes, all in host
+  /// byte order.
+  class VRCScoreWriter
+  {
+    /// \brief One line of score data.
+    public: class Record
+            {
+              public: Record() : completionScore(0), falls(0), force(false) {}
+
+              /// \brief Wall time since the start of the run
+              public: common::Time wallTime;
+
+              /// \brief Current simulation time
+              public: common::Time simTime;
+
+              /// \brief Elapsed wall time on the task clock
+              public: common::Time wallTimeElapsed;
+
+              /// \brief Elapsed sim time on the task clock
+              public: common::Time simTimeElapsed;
+
+              /// \brief The completion score
+              public: int completionScore;
+
+              /// \brief Number of falls
+              public: int falls;
+
+              /// \brief Log message
+              public: std::string msg;
+
+              /// \brief Whether something interesting happened
+              public: bool force;
+            };
+
+    /// \brief Constructor
+    public: VRCScoreWriter();
+
+    /// \brief Destructor, closes the writer.
+    public: virtual ~VRCScoreWriter();
+
+    /// \brief Open the score file, write its header and start the writer
+    /// thread.
+    /// \param[in] _scorePath Path of the score file; parent directories
+    /// are created as needed.
+    /// \param[in] _worldName Name of the world, for the header.
+    /// \param[in] _runStartTimeWall Absolute wall time the run started.
+    /// \param[in] _eventLogPath Path of the binary event log, empty for none.
+    /// \return false if a file couldn't be opened.
+    public: bool Open(const boost::filesystem::path &_scorePath,
+                      const std::string &_worldName,
+                      const common::Time &_runStartTimeWall,
+                      const std::string &_eventLogPath = "");
+
+    /// \brief Queue a record for writing; never blocks on I/O.  When the
+    /// queue is full, periodic records are dropped, forced ones are kept.
+    /// \param[in] _record The record.
+    /// \return false if the writer isn't open or the record was dropped.
+    public: bool Push(const Record &_record);
+
+    /// \brief Write out everything queued, flush and close the files.
+    public: void Close();
+
+    /// \brief Whether the writer is open.
+    public: bool IsOpen() const;
+
+    /// \brief Set a function to call from the writer thread after each
+    /// forced record is written.
+    /// \param[in] _callback The function.
+    public: void SetForceCallback(const boost::function<void()> &_callback);
+
+    /// \brief Writer thread
+    private: void Run();
+
+    /// \brief Write one record to the score file, and the event log if
+    /// it's forced.
+    /// \param[in] _record The record.
+    private: void Write(const Record &_record);
+
+    /// \brief Maximum number of records waiting to be written.
+    private: static const unsigned int maxQueueSize = 1024;
+
+    /// \brief Number of periodic records written before a flush.
+    private: static const unsigned int flushBatchSize = 16;
+
+    /// \brief Path of the score file
+    private: boost::filesystem::path scoreFilePath;
+
+    /// \brief The stream associated with scoreFilePath
+    private: std::ofstream scoreFileStream;
+
+    /// \brief The binary event log, if any
+    private: std::ofstream eventLogStream;
+
+    /// \brief Records waiting to be written
+    private: std::deque<Record> queue;
+
+    /// \brief Protects queue, running and droppedCount
+    private: boost::mutex queueMutex;
+
+    /// \brief Signaled when a record is queued or the writer is closing
+    private: boost::condition queueCondition;
+
+    /// \brief The writer thread
+    private: boost::thread writerThread;
+
+    /// \brief Whether the writer thread should keep running
+    private: bool running;
+
+    /// \brief Number of periodic records dropped because the queue was full
+    private: unsigned int droppedCount;
+
+    /// \brief Number of records written since the last flush
+    private: unsigned int unflushedCount;
+
+    /// \brief Wall time of the last flush
+    private: common::Time lastFlushTime;
+
+    /// \brief Called after each forced record is written
+    private: boost::function<void()> forceCallback;
+  };
+}
+#endif
@@ -0,0 +1,410 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef _GAZEBO_VRC_SCORING_ENGINE_HH_
+#define _GAZEBO_VRC_SCORING_ENGINE_HH_
+
+#include <string>
+#include <vector>
+
+#include <gazebo/math/Box.hh>
+#include <gazebo/math/Pose.hh>
+#include <gazebo/math/Quaternion.hh>
+#include <gazebo/math/Vector3.hh>
+#include <gazebo/physics/physics.hh>
+#include <gazebo/common/Time.hh>
+
+#include "drcsim_gazebo_ros_plugins/AtlasControlKernels.hh"
+#include "drcsim_gazebo_ros_plugins/VRCFireHoseCoupling.hh"
+
+namespace gazebo
+{
+  /// \brief The VRC scoring rules.  Each task is described by a table of
+  /// rule sequences (see VRCScoringEngine.cc), which is compiled at Load
+  /// into a list of checkpoints per sequence.  Only the next checkpoint of
+  /// each sequence is tested on Update, so the cost of an update doesn't
+  /// grow with the number of gates in the world.
+  class VRCScoringEngine
+  {
+    /// \brief The worlds that we might be scoring; each one can be
+    /// slightly different
+    public: enum WorldType
+            {
+              QUAL_1,
+              QUAL_2,
+              QUAL_3,
+              QUAL_4,
+              VRC_1,
+              VRC_2,
+              VRC_3,
+              UNKNOWN
+            };
+
+    /// \brief Kinds of checkpoints that a rule can test.
+    public: enum RuleType
+            {
+              /// \brief Go forward through the next gate
+              GATE,
+              /// \brief Atlas is in the region above the vehicle seat
+              ATLAS_IN_VEHICLE,
+              /// \brief The drill is in the bin
+              DRILL_IN_BIN,
+              /// \brief The hose coupler is up at the height of the standpipe
+              HOSE_OFF_TABLE,
+              /// \brief The hose coupler is aligned with the standpipe
+              HOSE_ALIGNED,
+              /// \brief The hose coupler is threaded onto the standpipe
+              HOSE_CONNECTED,
+              /// \brief The valve is turned at least one rotation
+              VALVE_OPEN
+            };
+
+    /// \brief What happens when a checkpoint is reached, or'ed together.
+    public: enum RuleAction
+            {
+              /// \brief Add one to the completion score
+              SCORE = 0x1,
+              /// \brief Start the clock
+              START_CLOCK = 0x2,
+              /// \brief Stop the clock
+              STOP_CLOCK = 0x4,
+              /// \brief Write the score right away
+              FORCE_LOG = 0x8
+            };
+
+    /// \brief Constructor
+    public: VRCScoringEngine();
+
+    /// \brief Destructor
+    public: virtual ~VRCScoringEngine();
+
+    /// \brief Pick the rule table from the world name, find the entities
+    /// that the rules refer to, and compile the table.
+    /// \param[in] _world Pointer to the world.
+    /// \param[in] _sdf Pointer to the scoring plugin's SDF.
+    /// \return false if the world can't be scored.
+    public: bool Load(physics::WorldPtr _world, sdf::ElementPtr _sdf);
+
+    /// \brief Set the robot, which usually shows up some time after Load.
+    /// \param[in] _atlas Pointer to Atlas.
+    /// \return false if Atlas lacks a link needed for scoring.
+    public: bool SetRobot(physics::ModelPtr _atlas);
+
+    /// \brief Decide hose alignment from the coupling and spout poses,
+    /// instead of looking for the screw joint that VRCPlugin makes.  For
+    /// worlds that run without VRCPlugin, e.g. when replaying a state log.
+    /// \param[in] _sdf The <drc_fire_hose> element of VRCPlugin.
+    /// \return false if the coupling geometry can't be found.
+    public: bool InferHoseAlignment(sdf::ElementPtr _sdf);
+
+    /// \brief Check the rules against the current state of the world.
+    /// \param[in] _simTime Current simulation time
+    /// \param[in] _wallTime Current wallclock time
+    /// \param[out] _msg Log messages (e.g., "passed gate") will be appended
+    /// \return true if the score changed or something happened that should
+    /// be written out right away.
+    public: bool Update(const common::Time &_simTime,
+                        const common::Time &_wallTime,
+                        std::string &_msg);
+
+    /// \brief Elapsed time on the clock; zero until it starts, and frozen
+    /// once it stops.
+    /// \param[in] _simTime Current simulation time
+    /// \param[in] _wallTime Current wallclock time
+    /// \param[out] _elapsedSim Elapsed simulation time
+    /// \param[out] _elapsedWall Elapsed wallclock time
+    public: void GetElapsedTime(const common::Time &_simTime,
+                                const common::Time &_wallTime,
+                                common::Time &_elapsedSim,
+                                common::Time &_elapsedWall) const;
+
+    /// \brief Which type of world we're scoring
+    public: WorldType GetWorldType() const;
+
+    /// \brief The completion score, called 'C' in the VRC docs
+    public: int GetCompletionScore() const;
+
+    /// \brief How many big falls we've taken
+    public: int GetFalls() const;
+
+    /// \brief Data about a gate.
+    private: class Gate
+             {
+               /// \brief Types of gates that we know about
+               public: enum GateType
+               {
+                 PEDESTRIAN,
+                 VEHICLE
+               };
+
+               public: Gate(const std::string &_name,
+                            GateType _type,
+                            unsigned int _number,
+                            const gazebo::math::Pose& _pose,
+                            double _width)
+                         : name(_name), type(_type),
+                           number(_number), pose(_pose),
+                           invRot(_pose.rot.GetInverse()),
+                           width(_width), halfWidth(_width / 2.0) {}
+
+               /// \brief Less-than operator to allow sorting of a list of
+               /// gates by number.
+               public: bool operator< (const Gate &other) const
+                       {
+                         return (this->number < other.number);
+                       }
+
+               /// \brief Name of the gate
+               public: std::string name;
+
+               /// \brief The type of the gate
+               public: GateType type;
+
+               /// \brief Number of the gate
+               public: unsigned int number;
+
+               /// \brief Pose of the center of the gate
+               public: gazebo::math::Pose pose;
+
+               /// \brief Inverse of the gate orientation, to transform
+               /// world positions into the gate frame.
+               public: gazebo::math::Quaternion invRot;
+
+               /// \brief Width of the gate
+               public: double width;
+
+               /// \brief Half of the width of the gate
+               public: double halfWidth;
+             };
+
+    /// \brief A compiled rule.
+    private: class Rule
+             {
+               public: Rule(RuleType _type, unsigned int _actions,
+                            unsigned int _gate = 0)
+                         : type(_type), actions(_actions), gate(_gate) {}
+
+               /// \brief What the rule checks
+               public: RuleType type;
+
+               /// \brief RuleAction flags applied when the check passes
+               public: unsigned int actions;
+
+               /// \brief Index into gates, for GATE rules
+               public: unsigned int gate;
+             };
+
+    /// \brief A compiled sequence of rules, met one after the other.
+    private: class Sequence
+             {
+               public: Sequence() : next(0), gateSide(-1), tracksHose(false) {}
+
+               /// \brief The rules, in order
+               public: std::vector<Rule> rules;
+
+               /// \brief Index of the next rule to check
+               public: unsigned int next;
+
+               /// \brief Which side of the next gate we were the last time
+               /// we checked.
+               public: int gateSide;
+
+               /// \brief Whether rules in this sequence read the hose state,
+               /// which is then updated before the sequence is checked.
+               public: bool tracksHose;
+             };
+
+    /// \brief Find the gates in the world and store them in this->gates.
+    private: bool FindGates();
+
+    /// \brief Find the drill and the bin (Q2)
+    private: bool FindDrillAndBin();
+
+    /// \brief Find the vehicle seat (V1)
+    private: bool FindVehicle();
+
+    /// \brief Find the hose coupler and standpipe (V3)
+    private: bool FindHose();
+
+    /// \brief Find the valve (V3)
+    private: bool FindValve();
+
+    /// \brief Check the given rule
+    /// \param _seq Sequence the rule belongs to
+    /// \param _rule The rule
+    /// \param _msg Log messages (e.g., "passed gate") will be appended here
+    /// \return true if the rule was met
+    private: bool CheckRule(Sequence &_seq, const Rule &_rule,
+                            std::string &_msg);
+
+    /// \brief Check whether we've gone through a gate
+    /// \param _seq Sequence the gate belongs to, holds the side we were on
+    /// \param _gate The gate
+    /// \param _msg Log messages (e.g., "passed gate") will be appended here
+    /// \return true if the gate was passed, false otherwise
+    private: bool CheckGate(Sequence &_seq, const Gate &_gate,
+                            std::string &_msg);
+
+    /// \brief Check whether we've fallen
+    /// \param _simTime Current simulation time
+    /// \param _msg Log messages (e.g., "passed gate") will be appended here
+    /// \return true if we've fallen, false otherwise
+    private: bool CheckFall(const common::Time &_simTime,
+      std::string &_msg);
+
+    /// \brief Check whether Atlas is in the vehicle
+    /// \param _msg Log messages (e.g., "entered vehicle") will be appended here
+    /// \return true if Atlas is in the vehicle, false otherwise
+    private: bool CheckAtlasInVehicle(std::string &_msg);
+
+    /// \brief Check whether the drill is in the bin
+    /// \param _msg Log messages (e.g., "passed gate") will be appended here
+    /// \return true if the drill was placed in the bin, false otherwise
+    private: bool CheckDrillInBin(std::string &_msg);
+
+    /// \brief Check whether the hose is off the table
+    /// \param _msg Log messages (e.g., "passed gate") will be appended here
+    /// \return true if the hose off the table, false otherwise
+    private: bool CheckHoseOffTable(std::string &_msg);
+
+    /// \brief Update the alignment and connection state of the hose; it's
+    /// done every cycle, because the competitor might align/connect and
+    /// unalign/disconnect the hose multiple times.
+    /// \param _simTime Current simulation time
+    /// \param _msg Log messages (e.g., "passed gate") will be appended here
+    private: void UpdateHose(const common::Time &_simTime, std::string &_msg);
+
+    /// \brief Check whether the valve is turned.
+    /// \param _msg Log messages (e.g., "passed gate") will be appended here
+    /// \return true if the valve is open, false otherwise
+    private: bool CheckValveOpen(std::string &_msg);
+
+    /// \brief Start the clock, used in computing elapsed time for the run
+    /// \param _simTime Current simulation time
+    /// \param _wallTime Current wallclock time
+    /// \param _msg Log messages (e.g., "starting clock") will be appended
+    private: void StartClock(const common::Time &_simTime,
+                             const common::Time &_wallTime,
+                             std::string &_msg);
+
+    /// \brief Stop the clock, used in computing elapsed time for the run
+    /// \param _simTime Current simulation time
+    /// \param _wallTime Current wallclock time
+    /// \param _msg Log messages (e.g., "stopping clock") will be appended
+    private: void StopClock(const common::Time &_simTime,
+                            const common::Time &_wallTime,
+                            std::string &_msg);
+
+    /// \brief Is the given robot pose "in" the given gate?
+    /// \param _robotWorldPose Pose of the robot, in the world frame
+    /// \param _gate The gate
+    /// \return If not "in" the gate, return 0; else return -1 if "before" the
+    ///         gate, 1 if "after" the gate.
+    private: int IsPoseInGate(const gazebo::math::Pose& _robotWorldPose,
+                              const Gate &_gate) const;
+
+    /// \brief Pointer to the world.
+    private: physics::WorldPtr world;
+
+    /// \brief Which type of world we're scoring
+    private: WorldType worldType;
+
+    /// \brief The compiled rule sequences, checked in order on each update.
+    private: std::vector<Sequence> sequences;
+
+    /// \brief All the gates in the world, sorted by number. We assume that
+    /// gates have the names: gate_1, gate_2, ..., gate_n.
+    private: std::vector<Gate> gates;
+
+    /// \brief Pointer to Atlas.
+    private: physics::ModelPtr atlas;
+
+    /// \brief Pointer to Atlas's head link.
+    private: physics::LinkPtr atlasHead;
+
+    /// \brief Pointer to drill. (Q2)
+    private: physics::ModelPtr drill;
+
+    /// \brief The bin that will receive the drill (Q2)
+    private: gazebo::math::Box bin;
+
+    /// \brief Pointer to vehicle. (V1)
+    private: physics::ModelPtr vehicle;
+
+    /// \brief Pointer to "seat" collision. (V1)
+    private: physics::CollisionPtr vehicleSeat;
+
+    /// \brief Pointer to "seat_back" collision. (V1)
+    private: physics::CollisionPtr vehicleSeatBack;
+
+    /// \brief Pointer to the hose coupler. (V3)
+    private: physics::LinkPtr hoseCoupler;
+
+    /// \brief Pointer to the standpipe. (V3)
+    private: physics::LinkPtr standpipe;
+
+    /// \brief Pointer to the valve. (V3)
+    private: physics::JointPtr valve;
+
+    /// \brief Coupling state shared with VRCPlugin, or our own when hose
+    /// alignment is inferred (V3)
+    private: VRCFireHoseCouplingPtr coupling;
+
+    /// \brief Whether the hose is currently aligned to the standpipe (V3)
+    private: bool isHoseAligned;
+
+    /// \brief Whether the hose is currently connected to the standpipe (V3)
+    private: bool isHoseConnected;
+
+    /// \brief Whether the hose coupler is threaded deep enough this cycle,
+    /// without the hysteresis of isHoseConnected (V3)
+    private: bool isHoseThreaded;
+
+    /// \brief Pose of the hose coupler at the time of initial alignment (V3)
+    private: math::Pose hoseCouplerAlignedPose;
+
+    /// \brief Sim time at which the clock started.
+    private: gazebo::common::Time startTimeSim;
+
+    /// \brief Wall time at which the clock started.
+    private: gazebo::common::Time startTimeWall;
+
+    /// \brief Sim time at which Atlas achieved the last checkpoint.
+    private: gazebo::common::Time stopTimeSim;
+
+    /// \brief Wall time at which Atlas achieved the last checkpoint.
+    private: gazebo::common::Time stopTimeWall;
+
+    /// \brief The completion score, called 'C' in the VRC docs
+    private: int completionScore;
+
+    /// \brief How much acceleration must be experienced at the robot's center
+    /// of mass to be considering damaging.
+    private: double fallAccelThreshold;
+
+    /// \brief How many big falls we've taken
+    private: int falls;
+
+    /// \brief Detects falls from the velocity of the head
+    private: AtlasFallDetector fallDetector;
+
+    // \brief Elapsed sim time after task completion when we stop counting
+    // falls.  It's non-zero to avoid having people dive across the finish
+    // line.
+    private: const common::Time postCompletionQuietTime;
+  };
+}
+#endif
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef _GAZEBO_VRC_STATE_LOG_READER_HH_
+#define _GAZEBO_VRC_STATE_LOG_READER_HH_
+
+#include <fstream>
+#include <string>
+
+namespace gazebo
+{
+  /// \brief Reads a gazebo state log (as written by gzserver -r) one
+  /// element at a time, without loading the whole file the way
+  /// util::LogPlay does.  Truncated logs, e.g. of a run that is still
+  /// going or that crashed, are read up to the last complete chunk.
+  class VRCStateLogReader
+  {
+    /// \brief Constructor
+    public: VRCStateLogReader();
+
+    /// \brief Destructor
+    public: virtual ~VRCStateLogReader();
+
+    /// \brief Open a log file, and read the world description from its
+    /// first chunk.
+    /// \param[in] _filename Path to the log.
+    /// \return false if the file can't be read or has no world.
+    public: bool Open(const std::string &_filename);
+
+    /// \brief The <sdf><world> description the log starts with.
+    public: const std::string &GetWorld() const;
+
+    /// \brief Get the next world state.
+    /// \param[out] _data The state, wrapped in an <sdf> element so it can
+    /// be read into an element initialized from state.sdf.
+    /// \return false at the end of the log.
+    public: bool Next(std::string &_data);
+
+    /// \brief Read the next chunk and decode it.
+    /// \param[out] _data The decoded chunk.
+    /// \return false at the end of the log.
+    private: bool NextChunk(std::string &_data);
+
+    /// \brief Read more of the file into the buffer.
+    /// \return false at the end of the file.
+    private: bool Fill();
+
+    /// \brief The log file
+    private: std::ifstream file;
+
+    /// \brief Data read from the file but not yet consumed
+    private: std::string buffer;
+
+    /// \brief The world description
+    private: std::string world;
+
+    /// \brief The current decoded chunk, states are taken from it in order
+    private: std::string chunk;
+
+    /// \brief Position of the next state in chunk
+    private: size_t chunkPos;
+
+    /// \brief The opening <sdf ...> tag of the current chunk
+    private: std::string sdfTag;
+  };
+}
+#endif
@@ -0,0 +1,196 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <string>
+#include <vector>
+
+#include <ros/console.h>
+
+#include "drcsim_gazebo_ros_plugins/AtlasCommandLog.hh"
+
+using namespace gazebo;
+
+namespace
+{
+  /// \brief Start of every recording
+  const char MAGIC[] = "ATLASCMD";
+  const size_t MAGIC_SIZE = sizeof(MAGIC) - 1;
+
+  /// \brief Version of the format
+  const uint32_t VERSION = 1;
+}
+
+/////////////////////////////////////////////////
+AtlasCommandLog::AtlasCommandLog()
+  : replaying(false), hasNext(false), nextType(ATLAS_COMMAND)
+{
+}
+
+/////////////////////////////////////////////////
+AtlasCommandLog::~AtlasCommandLog()
+{
+  this->Close();
+}
+
+/////////////////////////////////////////////////
+bool AtlasCommandLog::OpenRecord(const std::string &_path)
+{
+  this->Close();
+
+  this->out.open(_path.c_str(), std::ios::binary | std::ios::trunc);
+  if (!this->out.is_open())
+  {
+    ROS_ERROR("Unable to record commands to [%s]", _path.c_str());
+    return false;
+  }
+
+  this->out.write(MAGIC, MAGIC_SIZE);
+  this->out.write(reinterpret_cast<const char *>(&VERSION), sizeof(VERSION));
+  ROS_INFO("Recording commands to [%s]", _path.c_str());
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool AtlasCommandLog::OpenReplay(const std::string &_path)
+{
+  this->Close();
+
+  this->in.open(_path.c_str(), std::ios::binary);
+  if (!this->in.is_open())
+  {
+    ROS_ERROR("Unable to replay commands from [%s]", _path.c_str());
+    return false;
+  }
+
+  char magic[MAGIC_SIZE];
+  uint32_t version = 0;
+  this->in.read(magic, MAGIC_SIZE);
+  this->in.read(reinterpret_cast<char *>(&version), sizeof(version));
+  if (!this->in || memcmp(magic, MAGIC, MAGIC_SIZE) != 0 ||
+      version != VERSION)
+  {
+    ROS_ERROR("[%s] is not a command recording of version %u",
+              _path.c_str(), VERSION);
+    this->in.close();
+    return false;
+  }
+
+  this->replaying = true;
+  this->ReadEntry();
+  ROS_INFO("Replaying commands from [%s]", _path.c_str());
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool AtlasCommandLog::IsRecording() const
+{
+  return this->out.is_open();
+}
+
+/////////////////////////////////////////////////
+bool AtlasCommandLog::IsReplaying() const
+{
+  return this->replaying;
+}
+
+/////////////////////////////////////////////////
+void AtlasCommandLog::Flush(const ros::Time &_time)
+{
+  if (!this->IsRecording() || this->pending.empty())
+    return;
+
+  uint32_t sec = _time.sec;
+  uint32_t nsec = _time.nsec;
+  size_t offset = 0;
+  while (offset + ENTRY_HEADER_SIZE <= this->pending.size())
+  {
+    uint32_t size;
+    memcpy(&size, &this->pending[offset + 1], sizeof(size));
+
+    this->out.write(reinterpret_cast<const char *>(&sec), sizeof(sec));
+    this->out.write(reinterpret_cast<const char *>(&nsec), sizeof(nsec));
+    this->out.write(reinterpret_cast<const char *>(&this->pending[offset]),
+                    ENTRY_HEADER_SIZE + size);
+    offset += ENTRY_HEADER_SIZE + size;
+  }
+
+  // keeps its capacity, so that recording doesn't allocate once warm
+  this->pending.clear();
+
+  if (!this->out)
+  {
+    ROS_ERROR("Error writing the command recording, stopped recording");
+    this->out.close();
+  }
+}
+
+/////////////////////////////////////////////////
+bool AtlasCommandLog::Next(const ros::Time &_time, Type &_type,
+                           std::vector<uint8_t> &_data)
+{
+  if (!this->hasNext || this->nextTime > _time)
+    return false;
+
+  _type = this->nextType;
+  _data.swap(this->nextData);
+  this->ReadEntry();
+  return true;
+}
+
+/////////////////////////////////////////////////
+void AtlasCommandLog::Close()
+{
+  if (this->out.is_open())
+    this->out.close();
+  if (this->in.is_open())
+    this->in.close();
+  this->pending.clear();
+  this->hasNext = false;
+  this->replaying = false;
+}
+
+/////////////////////////////////////////////////
+void AtlasCommandLog::ReadEntry()
+{
+  this->hasNext = false;
+  if (!this->in.is_open())
+    return;
+
+  uint32_t sec, nsec, size;
+  uint8_t type;
+  this->in.read(reinterpret_cast<char *>(&sec), sizeof(sec));
+  this->in.read(reinterpret_cast<char *>(&nsec), sizeof(nsec));
+  this->in.read(reinterpret_cast<char *>(&type), sizeof(type));
+  this->in.read(reinterpret_cast<char *>(&size), sizeof(size));
+  if (this->in)
+  {
+    this->nextData.resize(size);
+    if (size > 0)
+      this->in.read(reinterpret_cast<char *>(&this->nextData[0]), size);
+  }
+
+  if (!this->in)
+  {
+    ROS_INFO("End of the command replay");
+    this->in.close();
+    return;
+  }
+
+  this->nextTime = ros::Time(sec, nsec);
+  this->nextType = static_cast<Type>(type);
+  this->hasNext = true;
+}
@@ -0,0 +1,374 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "drcsim_gazebo_ros_plugins/AtlasControlKernels.hh"
+
+using namespace gazebo;
+
+namespace
+{
+  /// \brief Same as math::clamp, without gazebo.
+  inline double Clamp(double _v, double _min, double _max)
+  {
+    return std::max(std::min(_v, _max), _min);
+  }
+}
+
+/////////////////////////////////////////////////
+AtlasPIDErrorTerms::AtlasPIDErrorTerms()
+  : q_p(0), d_q_p_dt(0), k_i_q_i(0), qd_p(0)
+{
+}
+
+/////////////////////////////////////////////////
+AtlasPIDInput::AtlasPIDInput()
+  : positionTarget(0), velocityTarget(0), effortTarget(0), position(0),
+    velocity(0), kpPosition(0), kiPosition(0), kdPosition(0), kpVelocity(0),
+    iEffortMin(0), iEffortMax(0), kEffort(0), bdiEffort(0), effortLimit(0),
+    dampingModel(0), dampingMax(0)
+{
+}
+
+/////////////////////////////////////////////////
+double gazebo::AtlasPIDUpdate(const AtlasPIDInput &_in, double _dt,
+                              AtlasPIDErrorTerms &_terms, double &_damping)
+{
+  double q_p = _in.positionTarget - _in.position;
+
+  // math::equal's tolerance
+  if (std::fabs(_dt) > 1e-6)
+    _terms.d_q_p_dt = (q_p - _terms.q_p) / _dt;
+
+  _terms.q_p = q_p;
+
+  // Take advantage of cfm damping by passing kp_velocity through
+  // to intrinsic joint damping coefficient.  Simulating
+  // infinite bandwidth kp_velocity.
+  //
+  // kp_velocity is truncated within (jointDampingModel, jointDampingMax).
+  //
+  // To take advantage of utilizing full range of cfm damping dynamically
+  // for controlling the robot, set model damping (jointDmapingModel)
+  // to jointDampingMin first.
+  _damping = Clamp(_in.kpVelocity, _in.dampingModel, _in.dampingMax);
+
+  // approximate effort generated by a non-zero joint velocity state
+  // this is the approximate force of the infinite bandwidth
+  // kp_velocity term, we'll use this to bound additional forces later.
+  // Force generated by cfm damping from damping coefficient smaller than
+  // jointDampingModel is generated for free.
+  double kpVelocityDampingEffort = 0;
+  double kpVelocityDampingCoef = _damping - _in.dampingModel;
+  if (kpVelocityDampingCoef > 0.0)
+    kpVelocityDampingEffort = kpVelocityDampingCoef * _in.velocity;
+
+  _terms.k_i_q_i = Clamp(
+    _terms.k_i_q_i + _dt * _in.kiPosition * _terms.q_p,
+    _in.iEffortMin, _in.iEffortMax);
+
+  // use gain params to compute force cmd
+  // AtlasSimInterface:  also, add bdi controller feed forward force
+  // to overall control torque scaled by 1 - k_effort.
+  double forceUnclamped =
+    _in.kEffort * (
+    _in.kpPosition * _terms.q_p +
+                     _terms.k_i_q_i +
+    _in.kdPosition * _terms.d_q_p_dt +
+          _damping * _in.velocityTarget +
+                     _in.effortTarget) +
+    (1.0 - _in.kEffort) * _in.bdiEffort;
+
+  // clamp force after integral tie-back
+  // shift by kpVelocityDampingEffort to prevent controller from
+  // exerting too much force from use of kp_velocity --> cfm damping
+  // pass through.
+  return Clamp(forceUnclamped,
+    -_in.effortLimit + kpVelocityDampingEffort,
+     _in.effortLimit + kpVelocityDampingEffort);
+}
+
+/////////////////////////////////////////////////
+void gazebo::AtlasFilterJoints(const double *_coefA, const double *_coefB,
+                               std::vector<std::vector<double> > &_in,
+                               std::vector<std::vector<double> > &_out,
+                               std::vector<float> &_aState,
+                               std::vector<double> &_jState)
+{
+  // Actually do filtering on each tick for each joint:
+  // filter velocities: assume a(0) is 1.0
+  // a(0)*y(0) = b(0)*x(0) + b(1)*x(1) + ... + b(n-1)*x(n-1)
+  //                       - a(1)*y(1) - ... - a(n-1)*y(n-1)
+  // filter each joint position/velocity
+  for (unsigned int i = 0; i < _in.size(); ++i)
+  {
+    // move data back one step in time.
+    for (int j = FIL_N_STEPS - 2; j >= 0; --j)
+    {
+      _in[i][j+1] = _in[i][j];
+      _out[i][j+1] = _out[i][j];
+    }
+    // load new input
+    _in[i][0] = _aState[i];
+    // do filtering
+    double tmp = 0;
+    for (unsigned int j = 0; j < FIL_N_STEPS; ++j)
+      tmp += _coefB[j]*_in[i][j];
+    for (unsigned int j = 1; j < FIL_N_STEPS; ++j)
+      tmp -= _coefA[j]*_out[i][j];
+    // stash filtered value;
+    _aState[i] = _jState[i] = _out[i][0] = tmp;
+  }
+}
+
+/////////////////////////////////////////////////
+AtlasCommandAgeStatistics::AtlasCommandAgeStatistics()
+  : index(0), mean(0), variance(0), age(0)
+{
+}
+
+/////////////////////////////////////////////////
+void AtlasCommandAgeStatistics::Init(unsigned int _size)
+{
+  // The variance is divided by size - 1
+  _size = std::max(_size, 2u);
+
+  // document this from
+  // http://en.wikipedia.org/wiki/Algorithms_for_calculating_variance
+  // Online algorithm
+  // where Delta2 buffer contains delta*(x - mean) line from code block
+  this->buffer.assign(_size, 0.0);
+  this->delta2Buffer.assign(_size, 0.0);
+  this->index = 0;
+  this->mean = 0.0;
+  this->variance = 0.0;
+  this->age = 0.0;
+}
+
+/////////////////////////////////////////////////
+void AtlasCommandAgeStatistics::Update(double _age)
+{
+  if (this->buffer.empty())
+    this->Init(2);
+
+  // Keep track of age of atlasCommand age in seconds.
+  // Note the value is invalid as a moving window average age
+  // until the buffer is full.
+  this->age = _age;
+
+  double weightedAge = this->age / this->buffer.size();
+
+  // for variance calculation, save delta before average is updated.
+  double delta = this->age - this->mean;
+
+  // update average
+  this->mean += weightedAge;
+  this->mean -= this->buffer[this->index];
+
+  // update variance with new average
+  double delta2 = delta * (this->age - this->mean);
+  this->variance += delta2;
+  this->variance -= this->delta2Buffer[this->index];
+
+  // save weighted average in window
+  this->buffer[this->index] = weightedAge;
+
+  // save delta buffer for incremental variance calculation
+  this->delta2Buffer[this->index] = delta2;
+
+  this->index = (this->index + 1) % this->buffer.size();
+}
+
+/////////////////////////////////////////////////
+double AtlasCommandAgeStatistics::GetAge() const
+{
+  return this->age;
+}
+
+/////////////////////////////////////////////////
+double AtlasCommandAgeStatistics::GetMean() const
+{
+  return this->mean;
+}
+
+/////////////////////////////////////////////////
+double AtlasCommandAgeStatistics::GetVariance() const
+{
+  if (this->buffer.size() < 2)
+    return 0.0;
+  return this->variance / (this->buffer.size() - 1);
+}
+
+/////////////////////////////////////////////////
+AtlasLatencyHistogram::AtlasLatencyHistogram()
+{
+  this->Reset();
+}
+
+/////////////////////////////////////////////////
+void AtlasLatencyHistogram::Record(double _latency)
+{
+  const uint64_t highest = (static_cast<uint64_t>(1) << MAX_VALUE_BITS) - 1;
+
+  uint64_t value = 0;
+  if (_latency > 0.0)
+  {
+    double us = std::floor(_latency * 1e6 + 0.5);
+    value = us < static_cast<double>(highest) ?
+      static_cast<uint64_t>(us) : highest;
+  }
+
+  ++this->counts[BucketIndex(value)];
+  ++this->count;
+  this->max = std::max(this->max, value);
+}
+
+/////////////////////////////////////////////////
+void AtlasLatencyHistogram::Reset()
+{
+  std::fill(this->counts, this->counts + BUCKET_COUNT, 0u);
+  this->count = 0;
+  this->max = 0;
+}
+
+/////////////////////////////////////////////////
+uint64_t AtlasLatencyHistogram::GetCount() const
+{
+  return this->count;
+}
+
+/////////////////////////////////////////////////
+double AtlasLatencyHistogram::GetMax() const
+{
+  return this->max * 1e-6;
+}
+
+/////////////////////////////////////////////////
+double AtlasLatencyHistogram::GetPercentile(double _percentile) const
+{
+  if (this->count == 0)
+    return 0.0;
+
+  // rank of the sample we are after, counting from 1
+  double rank = std::ceil(Clamp(_percentile, 0.0, 100.0) / 100.0 *
+    static_cast<double>(this->count));
+  uint64_t target = std::max(static_cast<uint64_t>(rank),
+    static_cast<uint64_t>(1));
+
+  uint64_t seen = 0;
+  for (unsigned int i = 0; i < BUCKET_COUNT; ++i)
+  {
+    seen += this->counts[i];
+    if (seen >= target)
+      return std::min(BucketUpperBound(i), this->max) * 1e-6;
+  }
+  return this->GetMax();
+}
+
+/////////////////////////////////////////////////
+double AtlasLatencyHistogram::GetHighestTrackable()
+{
+  return ((static_cast<uint64_t>(1) << MAX_VALUE_BITS) - 1) * 1e-6;
+}
+
+/////////////////////////////////////////////////
+unsigned int AtlasLatencyHistogram::BucketIndex(uint64_t _value)
+{
+  // small values have a bucket each
+  if (_value < (static_cast<uint64_t>(1) << SUB_BUCKET_BITS))
+    return static_cast<unsigned int>(_value);
+
+  // position of the most significant bit
+  unsigned int msb = 0;
+  for (uint64_t v = _value >> 1; v != 0; v >>= 1)
+    ++msb;
+
+  // keep the SUB_BUCKET_BITS most significant bits, the top one of which
+  // is always set, so each power of two gets half as many buckets.
+  unsigned int shift = msb - SUB_BUCKET_BITS + 1;
+  unsigned int sub = static_cast<unsigned int>(_value >> shift);
+  return (shift << (SUB_BUCKET_BITS - 1)) + sub;
+}
+
+/////////////////////////////////////////////////
+uint64_t AtlasLatencyHistogram::BucketUpperBound(unsigned int _index)
+{
+  if (_index < (1u << SUB_BUCKET_BITS))
+    return _index;
+
+  unsigned int shift = (_index >> (SUB_BUCKET_BITS - 1)) - 1;
+  uint64_t sub = _index - (shift << (SUB_BUCKET_BITS - 1));
+  return ((sub + 1) << shift) - 1;
+}
+
+/////////////////////////////////////////////////
+const double AtlasFallDetector::HOLD_OFF = 15.0;
+
+/////////////////////////////////////////////////
+AtlasFallDetector::AtlasFallDetector()
+  : threshold(1000.0)
+{
+  this->Reset();
+}
+
+/////////////////////////////////////////////////
+void AtlasFallDetector::Reset()
+{
+  this->fallTime = 0.0;
+  this->prevTime = 0.0;
+  this->prevVelocity = 0.0;
+  this->acceleration = 0.0;
+}
+
+/////////////////////////////////////////////////
+void AtlasFallDetector::SetThreshold(double _threshold)
+{
+  this->threshold = _threshold;
+}
+
+/////////////////////////////////////////////////
+bool AtlasFallDetector::Update(double _time, double _velocity)
+{
+  // Don't declare a fall if we had one recently
+  if (_time - this->fallTime < HOLD_OFF)
+  {
+    this->prevTime = _time;
+    this->prevVelocity = _velocity;
+    return false;
+  }
+
+  // Differentiate to get acceleration
+  double dt = _time - this->prevTime;
+  this->acceleration = (_velocity - this->prevVelocity) / dt;
+  this->prevTime = _time;
+  this->prevVelocity = _velocity;
+  if (std::fabs(this->acceleration) > this->threshold)
+  {
+    this->fallTime = _time;
+    return true;
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////
+double AtlasFallDetector::GetAcceleration() const
+{
+  return this->acceleration;
+}
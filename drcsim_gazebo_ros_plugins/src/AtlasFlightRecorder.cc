@@ -0,0 +1,235 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <ros/console.h>
+
+#include "drcsim_gazebo_ros_plugins/AtlasFlightRecorder.hh"
+
+using namespace gazebo;
+
+namespace
+{
+  /// \brief Start of every dump
+  const char MAGIC[] = "ATLASFDR";
+  const size_t MAGIC_SIZE = sizeof(MAGIC) - 1;
+
+  /// \brief Version of the format
+  const uint32_t VERSION = 1;
+
+  /// \brief Write a uint32 to a dump.
+  void WriteUint32(std::ofstream &_out, uint32_t _value)
+  {
+    _out.write(reinterpret_cast<const char *>(&_value), sizeof(_value));
+  }
+
+  /// \brief Write a string, preceded by its size, to a dump.
+  void WriteString(std::ofstream &_out, const std::string &_value)
+  {
+    WriteUint32(_out, _value.size());
+    _out.write(_value.data(), _value.size());
+  }
+}
+
+/////////////////////////////////////////////////
+AtlasFlightRecorder::AtlasFlightRecorder()
+  : frameSize(0), frames(0), head(0), count(0), postTriggerFrames(0),
+    triggered(false), countdown(0), dumpReady(false), dumpCount(0),
+    dumpHead(0), stop(false), writerThread(NULL)
+{
+}
+
+/////////////////////////////////////////////////
+AtlasFlightRecorder::~AtlasFlightRecorder()
+{
+  if (this->writerThread)
+  {
+    {
+      boost::mutex::scoped_lock lock(this->mutex);
+      this->stop = true;
+      this->condition.notify_one();
+    }
+    this->writerThread->join();
+    delete this->writerThread;
+  }
+}
+
+/////////////////////////////////////////////////
+void AtlasFlightRecorder::Init(size_t _frameSize, size_t _frames,
+  size_t _postTriggerFrames, const std::string &_directory,
+  const std::string &_layout)
+{
+  if (this->writerThread || _frameSize == 0 || _frames == 0)
+    return;
+
+  this->frameSize = _frameSize;
+  this->frames = _frames;
+  this->postTriggerFrames = std::min(_postTriggerFrames, _frames - 1);
+  this->directory = _directory;
+  this->layout = _layout;
+
+  // allocated and touched now, so that recording never page faults
+  this->ring.assign(this->frameSize * this->frames, 0);
+  this->spare.assign(this->frameSize * this->frames, 0);
+
+  this->writerThread = new boost::thread(
+    boost::bind(&AtlasFlightRecorder::WriterThread, this));
+}
+
+/////////////////////////////////////////////////
+bool AtlasFlightRecorder::IsEnabled() const
+{
+  return !this->ring.empty();
+}
+
+/////////////////////////////////////////////////
+uint8_t *AtlasFlightRecorder::NextFrame()
+{
+  return &this->ring[this->head * this->frameSize];
+}
+
+/////////////////////////////////////////////////
+void AtlasFlightRecorder::Commit(double _time)
+{
+  this->head = (this->head + 1) % this->frames;
+  if (this->count < this->frames)
+    ++this->count;
+
+  boost::mutex::scoped_lock lock(this->mutex);
+  if (!this->triggered || this->dumpReady)
+    return;
+  if (this->countdown > 0)
+    --this->countdown;
+  if (this->countdown > 0)
+    return;
+
+  // hand the frames over to the writer, and start a new ring
+  this->ring.swap(this->spare);
+  this->dumpCount = this->count;
+  this->dumpHead = this->head;
+  this->count = 0;
+  this->head = 0;
+  if (this->dumpPath.empty())
+  {
+    std::ostringstream path;
+    path << this->directory << "/atlas_flight_" << std::fixed
+         << std::setprecision(3) << _time << ".fdr";
+    this->dumpPath = path.str();
+  }
+  this->dumpReady = true;
+  this->condition.notify_one();
+}
+
+/////////////////////////////////////////////////
+bool AtlasFlightRecorder::Trigger(const std::string &_reason,
+  const std::string &_path, std::string &_status)
+{
+  if (!this->IsEnabled())
+  {
+    _status = "flight recorder disabled";
+    return false;
+  }
+
+  boost::mutex::scoped_lock lock(this->mutex);
+  if (this->triggered)
+  {
+    _status = "a dump is already in progress, for: " + this->dumpReason;
+    return false;
+  }
+
+  this->triggered = true;
+  this->countdown = this->postTriggerFrames;
+  this->dumpReason = _reason;
+  this->dumpPath = _path;
+  _status = "dump started";
+  return true;
+}
+
+/////////////////////////////////////////////////
+size_t AtlasFlightRecorder::GetFrameSize() const
+{
+  return this->frameSize;
+}
+
+/////////////////////////////////////////////////
+void AtlasFlightRecorder::WriterThread()
+{
+  boost::mutex::scoped_lock lock(this->mutex);
+  while (true)
+  {
+    while (!this->dumpReady && !this->stop)
+      this->condition.wait(lock);
+    if (!this->dumpReady)
+      return;
+
+    std::string path = this->dumpPath;
+    std::string reason = this->dumpReason;
+    size_t dumpCount = this->dumpCount;
+    size_t dumpHead = this->dumpHead;
+
+    // the spare ring isn't touched by Commit until dumpReady is cleared
+    lock.unlock();
+    this->Write(path, reason, dumpCount, dumpHead);
+    lock.lock();
+
+    this->dumpReady = false;
+    this->triggered = false;
+  }
+}
+
+/////////////////////////////////////////////////
+void AtlasFlightRecorder::Write(const std::string &_path,
+  const std::string &_reason, size_t _count, size_t _head)
+{
+  std::ofstream out(_path.c_str(), std::ios::binary | std::ios::trunc);
+  if (!out.is_open())
+  {
+    ROS_ERROR("Unable to write flight recorder dump [%s]", _path.c_str());
+    return;
+  }
+
+  out.write(MAGIC, MAGIC_SIZE);
+  WriteUint32(out, VERSION);
+  WriteUint32(out, this->frameSize);
+  WriteUint32(out, _count);
+  WriteString(out, this->layout);
+  WriteString(out, _reason);
+
+  // oldest first, the ring wraps around once it is full
+  size_t oldest = (_head + this->frames - _count) % this->frames;
+  size_t first = std::min(_count, this->frames - oldest);
+  out.write(reinterpret_cast<const char *>(
+    &this->spare[oldest * this->frameSize]), first * this->frameSize);
+  if (_count > first)
+  {
+    out.write(reinterpret_cast<const char *>(&this->spare[0]),
+              (_count - first) * this->frameSize);
+  }
+
+  if (!out)
+    ROS_ERROR("Error writing flight recorder dump [%s]", _path.c_str());
+  else
+    ROS_INFO("Wrote flight recorder dump [%s], %s", _path.c_str(),
+             _reason.c_str());
+}
@@ -23,7 +23,10 @@
 // publish separate /atlas/force_torque_sensors topic, to be deprecated
 #include <atlas_msgs/ForceTorqueSensors.h>
 
+#include <ros/file_log.h>
+
 #include <algorithm>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -48,6 +51,8 @@ AtlasPlugin::AtlasPlugin()
   // the <pose> tag in the imu_senosr block.
   this->imuLinkName = "imu_link";
 
+  this->controllableReported = false;
+
   // initialize behavior library
   this->atlasSimInterface = create_atlas_sim_interface();
 
@@ -70,6 +75,14 @@ AtlasPlugin::AtlasPlugin()
   this->delayWindowStart = common::Time(0.0);
   this->delayInWindow = common::Time(0.0);
 
+  // latency histogram windows, sized in Load
+  this->latencyWindowTicks = 1000;
+  this->windowStaleTicks = 0;
+  this->staleTicks = 0;
+
+  // flight recorder, allocated in LoadROS
+  this->flightErrorCode = NO_ERRORS;
+
   // option to filter velocity or position
   this->filterVelocity = false;
 
@@ -88,7 +101,7 @@ AtlasPlugin::AtlasPlugin()
 ////////////////////////////////////////////////////////////////////////////////
 AtlasPlugin::~AtlasPlugin()
 {
-  event::Events::DisconnectWorldUpdateBegin(this->updateConnection);
+  this->updateConnection.reset();
   delete this->pmq;
   this->rosNode->shutdown();
   this->rosQueue.clear();
@@ -139,6 +152,7 @@ void AtlasPlugin::Load(physics::ModelPtr _parent, sdf::ElementPtr _sdf)
 
   // Get the world name.
   this->world = this->model->GetWorld();
+  this->readiness = ModelReadiness::Get(this->world);
 
   // JointController: built-in gazebo to control joints
   this->jointController = this->model->GetJointController();
@@ -277,7 +291,7 @@ void AtlasPlugin::Load(physics::ModelPtr _parent, sdf::ElementPtr _sdf)
 
       this->jointDampingModel.push_back(this->joints[i]->GetDamping(0));
 
-      this->lastJointCFMDamping.push_back(this->joints[i]->GetDamping(0));
+      this->jointParams.push_back(JointParamWriter(this->joints[i]));
 
       ROS_INFO("Bounds for joint[%s] is [%f, %f], model default is [%f]",
                this->jointNames[i].c_str(),
@@ -694,16 +708,10 @@ void AtlasPlugin::LoadROS()
     ROS_WARN("simulation step size is zero, something is wrong,"
               "  Defaulting to step size of %f sec.", stepSize);
   }
-  // document this from
-  // http://en.wikipedia.org/wiki/Algorithms_for_calculating_variance
-  // Online algorithm
-  // where Delta2 buffer contains delta*(x - mean) line from code block
-  unsigned int bufferSize = this->atlasCommandAgeBufferDuration / stepSize;
-  this->atlasCommandAgeBuffer.resize(bufferSize);
-  this->atlasCommandAgeDelta2Buffer.resize(bufferSize);
-  this->atlasCommandAgeBufferIndex = 0;
-  this->atlasCommandAgeMean = 0.0;
-  this->atlasCommandAgeVariance = 0.0;
+  this->atlasCommandAgeStatistics.Init(
+    this->atlasCommandAgeBufferDuration / stepSize);
+  this->latencyWindowTicks = std::max(1u, static_cast<unsigned int>(
+    this->atlasCommandAgeBufferDuration / stepSize));
 
   // Read delay settings in param server and apply limits if
   // atlas_msgs::AtlasCommand::desired_controller_period_ms is not zero.
@@ -838,6 +846,25 @@ void AtlasPlugin::LoadROS()
     this->subTest = this->rosNode->subscribe(testSo);
   }
 
+  // Record the commands received to a file, or replay a recording instead
+  // of subscribing to commands, see AtlasCommandLog.
+  std::string commandLogPath;
+  if (this->rosNode->getParam("atlas/command_replay", commandLogPath) &&
+      !commandLogPath.empty())
+  {
+    if (this->commandLog.OpenReplay(commandLogPath))
+      ROS_WARN("AtlasPlugin is replaying commands, and ignores "
+               "atlas_command, joint_commands and "
+               "atlas_sim_interface_command.");
+  }
+  if (this->rosNode->getParam("atlas/command_record", commandLogPath) &&
+      !commandLogPath.empty())
+  {
+    this->commandLog.OpenRecord(commandLogPath);
+  }
+
+  this->InitFlightRecorder();
+
   // ros topic subscribtions
   ros::SubscribeOptions atlasCommandSo =
     ros::SubscribeOptions::create<atlas_msgs::AtlasCommand>(
@@ -847,8 +874,9 @@ void AtlasPlugin::LoadROS()
   // Enable TCP_NODELAY since TCP causes bursty communication with high jitter,
   atlasCommandSo.transport_hints =
     ros::TransportHints().reliable().tcpNoDelay(true);
-  this->subAtlasCommand =
-    this->rosNode->subscribe(atlasCommandSo);
+  if (!this->commandLog.IsReplaying())
+    this->subAtlasCommand =
+      this->rosNode->subscribe(atlasCommandSo);
 
   // ros topic subscribtions
   ros::SubscribeOptions jointCommandsSo =
@@ -861,8 +889,9 @@ void AtlasPlugin::LoadROS()
   // demarshalling following packet loss.
   jointCommandsSo.transport_hints =
     ros::TransportHints().reliable().tcpNoDelay(true);
-  this->subJointCommands =
-    this->rosNode->subscribe(jointCommandsSo);
+  if (!this->commandLog.IsReplaying())
+    this->subJointCommands =
+      this->rosNode->subscribe(jointCommandsSo);
 
   // AtlasSimInterface:
   // subscribe to a control_mode string message, current valid commands are:
@@ -884,7 +913,8 @@ void AtlasPlugin::LoadROS()
     ros::VoidPtr(), &this->rosQueue);
   asiCommandSo.transport_hints =
     ros::TransportHints().reliable().tcpNoDelay(true);
-  this->subASICommand = this->rosNode->subscribe(asiCommandSo);
+  if (!this->commandLog.IsReplaying())
+    this->subASICommand = this->rosNode->subscribe(asiCommandSo);
 
   ////////////////////////////////////////////////////////////////
   //                                                            //
@@ -928,6 +958,23 @@ void AtlasPlugin::LoadROS()
   this->getJointDampingService = this->rosNode->advertiseService(
     getJointDampingAso);
 
+  // Capture and restore controller internals, used by scenario snapshots
+  ros::AdvertiseServiceOptions getControllerStateAso =
+    ros::AdvertiseServiceOptions::create<atlas_msgs::GetAtlasControllerState>(
+      "atlas/get_controller_state", boost::bind(
+        &AtlasPlugin::GetControllerState, this, _1, _2),
+        ros::VoidPtr(), &this->rosQueue);
+  this->getControllerStateService = this->rosNode->advertiseService(
+    getControllerStateAso);
+
+  ros::AdvertiseServiceOptions setControllerStateAso =
+    ros::AdvertiseServiceOptions::create<atlas_msgs::SetAtlasControllerState>(
+      "atlas/set_controller_state", boost::bind(
+        &AtlasPlugin::SetControllerState, this, _1, _2),
+        ros::VoidPtr(), &this->rosQueue);
+  this->setControllerStateService = this->rosNode->advertiseService(
+    setControllerStateAso);
+
   ////////////////////////////////////////////////////////////////
   //                                                            //
   //  ROS Custom callback queue                                 //
@@ -941,8 +988,9 @@ void AtlasPlugin::LoadROS()
   //  Hook up to gazebo periodic updates                        //
   //                                                            //
   ////////////////////////////////////////////////////////////////
-  this->updateConnection = event::Events::ConnectWorldUpdateBegin(
-     boost::bind(&AtlasPlugin::UpdateStates, this));
+  this->updateConnection = DRCUpdateScheduler::Connect("AtlasPlugin",
+     boost::bind(&AtlasPlugin::UpdateStates, this),
+     DRCUpdateAccess().WriteJoints(this->joints));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -952,15 +1000,34 @@ void AtlasPlugin::UpdateStates()
 
   if (curTime > this->lastControllerUpdateTime)
   {
+    // commands are applied from this update on
+    if (!this->controllableReported)
+    {
+      this->readiness->Report("atlas controllable");
+      this->controllableReported = true;
+    }
+
     // gather robot state data and publish them
     this->GetAndPublishRobotStates(curTime);
 
-    // enforce delay for controller synchronization
-    if (this->atlasCommand.desired_controller_period_ms != 0)
+    // VRCPlugin makes the robot kinematic while fast traveling, nothing
+    // is controlled until it is dynamic again
+    physics::LinkPtr canonicalLink = this->model->GetLink();
+    bool frozen = canonicalLink && canonicalLink->GetKinematic();
+
+    // enforce delay for controller synchronization, unless replaying,
+    // when there is no controller to wait for
+    this->delayStatistics.delay_in_step = 0.0;
+    if (this->atlasCommand.desired_controller_period_ms != 0 &&
+        !this->commandLog.IsReplaying() && !frozen)
       this->EnforceSynchronizationDelay(curTime);
 
     // AtlasSimInterface: process controller updates
-    if (this->startupStep == AtlasPlugin::NOMINAL)
+    if (frozen)
+    {
+      // behaviors resume where they were when the robot is dynamic again
+    }
+    else if (this->startupStep == AtlasPlugin::NOMINAL)
     {
       this->UpdateAtlasSimInterface(curTime);
     }
@@ -996,15 +1063,25 @@ void AtlasPlugin::UpdateStates()
       ROS_ERROR("AtlasSimInterface: startup in broken state");
     }
 
+    if (this->commandLog.IsReplaying())
+      this->ReplayCommands(curTime);
+
     {
       boost::mutex::scoped_lock lock(this->mutex);
 
+      // commands received so far are used from this step on
+      this->commandLog.Flush(ros::Time(curTime.sec, curTime.nsec));
+
       this->CalculateControllerStatistics(curTime);
 
-      this->UpdatePIDControl(
-        (curTime - this->lastControllerUpdateTime).Double());
+      if (!frozen)
+        this->UpdatePIDControl(
+          (curTime - this->lastControllerUpdateTime).Double());
     }
 
+    if (this->flightRecorder.IsEnabled())
+      this->UpdateFlightRecorder(curTime);
+
     this->lastControllerUpdateTime = curTime;
 
     this->PublishConstrollerStatistics(curTime);
@@ -1025,6 +1102,8 @@ void AtlasPlugin::SetAtlasCommand(
 {
   boost::mutex::scoped_lock lock(this->mutex);
 
+  this->commandLog.Push(AtlasCommandLog::ATLAS_COMMAND, *_msg);
+
   this->atlasCommand.header.stamp = _msg->header.stamp;
 
   // for atlasCommand, only position, velocity and efforts are used.
@@ -1144,7 +1223,7 @@ void AtlasPlugin::SetAtlasCommand(
     if (kqdpSize)
     {
       this->atlasControlInput.jparams[i].k_qd_p = _msg->kp_velocity[i];
-      this->joints[i]->SetDamping(0, _msg->kp_velocity[i]);
+      this->jointParams[i].SetDamping(0, _msg->kp_velocity[i]);
     }
   }
   /* debug
@@ -1170,6 +1249,8 @@ void AtlasPlugin::SetJointCommands(
 {
   boost::mutex::scoped_lock lock(this->mutex);
 
+  this->commandLog.Push(AtlasCommandLog::JOINT_COMMANDS, *_msg);
+
   this->atlasCommand.header.stamp = _msg->header.stamp;
 
   /// \TODO: at some point, we can try stuffing
@@ -1266,10 +1347,9 @@ bool AtlasPlugin::SetJointDamping(atlas_msgs::SetJointDamping::Request &_req,
 
       // save model damping coefficient
       this->jointDampingModel[i] = d;
-      this->lastJointCFMDamping[i] = d;
 
       // set damping coefficient in model
-      this->joints[i]->SetDamping(0, d);
+      this->jointParams[i].SetDamping(0, d);
 
       if (!math::equal(d, _req.damping_coefficients[i]))
       {
@@ -1314,6 +1394,137 @@ bool AtlasPlugin::GetJointDamping(atlas_msgs::GetJointDamping::Request &_req,
   return _res.success;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool AtlasPlugin::GetControllerState(
+  atlas_msgs::GetAtlasControllerState::Request &/*_req*/,
+  atlas_msgs::GetAtlasControllerState::Response &_res)
+{
+  atlas_msgs::AtlasControllerState &state = _res.state;
+  state.header.stamp = ros::Time(this->world->GetSimTime().sec,
+                                 this->world->GetSimTime().nsec);
+
+  {
+    boost::mutex::scoped_lock lock(this->mutex);
+
+    // servo targets live in atlasCommand, gains in atlasState
+    state.atlas_command = this->atlasCommand;
+    state.atlas_command.kp_position = this->atlasState.kp_position;
+    state.atlas_command.ki_position = this->atlasState.ki_position;
+    state.atlas_command.kd_position = this->atlasState.kd_position;
+    state.atlas_command.kp_velocity = this->atlasState.kp_velocity;
+    state.atlas_command.i_effort_min = this->atlasState.i_effort_min;
+    state.atlas_command.i_effort_max = this->atlasState.i_effort_max;
+    state.atlas_command.k_effort = this->atlasState.k_effort;
+
+    for (unsigned int i = 0; i < this->errorTerms.size(); ++i)
+    {
+      state.q_p.push_back(this->errorTerms[i].q_p);
+      state.d_q_p_dt.push_back(this->errorTerms[i].d_q_p_dt);
+      state.k_i_q_i.push_back(this->errorTerms[i].k_i_q_i);
+      state.qd_p.push_back(this->errorTerms[i].qd_p);
+    }
+  }
+
+  {
+    boost::mutex::scoped_lock lock(this->filterMutex);
+
+    state.filter_velocity = this->filterVelocity;
+    state.filter_position = this->filterPosition;
+    state.filter_steps = FIL_N_STEPS;
+    state.filter_coef_a.assign(this->filCoefA, this->filCoefA + FIL_N_STEPS);
+    state.filter_coef_b.assign(this->filCoefB, this->filCoefB + FIL_N_STEPS);
+    for (unsigned int i = 0; i < this->unfilteredIn.size(); ++i)
+    {
+      state.filter_input.insert(state.filter_input.end(),
+        this->unfilteredIn[i].begin(), this->unfilteredIn[i].end());
+      state.filter_output.insert(state.filter_output.end(),
+        this->unfilteredOut[i].begin(), this->unfilteredOut[i].end());
+    }
+  }
+
+  {
+    boost::mutex::scoped_lock lock(this->asiMutex);
+
+    state.asi_command = this->asiCommand;
+    // restore into the behavior actually running, which lags the
+    // desired behavior by a few steps during transitions.
+    if (this->asiState.current_behavior >= 0)
+      state.asi_command.behavior = this->asiState.current_behavior;
+    else
+      state.asi_command.behavior = this->asiState.desired_behavior;
+    state.asi_command.k_effort = state.atlas_command.k_effort;
+  }
+
+  _res.success = true;
+  _res.status_message = "success";
+  return _res.success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool AtlasPlugin::SetControllerState(
+  atlas_msgs::SetAtlasControllerState::Request &_req,
+  atlas_msgs::SetAtlasControllerState::Response &_res)
+{
+  const atlas_msgs::AtlasControllerState &state = _req.state;
+  unsigned int n = this->joints.size();
+
+  if (state.q_p.size() != n || state.d_q_p_dt.size() != n ||
+      state.k_i_q_i.size() != n || state.qd_p.size() != n ||
+      state.filter_steps != FIL_N_STEPS ||
+      state.filter_input.size() != n * FIL_N_STEPS ||
+      state.filter_output.size() != n * FIL_N_STEPS ||
+      state.filter_coef_a.size() != FIL_N_STEPS ||
+      state.filter_coef_b.size() != FIL_N_STEPS)
+  {
+    _res.success = false;
+    _res.status_message = "controller state does not match this robot";
+    ROS_ERROR("SetControllerState: %s", _res.status_message.c_str());
+    return _res.success;
+  }
+
+  // servo targets and gains
+  this->SetAtlasCommand(atlas_msgs::AtlasCommand::ConstPtr(
+    new atlas_msgs::AtlasCommand(state.atlas_command)));
+
+  {
+    boost::mutex::scoped_lock lock(this->mutex);
+    for (unsigned int i = 0; i < n; ++i)
+    {
+      this->errorTerms[i].q_p = state.q_p[i];
+      this->errorTerms[i].d_q_p_dt = state.d_q_p_dt[i];
+      this->errorTerms[i].k_i_q_i = state.k_i_q_i[i];
+      this->errorTerms[i].qd_p = state.qd_p[i];
+    }
+  }
+
+  {
+    boost::mutex::scoped_lock lock(this->filterMutex);
+    this->filterVelocity = state.filter_velocity;
+    this->filterPosition = state.filter_position;
+    for (unsigned int j = 0; j < FIL_N_STEPS; ++j)
+    {
+      this->filCoefA[j] = state.filter_coef_a[j];
+      this->filCoefB[j] = state.filter_coef_b[j];
+    }
+    for (unsigned int i = 0; i < n; ++i)
+    {
+      for (unsigned int j = 0; j < FIL_N_STEPS; ++j)
+      {
+        this->unfilteredIn[i][j] = state.filter_input[i * FIL_N_STEPS + j];
+        this->unfilteredOut[i][j] = state.filter_output[i * FIL_N_STEPS + j];
+      }
+    }
+  }
+
+  // behavior and behavior parameters
+  this->SetASICommand(atlas_msgs::AtlasSimInterfaceCommand::ConstPtr(
+    new atlas_msgs::AtlasSimInterfaceCommand(state.asi_command)));
+
+  _res.success = true;
+  _res.status_message = "success";
+  return _res.success;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 bool AtlasPlugin::AtlasFilters(atlas_msgs::AtlasFilters::Request &_req,
   atlas_msgs::AtlasFilters::Response &_res)
@@ -1423,6 +1634,9 @@ void AtlasPlugin::SetASICommand(
   // k_effort
   {
     boost::mutex::scoped_lock lock(this->mutex);
+
+    this->commandLog.Push(AtlasCommandLog::ASI_COMMAND, *_msg);
+
     if (_msg->k_effort.size() == this->atlasState.k_effort.size())
     {
       std::copy(_msg->k_effort.begin(), _msg->k_effort.end(),
@@ -1439,6 +1653,7 @@ void AtlasPlugin::SetASICommand(
   {
     boost::mutex::scoped_lock lock(this->asiMutex);
 
+    this->asiCommand = *_msg;
     this->asiState.desired_behavior = _msg->behavior;
 
     // stand
@@ -1537,11 +1752,16 @@ void AtlasPlugin::SetASICommand(
       if (kqiSize)
         this->atlasControlInput.jparams[i].k_q_i = _msg->ki_position[i];
       if (kqdpSize)
-      {
         this->atlasControlInput.jparams[i].k_qd_p = _msg->kp_velocity[i];
-        // set joint damping from kp_velocity issue
-        this->joints[i]->SetDamping(0, _msg->kp_velocity[i]);
-      }
+    }
+
+    // set joint damping from kp_velocity issue, jointParams is shared with
+    // the update thread
+    if (kqdpSize)
+    {
+      boost::mutex::scoped_lock lock(this->mutex);
+      for (unsigned int i = 0; i < this->joints.size(); ++i)
+        this->jointParams[i].SetDamping(0, _msg->kp_velocity[i]);
     }
 
     // Try and set desired behavior (reverse map of behaviorMap)
@@ -1781,7 +2001,7 @@ void AtlasPlugin::SetExperimentalDampingPID(
   if (_msg->damping.size() == this->joints.size())
   {
     for (unsigned int i = 0; i < this->joints.size(); ++i)
-      this->joints[i]->SetDamping(0, _msg->damping[i]);
+      this->jointParams[i].SetDamping(0, _msg->damping[i]);
   }
   else
   {
@@ -2427,6 +2647,210 @@ void AtlasPlugin::EnforceSynchronizationDelay(const common::Time &_curTime)
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void AtlasPlugin::ReplayCommands(const common::Time &_curTime)
+{
+  ros::Time curTime(_curTime.sec, _curTime.nsec);
+  AtlasCommandLog::Type type;
+  while (this->commandLog.Next(curTime, type, this->replayData))
+  {
+    bool valid = false;
+    switch (type)
+    {
+      case AtlasCommandLog::ATLAS_COMMAND:
+      {
+        atlas_msgs::AtlasCommand::Ptr msg(new atlas_msgs::AtlasCommand);
+        valid = AtlasCommandLog::Deserialize(this->replayData, *msg);
+        if (valid)
+          this->SetAtlasCommand(msg);
+        break;
+      }
+      case AtlasCommandLog::JOINT_COMMANDS:
+      {
+        osrf_msgs::JointCommands::Ptr msg(new osrf_msgs::JointCommands);
+        valid = AtlasCommandLog::Deserialize(this->replayData, *msg);
+        if (valid)
+          this->SetJointCommands(msg);
+        break;
+      }
+      case AtlasCommandLog::ASI_COMMAND:
+      {
+        atlas_msgs::AtlasSimInterfaceCommand::Ptr msg(
+          new atlas_msgs::AtlasSimInterfaceCommand);
+        valid = AtlasCommandLog::Deserialize(this->replayData, *msg);
+        if (valid)
+          this->SetASICommand(msg);
+        break;
+      }
+      default:
+        break;
+    }
+
+    if (!valid)
+      ROS_WARN("AtlasPlugin skipped an invalid replayed command of type %d",
+               static_cast<int>(type));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void AtlasPlugin::InitFlightRecorder()
+{
+  double duration, postTriggerDuration, fallAccelThreshold;
+  std::string directory;
+  this->rosNode->param("atlas/flight_recorder/duration", duration, 30.0);
+  this->rosNode->param("atlas/flight_recorder/post_trigger_duration",
+    postTriggerDuration, 1.0);
+  this->rosNode->param("atlas/flight_recorder/directory", directory,
+    ros::file_log::getLogDirectory());
+  this->rosNode->param("atlas/flight_recorder/fall_accel_threshold",
+    fallAccelThreshold, 1000.0);
+  if (duration <= 0.0)
+  {
+    ROS_INFO("AtlasPlugin flight recorder disabled");
+    return;
+  }
+
+  double stepSize = this->world->GetPhysicsEngine()->GetMaxStepSize();
+  if (math::equal(stepSize, 0.0))
+    stepSize = 0.001;
+
+  // A frame is packed by UpdateFlightRecorder in this order
+  unsigned int n = this->joints.size();
+  std::ostringstream layout;
+  layout << "time:float64 current_behavior:int32 desired_behavior:int32"
+         << " error_code:int32 orientation:float32[4]"
+         << " angular_velocity:float32[3] linear_acceleration:float32[3]"
+         << " l_foot:float32[6] r_foot:float32[6]"
+         << " position:float32[" << n << "] velocity:float32[" << n << "]"
+         << " effort:float32[" << n << "]"
+         << " command_position:float32[" << n << "]"
+         << " command_velocity:float32[" << n << "]"
+         << " command_effort:float32[" << n << "]"
+         << " k_effort:uint8[" << n << "]" << std::endl << "joints:";
+  for (unsigned int i = 0; i < this->jointNames.size(); ++i)
+    layout << " " << this->jointNames[i];
+  size_t frameSize = sizeof(double) + 3 * sizeof(int32_t) +
+    22 * sizeof(float) + n * (6 * sizeof(float) + sizeof(uint8_t));
+
+  this->flightRecorder.Init(frameSize,
+    static_cast<size_t>(duration / stepSize),
+    static_cast<size_t>(postTriggerDuration / stepSize), directory,
+    layout.str());
+
+  this->fallDetector.SetThreshold(fallAccelThreshold);
+  this->headLink = this->model->GetLink("head");
+  if (!this->headLink)
+    ROS_WARN("AtlasPlugin has no head link, falls won't dump the flight "
+             "recorder");
+
+  ros::AdvertiseServiceOptions dumpFlightRecorderAso =
+    ros::AdvertiseServiceOptions::create<atlas_msgs::DumpFlightRecorder>(
+      "atlas/dump_flight_recorder", boost::bind(
+        &AtlasPlugin::DumpFlightRecorder, this, _1, _2),
+        ros::VoidPtr(), &this->rosQueue);
+  this->dumpFlightRecorderService = this->rosNode->advertiseService(
+    dumpFlightRecorderAso);
+
+  ROS_INFO("AtlasPlugin flight recorder keeps the last %f sec, dumped to [%s]",
+           duration, directory.c_str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void AtlasPlugin::UpdateFlightRecorder(const common::Time &_curTime)
+{
+  int32_t currentBehavior, desiredBehavior, errorCode;
+  {
+    boost::mutex::scoped_lock lock(this->asiMutex);
+    currentBehavior = this->asiState.current_behavior;
+    desiredBehavior = this->asiState.desired_behavior;
+    errorCode = this->asiState.error_code;
+  }
+
+  {
+    boost::mutex::scoped_lock lock(this->mutex);
+
+    uint8_t *frame = this->flightRecorder.NextFrame();
+    AtlasFlightRecorder::Pack(frame, _curTime.Double());
+    AtlasFlightRecorder::Pack(frame, currentBehavior);
+    AtlasFlightRecorder::Pack(frame, desiredBehavior);
+    AtlasFlightRecorder::Pack(frame, errorCode);
+
+    const atlas_msgs::AtlasState &s = this->atlasState;
+    const double sensors[22] = {
+      s.orientation.x, s.orientation.y, s.orientation.z, s.orientation.w,
+      s.angular_velocity.x, s.angular_velocity.y, s.angular_velocity.z,
+      s.linear_acceleration.x, s.linear_acceleration.y,
+      s.linear_acceleration.z,
+      s.l_foot.force.x, s.l_foot.force.y, s.l_foot.force.z,
+      s.l_foot.torque.x, s.l_foot.torque.y, s.l_foot.torque.z,
+      s.r_foot.force.x, s.r_foot.force.y, s.r_foot.force.z,
+      s.r_foot.torque.x, s.r_foot.torque.y, s.r_foot.torque.z};
+    for (unsigned int i = 0; i < 22; ++i)
+      AtlasFlightRecorder::Pack(frame, static_cast<float>(sensors[i]));
+
+    unsigned int n = this->joints.size();
+    for (unsigned int i = 0; i < n; ++i)
+      AtlasFlightRecorder::Pack(frame, s.position[i]);
+    for (unsigned int i = 0; i < n; ++i)
+      AtlasFlightRecorder::Pack(frame, s.velocity[i]);
+    for (unsigned int i = 0; i < n; ++i)
+      AtlasFlightRecorder::Pack(frame, s.effort[i]);
+    for (unsigned int i = 0; i < n; ++i)
+      AtlasFlightRecorder::Pack(frame,
+        static_cast<float>(this->atlasCommand.position[i]));
+    for (unsigned int i = 0; i < n; ++i)
+      AtlasFlightRecorder::Pack(frame,
+        static_cast<float>(this->atlasCommand.velocity[i]));
+    for (unsigned int i = 0; i < n; ++i)
+      AtlasFlightRecorder::Pack(frame,
+        static_cast<float>(this->atlasCommand.effort[i]));
+    for (unsigned int i = 0; i < n; ++i)
+      AtlasFlightRecorder::Pack(frame, s.k_effort[i]);
+
+    this->flightRecorder.Commit(_curTime.Double());
+  }
+
+  // triggers, the step that triggered is in the dump
+  std::string reason;
+  if (this->headLink && this->fallDetector.Update(_curTime.Double(),
+        this->headLink->GetWorldLinearVel().z))
+  {
+    std::ostringstream ss;
+    ss << "fall, head acceleration of " <<
+      this->fallDetector.GetAcceleration() << " m/s^2";
+    reason = ss.str();
+  }
+  else if (errorCode != NO_ERRORS && this->flightErrorCode == NO_ERRORS)
+  {
+    std::ostringstream ss;
+    ss << "AtlasSimInterface error code (" << errorCode << ")";
+    reason = ss.str();
+  }
+  this->flightErrorCode = errorCode;
+
+  if (!reason.empty())
+  {
+    std::string status;
+    if (this->flightRecorder.Trigger(reason, "", status))
+      ROS_WARN("AtlasPlugin flight recorder dump on %s at t = %f",
+               reason.c_str(), _curTime.Double());
+    else
+      ROS_WARN("AtlasPlugin flight recorder ignored %s: %s",
+               reason.c_str(), status.c_str());
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool AtlasPlugin::DumpFlightRecorder(
+  atlas_msgs::DumpFlightRecorder::Request &_req,
+  atlas_msgs::DumpFlightRecorder::Response &_res)
+{
+  std::string reason = _req.reason.empty() ? "service" : _req.reason;
+  _res.success = this->flightRecorder.Trigger(reason, _req.filename,
+    _res.status_message);
+  return _res.success;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void AtlasPlugin::UpdateAtlasSimInterface(const common::Time &_curTime)
 {
@@ -2568,39 +2992,51 @@ void AtlasPlugin::UpdateAtlasSimInterface(const common::Time &_curTime)
 void AtlasPlugin::CalculateControllerStatistics(const common::Time &_curTime)
 {
   // Keep track of age of atlasCommand age in seconds.
-  // Note the value is invalid as a moving window average age
-  // until the buffer is full.
-  this->atlasCommandAge = _curTime.Double() -
-    this->atlasCommand.header.stamp.toSec();
-
-  double weightedAtlasCommandAge = this->atlasCommandAge
-    / this->atlasCommandAgeBuffer.size();
-
-  // for variance calculation, save delta before average is updated.
-  double delta = this->atlasCommandAge - this->atlasCommandAgeMean;
-
-  // update average
-  this->atlasCommandAgeMean += weightedAtlasCommandAge;
-  this->atlasCommandAgeMean -=
-    this->atlasCommandAgeBuffer[this->atlasCommandAgeBufferIndex];
-
-  // update variance with new average
-  double delta2 = delta *
-    (this->atlasCommandAge - this->atlasCommandAgeMean);
-  this->atlasCommandAgeVariance += delta2;
-  this->atlasCommandAgeVariance -=
-    this->atlasCommandAgeDelta2Buffer[
-    this->atlasCommandAgeBufferIndex];
-
-  // save weighted average in window
-  this->atlasCommandAgeBuffer[this->atlasCommandAgeBufferIndex] =
-    weightedAtlasCommandAge;
-
-  // save delta buffer for incremental variance calculation
-  this->atlasCommandAgeDelta2Buffer[this->atlasCommandAgeBufferIndex] = delta2;
-
-  this->atlasCommandAgeBufferIndex = (this->atlasCommandAgeBufferIndex + 1) %
-    this->atlasCommandAgeBuffer.size();
+  double age = _curTime.Double() - this->atlasCommand.header.stamp.toSec();
+  this->atlasCommandAgeStatistics.Update(age);
+
+  // tails of the age and of the wait for the controller in this step
+  this->commandAgeHistogram.Record(age);
+  this->synchronizationDelayHistogram.Record(
+    this->delayStatistics.delay_in_step);
+
+  // the controller did not send anything since the last step
+  if (this->atlasCommand.header.stamp == this->lastCommandStamp)
+  {
+    ++this->windowStaleTicks;
+    ++this->staleTicks;
+  }
+  this->lastCommandStamp = this->atlasCommand.header.stamp;
+
+  // window complete, keep its summary for PublishConstrollerStatistics
+  if (this->commandAgeHistogram.GetCount() >= this->latencyWindowTicks)
+  {
+    atlas_msgs::ControllerStatistics &stats = this->controllerStatistics;
+
+    stats.command_age_p50 = this->commandAgeHistogram.GetPercentile(50.0);
+    stats.command_age_p90 = this->commandAgeHistogram.GetPercentile(90.0);
+    stats.command_age_p99 = this->commandAgeHistogram.GetPercentile(99.0);
+    stats.command_age_p999 = this->commandAgeHistogram.GetPercentile(99.9);
+    stats.command_age_max = this->commandAgeHistogram.GetMax();
+
+    stats.synchronization_delay_p50 =
+      this->synchronizationDelayHistogram.GetPercentile(50.0);
+    stats.synchronization_delay_p90 =
+      this->synchronizationDelayHistogram.GetPercentile(90.0);
+    stats.synchronization_delay_p99 =
+      this->synchronizationDelayHistogram.GetPercentile(99.0);
+    stats.synchronization_delay_p999 =
+      this->synchronizationDelayHistogram.GetPercentile(99.9);
+    stats.synchronization_delay_max =
+      this->synchronizationDelayHistogram.GetMax();
+
+    stats.window_ticks = this->commandAgeHistogram.GetCount();
+    stats.window_stale_ticks = this->windowStaleTicks;
+
+    this->commandAgeHistogram.Reset();
+    this->synchronizationDelayHistogram.Reset();
+    this->windowStaleTicks = 0;
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -2609,84 +3045,35 @@ void AtlasPlugin::UpdatePIDControl(double _dt)
   /// update pid with feedforward force
   for (unsigned int i = 0; i < this->joints.size(); ++i)
   {
+    AtlasPIDInput in;
     // truncate joint position within range of motion
-    double positionTarget = math::clamp(
+    in.positionTarget = math::clamp(
       this->atlasCommand.position[i],
       this->joints[i]->GetLowStop(0).Radian(),
       this->joints[i]->GetHighStop(0).Radian());
+    in.velocityTarget = this->atlasCommand.velocity[i];
+    in.effortTarget = this->atlasCommand.effort[i];
+    in.position = this->atlasState.position[i];
+    in.velocity = this->atlasState.velocity[i];
+    in.kpPosition = this->atlasState.kp_position[i];
+    in.kiPosition = this->atlasState.ki_position[i];
+    in.kdPosition = this->atlasState.kd_position[i];
+    in.kpVelocity = this->atlasState.kp_velocity[i];
+    in.iEffortMin = this->atlasState.i_effort_min[i];
+    in.iEffortMax = this->atlasState.i_effort_max[i];
+    // convert k_effort to a double between 0 and 1
+    in.kEffort = static_cast<double>(this->atlasState.k_effort[i])/255.0;
+    in.bdiEffort = this->controlOutput.f_out[i];
+    in.effortLimit = this->effortLimit[i];
+    in.dampingModel = this->jointDampingModel[i];
+    in.dampingMax = this->jointDampingMax[i];
 
-    double q_p = positionTarget - this->atlasState.position[i];
-
-    if (!math::equal(_dt, 0.0))
-      this->errorTerms[i].d_q_p_dt = (q_p - this->errorTerms[i].q_p) / _dt;
-
-    this->errorTerms[i].q_p = q_p;
-
-    // Take advantage of cfm damping by passing kp_velocity through
-    // to intrinsic joint damping coefficient.  Simulating
-    // infinite bandwidth kp_velocity.
-    //
-    // kp_velocity is truncated within (jointDampingModel, jointDampingMax).
-    //
-    // To take advantage of utilizing full range of cfm damping dynamically
-    // for controlling the robot, set model damping (jointDmapingModel)
-    // to jointDampingMin first.
-    double jointDampingCoef = math::clamp(
-      static_cast<double>(this->atlasState.kp_velocity[i]),
-      this->jointDampingModel[i], this->jointDampingMax[i]);
-
-    // skip set joint damping if value is not changing
-    if (!math::equal(this->lastJointCFMDamping[i], jointDampingCoef))
-    {
-      this->joints[i]->SetDamping(0, jointDampingCoef);
-      this->lastJointCFMDamping[i] = jointDampingCoef;
-    }
-
-    // approximate effort generated by a non-zero joint velocity state
-    // this is the approximate force of the infinite bandwidth
-    // kp_velocity term, we'll use this to bound additional forces later.
-    // Force generated by cfm damping from damping coefficient smaller than
-    // jointDampingModel is generated for free.
-    double kpVelocityDampingEffort = 0;
-    double kpVelocityDampingCoef =
-      jointDampingCoef - this->jointDampingModel[i];
-    if (kpVelocityDampingCoef > 0.0)
-      kpVelocityDampingEffort =
-        kpVelocityDampingCoef * this->atlasState.velocity[i];
-
-    this->errorTerms[i].k_i_q_i = math::clamp(
-      this->errorTerms[i].k_i_q_i +
-      _dt * this->atlasState.ki_position[i] * this->errorTerms[i].q_p,
-      static_cast<double>(this->atlasState.i_effort_min[i]),
-      static_cast<double>(this->atlasState.i_effort_max[i]));
+    double jointDampingCoef;
+    double forceClamped = AtlasPIDUpdate(in, _dt, this->errorTerms[i],
+      jointDampingCoef);
 
-    // convert k_effort to a double between 0 and 1
-    double k_effort =
-      static_cast<double>(this->atlasState.k_effort[i])/255.0;
-
-    // use gain params to compute force cmd
-    // AtlasSimInterface:  also, add bdi controller feed forward force
-    // to overall control torque scaled by 1 - k_effort.
-    double forceUnclamped =
-      k_effort * (
-      this->atlasState.kp_position[i] * this->errorTerms[i].q_p +
-                                        this->errorTerms[i].k_i_q_i +
-      this->atlasState.kd_position[i] * this->errorTerms[i].d_q_p_dt +
-                     jointDampingCoef * this->atlasCommand.velocity[i] +
-                                        this->atlasCommand.effort[i]) +
-      (1.0 - k_effort)                * this->controlOutput.f_out[i];
-
-    // keep unclamped force for integral tie-back calculation
-    double forceClamped = math::clamp(forceUnclamped, -this->effortLimit[i],
-      this->effortLimit[i]);
-
-    // clamp force after integral tie-back
-    // shift by kpVelocityDampingEffort to prevent controller from
-    // exerting too much force from use of kp_velocity --> cfm damping
-    // pass through.
-    forceClamped = math::clamp(forceUnclamped,
-      -this->effortLimit[i] + kpVelocityDampingEffort,
-       this->effortLimit[i] + kpVelocityDampingEffort);
+    // skipped by the writer if the value is not changing
+    this->jointParams[i].SetDamping(0, jointDampingCoef);
 
     // apply force to joint
     this->joints[i]->SetForce(0, forceClamped);
@@ -2711,13 +3098,24 @@ void AtlasPlugin::PublishConstrollerStatistics(const common::Time &_curTime)
     if ((_curTime - this->lastControllerStatisticsTime).Double() >=
       1.0/this->statsUpdateRate)
     {
-      atlas_msgs::ControllerStatistics msg;
+      // tails of the last complete window
+      atlas_msgs::ControllerStatistics msg = this->controllerStatistics;
       msg.header.stamp = ros::Time(_curTime.sec, _curTime.nsec);
-      msg.command_age = this->atlasCommandAge;
-      msg.command_age_mean = this->atlasCommandAgeMean;
-      msg.command_age_variance = this->atlasCommandAgeVariance /
-        (this->atlasCommandAgeBuffer.size() - 1);
+      msg.command_age = this->atlasCommandAgeStatistics.GetAge();
+      msg.command_age_mean = this->atlasCommandAgeStatistics.GetMean();
+      msg.command_age_variance =
+        this->atlasCommandAgeStatistics.GetVariance();
       msg.command_age_window_size = this->atlasCommandAgeBufferDuration;
+      msg.stale_ticks = this->staleTicks;
+      {
+        boost::mutex::scoped_lock lock(this->mutex);
+        for (unsigned int i = 0; i < this->jointParams.size(); ++i)
+        {
+          msg.joint_param_writes += this->jointParams[i].GetWriteCount();
+          msg.joint_param_writes_suppressed +=
+            this->jointParams[i].GetSuppressedCount();
+        }
+      }
 
       this->pubControllerStatisticsQueue->push(msg,
         this->pubControllerStatistics);
@@ -2816,30 +3214,8 @@ void AtlasPlugin::InitFilter()
 void AtlasPlugin::Filter(std::vector<float> &_aState,
                          std::vector<double> &_jState)
 {
-  // Actually do filtering on each tick for each joint:
-  // filter velocities: assume a(0) is 1.0
-  // a(0)*y(0) = b(0)*x(0) + b(1)*x(1) + ... + b(n-1)*x(n-1)
-  //                       - a(1)*y(1) - ... - a(n-1)*y(n-1)
-  // filter each joint position/velocity
-  for (unsigned int i = 0; i < this->joints.size(); ++i)
-  {
-    // move data back one step in time.
-    for (int j = FIL_N_STEPS - 2; j >= 0; --j)
-    {
-      this->unfilteredIn[i][j+1] = this->unfilteredIn[i][j];
-      this->unfilteredOut[i][j+1] = this->unfilteredOut[i][j];
-    }
-    // load new input
-    this->unfilteredIn[i][0] = _aState[i];
-    // do filtering
-    double tmp = 0;
-    for (unsigned int j = 0; j < FIL_N_STEPS; ++j)
-      tmp += this->filCoefB[j]*this->unfilteredIn[i][j];
-    for (unsigned int j = 1; j < FIL_N_STEPS; ++j)
-      tmp -= this->filCoefA[j]*this->unfilteredOut[i][j];
-    // stash filtered value;
-    _aState[i] = _jState[i] = this->unfilteredOut[i][0] = tmp;
-  }
+  AtlasFilterJoints(this->filCoefA, this->filCoefB, this->unfilteredIn,
+    this->unfilteredOut, _aState, _jState);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,364 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <gazebo/common/common.hh>
+#include <gazebo/physics/ContactManager.hh>
+#include <gazebo/transport/transport.hh>
+#include "drcsim_gazebo_ros_plugins/ContactDemux.hh"
+
+#include <map>
+#include <string>
+
+#include <boost/functional/hash.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/weak_ptr.hpp>
+
+using namespace gazebo;
+
+namespace
+{
+  /// \brief Demuxes by world name
+  std::map<std::string, boost::weak_ptr<ContactDemux> > demuxes;
+
+  /// \brief Protects demuxes
+  boost::mutex demuxesMutex;
+}
+
+/////////////////////////////////////////////////
+ContactView::ContactView(ConstContactsPtr _msg)
+  : msg(_msg), distinct(0)
+{
+}
+
+/////////////////////////////////////////////////
+ConstContactsPtr ContactView::GetMessage() const
+{
+  return this->msg;
+}
+
+/////////////////////////////////////////////////
+const msgs::Time &ContactView::GetTime() const
+{
+  return this->msg->time();
+}
+
+/////////////////////////////////////////////////
+unsigned int ContactView::GetContactCount() const
+{
+  return this->entries.size();
+}
+
+/////////////////////////////////////////////////
+const msgs::Contact &ContactView::GetContact(unsigned int _i) const
+{
+  return this->msg->contact(this->entries[_i].index);
+}
+
+/////////////////////////////////////////////////
+bool ContactView::IsFirst(unsigned int _i) const
+{
+  return this->entries[_i].first;
+}
+
+/////////////////////////////////////////////////
+unsigned int ContactView::GetCollision(unsigned int _i) const
+{
+  return this->entries[_i].collision;
+}
+
+/////////////////////////////////////////////////
+bool ContactView::IsComplete() const
+{
+  return this->distinct == this->msg->contact_size();
+}
+
+/////////////////////////////////////////////////
+void ContactView::Add(int _index, bool _first, unsigned int _collision)
+{
+  // Contacts are added in message order
+  if (this->entries.empty() || this->entries.back().index != _index)
+    ++this->distinct;
+
+  Entry entry;
+  entry.index = _index;
+  entry.first = _first;
+  entry.collision = _collision;
+  this->entries.push_back(entry);
+}
+
+/////////////////////////////////////////////////
+ContactDemux::ContactDemux(physics::WorldPtr _world)
+  : world(_world), filterCount(0), filterChanged(false), nextId(0),
+    messageCount(0), contactCount(0), deliveredCount(0)
+{
+  this->node.reset(new transport::Node());
+  this->node->Init(this->world->GetName());
+
+  this->updateConnection = event::Events::ConnectWorldUpdateBegin(
+      boost::bind(&ContactDemux::OnUpdate, this));
+}
+
+/////////////////////////////////////////////////
+ContactDemux::~ContactDemux()
+{
+  event::Events::DisconnectWorldUpdateBegin(this->updateConnection);
+  this->contactSub.reset();
+#if GAZEBO_MAJOR_VERSION >= 2
+  if (!this->filterName.empty())
+  {
+    this->world->GetPhysicsEngine()->GetContactManager()->RemoveFilter(
+        this->filterName);
+  }
+#endif
+  gzlog << "Contact demux: " << this->messageCount << " messages, "
+        << this->contactCount << " contacts received, "
+        << this->deliveredCount << " delivered\n";
+}
+
+/////////////////////////////////////////////////
+ContactDemuxPtr ContactDemux::Get(physics::WorldPtr _world)
+{
+  boost::mutex::scoped_lock lock(demuxesMutex);
+  ContactDemuxPtr demux = demuxes[_world->GetName()].lock();
+  if (!demux)
+  {
+    demux.reset(new ContactDemux(_world));
+    demuxes[_world->GetName()] = demux;
+  }
+  return demux;
+}
+
+/////////////////////////////////////////////////
+unsigned int ContactDemux::Connect(
+    const std::vector<std::string> &_collisions, Callback _callback)
+{
+  boost::mutex::scoped_lock lock(this->mutex);
+  unsigned int id = this->nextId++;
+  Consumer &consumer = this->consumers[id];
+  consumer.callback = _callback;
+
+  for (unsigned int i = 0; i < _collisions.size(); ++i)
+  {
+    int collisionId = this->GetCollisionId(_collisions[i]);
+    if (collisionId < 0)
+    {
+      collisionId = this->collisionNames.size();
+      this->collisionIds.insert(std::make_pair(
+          boost::hash_value(_collisions[i]),
+          static_cast<unsigned int>(collisionId)));
+      this->collisionNames.push_back(_collisions[i]);
+      this->targets.push_back(std::vector<Target>());
+    }
+    consumer.collisions.push_back(collisionId);
+
+    Target target;
+    target.consumer = id;
+    target.collision = i;
+    this->targets[collisionId].push_back(target);
+  }
+  this->filterChanged = true;
+  return id;
+}
+
+/////////////////////////////////////////////////
+void ContactDemux::Disconnect(unsigned int _id)
+{
+  boost::mutex::scoped_lock lock(this->mutex);
+  std::map<unsigned int, Consumer>::iterator iter = this->consumers.find(_id);
+  if (iter == this->consumers.end())
+    return;
+
+  const std::vector<unsigned int> &collisions = iter->second.collisions;
+  for (unsigned int i = 0; i < collisions.size(); ++i)
+  {
+    std::vector<Target> &collTargets = this->targets[collisions[i]];
+    for (std::vector<Target>::iterator t = collTargets.begin();
+         t != collTargets.end();)
+    {
+      if (t->consumer == _id)
+        t = collTargets.erase(t);
+      else
+        ++t;
+    }
+  }
+  this->consumers.erase(iter);
+  this->filterChanged = true;
+}
+
+/////////////////////////////////////////////////
+unsigned int ContactDemux::GetMessageCount() const
+{
+  boost::mutex::scoped_lock lock(this->mutex);
+  return this->messageCount;
+}
+
+/////////////////////////////////////////////////
+unsigned int ContactDemux::GetContactCount() const
+{
+  boost::mutex::scoped_lock lock(this->mutex);
+  return this->contactCount;
+}
+
+/////////////////////////////////////////////////
+unsigned int ContactDemux::GetDeliveredCount() const
+{
+  boost::mutex::scoped_lock lock(this->mutex);
+  return this->deliveredCount;
+}
+
+/////////////////////////////////////////////////
+void ContactDemux::OnContacts(ConstContactsPtr &_msg)
+{
+  boost::mutex::scoped_lock lock(this->mutex);
+
+  // Store the contacts message for processing
+  this->incomingContacts.push_back(_msg);
+  ++this->messageCount;
+  this->contactCount += _msg->contact_size();
+
+  // Prevent the incomingContacts list to grow indefinitely.
+  if (this->incomingContacts.size() > 100)
+    this->incomingContacts.pop_front();
+}
+
+/////////////////////////////////////////////////
+void ContactDemux::OnUpdate()
+{
+  std::vector<Delivery> ready;
+  {
+    boost::mutex::scoped_lock lock(this->mutex);
+
+    // The contact manager is only used from the world update thread
+    if (this->filterChanged)
+    {
+      this->Subscribe();
+      this->filterChanged = false;
+    }
+
+    for (ContactMsgs_L::iterator iter = this->incomingContacts.begin();
+         iter != this->incomingContacts.end(); ++iter)
+    {
+      this->Dispatch(*iter);
+    }
+    this->incomingContacts.clear();
+    ready.swap(this->deliveries);
+  }
+
+  // callbacks may connect, disconnect and get the statistics
+  for (unsigned int i = 0; i < ready.size(); ++i)
+  {
+    {
+      // skip consumers disconnected by an earlier callback
+      boost::mutex::scoped_lock lock(this->mutex);
+      if (this->consumers.find(ready[i].consumer) == this->consumers.end())
+        continue;
+    }
+    ready[i].callback(ready[i].view);
+  }
+}
+
+/////////////////////////////////////////////////
+void ContactDemux::Subscribe()
+{
+  physics::ContactManager *mgr =
+    this->world->GetPhysicsEngine()->GetContactManager();
+
+  this->contactSub.reset();
+#if GAZEBO_MAJOR_VERSION >= 2
+  if (!this->filterName.empty())
+    mgr->RemoveFilter(this->filterName);
+#endif
+  this->filterName.clear();
+  // Contacts of the old set of collisions
+  this->incomingContacts.clear();
+
+  std::vector<std::string> collisions;
+  for (unsigned int i = 0; i < this->targets.size(); ++i)
+  {
+    if (!this->targets[i].empty())
+      collisions.push_back(this->collisionNames[i]);
+  }
+  if (collisions.empty())
+    return;
+
+  // Filter names can't be reused
+  this->filterName = "contact_demux_" +
+    boost::lexical_cast<std::string>(this->filterCount++);
+  std::string topic = mgr->CreateFilter(this->filterName, collisions);
+  this->contactSub = this->node->Subscribe(topic,
+      &ContactDemux::OnContacts, this);
+}
+
+/////////////////////////////////////////////////
+void ContactDemux::Dispatch(ConstContactsPtr _msg)
+{
+  std::map<unsigned int, ContactView> views;
+  for (int i = 0; i < _msg->contact_size(); ++i)
+  {
+    const msgs::Contact &contact = _msg->contact(i);
+
+    // Check to see if the contact arrays all have the same size.
+    int count = contact.position_size();
+    if (count != contact.normal_size() ||
+        count != contact.wrench_size() ||
+        count != contact.depth_size())
+    {
+      gzerr << "Contact message has invalid array sizes\n";
+      continue;
+    }
+
+    for (int c = 0; c < 2; ++c)
+    {
+      int collisionId = this->GetCollisionId(
+          c == 0 ? contact.collision1() : contact.collision2());
+      if (collisionId < 0)
+        continue;
+
+      const std::vector<Target> &collTargets = this->targets[collisionId];
+      for (std::vector<Target>::const_iterator t = collTargets.begin();
+           t != collTargets.end(); ++t)
+      {
+        std::map<unsigned int, ContactView>::iterator view =
+          views.insert(std::make_pair(t->consumer, ContactView(_msg))).first;
+        view->second.Add(i, c == 0, t->collision);
+      }
+    }
+  }
+
+  for (std::map<unsigned int, ContactView>::iterator iter = views.begin();
+       iter != views.end(); ++iter)
+  {
+    this->deliveredCount += iter->second.GetContactCount();
+    this->deliveries.push_back(Delivery(iter->first,
+        this->consumers[iter->first].callback, iter->second));
+  }
+}
+
+/////////////////////////////////////////////////
+int ContactDemux::GetCollisionId(const std::string &_name) const
+{
+  typedef boost::unordered_multimap<std::size_t, unsigned int>::const_iterator
+    Iter;
+  std::pair<Iter, Iter> range =
+    this->collisionIds.equal_range(boost::hash_value(_name));
+  for (Iter iter = range.first; iter != range.second; ++iter)
+  {
+    if (this->collisionNames[iter->second] == _name)
+      return iter->second;
+  }
+  return -1;
+}
@@ -15,7 +15,8 @@
  *
 */
 
-#include <gazebo/physics/ContactManager.hh>
+#include <algorithm>
+
 #include <gazebo/transport/transport.hh>
 #include "drcsim_gazebo_ros_plugins/ContactModelPlugin.h"
 
@@ -23,14 +24,18 @@ using namespace gazebo;
 GZ_REGISTER_MODEL_PLUGIN(ContactModelPlugin)
 
 /////////////////////////////////////////////////
-ContactModelPlugin::ContactModelPlugin() : ModelPlugin()
+ContactModelPlugin::ContactModelPlugin()
+  : ModelPlugin(), contactDemuxId(0), contactDemuxConnected(false),
+    summary(false)
 {
 }
 
 /////////////////////////////////////////////////
 ContactModelPlugin::~ContactModelPlugin()
 {
-  this->contactSub.reset();
+  if (this->contactDemuxConnected)
+    this->contactDemux->Disconnect(this->contactDemuxId);
+  this->contactDemux.reset();
   this->contactsPub.reset();
   event::Events::DisconnectWorldUpdateBegin(this->updateConnection);
   this->collisions.clear();
@@ -48,15 +53,41 @@ void ContactModelPlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf)
 
   if (_sdf->HasElement("contact"))
   {
-    sdf::ElementPtr collisionElem =
-        _sdf->GetElement("contact")->GetElement("collision");
+    sdf::ElementPtr contactElem = _sdf->GetElement("contact");
+    if (contactElem->HasElement("summary"))
+      this->summary = contactElem->Get<bool>("summary");
+
+    sdf::ElementPtr collisionElem = contactElem->GetElement("collision");
     // Get all the collision elements
     while (collisionElem)
     {
       // get collision name
       collisionName = collisionElem->Get<std::string>();
-      this->collisions.insert(_model->GetName() + "::" + collisionName);
+      collisionScopedName = _model->GetName() + "::" + collisionName;
       collisionElem = collisionElem->GetNextElement("collision");
+      if (std::find(this->collisions.begin(), this->collisions.end(),
+            collisionScopedName) != this->collisions.end())
+        continue;
+
+      // The collision's link is the scope it's in
+      std::string linkName = collisionScopedName.substr(0,
+          collisionScopedName.rfind("::"));
+      physics::LinkPtr link = _model->GetLink(linkName);
+      if (!link)
+      {
+        gzerr << "No link for contact collision [" << collisionScopedName
+              << "]\n";
+        continue;
+      }
+
+      unsigned int linkIndex = 0;
+      while (linkIndex < this->links.size() && this->links[linkIndex] != link)
+        ++linkIndex;
+      if (linkIndex == this->links.size())
+        this->links.push_back(link);
+
+      this->collisions.push_back(collisionScopedName);
+      this->collisionLinks.push_back(linkIndex);
     }
   }
 }
@@ -86,12 +117,10 @@ void ContactModelPlugin::Init()
     topicName += this->model->GetName() + "/contact_" +
         boost::lexical_cast<std::string>(contactNum++);
     boost::replace_all(topicName, "::", "/");
-    this->filterTopicName = this->model->GetName() + "_tactile_" +
-        boost::lexical_cast<std::string>(contactNum) + "_filter";
-    boost::replace_all(this->filterTopicName, "::", "/");
     this->contactsPub = this->node->Advertise<msgs::Contacts>(topicName);
   }
 
+  this->contactDemux = ContactDemux::Get(this->world);
   this->updateConnection = event::Events::ConnectWorldUpdateBegin(
       boost::bind(&ContactModelPlugin::OnUpdate, this));
 }
@@ -99,103 +128,103 @@ void ContactModelPlugin::Init()
 //////////////////////////////////////////////////
 void ContactModelPlugin::OnUpdate()
 {
-  // only subscribe when needed
-  if (this->contactsPub && this->contactsPub->HasConnections())
+  // only receive contacts when someone is listening
+  bool listening = this->contactsPub && this->contactsPub->HasConnections();
+  if (listening && !this->contactDemuxConnected && !this->collisions.empty())
   {
-    if (!this->contactSub)
-    {
-      if (!this->collisions.empty())
-      {
-        // request the contact manager to publish messages to a custom topic for
-        // this sensor
-        physics::ContactManager *mgr =
-            this->world->GetPhysicsEngine()->GetContactManager();
-        std::vector<std::string> collisionNames;
-        std::copy(this->collisions.begin(), this->collisions.end(),
-            std::back_inserter(collisionNames));
-        std::string topic = mgr->CreateFilter(this->filterTopicName,
-            collisionNames);
-        this->contactSub = this->node->Subscribe(topic,
-            &ContactModelPlugin::OnContacts, this);
-      }
-    }
+    this->contactDemuxId = this->contactDemux->Connect(this->collisions,
+        boost::bind(&ContactModelPlugin::OnContacts, this, _1));
+    this->contactDemuxConnected = true;
   }
-  else
+  else if (!listening && this->contactDemuxConnected)
   {
-    return;
+    this->contactDemux->Disconnect(this->contactDemuxId);
+    this->contactDemuxConnected = false;
   }
+}
 
-  boost::mutex::scoped_lock lock(this->mutex);
-  boost::unordered_set<std::string>::iterator collIter;
-  std::string collision1;
-
-  // Don't do anything if there is no new data to process.
-  if (this->incomingContacts.empty())
+//////////////////////////////////////////////////
+void ContactModelPlugin::OnContacts(const ContactView &_view)
+{
+  if (this->summary)
+  {
+    this->PublishSummary(_view);
     return;
+  }
 
-  // Clear the outgoing contact message.
-  this->contactsMsg.clear_contact();
-
-  // Iterate over all the contact messages
-  for (ContactMsgs_L::iterator iter = this->incomingContacts.begin();
-      iter != this->incomingContacts.end(); ++iter)
+  // The demux's filter normally leaves only monitored collisions, in
+  // which case the message is forwarded as it is, without a copy.
+  if (_view.IsComplete())
   {
-    // Iterate over all the contacts in the message
-    for (int i = 0; i < (*iter)->contact_size(); ++i)
-    {
-      collision1 = (*iter)->contact(i).collision1();
-
-      // Try to find the first collision's name
-      collIter = this->collisions.find(collision1);
-
-      // If unable to find the first collision's name, try the second
-      if (collIter == this->collisions.end())
-      {
-        collision1 = (*iter)->contact(i).collision2();
-        collIter = this->collisions.find(collision1);
-      }
-
-      // If this model is monitoring one of the collision's in the
-      // contact, then add the contact to our outgoing message.
-      if (collIter != this->collisions.end())
-      {
-        int count = (*iter)->contact(i).position_size();
-
-        // Check to see if the contact arrays all have the same size.
-        if (count != (*iter)->contact(i).normal_size() ||
-            count != (*iter)->contact(i).wrench_size() ||
-            count != (*iter)->contact(i).depth_size())
-        {
-          gzerr << "Contact message has invalid array sizes\n";
-          continue;
-        }
-        // Copy the contact message.
-        msgs::Contact *contactMsg = this->contactsMsg.add_contact();
-        contactMsg->CopyFrom((*iter)->contact(i));
-      }
-    }
+    this->contactsPub->Publish(*_view.GetMessage());
+    return;
   }
 
-  // Clear the incoming contact list.
-  this->incomingContacts.clear();
-
-  // Generate an outgoing message only if someone is listening.
-  if (this->contactsPub && this->contactsPub->HasConnections())
+  // Otherwise copy the contacts this model is monitoring; a contact
+  // between two of them is in the view twice.
+  this->contactsMsg.clear_contact();
+  const msgs::Contact *previous = NULL;
+  for (unsigned int i = 0; i < _view.GetContactCount(); ++i)
   {
-    msgs::Set(this->contactsMsg.mutable_time(), this->world->GetSimTime());
-    this->contactsPub->Publish(this->contactsMsg);
+    const msgs::Contact &contact = _view.GetContact(i);
+    if (&contact != previous)
+      this->contactsMsg.add_contact()->CopyFrom(contact);
+    previous = &contact;
   }
+  this->contactsMsg.mutable_time()->CopyFrom(_view.GetTime());
+  this->contactsPub->Publish(this->contactsMsg);
 }
 
 //////////////////////////////////////////////////
-void ContactModelPlugin::OnContacts(ConstContactsPtr &_msg)
+void ContactModelPlugin::PublishSummary(const ContactView &_view)
 {
-  boost::mutex::scoped_lock lock(this->mutex);
-
-  // Store the contacts message for processing
-  this->incomingContacts.push_back(_msg);
+  std::vector<math::Vector3> forces(this->links.size());
+  std::vector<math::Vector3> torques(this->links.size());
+  std::vector<bool> touched(this->links.size(), false);
+  for (unsigned int i = 0; i < _view.GetContactCount(); ++i)
+  {
+    const msgs::Contact &contact = _view.GetContact(i);
+    unsigned int link = this->collisionLinks[_view.GetCollision(i)];
+    for (int j = 0; j < contact.wrench_size(); ++j)
+    {
+      const msgs::Wrench &wrench = _view.IsFirst(i) ?
+        contact.wrench(j).body_1_wrench() : contact.wrench(j).body_2_wrench();
+      forces[link] += msgs::Convert(wrench.force());
+      torques[link] += msgs::Convert(wrench.torque());
+    }
+    touched[link] = true;
+  }
 
-  // Prevent the incomingContacts list to grow indefinitely.
-  if (this->incomingContacts.size() > 100)
-    this->incomingContacts.pop_front();
+  // One contact per touched link, at the link's origin, with the force
+  // direction as its normal
+  this->contactsMsg.clear_contact();
+  for (unsigned int l = 0; l < this->links.size(); ++l)
+  {
+    if (!touched[l])
+      continue;
+
+    std::string linkName = this->links[l]->GetScopedName();
+    msgs::Contact *contact = this->contactsMsg.add_contact();
+    contact->set_collision1(linkName);
+    contact->set_collision2("");
+    contact->set_world(this->world->GetName());
+    msgs::Set(contact->add_position(), this->links[l]->GetWorldPose().pos);
+    msgs::Set(contact->add_normal(), math::Vector3(forces[l]).Normalize());
+    contact->add_depth(0);
+    contact->mutable_time()->CopyFrom(_view.GetTime());
+
+    msgs::JointWrench *wrench = contact->add_wrench();
+    wrench->set_body_1_name(linkName);
+    wrench->set_body_1_id(this->links[l]->GetId());
+    wrench->set_body_2_name("");
+    wrench->set_body_2_id(-1);
+    msgs::Set(wrench->mutable_body_1_wrench()->mutable_force(), forces[l]);
+    msgs::Set(wrench->mutable_body_1_wrench()->mutable_torque(), torques[l]);
+    msgs::Set(wrench->mutable_body_2_wrench()->mutable_force(),
+        math::Vector3::Zero);
+    msgs::Set(wrench->mutable_body_2_wrench()->mutable_torque(),
+        math::Vector3::Zero);
+  }
+  this->contactsMsg.mutable_time()->CopyFrom(_view.GetTime());
+  this->contactsPub->Publish(this->contactsMsg);
 }
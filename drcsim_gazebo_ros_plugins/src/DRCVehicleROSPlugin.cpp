@@ -32,17 +32,21 @@ DRCVehicleROSPlugin::DRCVehicleROSPlugin()
   this->rosPublishPeriod = common::Time(0.05);
   this->lastRosPublishTime = common::Time(0.0);
   this->rosNode = NULL;
+  this->hasVehicleCmd = false;
+  this->perFieldTopics = true;
+  this->pmq = new PubMultiQueue();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // Destructor
 DRCVehicleROSPlugin::~DRCVehicleROSPlugin()
 {
-  event::Events::DisconnectWorldUpdateBegin(this->ros_publish_connection_);
+  this->ros_publish_connection_.reset();
   this->rosNode->shutdown();
   this->queue.clear();
   this->queue.disable();
   this->callbackQueueThread.join();
+  delete this->pmq;
   delete this->rosNode;
 }
 
@@ -53,11 +57,19 @@ void DRCVehicleROSPlugin::Init()
   DRCVehiclePlugin::Init();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void DRCVehicleROSPlugin::SetKinematicEnabled(
+  const std_msgs::Bool::ConstPtr &_msg)
+{
+  DRCVehiclePlugin::SetKinematicEnabled(_msg->data);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Reset
 void DRCVehicleROSPlugin::Reset()
 {
   this->lastRosPublishTime.Set(0, 0);
+  this->hasVehicleCmd = false;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -130,6 +142,61 @@ void DRCVehicleROSPlugin::SetBrakePedalPercent(const std_msgs::Float64::ConstPtr
   DRCVehiclePlugin::SetBrakePedalState(cmd);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void DRCVehicleROSPlugin::SetVehicleCommand(
+  const atlas_msgs::VehicleCommand::ConstPtr &_msg)
+{
+  double min, max, percent;
+  DRCVehiclePlugin::SetHandWheelState(_msg->hand_wheel);
+
+  percent = math::clamp(_msg->gas_pedal, 0.0, 1.0);
+  DRCVehiclePlugin::GetGasPedalLimits(min, max);
+  DRCVehiclePlugin::SetGasPedalState(min + percent * (max - min));
+
+  percent = math::clamp(_msg->brake_pedal, 0.0, 1.0);
+  DRCVehiclePlugin::GetBrakePedalLimits(min, max);
+  DRCVehiclePlugin::SetBrakePedalState(min + percent * (max - min));
+
+  if (!this->hasVehicleCmd ||
+      _msg->hand_brake != this->lastVehicleCmd.hand_brake)
+  {
+    percent = math::clamp(_msg->hand_brake, 0.0, 1.0);
+    DRCVehiclePlugin::GetHandBrakeLimits(min, max);
+    DRCVehiclePlugin::SetHandBrakeState(min + percent * (max - min));
+    this->UpdateHandBrakeTime();
+  }
+
+  // Direction before key, since turning the key in gear gives ON_FR
+  if (!this->hasVehicleCmd ||
+      _msg->direction != this->lastVehicleCmd.direction)
+  {
+    if (_msg->direction == atlas_msgs::VehicleCommand::DIRECTION_NEUTRAL)
+      this->DRCVehiclePlugin::SetDirectionState(NEUTRAL);
+    else if (_msg->direction == atlas_msgs::VehicleCommand::DIRECTION_FORWARD)
+      this->DRCVehiclePlugin::SetDirectionState(FORWARD);
+    else if (_msg->direction == atlas_msgs::VehicleCommand::DIRECTION_REVERSE)
+      this->DRCVehiclePlugin::SetDirectionState(REVERSE);
+    else
+      ROS_ERROR("Invalid Direction State: %d, expected -1, 0, or 1\n",
+        static_cast<int16_t>(_msg->direction));
+    this->UpdateFNRSwitchTime();
+  }
+
+  if (!this->hasVehicleCmd || _msg->key != this->lastVehicleCmd.key)
+  {
+    if (_msg->key == atlas_msgs::VehicleCommand::KEY_OFF)
+      this->SetKeyOff();
+    else if (_msg->key == atlas_msgs::VehicleCommand::KEY_ON)
+      this->SetKeyOn();
+    else
+      ROS_ERROR("Invalid Key State: %d, expected 0 or 1\n",
+        static_cast<int16_t>(_msg->key));
+  }
+
+  this->lastVehicleCmd = *_msg;
+  this->hasVehicleCmd = true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Load the controller
 void DRCVehicleROSPlugin::Load(physics::ModelPtr _parent,
@@ -170,7 +237,41 @@ void DRCVehicleROSPlugin::Load(physics::ModelPtr _parent,
   this->world = _parent->GetWorld();
   this->model = _parent;
 
+  // The per-field topics predate <vehicle>/state and <vehicle>/cmd, and are
+  // kept for existing controllers
+  if (_sdf->HasElement("per_field_topics"))
+    this->perFieldTopics = _sdf->Get<bool>("per_field_topics");
+
   if (this->cheatsEnabled)
+  {
+    this->pmq->startServiceThread();
+
+    ros::SubscribeOptions vehicle_cmd_so =
+      ros::SubscribeOptions::create<atlas_msgs::VehicleCommand>(
+      this->model->GetName() + "/cmd", 100,
+      boost::bind(&DRCVehicleROSPlugin::SetVehicleCommand, this, _1),
+      ros::VoidPtr(), &this->queue);
+    this->subVehicleCmd = this->rosNode->subscribe(vehicle_cmd_so);
+
+    this->pubVehicleStateQueue = this->pmq->addPub<atlas_msgs::VehicleState>();
+    this->pubVehicleState = this->rosNode->advertise<atlas_msgs::VehicleState>(
+      this->model->GetName() + "/state", 10);
+
+    // Lets tests check that the kinematic model actually drove
+    this->pubKinematicTimeQueue = this->pmq->addPub<std_msgs::Float64>();
+    this->pubKinematicTime = this->rosNode->advertise<std_msgs::Float64>(
+      this->model->GetName() + "/kinematic_mode/time", 10);
+
+    // and compare it with full dynamics in the same run
+    ros::SubscribeOptions kinematic_enable_so =
+      ros::SubscribeOptions::create<std_msgs::Bool>(
+      this->model->GetName() + "/kinematic_mode/enable", 100,
+      boost::bind(&DRCVehicleROSPlugin::SetKinematicEnabled, this, _1),
+      ros::VoidPtr(), &this->queue);
+    this->subKinematicEnable = this->rosNode->subscribe(kinematic_enable_so);
+  }
+
+  if (this->cheatsEnabled && this->perFieldTopics)
   {
     ros::SubscribeOptions hand_wheel_cmd_so =
       ros::SubscribeOptions::create<std_msgs::Float64>(
@@ -226,6 +327,12 @@ void DRCVehicleROSPlugin::Load(physics::ModelPtr _parent,
       ros::VoidPtr(), &this->queue);
     this->subDirectionCmd = this->rosNode->subscribe(direction_cmd_so);
 
+    this->pubHandWheelStateQueue = this->pmq->addPub<std_msgs::Float64>();
+    this->pubHandBrakeStateQueue = this->pmq->addPub<std_msgs::Float64>();
+    this->pubGasPedalStateQueue = this->pmq->addPub<std_msgs::Float64>();
+    this->pubBrakePedalStateQueue = this->pmq->addPub<std_msgs::Float64>();
+    this->pubKeyStateQueue = this->pmq->addPub<std_msgs::Int8>();
+    this->pubDirectionStateQueue = this->pmq->addPub<std_msgs::Int8>();
     this->pubHandWheelState = this->rosNode->advertise<std_msgs::Float64>(
       this->model->GetName() + "/hand_wheel/state", 10);
     this->pubHandBrakeState = this->rosNode->advertise<std_msgs::Float64>(
@@ -238,13 +345,18 @@ void DRCVehicleROSPlugin::Load(physics::ModelPtr _parent,
       this->model->GetName() + "/key/state", 10);
     this->pubDirectionState = this->rosNode->advertise<std_msgs::Int8>(
       this->model->GetName() + "/direction/state", 10);
+  }
 
+  if (this->cheatsEnabled)
+  {
     // ros callback queue for processing subscription
     this->callbackQueueThread = boost::thread(
       boost::bind(&DRCVehicleROSPlugin::QueueThread, this));
 
-    this->ros_publish_connection_ = event::Events::ConnectWorldUpdateBegin(
-        boost::bind(&DRCVehicleROSPlugin::RosPublishStates, this));
+    this->ros_publish_connection_ = DRCUpdateScheduler::Connect(
+        "DRCVehicleROSPlugin",
+        boost::bind(&DRCVehicleROSPlugin::RosPublishStates, this),
+        DRCUpdateAccess());
   }
 }
 
@@ -274,22 +386,44 @@ void DRCVehicleROSPlugin::RosPublishStates()
   {
     // Update time
     this->lastRosPublishTime = this->world->GetSimTime();
+
+    // All of the controls in one message, read at the same time
+    atlas_msgs::VehicleState msg_state;
+    msg_state.header.stamp = ros::Time(this->lastRosPublishTime.sec,
+                                       this->lastRosPublishTime.nsec);
+    msg_state.hand_wheel = GetHandWheelState();
+    msg_state.hand_brake = GetHandBrakePercent();
+    msg_state.gas_pedal = GetGasPedalPercent();
+    msg_state.brake_pedal = GetBrakePedalPercent();
+    msg_state.key = static_cast<int8_t>(GetKeyState());
+    msg_state.direction = static_cast<int8_t>(GetDirectionState());
+    this->pubVehicleStateQueue->push(msg_state, this->pubVehicleState);
+
+    std_msgs::Float64 msg_kinematic_time;
+    msg_kinematic_time.data = GetKinematicTime();
+    this->pubKinematicTimeQueue->push(msg_kinematic_time,
+                                      this->pubKinematicTime);
+
+    if (!this->perFieldTopics)
+      return;
+
     // Publish Float64 messages
     std_msgs::Float64 msg_steer, msg_brake, msg_gas, msg_hand_brake;
-    msg_steer.data = GetHandWheelState();
-    this->pubHandWheelState.publish(msg_steer);
-    msg_brake.data = GetBrakePedalPercent();
-    this->pubBrakePedalState.publish(msg_brake);
-    msg_gas.data = GetGasPedalPercent();
-    this->pubGasPedalState.publish(msg_gas);
-    msg_hand_brake.data = GetHandBrakePercent();
-    this->pubHandBrakeState.publish(msg_hand_brake);
+    msg_steer.data = msg_state.hand_wheel;
+    this->pubHandWheelStateQueue->push(msg_steer, this->pubHandWheelState);
+    msg_brake.data = msg_state.brake_pedal;
+    this->pubBrakePedalStateQueue->push(msg_brake, this->pubBrakePedalState);
+    msg_gas.data = msg_state.gas_pedal;
+    this->pubGasPedalStateQueue->push(msg_gas, this->pubGasPedalState);
+    msg_hand_brake.data = msg_state.hand_brake;
+    this->pubHandBrakeStateQueue->push(msg_hand_brake,
+                                       this->pubHandBrakeState);
     // Publish Int8
     std_msgs::Int8 msg_key, msg_direction;
-    msg_key.data = static_cast<int8_t>(GetKeyState());
-    this->pubKeyState.publish(msg_key);
-    msg_direction.data = static_cast<int8_t>(GetDirectionState());
-    this->pubDirectionState.publish(msg_direction);
+    msg_key.data = msg_state.key;
+    this->pubKeyStateQueue->push(msg_key, this->pubKeyState);
+    msg_direction.data = msg_state.direction;
+    this->pubDirectionStateQueue->push(msg_direction, this->pubDirectionState);
   }
 }
 
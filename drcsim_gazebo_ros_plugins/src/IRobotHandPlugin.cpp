@@ -51,7 +51,7 @@ IRobotHandPlugin::IRobotHandPlugin()
 ////////////////////////////////////////////////////////////////////////////////
 IRobotHandPlugin::~IRobotHandPlugin()
 {
-  gazebo::event::Events::DisconnectWorldUpdateBegin(this->updateConnection);
+  this->updateConnection.reset();
   this->rosNode->shutdown();
   this->rosQueue.clear();
   this->rosQueue.disable();
@@ -140,9 +140,15 @@ void IRobotHandPlugin::Load(gazebo::physics::ModelPtr _parent,
   this->callbackQueeuThread = boost::thread(
     boost::bind(&IRobotHandPlugin::RosQueueThread, this));
 
-  // connect to gazebo world update
-  this->updateConnection = gazebo::event::Events::ConnectWorldUpdateBegin(
-     boost::bind(&IRobotHandPlugin::UpdateStates, this));
+  // connect to gazebo world update, UpdateStates pushes on the finger links
+  gazebo::DRCUpdateAccess access;
+  access.WriteJoints(this->fingerBaseJoints);
+  access.WriteJoints(this->fingerBaseRotationJoints);
+  for (unsigned int i = 0; i < this->flexureFlexJoints.size(); ++i)
+    access.WriteJoints(this->flexureFlexJoints[i]);
+  this->updateConnection = gazebo::DRCUpdateScheduler::Connect(
+     "IRobotHandPlugin", boost::bind(&IRobotHandPlugin::UpdateStates, this),
+     access);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,237 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <unistd.h>
+
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/weak_ptr.hpp>
+#include <gazebo/common/common.hh>
+#include <ros/ros.h>
+
+#include "drcsim_gazebo_ros_plugins/ModelReadiness.hh"
+
+using namespace gazebo;
+
+namespace
+{
+  /// \brief Services by world name
+  std::map<std::string, boost::weak_ptr<ModelReadiness> > services;
+
+  /// \brief Protects services
+  boost::mutex servicesMutex;
+
+  /// \brief Wall seconds between checks without entity added events
+  const double CHECK_PERIOD = 1.0;
+
+  /// \brief Seconds since this process started, from /proc.
+  /// \return The age, negative if unknown.
+  double GetProcessAge()
+  {
+    std::ifstream uptimeFile("/proc/uptime");
+    double uptime = 0;
+    if (!(uptimeFile >> uptime))
+      return -1;
+
+    // the command name in parentheses may hold spaces, skip past it to the
+    // start time, field 22, in clock ticks since boot
+    std::ifstream statFile("/proc/self/stat");
+    std::string stat;
+    std::getline(statFile, stat);
+    std::string::size_type end = stat.rfind(')');
+    if (end == std::string::npos)
+      return -1;
+    std::istringstream fields(stat.substr(end + 1));
+    std::string field;
+    for (int i = 3; i < 22; ++i)
+      fields >> field;
+    double startTicks = 0;
+    if (!(fields >> startTicks))
+      return -1;
+
+    return uptime - startTicks / sysconf(_SC_CLK_TCK);
+  }
+}
+
+/////////////////////////////////////////////////
+const unsigned int ModelReadiness::NO_WAITER;
+
+/////////////////////////////////////////////////
+ModelReadiness::ModelReadiness(physics::WorldPtr _world)
+  : world(_world), nextId(NO_WAITER + 1), check(false), rosWarned(false)
+{
+  this->startTime = common::Time::GetWallTime();
+  this->lastCheck = this->startTime;
+
+  this->addEntityConnection = event::Events::ConnectAddEntity(
+      boost::bind(&ModelReadiness::OnAddEntity, this, _1));
+  this->updateConnection = event::Events::ConnectWorldUpdateBegin(
+      boost::bind(&ModelReadiness::OnUpdate, this));
+}
+
+/////////////////////////////////////////////////
+ModelReadiness::~ModelReadiness()
+{
+  event::Events::DisconnectWorldUpdateBegin(this->updateConnection);
+  event::Events::DisconnectAddEntity(this->addEntityConnection);
+
+  for (std::map<unsigned int, Waiter>::const_iterator iter =
+       this->waiters.begin(); iter != this->waiters.end(); ++iter)
+  {
+    gzlog << "Model readiness: gave up waiting for ["
+          << iter->second.model << "]\n";
+  }
+}
+
+/////////////////////////////////////////////////
+ModelReadinessPtr ModelReadiness::Get(physics::WorldPtr _world)
+{
+  boost::mutex::scoped_lock lock(servicesMutex);
+  ModelReadinessPtr service = services[_world->GetName()].lock();
+  if (!service)
+  {
+    service.reset(new ModelReadiness(_world));
+    services[_world->GetName()] = service;
+  }
+  return service;
+}
+
+/////////////////////////////////////////////////
+unsigned int ModelReadiness::Connect(const std::string &_model,
+    const std::vector<std::string> &_links, Callback _callback)
+{
+  boost::mutex::scoped_lock lock(this->mutex);
+  unsigned int id = this->nextId++;
+  if (this->nextId == NO_WAITER)
+    ++this->nextId;
+  Waiter &waiter = this->waiters[id];
+  waiter.model = _model;
+  waiter.links = _links;
+  waiter.callback = _callback;
+  waiter.start = common::Time::GetWallTime();
+
+  // the model may be there already
+  this->check = true;
+  return id;
+}
+
+/////////////////////////////////////////////////
+void ModelReadiness::Disconnect(unsigned int _id)
+{
+  boost::mutex::scoped_lock lock(this->mutex);
+  this->waiters.erase(_id);
+}
+
+/////////////////////////////////////////////////
+void ModelReadiness::Report(const std::string &_what) const
+{
+  common::Time now = common::Time::GetWallTime();
+  double age = GetProcessAge();
+  if (age >= 0)
+  {
+    gzmsg << "Model readiness: " << _what << " " << age
+          << " s after gazebo started, "
+          << (now - this->startTime).Double() << " s after the world loaded, "
+          << "at sim time " << this->world->GetSimTime().Double() << "\n";
+  }
+  else
+  {
+    gzmsg << "Model readiness: " << _what << " "
+          << (now - this->startTime).Double() << " s after the world loaded, "
+          << "at sim time " << this->world->GetSimTime().Double() << "\n";
+  }
+}
+
+/////////////////////////////////////////////////
+void ModelReadiness::OnAddEntity(const std::string &/*_name*/)
+{
+  boost::mutex::scoped_lock lock(this->mutex);
+  this->check = true;
+}
+
+/////////////////////////////////////////////////
+void ModelReadiness::OnUpdate()
+{
+  std::vector<std::pair<Waiter, physics::ModelPtr> > ready;
+  {
+    boost::mutex::scoped_lock lock(this->mutex);
+    if (this->waiters.empty())
+      return;
+
+    common::Time now = common::Time::GetWallTime();
+    if (!this->check && (now - this->lastCheck).Double() < CHECK_PERIOD)
+      return;
+    this->check = false;
+    this->lastCheck = now;
+
+    if (!ros::isInitialized())
+    {
+      if (!this->rosWarned)
+      {
+        gzerr << "Model readiness: waiting for ROS to be initialized.  Try "
+              << "starting gazebo with ros plugin:\n"
+              << "  gazebo -s libgazebo_ros_api_plugin.so\n";
+        this->rosWarned = true;
+      }
+      return;
+    }
+
+    for (std::map<unsigned int, Waiter>::iterator iter =
+         this->waiters.begin(); iter != this->waiters.end();)
+    {
+      physics::ModelPtr model = this->world->GetModel(iter->second.model);
+      bool modelReady = false;
+      if (model)
+      {
+        modelReady = true;
+        for (unsigned int i = 0; i < iter->second.links.size(); ++i)
+        {
+          if (!model->GetLink(iter->second.links[i]))
+          {
+            modelReady = false;
+            break;
+          }
+        }
+      }
+
+      if (modelReady)
+      {
+        ready.push_back(std::make_pair(iter->second, model));
+        this->waiters.erase(iter++);
+      }
+      else
+        ++iter;
+    }
+  }
+
+  // callbacks may connect and disconnect
+  for (unsigned int i = 0; i < ready.size(); ++i)
+  {
+    std::ostringstream what;
+    what << "model [" << ready[i].first.model << "] ready, waited "
+         << (common::Time::GetWallTime() - ready[i].first.start).Double()
+         << " s,";
+    this->Report(what.str());
+    ready[i].first.callback(ready[i].second);
+  }
+}
@@ -17,8 +17,11 @@
 
 #include <gazebo/physics/PhysicsTypes.hh>
 #include <gazebo/rendering/Camera.hh>
+#include <gazebo/rendering/ogre_gazebo.h>
 #include <sensor_msgs/Imu.h>
 
+#include <boost/lexical_cast.hpp>
+
 #include "drcsim_gazebo_ros_plugins/MultiSenseSLPlugin.h"
 
 
@@ -46,15 +49,38 @@ MultiSenseSL::MultiSenseSL()
   // change default imager mode to 1 (1Hz ~ 30Hz)
   // in simulation, we are using 800X800 pixels @30Hz
   this->imagerMode = 1;
+  this->pendingImagerMode = -1;
+  this->resolutionChangeCount = 0;
+  this->multiCameraBuffersSized = false;
   this->rosNamespace = "/multisense";
 
+  // rate governor is off unless enabled over the parameter server,
+  // see LoadRateGovernor()
+  this->governorEnabled = false;
+  this->laserUpdateRate = 0;
+  this->cameraUpdateCount = 0;
+  this->laserUpdateCount = 0;
+  // initial guesses of real time factor lost per Hz, refined online;
+  // stereo rendering is assumed an order of magnitude dearer than a scan.
+  this->cameraCost = 0.01;
+  this->laserCost = 0.001;
+  this->lastGovernorStep = 0;
+  this->lastGovernorStepRate = 0;
+  this->lastGovernorRTF = 0;
+
   this->pmq = new PubMultiQueue();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 MultiSenseSL::~MultiSenseSL()
 {
-  event::Events::DisconnectWorldUpdateBegin(this->updateConnection);
+  this->updateConnection.reset();
+  if (this->preRenderConnection)
+    event::Events::DisconnectPreRender(this->preRenderConnection);
+  if (this->multiCameraSensor && this->cameraUpdatedConnection)
+    this->multiCameraSensor->DisconnectUpdated(this->cameraUpdatedConnection);
+  if (this->laserSensor && this->laserUpdatedConnection)
+    this->laserSensor->DisconnectUpdated(this->laserUpdatedConnection);
   delete this->pmq;
   this->rosnode_->shutdown();
   this->queue_.clear();
@@ -125,8 +151,12 @@ void MultiSenseSL::Load(physics::ModelPtr _parent, sdf::ElementPtr _sdf)
   this->multiCameraFrameRate = this->multiCameraSensor->GetUpdateRate();
 
 
-  if (!sensors::SensorManager::Instance()->GetSensor("head_hokuyo_sensor"))
+  this->laserSensor =
+    sensors::SensorManager::Instance()->GetSensor("head_hokuyo_sensor");
+  if (!this->laserSensor)
     gzerr << "laser sensor not found\n";
+  else
+    this->laserUpdateRate = this->laserSensor->GetUpdateRate();
 
   if (!ros::isInitialized())
   {
@@ -213,7 +243,6 @@ void MultiSenseSL::LoadThread()
   this->set_multi_camera_frame_rate_sub_ =
     this->rosnode_->subscribe(set_multi_camera_frame_rate_so);
 
-  /* FIXME currently this causes simulation to crash,
   ros::SubscribeOptions set_multi_camera_resolution_so =
     ros::SubscribeOptions::create<std_msgs::Int32>(
     this->rosNamespace + "/set_camera_resolution_mode", 100,
@@ -223,7 +252,6 @@ void MultiSenseSL::LoadThread()
     ros::VoidPtr(), &this->queue_);
   this->set_multi_camera_resolution_sub_ =
     this->rosnode_->subscribe(set_multi_camera_resolution_so);
-  */
 
   /* not implemented, not supported
   ros::SubscribeOptions set_spindle_state_so =
@@ -283,12 +311,19 @@ void MultiSenseSL::LoadThread()
   this->lastUpdateTime = this->world->GetSimTime().Double();
   this->updateRate = 1.0;
 
+  this->LoadRateGovernor();
+
   // ros callback queue for processing subscription
   this->callback_queue_thread_ = boost::thread(
     boost::bind(&MultiSenseSL::QueueThread, this));
 
-  this->updateConnection = event::Events::ConnectWorldUpdateBegin(
-     boost::bind(&MultiSenseSL::UpdateStates, this));
+  this->updateConnection = DRCUpdateScheduler::Connect("MultiSenseSL",
+     boost::bind(&MultiSenseSL::UpdateStates, this),
+     DRCUpdateAccess().WriteJoint(this->spindleJoint));
+
+  if (this->multiCameraSensor)
+    this->preRenderConnection = event::Events::ConnectPreRender(
+       boost::bind(&MultiSenseSL::ApplyMultiCameraResolution, this));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -359,6 +394,215 @@ void MultiSenseSL::UpdateStates()
     }
     this->pubJointStatesQueue->push(this->jointStates, this->pubJointStates);
   }
+
+  this->UpdateRateGovernor(curTime);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MultiSenseSL::LoadRateGovernor()
+{
+  std::string prefix = this->rosNamespace + "/rate_governor/";
+
+  this->rosnode_->param(prefix + "enable", this->governorEnabled, false);
+  if (!this->governorEnabled)
+    return;
+
+  if (!this->multiCameraSensor || !this->laserSensor)
+  {
+    ROS_WARN("MultiSense SL rate governor needs both the stereo camera and "
+             "the laser sensor, not enabling it.");
+    this->governorEnabled = false;
+    return;
+  }
+
+  this->rosnode_->param(prefix + "target_rtf", this->governorTargetRTF, 0.9);
+  this->rosnode_->param(prefix + "deadband", this->governorDeadband, 0.05);
+  this->rosnode_->param(prefix + "window_size", this->governorWindow, 2.0);
+  this->rosnode_->param(prefix + "step_factor", this->governorStepFactor,
+    0.75);
+  this->rosnode_->param(prefix + "camera_rate_floor", this->cameraRateFloor,
+    1.0);
+  this->rosnode_->param(prefix + "camera_rate_ceiling",
+    this->cameraRateCeiling, this->multiCameraFrameRate);
+  this->rosnode_->param(prefix + "laser_rate_floor", this->laserRateFloor,
+    5.0);
+  this->rosnode_->param(prefix + "laser_rate_ceiling", this->laserRateCeiling,
+    this->laserUpdateRate);
+
+  if (this->governorStepFactor <= 0.0 || this->governorStepFactor >= 1.0)
+  {
+    ROS_WARN("rate_governor/step_factor must be in (0, 1), using 0.75.");
+    this->governorStepFactor = 0.75;
+  }
+  if (this->governorWindow <= 0.0)
+  {
+    ROS_WARN("rate_governor/window_size must be positive, using 2s.");
+    this->governorWindow = 2.0;
+  }
+
+  this->pubRateGovernorQueue =
+    this->pmq->addPub<atlas_msgs::SensorRateGovernor>();
+  this->pubRateGovernor =
+    this->rosnode_->advertise<atlas_msgs::SensorRateGovernor>(
+      this->rosNamespace + "/rate_governor", 10);
+
+  this->cameraUpdatedConnection = this->multiCameraSensor->ConnectUpdated(
+    boost::bind(&MultiSenseSL::OnCameraUpdated, this));
+  this->laserUpdatedConnection = this->laserSensor->ConnectUpdated(
+    boost::bind(&MultiSenseSL::OnLaserUpdated, this));
+
+  this->governorWindowStartSim = this->world->GetSimTime();
+  this->governorWindowStartWall = common::Time::GetWallTime();
+
+  ROS_INFO("MultiSense SL rate governor enabled, target real time factor "
+           "%f, camera [%f, %f] Hz, laser [%f, %f] Hz.",
+           this->governorTargetRTF,
+           this->cameraRateFloor, this->cameraRateCeiling,
+           this->laserRateFloor, this->laserRateCeiling);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MultiSenseSL::OnCameraUpdated()
+{
+  boost::mutex::scoped_lock lock(this->governorMutex);
+  ++this->cameraUpdateCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MultiSenseSL::OnLaserUpdated()
+{
+  boost::mutex::scoped_lock lock(this->governorMutex);
+  ++this->laserUpdateCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MultiSenseSL::UpdateRateGovernor(const common::Time &_curTime)
+{
+  if (!this->governorEnabled)
+    return;
+
+  common::Time wallTime = common::Time::GetWallTime();
+  double wallDt = (wallTime - this->governorWindowStartWall).Double();
+  if (wallDt < this->governorWindow)
+    return;
+
+  double simDt = (_curTime - this->governorWindowStartSim).Double();
+  this->governorWindowStartSim = _curTime;
+  this->governorWindowStartWall = wallTime;
+  // sim time went backwards (world reset), start over
+  if (simDt <= 0.0)
+  {
+    this->lastGovernorStep = 0;
+    return;
+  }
+
+  unsigned int cameraUpdates, laserUpdates;
+  {
+    boost::mutex::scoped_lock lock(this->governorMutex);
+    cameraUpdates = this->cameraUpdateCount;
+    laserUpdates = this->laserUpdateCount;
+    this->cameraUpdateCount = 0;
+    this->laserUpdateCount = 0;
+  }
+
+  double rtf = simDt / wallDt;
+
+  // learn the cost of the sensor we stepped last window from how much the
+  // real time factor moved in response, with a little smoothing.
+  if (this->lastGovernorStep != 0 &&
+      !math::equal(this->lastGovernorStepRate, 0.0))
+  {
+    double cost = (this->lastGovernorRTF - rtf) / this->lastGovernorStepRate;
+    if (cost > 0.0)
+    {
+      double &c = (this->lastGovernorStep == 1) ?
+        this->cameraCost : this->laserCost;
+      c = 0.5 * c + 0.5 * cost;
+    }
+  }
+
+  // hold the lock while stepping, so that a new frame rate or resolution
+  // set over ros can't be overwritten with a rate read before it
+  boost::mutex::scoped_lock rateLock(this->governorMutex);
+  double cameraRate = this->multiCameraSensor->GetUpdateRate();
+  double cameraCeiling =
+    std::min(this->cameraRateCeiling, this->multiCameraFrameRate);
+
+  // estimated share of the real time factor each sensor consumes
+  double cameraLoad = this->cameraCost * cameraRate;
+  double laserLoad = this->laserCost * this->laserUpdateRate;
+
+  // too slow: shed the most expensive sensor first; headroom: restore
+  // the cheapest one first.  Fall back to the other sensor if the first
+  // is already at its limit.
+  double factor = 0;
+  bool cameraFirst = false;
+  if (rtf < this->governorTargetRTF - this->governorDeadband)
+  {
+    factor = this->governorStepFactor;
+    cameraFirst = cameraLoad >= laserLoad;
+  }
+  else if (rtf > this->governorTargetRTF + this->governorDeadband)
+  {
+    factor = 1.0 / this->governorStepFactor;
+    cameraFirst = cameraLoad < laserLoad;
+  }
+
+  std::string decision = "hold";
+  this->lastGovernorStep = 0;
+  this->lastGovernorStepRate = 0;
+  for (int i = 0; i < 2 && factor > 0 && this->lastGovernorStep == 0; ++i)
+  {
+    bool camera = (cameraFirst == (i == 0));
+    double change;
+    if (camera)
+      change = this->StepSensorRate(this->multiCameraSensor, cameraRate,
+        factor, this->cameraRateFloor, cameraCeiling);
+    else
+      change = this->StepSensorRate(this->laserSensor, this->laserUpdateRate,
+        factor, this->laserRateFloor, this->laserRateCeiling);
+
+    if (!math::equal(change, 0.0))
+    {
+      this->lastGovernorStep = camera ? 1 : 2;
+      this->lastGovernorStepRate = change;
+      decision = std::string(camera ? "camera" : "laser") +
+        (factor < 1.0 ? " down" : " up");
+    }
+  }
+  if (factor > 0 && this->lastGovernorStep == 0)
+    decision = (factor < 1.0) ? "at floor" : "at ceiling";
+  this->lastGovernorRTF = rtf;
+
+  atlas_msgs::SensorRateGovernor msg;
+  msg.header.stamp = ros::Time(_curTime.sec, _curTime.nsec);
+  msg.real_time_factor = rtf;
+  msg.target_real_time_factor = this->governorTargetRTF;
+  msg.window_size = wallDt;
+  msg.camera_update_rate = cameraRate;
+  msg.camera_measured_rate = cameraUpdates / simDt;
+  msg.camera_cost = this->cameraCost;
+  msg.laser_update_rate = this->laserUpdateRate;
+  msg.laser_measured_rate = laserUpdates / simDt;
+  msg.laser_cost = this->laserCost;
+  msg.decision = decision;
+  this->pubRateGovernorQueue->push(msg, this->pubRateGovernor);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+double MultiSenseSL::StepSensorRate(sensors::SensorPtr _sensor, double &_rate,
+                                    double _factor, double _floor,
+                                    double _ceiling)
+{
+  double rate = math::clamp(_rate * _factor, _floor, _ceiling);
+  double change = rate - _rate;
+  // ignore steps that round to nothing at a limit
+  if (fabs(change) < 1e-3)
+    return 0;
+
+  _sensor->SetUpdateRate(rate);
+  _rate = rate;
+  return change;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -462,7 +706,19 @@ void MultiSenseSL::SetMultiCameraFrameRate(const std_msgs::Float64::ConstPtr
     ROS_ERROR("MultiSense SL internal state error (%d)", this->imagerMode);
   }
 
-  this->multiCameraSensor->SetUpdateRate(this->multiCameraFrameRate);
+  this->UpdateMultiCameraRate();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MultiSenseSL::UpdateMultiCameraRate()
+{
+  boost::mutex::scoped_lock lock(this->governorMutex);
+  double rate = this->multiCameraFrameRate;
+  // keep the governor's reduction, it raises the rate back up to the new
+  // limit by itself when there is headroom
+  if (this->governorEnabled)
+    rate = std::min(rate, this->multiCameraSensor->GetUpdateRate());
+  this->multiCameraSensor->SetUpdateRate(rate);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -481,58 +737,127 @@ void MultiSenseSL::SetMultiCameraResolution(
     return;
   }
 
+  if (!this->multiCameraSensor)
+    return;
+
   this->imagerMode = _msg->data;
 
-  unsigned int width = 640;
-  unsigned int height = 480;
-  if (this->imagerMode == 0)
+  // limit frame rate to what the new mode is capable of
+  static const double maxFrameRate[] = {15.0, 30.0, 60.0, 70.0};
+  if (this->multiCameraFrameRate > maxFrameRate[this->imagerMode])
   {
-    width = 2048;
-    height = 1088;
-    if (this->multiCameraFrameRate > 15)
-    {
-      ROS_INFO("Reducing frame rate to 15Hz.");
-      this->multiCameraFrameRate = 15.0;
-    }
+    ROS_INFO("Reducing frame rate to %gHz.", maxFrameRate[this->imagerMode]);
+    this->multiCameraFrameRate = maxFrameRate[this->imagerMode];
   }
-  else if (this->imagerMode == 1)
+  this->UpdateMultiCameraRate();
+
+  // Resizing the cameras here, while the rendering thread may be drawing
+  // into them, crashes the simulation.  Defer to the pre-render event.
+  boost::mutex::scoped_lock lock(this->resolutionMutex);
+  this->pendingImagerMode = this->imagerMode;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MultiSenseSL::ApplyMultiCameraResolution()
+{
+  // mode changes wait until the frame buffers fit the largest mode
+  if (!this->multiCameraBuffersSized &&
+      !this->SizeMultiCameraFrameBuffers())
+    return;
+
+  int mode;
   {
-    width = 2048;
-    height = 544;
-    if (this->multiCameraFrameRate > 30)
-    {
-      ROS_INFO("Reducing frame rate to 30Hz.");
-      this->multiCameraFrameRate = 30.0;
-    }
+    boost::mutex::scoped_lock lock(this->resolutionMutex);
+    mode = this->pendingImagerMode;
+    this->pendingImagerMode = -1;
   }
-  else if (this->imagerMode == 2)
+  if (mode < 0)
+    return;
+
+  static const unsigned int widths[] = {2048, 2048, 1024, 640};
+  static const unsigned int heights[] = {1088, 544, 544, 480};
+
+  ++this->resolutionChangeCount;
+  for (unsigned int i = 0; i < this->multiCameraSensor->GetCameraCount(); ++i)
   {
-    width = 1024;
-    height = 544;
-    if (this->multiCameraFrameRate > 60)
-    {
-      ROS_INFO("Reducing frame rate to 60Hz.");
-      this->multiCameraFrameRate = 60.0;
-    }
+    rendering::CameraPtr camera = this->multiCameraSensor->GetCamera(i);
+    if (camera->GetImageWidth() == widths[mode] &&
+        camera->GetImageHeight() == heights[mode])
+      continue;
+
+    this->ResizeMultiCamera(camera, widths[mode], heights[mode]);
   }
-  else if (this->imagerMode == 3)
+  ROS_INFO("MultiSense SL camera resolution set to %dx%d (mode %d).",
+           widths[mode], heights[mode], mode);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool MultiSenseSL::SizeMultiCameraFrameBuffers()
+{
+  // largest imager mode, see SetMultiCameraResolution
+  static const unsigned int maxWidth = 2048;
+  static const unsigned int maxHeight = 1088;
+
+  unsigned int count = this->multiCameraSensor->GetCameraCount();
+  if (count == 0)
+    return false;
+
+  if (this->multiCameraSdfWidths.empty())
   {
-    width = 640;
-    height = 480;
-    if (this->multiCameraFrameRate > 70)
+    ++this->resolutionChangeCount;
+    for (unsigned int i = 0; i < count; ++i)
     {
-      ROS_INFO("Reducing frame rate to 70Hz.");
-      this->multiCameraFrameRate = 70.0;
+      rendering::CameraPtr camera = this->multiCameraSensor->GetCamera(i);
+      this->multiCameraSdfWidths.push_back(camera->GetImageWidth());
+      this->multiCameraSdfHeights.push_back(camera->GetImageHeight());
+      if (camera->GetImageData())
+        gzerr << "MultiSense SL camera " << camera->GetName()
+              << " rendered before its frame buffer could be sized, "
+              << "resolution changes may overflow it.\n";
+      else
+        this->ResizeMultiCamera(camera, maxWidth, maxHeight);
     }
   }
 
-  this->multiCameraSensor->SetUpdateRate(this->multiCameraFrameRate);
+  // GetImageData is the frame buffer, allocated at the first frame
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    if (!this->multiCameraSensor->GetCamera(i)->GetImageData())
+      return false;
+  }
 
-  for (unsigned int i = 0; i < this->multiCameraSensor->GetCameraCount(); ++i)
+  ++this->resolutionChangeCount;
+  for (unsigned int i = 0; i < count; ++i)
   {
-    this->multiCameraSensor->GetCamera(i)->SetImageWidth(width);
-    this->multiCameraSensor->GetCamera(i)->SetImageHeight(height);
+    rendering::CameraPtr camera = this->multiCameraSensor->GetCamera(i);
+    if (camera->GetImageWidth() != this->multiCameraSdfWidths[i] ||
+        camera->GetImageHeight() != this->multiCameraSdfHeights[i])
+    {
+      this->ResizeMultiCamera(camera, this->multiCameraSdfWidths[i],
+        this->multiCameraSdfHeights[i]);
+    }
   }
+  this->multiCameraBuffersSized = true;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MultiSenseSL::ResizeMultiCamera(rendering::CameraPtr _camera,
+                                     unsigned int _width,
+                                     unsigned int _height)
+{
+  _camera->SetImageWidth(_width);
+  _camera->SetImageHeight(_height);
+
+  // reallocate the render target at the new size, once per change.  The
+  // camera moves its viewport to the new texture, only then can the old
+  // one be freed.  The frame buffer already fits, see
+  // SizeMultiCameraFrameBuffers.
+  Ogre::Texture *oldTexture = _camera->GetRenderTexture();
+  _camera->CreateRenderTexture(_camera->GetName() + "_RttTex_mode" +
+    boost::lexical_cast<std::string>(this->resolutionChangeCount));
+  if (oldTexture)
+    Ogre::TextureManager::getSingleton().remove(oldTexture->getName());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -56,7 +56,7 @@ RobotiqHandPlugin::RobotiqHandPlugin()
 ////////////////////////////////////////////////////////////////////////////////
 RobotiqHandPlugin::~RobotiqHandPlugin()
 {
-  gazebo::event::Events::DisconnectWorldUpdateBegin(this->updateConnection);
+  this->updateConnection.reset();
   this->rosNode->shutdown();
   this->rosQueue.clear();
   this->rosQueue.disable();
@@ -188,8 +188,9 @@ void RobotiqHandPlugin::Load(gazebo::physics::ModelPtr _parent,
 
   // Connect to gazebo world update.
   this->updateConnection =
-    gazebo::event::Events::ConnectWorldUpdateBegin(
-      boost::bind(&RobotiqHandPlugin::UpdateStates, this));
+    gazebo::DRCUpdateScheduler::Connect("RobotiqHandPlugin " + this->side,
+      boost::bind(&RobotiqHandPlugin::UpdateStates, this),
+      gazebo::DRCUpdateAccess().WriteJoints(this->fingerJoints));
 
   // Log information.
   gzlog << "RobotiqHandPlugin loaded for " << this->side << " hand."
@@ -34,6 +34,7 @@ SandiaHandPlugin::SandiaHandPlugin()
 {
   this->hasStumps = false;
   this->tactileConnectCount = 0;
+  this->contactDemuxId = 0;
   this->pmq = new PubMultiQueue();
   this->rosNode = NULL;
 }
@@ -42,7 +43,9 @@ SandiaHandPlugin::SandiaHandPlugin()
 // Destructor
 SandiaHandPlugin::~SandiaHandPlugin()
 {
-  event::Events::DisconnectWorldUpdateBegin(this->updateConnection);
+  this->updateConnection.reset();
+  if (this->contactDemux)
+    this->contactDemux->Disconnect(this->contactDemuxId);
   delete this->pmq;
   this->rosNode->shutdown();
   this->rosQueue.clear();
@@ -269,13 +272,30 @@ void SandiaHandPlugin::Load(physics::ModelPtr _parent,
     this->fingerHorSize[1] = 3;
     this->fingerVerSize[1] = 4;
 
-    this->node.reset(new transport::Node());
-    this->node->Init(this->world->GetName());
+    // Receive the contacts of the finger and palm collisions from the
+    // world's contact demux, which shares one contact manager filter
+    // between all the plugins that need contacts.
+    std::vector<std::string> contactCollisionNames;
+    physics::Link_V links = this->model->GetLinks();
+    for (unsigned int i = 0; i < links.size(); ++i)
+    {
+      for (unsigned int j = 0; j < links[i]->GetChildCount(); ++j)
+      {
+        physics::CollisionPtr collision =
+          boost::dynamic_pointer_cast<physics::Collision>(
+          links[i]->GetChild(j));
+        if (!collision)
+          continue;
+        std::string name = collision->GetScopedName();
+        if (name.find(this->side + "_f") != std::string::npos ||
+            name.find("palm") != std::string::npos)
+          contactCollisionNames.push_back(name);
+      }
+    }
 
-    std::string modelName = this->model->GetName();
-    this->contactSub =
-        this->node->Subscribe("~/" + modelName + "/contact",
-        &SandiaHandPlugin::OnContacts, this);
+    this->contactDemux = ContactDemux::Get(this->world);
+    this->contactDemuxId = this->contactDemux->Connect(contactCollisionNames,
+        boost::bind(&SandiaHandPlugin::OnContacts, this, _1));
   }
 
   // \todo: add ros topic / service to reset imu (imuReferencePose, etc.)
@@ -404,8 +424,9 @@ void SandiaHandPlugin::DeferredLoad()
   this->callbackQueeuThread = boost::thread(
     boost::bind(&SandiaHandPlugin::RosQueueThread, this));
 
-  this->updateConnection = event::Events::ConnectWorldUpdateBegin(
-     boost::bind(&SandiaHandPlugin::UpdateStates, this));
+  this->updateConnection = DRCUpdateScheduler::Connect("SandiaHandPlugin",
+     boost::bind(&SandiaHandPlugin::UpdateStates, this),
+     DRCUpdateAccess().WriteJoints(this->joints));
 
   // Offer teams ability to change damping coef. between preset bounds
   ros::AdvertiseServiceOptions setJointDampingAso =
@@ -628,12 +649,12 @@ void SandiaHandPlugin::RosQueueThread()
 }
 
 //////////////////////////////////////////////////
-void SandiaHandPlugin::OnContacts(ConstContactsPtr &_msg)
+void SandiaHandPlugin::OnContacts(const ContactView &_view)
 {
   boost::mutex::scoped_lock lock(this->contactMutex);
 
-  // Store the contacts message for processing in UpdateImpl
-  this->incomingContacts.push_back(_msg);
+  // Store the contacts for processing in UpdateImpl
+  this->incomingContacts.push_back(_view);
 
   // Prevent the incomingContacts list to grow indefinitely.
   if (this->incomingContacts.size() > 50)
@@ -657,27 +678,20 @@ void SandiaHandPlugin::FillTactileData(ContactMsgs_L _incomingContacts,
   // Don't do anything if there is no new data to process.
   if (!_incomingContacts.empty())
   {
-    std::vector<std::string>::iterator collIter;
     std::string collision1;
 
     // Iterate over all the contact messages
     for (ContactMsgs_L::iterator iter = _incomingContacts.begin();
         iter != _incomingContacts.end(); ++iter)
     {
-      // Iterate over all the contacts in the message
-      for (int i = 0; i < (*iter)->contact_size(); ++i)
+      // Iterate over the hand's contacts in the message
+      for (unsigned int i = 0; i < iter->GetContactCount(); ++i)
       {
+        const msgs::Contact &contact = iter->GetContact(i);
         bool isPalm = false;
-        bool isBody1 = true;
         // Get the collision pointer from name in contact msg
-        collision1 = (*iter)->contact(i).collision1();
-
-        if (collision1.find(this->side + "_f") ==  std::string::npos
-            && collision1.find("palm") ==  std::string::npos)
-        {
-          collision1 = (*iter)->contact(i).collision2();
-          isBody1 = false;
-        }
+        bool isBody1 = iter->IsFirst(i);
+        collision1 = isBody1 ? contact.collision1() : contact.collision2();
 
         physics::Collision *col = NULL;
         if (!this->contactCollisions.count(collision1))
@@ -747,17 +761,17 @@ void SandiaHandPlugin::FillTactileData(ContactMsgs_L _incomingContacts,
         math::Vector3 force;
         int tactileOuput = 0;
         // Iterate all contact positions
-        for (int j = 0; j < (*iter)->contact(i).position_size(); ++j)
+        for (int j = 0; j < contact.position_size(); ++j)
         {
-          pos = msgs::Convert((*iter)->contact(i).position(j));
+          pos = msgs::Convert(contact.position(j));
           if (isBody1)
           {
-            force = msgs::Convert((*iter)->contact(i).wrench(j).
+            force = msgs::Convert(contact.wrench(j).
                 body_1_wrench().force());
           }
           else
           {
-            force = msgs::Convert((*iter)->contact(i).wrench(j).
+            force = msgs::Convert(contact.wrench(j).
                 body_2_wrench().force());
           }
 
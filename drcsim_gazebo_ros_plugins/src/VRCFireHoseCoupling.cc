@@ -0,0 +1,319 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <gazebo/common/common.hh>
+#include <gazebo/physics/physics.hh>
+#include "drcsim_gazebo_ros_plugins/VRCFireHoseCoupling.hh"
+
+#include <map>
+#include <string>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/weak_ptr.hpp>
+
+using namespace gazebo;
+
+namespace
+{
+  /// \brief Couplings by world name
+  std::map<std::string, boost::weak_ptr<VRCFireHoseCoupling> > couplings;
+
+  /// \brief Protects couplings
+  boost::mutex couplingsMutex;
+}
+
+/////////////////////////////////////////////////
+VRCFireHoseCoupling::VRCFireHoseCoupling()
+  : threadPitch(0.0), collisionSurfaceZOffset(0.0),
+    broadPhaseDistanceSquared(0.0), threaded(false), threadTravel(0.0),
+    updated(false), isLoaded(false)
+{
+}
+
+/////////////////////////////////////////////////
+VRCFireHoseCoupling::~VRCFireHoseCoupling()
+{
+}
+
+/////////////////////////////////////////////////
+bool VRCFireHoseCoupling::Load(physics::WorldPtr _world,
+                               sdf::ElementPtr _sdf)
+{
+  this->isLoaded = false;
+
+  std::string fireHoseModelName = _sdf->Get<std::string>("fire_hose_model");
+  this->fireHoseModel = _world->GetModel(fireHoseModelName);
+  if (!this->fireHoseModel)
+  {
+    gzerr << "fire_hose_model [" << fireHoseModelName << "] not found"
+          << std::endl;
+    return false;
+  }
+
+  std::string couplingLinkName = _sdf->Get<std::string>("coupling_link");
+  this->couplingLink = this->fireHoseModel->GetLink(couplingLinkName);
+  if (!this->couplingLink)
+  {
+    gzerr << "coupling link [" << couplingLinkName << "] not found"
+          << std::endl;
+    return false;
+  }
+
+  std::string standpipeModelName = _sdf->Get<std::string>("standpipe_model");
+  physics::ModelPtr standpipeModel = _world->GetModel(standpipeModelName);
+  if (!standpipeModel)
+  {
+    gzerr << "standpipe model [" << standpipeModelName << "] not found"
+          << std::endl;
+    return false;
+  }
+
+  std::string spoutLinkName = _sdf->Get<std::string>("spout_link");
+  this->spoutLink = standpipeModel->GetLink(spoutLinkName);
+  if (!this->spoutLink)
+  {
+    gzerr << "spout link [" << spoutLinkName << "] not found" << std::endl;
+    return false;
+  }
+
+  // The valve is optional, it only keeps the hose from being attached
+  // while the water is running.
+  std::string valveModelName = "valve";
+  if (_sdf->HasElement("valve_model"))
+    valveModelName = _sdf->Get<std::string>("valve_model");
+  std::string valveJointName = "valve";
+  if (_sdf->HasElement("valve_joint"))
+    valveJointName = _sdf->Get<std::string>("valve_joint");
+  physics::ModelPtr valveModel = _world->GetModel(valveModelName);
+  if (valveModel)
+    this->valveJoint = valveModel->GetJoint(valveJointName);
+  if (!this->valveJoint)
+  {
+    gzwarn << "valve joint [" << valveModelName << "::" << valveJointName
+           << "] not found" << std::endl;
+  }
+
+  this->threadPitch = _sdf->Get<double>("thread_pitch");
+  this->couplingRelativePose =
+    _sdf->Get<gazebo::math::Pose>("coupling_relative_pose");
+
+  // surface of the coupling cylinder is -0.135m from link origin
+  physics::CollisionPtr col = this->couplingLink->GetCollision("attachment_col");
+  boost::shared_ptr<physics::CylinderShape> cylinder;
+  if (col)
+    cylinder = boost::dynamic_pointer_cast<physics::CylinderShape>(
+      col->GetShape());
+  if (!cylinder)
+  {
+    gzerr << "coupling link [" << couplingLinkName
+          << "] has no cylinder attachment_col" << std::endl;
+    return false;
+  }
+  this->collisionSurfaceZOffset =
+    col->GetRelativePose().pos.x - cylinder->GetLength()/2;
+
+  // Threading can't start unless the coupling and spout origins are about
+  // as far apart as they are when lined up.
+  double broadPhaseDistance = 0.1;
+  if (_sdf->HasElement("broad_phase_distance"))
+    broadPhaseDistance = _sdf->Get<double>("broad_phase_distance");
+  broadPhaseDistance += this->couplingRelativePose.pos.GetLength() +
+    fabs(this->collisionSurfaceZOffset);
+  this->broadPhaseDistanceSquared = broadPhaseDistance * broadPhaseDistance;
+
+  this->Reset();
+  this->isLoaded = true;
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool VRCFireHoseCoupling::IsLoaded() const
+{
+  return this->isLoaded;
+}
+
+/////////////////////////////////////////////////
+void VRCFireHoseCoupling::Register(const std::string &_worldName,
+                                   VRCFireHoseCouplingPtr _coupling)
+{
+  boost::mutex::scoped_lock lock(couplingsMutex);
+  couplings[_worldName] = _coupling;
+}
+
+/////////////////////////////////////////////////
+VRCFireHoseCouplingPtr VRCFireHoseCoupling::Find(
+  const std::string &_worldName)
+{
+  boost::mutex::scoped_lock lock(couplingsMutex);
+  std::map<std::string, boost::weak_ptr<VRCFireHoseCoupling> >::iterator
+    iter = couplings.find(_worldName);
+  if (iter == couplings.end())
+    return VRCFireHoseCouplingPtr();
+  return iter->second.lock();
+}
+
+/////////////////////////////////////////////////
+bool VRCFireHoseCoupling::CanStartThread(
+  const math::Pose &_couplingPose) const
+{
+  if (!this->isLoaded)
+    return false;
+
+  math::Pose spoutPose = this->spoutLink->GetWorldPose();
+
+  // Broad phase: most of the time the hose is nowhere near the standpipe
+  if ((_couplingPose.pos - spoutPose.pos).GetSquaredLength() >
+      this->broadPhaseDistanceSquared)
+    return false;
+
+  const math::Pose &connectPose = this->couplingRelativePose;
+
+  math::Pose relativePose =
+    (math::Pose(this->collisionSurfaceZOffset, 0, 0, 0, 0, 0) +
+     _couplingPose) - spoutPose;
+
+  double posErrInsert = relativePose.pos.z - connectPose.pos.z +
+    this->collisionSurfaceZOffset;
+  double posErrCenter = fabs(relativePose.pos.x - connectPose.pos.x) +
+                        fabs(relativePose.pos.y - connectPose.pos.y);
+  double rotErr = (relativePose.rot.GetXAxis() -
+                   connectPose.rot.GetXAxis()).GetLength();
+  double valveAng = 0;
+  if (this->valveJoint)
+    valveAng = this->valveJoint->GetAngle(0).Radian();
+
+  // The valve must not be opened, because the water rushing out would
+  // prevent you from attaching a hose.  This check also prevents
+  // out-of-order execution that would confuse scoring.
+  return posErrInsert > 0.0 && posErrCenter < 0.003 &&
+    rotErr < 0.05 && valveAng > -0.1;
+}
+
+/////////////////////////////////////////////////
+bool VRCFireHoseCoupling::Update(const common::Time &_simTime)
+{
+  if (!this->isLoaded)
+    return false;
+
+  if (this->updated && _simTime == this->lastUpdateTime)
+    return this->threaded;
+  this->updated = true;
+  this->lastUpdateTime = _simTime;
+
+  math::Pose couplingPose = this->couplingLink->GetWorldPose();
+  if (!this->threaded)
+  {
+    if (this->CanStartThread(couplingPose))
+    {
+      this->threaded = true;
+      this->threadStartPose = couplingPose;
+      this->threadTravel = 0.0;
+      this->threadChanged(true);
+    }
+  }
+  else
+  {
+    math::Vector3 travel = this->threadStartPose.rot.GetInverse().RotateVector(
+      couplingPose.pos - this->threadStartPose.pos);
+    this->threadTravel = travel.x;
+
+    // check joint position to disconnect
+    double position;
+    if (this->screwJoint)
+      position = this->screwJoint->GetAngle(0).Radian();
+    else
+      position = this->threadPitch * travel.x;
+    if (position < -0.0003)
+    {
+      this->threaded = false;
+      this->screwJoint.reset();
+      this->threadChanged(false);
+    }
+  }
+  return this->threaded;
+}
+
+/////////////////////////////////////////////////
+bool VRCFireHoseCoupling::IsThreaded() const
+{
+  return this->threaded;
+}
+
+/////////////////////////////////////////////////
+double VRCFireHoseCoupling::GetThreadTravel() const
+{
+  return this->threadTravel;
+}
+
+/////////////////////////////////////////////////
+void VRCFireHoseCoupling::SetScrewJoint(physics::JointPtr _joint)
+{
+  this->screwJoint = _joint;
+}
+
+/////////////////////////////////////////////////
+void VRCFireHoseCoupling::Reset()
+{
+  this->threaded = false;
+  this->threadTravel = 0.0;
+  this->screwJoint.reset();
+  this->updated = false;
+}
+
+/////////////////////////////////////////////////
+event::ConnectionPtr VRCFireHoseCoupling::ConnectThreadChanged(
+  const boost::function<void (bool)> &_subscriber)
+{
+  return this->threadChanged.Connect(_subscriber);
+}
+
+/////////////////////////////////////////////////
+void VRCFireHoseCoupling::DisconnectThreadChanged(
+  event::ConnectionPtr _connection)
+{
+  this->threadChanged.Disconnect(_connection);
+}
+
+/////////////////////////////////////////////////
+physics::ModelPtr VRCFireHoseCoupling::GetFireHoseModel() const
+{
+  return this->fireHoseModel;
+}
+
+/////////////////////////////////////////////////
+physics::LinkPtr VRCFireHoseCoupling::GetCouplingLink() const
+{
+  return this->couplingLink;
+}
+
+/////////////////////////////////////////////////
+physics::LinkPtr VRCFireHoseCoupling::GetSpoutLink() const
+{
+  return this->spoutLink;
+}
+
+/////////////////////////////////////////////////
+physics::JointPtr VRCFireHoseCoupling::GetValveJoint() const
+{
+  return this->valveJoint;
+}
+
+/////////////////////////////////////////////////
+double VRCFireHoseCoupling::GetThreadPitch() const
+{
+  return this->threadPitch;
+}
@@ -15,11 +15,20 @@
  *
 */
 
+#include <algorithm>
+#include <fstream>
+#include <iterator>
 #include <map>
+#include <sstream>
 #include <string>
+#include <vector>
 #include <stdlib.h>
 
 #include <angles/angles.h>
+#include <ros/serialization.h>
+#include <sdf/sdf.hh>
+#include <atlas_msgs/GetAtlasControllerState.h>
+#include <atlas_msgs/SetAtlasControllerState.h>
 #include <gazebo/transport/transport.hh>
 #include <gazebo/physics/CylinderShape.hh>
 #include "drcsim_gazebo_ros_plugins/VRCPlugin.h"
@@ -34,18 +43,35 @@ VRCPlugin::VRCPlugin()
 {
   /// initial anchor pose
   this->warpRobotWithCmdVel = false;
+  this->fastTravelActive = false;
+  this->fastTravelRequested = false;
+  this->haveSnapshot = false;
+  this->startupSnapshotPending = false;
+  this->snapshotJob = NULL;
+  this->pmq = new PubMultiQueue();
   this->rosNode = NULL;
+  this->atlasReadyId = ModelReadiness::NO_WAITER;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // Destructor
 VRCPlugin::~VRCPlugin()
 {
-  event::Events::DisconnectWorldUpdateBegin(this->updateConnection);
+  if (this->readiness && this->atlasReadyId != ModelReadiness::NO_WAITER)
+    this->readiness->Disconnect(this->atlasReadyId);
+  this->updateConnection.reset();
+  if (this->drcFireHose.coupling)
+  {
+    this->drcFireHose.coupling->DisconnectThreadChanged(
+      this->drcFireHose.threadConnection);
+  }
+  delete this->pmq;
   this->rosNode->shutdown();
   this->rosQueue.clear();
   this->rosQueue.disable();
   this->callbackQueueThread.join();
+  if (this->startupSnapshotThread.joinable())
+    this->startupSnapshotThread.join();
   delete this->rosNode;
 }
 
@@ -56,6 +82,7 @@ void VRCPlugin::Load(physics::WorldPtr _parent, sdf::ElementPtr _sdf)
   // save pointers
   this->world = _parent;
   this->sdf = _sdf;
+  this->readiness = ModelReadiness::Get(this->world);
 
   // By default, cheats are off.  Allow override via environment variable.
   char* cheatsEnabledString = getenv("VRC_CHEATS_ENABLED");
@@ -86,6 +113,9 @@ void VRCPlugin::DeferredLoad()
   // ros stuff
   this->rosNode = new ros::NodeHandle("");
 
+  // publish multi queue
+  this->pmq->startServiceThread();
+
   // load VRC ROS API
   this->LoadVRCROSAPI();
 
@@ -98,6 +128,12 @@ void VRCPlugin::DeferredLoad()
 
   // Load fire hose and standpipe
   this->drcFireHose.Load(this->world, this->sdf);
+  if (this->drcFireHose.isInitialized)
+  {
+    this->drcFireHose.threadConnection =
+      this->drcFireHose.coupling->ConnectThreadChanged(
+        boost::bind(&VRCPlugin::OnFireHoseThreadChanged, this, _1));
+  }
 
   // Setup ROS interfaces for robot
   this->LoadRobotROSAPI();
@@ -122,8 +158,10 @@ void VRCPlugin::DeferredLoad()
   // Mechanism for Updating every World Cycle
   // Listen to the update event. This event is broadcast every
   // simulation iteration.
-  this->updateConnection = event::Events::ConnectWorldUpdateBegin(
-     boost::bind(&VRCPlugin::UpdateStates, this));
+  // UpdateStates moves and pins models, nothing runs with it
+  this->updateConnection = DRCUpdateScheduler::Connect("VRCPlugin",
+     boost::bind(&VRCPlugin::UpdateStates, this),
+     DRCUpdateAccess().Exclusive());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -176,17 +214,15 @@ void VRCPlugin::UnpinAtlas()
 ////////////////////////////////////////////////////////////////////////////////
 void VRCPlugin::SetFeetCollide(const std::string &_mode)
 {
-  physics::LinkPtr l_foot_link = this->atlas.model->GetLink("l_foot");
-  if (!l_foot_link)
+  if (!this->atlas.lFootLink)
     ROS_WARN("Couldn't find l_foot link when setting collide mode");
   else
-    l_foot_link->SetCollideMode(_mode);
+    this->atlas.lFootLink->SetCollideMode(_mode);
 
-  physics::LinkPtr r_foot_link = this->atlas.model->GetLink("r_foot");
-  if (!r_foot_link)
+  if (!this->atlas.rFootLink)
     ROS_WARN("Couldn't find r_foot link when setting collide mode");
   else
-    r_foot_link->SetCollideMode(_mode);
+    this->atlas.rFootLink->SetCollideMode(_mode);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -214,8 +250,10 @@ void VRCPlugin::SetRobotMode(const std::string &_str)
     this->warpRobotWithCmdVel = false;
 
     this->atlas.model->SetGravityMode(false);
-    this->atlas.model->GetLink("l_foot")->SetGravityMode(true);
-    this->atlas.model->GetLink("r_foot")->SetGravityMode(true);
+    if (this->atlas.lFootLink)
+      this->atlas.lFootLink->SetGravityMode(true);
+    if (this->atlas.rFootLink)
+      this->atlas.rFootLink->SetGravityMode(true);
 
     if (this->atlas.pinJoint)
       this->RemoveJoint(this->atlas.pinJoint);
@@ -586,6 +624,512 @@ void VRCPlugin::SetRobotCmdVel(const geometry_msgs::Twist::ConstPtr &_cmd,
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void VRCPlugin::SetRobotFastTravel(
+  const geometry_msgs::PoseArray::ConstPtr &_waypoints)
+{
+  if (this->atlas.startupSequence != Robot::INITIALIZED)
+  {
+    ROS_WARN("atlas/fast_travel ignored, robot is not initialized yet.");
+    return;
+  }
+
+  boost::mutex::scoped_lock lock(this->fastTravelMutex);
+  this->fastTravelRequest.clear();
+  for (unsigned int i = 0; i < _waypoints->poses.size(); ++i)
+  {
+    const geometry_msgs::Pose &p = _waypoints->poses[i];
+    math::Quaternion q(p.orientation.w, p.orientation.x,
+                       p.orientation.y, p.orientation.z);
+    q.Normalize();
+    this->fastTravelRequest.push_back(math::Pose(
+      math::Vector3(p.position.x, p.position.y, p.position.z), q));
+  }
+  this->fastTravelRequested = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void VRCPlugin::UpdateFastTravel()
+{
+  // pick up a new request from the ros callback thread
+  {
+    boost::mutex::scoped_lock lock(this->fastTravelMutex);
+    if (this->fastTravelRequested)
+    {
+      this->fastTravelRequested = false;
+      this->fastTravelWaypoints = this->fastTravelRequest;
+      this->fastTravelRequest.clear();
+
+      if (!this->fastTravelActive && !this->fastTravelWaypoints.empty())
+      {
+        ROS_INFO("Fast travel through %lu waypoints at %fx real time.",
+          this->fastTravelWaypoints.size(), this->fastTravelRealTimeMultiple);
+        // stop warping and freeze the robot: kinematic links have no
+        // dynamics, hold their configuration, and AtlasPlugin stops
+        // controlling them.  The rest of the world keeps simulating.
+        this->warpRobotWithCmdVel = false;
+        if (this->vehicleRobotJoint)
+          this->RemoveJoint(this->vehicleRobotJoint);
+        if (this->atlas.pinJoint)
+          this->RemoveJoint(this->atlas.pinJoint);
+        this->SetAtlasKinematic(true);
+        this->fastTravelActive = true;
+      }
+      this->fastTravelSegmentStart = this->atlas.pinLink->GetWorldPose();
+      this->fastTravelLastWallTime = common::Time::GetWallTime();
+    }
+  }
+
+  if (!this->fastTravelActive)
+    return;
+
+  common::Time wallTime = common::Time::GetWallTime();
+  double step = this->fastTravelSpeed * this->fastTravelRealTimeMultiple *
+    (wallTime - this->fastTravelLastWallTime).Double();
+  this->fastTravelLastWallTime = wallTime;
+
+  // walk along the path in the plane, possibly past several waypoints
+  math::Pose pose = this->atlas.pinLink->GetWorldPose();
+  double yaw = pose.rot.GetAsEuler().z;
+  while (step > 0 && !this->fastTravelWaypoints.empty())
+  {
+    const math::Pose &goal = this->fastTravelWaypoints.front();
+    double goalYaw = goal.rot.GetAsEuler().z;
+    math::Vector3 d = goal.pos - pose.pos;
+    d.z = 0;
+    double dist = d.GetLength();
+    if (dist <= step)
+    {
+      pose.pos.x = goal.pos.x;
+      pose.pos.y = goal.pos.y;
+      yaw = goalYaw;
+      step -= dist;
+      this->fastTravelWaypoints.pop_front();
+      this->fastTravelSegmentStart = math::Pose(pose.pos,
+        math::Quaternion(0, 0, yaw));
+    }
+    else
+    {
+      pose.pos += d * (step / dist);
+      // turn towards the waypoint heading over the length of the segment
+      math::Vector3 seg = goal.pos - this->fastTravelSegmentStart.pos;
+      seg.z = 0;
+      double startYaw = this->fastTravelSegmentStart.rot.GetAsEuler().z;
+      double s = 1.0 - (dist - step) / std::max(seg.GetLength(), dist);
+      yaw = startYaw + s * angles::shortest_angular_distance(startYaw, goalYaw);
+      step = 0;
+    }
+  }
+  // stay upright
+  pose.rot.SetFromEuler(0, 0, yaw);
+  this->atlas.model->SetLinkWorldPose(pose, this->atlas.pinLink);
+
+  if (this->fastTravelWaypoints.empty())
+  {
+    ROS_INFO("Fast travel arrived, standing robot up.");
+    this->fastTravelActive = false;
+    this->SetAtlasKinematic(false);
+    this->atlas.model->ResetPhysicsStates();
+
+    // set the robot down on whatever is below it, then re-run the startup
+    // sequence to get back to a settled stand.
+    this->SetRobotMode("harnessed");
+    this->atlas.bdiStandSequence = Robot::BS_NONE;
+    this->atlas.pinnedSequence = Robot::PS_NONE;
+    this->atlas.restartAfterFastTravel = true;
+    this->atlas.startupSequence = Robot::INIT_MODEL_SUCCESS;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void VRCPlugin::SetAtlasKinematic(bool _kinematic)
+{
+  const physics::Link_V &links = this->atlas.model->GetLinks();
+  for (physics::Link_V::const_iterator li = links.begin(); li != links.end();
+       ++li)
+  {
+    (*li)->SetKinematic(_kinematic);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool VRCPlugin::SaveSnapshot(atlas_msgs::SaveSnapshot::Request &_req,
+  atlas_msgs::SaveSnapshot::Response &_res)
+{
+  SnapshotJob job;
+  job.restore = false;
+  job.startup = false;
+  _res.success = this->RunSnapshotJob(job);
+  _res.status_message = job.status;
+
+  if (_res.success)
+  {
+    {
+      boost::mutex::scoped_lock lock(this->snapshotMutex);
+      this->snapshot = job.snapshot;
+      this->haveSnapshot = true;
+    }
+
+    if (!_req.filename.empty())
+      _res.success = this->WriteSnapshotFile(_req.filename, job.snapshot,
+        _res.status_message);
+  }
+
+  if (_res.success)
+    _res.status_message = "success";
+  else
+    ROS_ERROR("save_snapshot: %s", _res.status_message.c_str());
+  return _res.success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool VRCPlugin::RestoreSnapshot(atlas_msgs::RestoreSnapshot::Request &_req,
+  atlas_msgs::RestoreSnapshot::Response &_res)
+{
+  SnapshotJob job;
+  job.restore = true;
+  job.startup = false;
+  _res.success = true;
+
+  if (!_req.filename.empty())
+  {
+    _res.success = this->ReadSnapshotFile(_req.filename, job.snapshot,
+      _res.status_message);
+  }
+  else
+  {
+    boost::mutex::scoped_lock lock(this->snapshotMutex);
+    if (this->haveSnapshot)
+      job.snapshot = this->snapshot;
+    else
+    {
+      _res.success = false;
+      _res.status_message = "no snapshot saved";
+    }
+  }
+
+  if (_res.success)
+  {
+    _res.success = this->RunSnapshotJob(job);
+    _res.status_message = job.status;
+  }
+
+  if (_res.success)
+    _res.status_message = "success";
+  else
+    ROS_ERROR("restore_snapshot: %s", _res.status_message.c_str());
+  return _res.success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool VRCPlugin::RunSnapshotJob(SnapshotJob &_job)
+{
+  _job.success = false;
+  _job.done = false;
+
+  boost::mutex::scoped_lock lock(this->snapshotJobMutex);
+
+  // one job at a time
+  while (this->snapshotJob)
+  {
+    if (!this->rosNode->ok())
+    {
+      _job.status = "shutting down";
+      return false;
+    }
+    this->snapshotJobDone.timed_wait(lock,
+      boost::posix_time::milliseconds(100));
+  }
+  this->snapshotJob = &_job;
+
+  while (!_job.done)
+  {
+    // a running job holds the lock until done, so this one hasn't started
+    if (!this->rosNode->ok())
+    {
+      this->snapshotJob = NULL;
+      _job.status = "shutting down";
+      return false;
+    }
+
+    // jobs run at the start of a world update, step a paused world once.
+    // World::Step waits for the step, let the job take the lock meanwhile.
+    if (!_job.startup && this->world->IsPaused())
+    {
+      lock.unlock();
+      this->world->Step(1);
+      lock.lock();
+    }
+    else
+    {
+      this->snapshotJobDone.timed_wait(lock,
+        boost::posix_time::milliseconds(100));
+    }
+  }
+  return _job.success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void VRCPlugin::UpdateSnapshotJob()
+{
+  boost::mutex::scoped_lock lock(this->snapshotJobMutex);
+  if (!this->snapshotJob)
+    return;
+
+  SnapshotJob &job = *this->snapshotJob;
+  if (!job.restore)
+    job.success = this->CaptureSnapshot(job.snapshot, job.status);
+  else if (!job.startup &&
+           (this->atlas.startupSequence < Robot::INIT_MODEL_SUCCESS ||
+            this->startupSnapshotPending || this->fastTravelActive))
+  {
+    job.success = false;
+    job.status = "robot is not ready to be restored";
+  }
+  else
+    job.success = this->ApplySnapshot(job.snapshot, job.status);
+
+  if (job.startup)
+    this->startupSnapshotPending = false;
+
+  job.done = true;
+  this->snapshotJob = NULL;
+  this->snapshotJobDone.notify_all();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool VRCPlugin::CaptureSnapshot(atlas_msgs::VRCSnapshot &_snapshot,
+  std::string &_status)
+{
+  if (this->atlas.startupSequence < Robot::INIT_MODEL_SUCCESS ||
+      this->startupSnapshotPending || this->fastTravelActive)
+  {
+    _status = "robot is not ready to be captured";
+    return false;
+  }
+
+  if (this->vehicleRobotJoint)
+  {
+    _status = "robot is attached to the vehicle, exit the vehicle first";
+    return false;
+  }
+
+  // the world doesn't step while this runs on its update thread, so world
+  // and controller states agree
+  atlas_msgs::GetAtlasControllerState controllerState;
+  bool success = this->getControllerStateClient.call(controllerState) &&
+    controllerState.response.success;
+
+  if (success)
+  {
+    common::Time simTime = this->world->GetSimTime();
+    _snapshot.header.stamp = ros::Time(simTime.sec, simTime.nsec);
+
+    physics::WorldState worldState(this->world);
+    std::ostringstream stream;
+    stream << worldState;
+    _snapshot.world_state = stream.str();
+
+    _snapshot.pinned = this->atlas.pinJoint ? true : false;
+    _snapshot.gravity = this->atlas.pinLink->GetGravityMode();
+    _snapshot.controller = controllerState.response.state;
+  }
+  else
+  {
+    _status = "unable to get atlas/get_controller_state";
+  }
+
+  return success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool VRCPlugin::ApplySnapshot(const atlas_msgs::VRCSnapshot &_snapshot,
+  std::string &_status)
+{
+  // same wrapping World uses to read <state> elements back from a log
+  sdf::ElementPtr stateElem(new sdf::Element);
+  sdf::initFile("state.sdf", stateElem);
+  std::string data = std::string("<sdf version='") + SDF_VERSION + "'>" +
+    _snapshot.world_state + "</sdf>";
+  if (!sdf::readString(data, stateElem))
+  {
+    _status = "unable to parse snapshot world state";
+    return false;
+  }
+
+  physics::WorldState worldState;
+  worldState.Load(stateElem);
+
+  if (!worldState.HasModelState(this->atlas.model->GetName()))
+  {
+    _status = "snapshot does not contain model [" +
+      this->atlas.model->GetName() + "]";
+    return false;
+  }
+
+  // drop constraints made since the snapshot, the pin is put back below
+  // at the restored pose
+  this->warpRobotWithCmdVel = false;
+  if (this->atlas.pinJoint)
+    this->RemoveJoint(this->atlas.pinJoint);
+  if (this->grabJoint)
+    this->RemoveJoint(this->grabJoint);
+  if (this->vehicleRobotJoint)
+    this->RemoveJoint(this->vehicleRobotJoint);
+  if (this->drcFireHose.screwJoint)
+    this->RemoveJoint(this->drcFireHose.screwJoint);
+  if (this->drcFireHose.coupling)
+    this->drcFireHose.coupling->Reset();
+  if (this->drcFireHose.isInitialized)
+    this->drcFireHose.SetReducedOrder(false);
+
+  // Link poses and twists.  In maximal coordinates these also carry the
+  // joint positions and velocities.  Sim time keeps running forward.
+  physics::Model_V models = this->world->GetModels();
+  for (physics::Model_V::iterator mi = models.begin(); mi != models.end();
+       ++mi)
+  {
+    if (worldState.HasModelState((*mi)->GetName()))
+      (*mi)->SetState(worldState.GetModelState((*mi)->GetName()));
+  }
+
+  if (_snapshot.pinned)
+    this->PinAtlas(_snapshot.gravity);
+  else
+  {
+    this->UnpinAtlas();
+    this->atlas.model->SetGravityMode(_snapshot.gravity);
+  }
+
+  atlas_msgs::SetAtlasControllerState controllerState;
+  controllerState.request.state = _snapshot.controller;
+  bool success = this->setControllerStateClient.call(controllerState) &&
+    controllerState.response.success;
+  if (success)
+  {
+    // startup is complete in the snapshot
+    this->atlas.bdiStandSequence = Robot::BS_INITIALIZED;
+    this->atlas.pinnedSequence = Robot::PS_INITIALIZED;
+    this->atlas.restartAfterFastTravel = false;
+    this->atlas.startupSequence = Robot::INITIALIZED;
+  }
+  else
+  {
+    _status = "unable to set atlas/set_controller_state: " +
+      controllerState.response.status_message;
+  }
+
+  return success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool VRCPlugin::WriteSnapshotFile(const std::string &_filename,
+  const atlas_msgs::VRCSnapshot &_snapshot, std::string &_status)
+{
+  uint32_t size = ros::serialization::serializationLength(_snapshot);
+  std::vector<uint8_t> buffer(size);
+  ros::serialization::OStream stream(&buffer[0], size);
+  ros::serialization::serialize(stream, _snapshot);
+
+  std::ofstream file(_filename.c_str(), std::ios::out | std::ios::binary);
+  if (!file.is_open())
+  {
+    _status = "unable to open [" + _filename + "] for writing";
+    return false;
+  }
+
+  file << ros::message_traits::md5sum<atlas_msgs::VRCSnapshot>() << "\n";
+  file.write(reinterpret_cast<const char *>(&buffer[0]), size);
+  if (!file.good())
+  {
+    _status = "error writing [" + _filename + "]";
+    return false;
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool VRCPlugin::ReadSnapshotFile(const std::string &_filename,
+  atlas_msgs::VRCSnapshot &_snapshot, std::string &_status)
+{
+  std::ifstream file(_filename.c_str(), std::ios::in | std::ios::binary);
+  if (!file.is_open())
+  {
+    _status = "unable to open [" + _filename + "]";
+    return false;
+  }
+
+  // reject files written with a different message definition
+  std::string md5;
+  std::getline(file, md5);
+  if (md5 != ros::message_traits::md5sum<atlas_msgs::VRCSnapshot>())
+  {
+    _status = "[" + _filename + "] is not a compatible snapshot file";
+    return false;
+  }
+
+  std::vector<uint8_t> buffer((std::istreambuf_iterator<char>(file)),
+    std::istreambuf_iterator<char>());
+  if (buffer.empty())
+  {
+    _status = "[" + _filename + "] is empty";
+    return false;
+  }
+
+  try
+  {
+    ros::serialization::IStream stream(&buffer[0], buffer.size());
+    ros::serialization::deserialize(stream, _snapshot);
+  }
+  catch(ros::Exception &_e)
+  {
+    _status = "[" + _filename + "] is truncated: " + _e.what();
+    return false;
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void VRCPlugin::RestoreStartupSnapshot()
+{
+  SnapshotJob job;
+  job.restore = true;
+  job.startup = true;
+  bool success = false;
+
+  // AtlasPlugin loads with the robot model, wait for its services
+  while (this->rosNode->ok() &&
+         !this->setControllerStateClient.waitForExistence(ros::Duration(1.0)))
+  {
+    ROS_INFO("waiting for atlas/set_controller_state to restore snapshot.");
+  }
+
+  if (this->rosNode->ok() &&
+      this->ReadSnapshotFile(this->startupSnapshotFile, job.snapshot,
+                             job.status))
+  {
+    // clears startupSnapshotPending
+    success = this->RunSnapshotJob(job);
+  }
+
+  if (success)
+  {
+    ROS_INFO("Robot started from snapshot [%s]",
+      this->startupSnapshotFile.c_str());
+    boost::mutex::scoped_lock lock(this->snapshotMutex);
+    this->snapshot = job.snapshot;
+    this->haveSnapshot = true;
+  }
+  else
+  {
+    ROS_ERROR("Unable to start from snapshot [%s]: %s, running startup "
+      "sequence [%s] instead.", this->startupSnapshotFile.c_str(),
+      job.status.c_str(), this->atlas.startupMode.c_str());
+    boost::mutex::scoped_lock lock(this->snapshotJobMutex);
+    this->startupSnapshotPending = false;
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void VRCPlugin::SetRobotPose(const geometry_msgs::Pose::ConstPtr &_pose)
 {
@@ -626,6 +1170,9 @@ void VRCPlugin::RobotGrabFireHose(const geometry_msgs::Pose::ConstPtr &_cmd)
 
   if (this->drcFireHose.fireHoseModel && this->drcFireHose.couplingLink)
   {
+    if (this->drcFireHose.isInitialized)
+      this->drcFireHose.SetReducedOrder(false);
+
     physics::LinkPtr gripper = this->atlas.model->GetLink(gripperName);
     if (gripper)
     {
@@ -911,6 +1458,18 @@ void VRCPlugin::Teleport(const physics::LinkPtr &_pinLink,
   this->world->EnablePhysicsEngine(e);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void VRCPlugin::OnAtlasSpawned(physics::ModelPtr /*_model*/)
+{
+  // called on the world update thread, like UpdateStates
+  this->atlasReadyId = ModelReadiness::NO_WAITER;
+  if (this->atlas.startupSequence == Robot::SPAWN_QUEUED &&
+      this->atlas.CheckGetModel(this->world))
+  {
+    this->atlas.startupSequence = Robot::SPAWN_SUCCESS;
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Play the trajectory, update states
 void VRCPlugin::UpdateStates()
@@ -926,18 +1485,19 @@ void VRCPlugin::UpdateStates()
   {
     // Load and Spawn Robot
     this->atlas.InsertModel(this->world, this->sdf);
+
+    // OnAtlasSpawned moves on as soon as the model is loaded
+    if (this->atlas.startupSequence == Robot::SPAWN_QUEUED)
+    {
+      std::vector<std::string> links;
+      links.push_back(this->atlas.pinLinkName);
+      this->atlasReadyId = this->readiness->Connect(this->atlas.modelName,
+        links, boost::bind(&VRCPlugin::OnAtlasSpawned, this, _1));
+    }
   }
   else if (this->atlas.startupSequence == Robot::SPAWN_QUEUED)
   {
-    if (this->atlas.CheckGetModel(this->world))
-    {
-      this->atlas.startupSequence = Robot::SPAWN_SUCCESS;
-    }
-    else
-    {
-      // still waiting for robot to be spawned
-      ROS_INFO("waiting for atlas robot to be spawned.");
-    }
+    // still waiting for robot to be spawned, see OnAtlasSpawned
   }
   else if (this->atlas.startupSequence == Robot::SPAWN_SUCCESS)
   {
@@ -959,9 +1519,30 @@ void VRCPlugin::UpdateStates()
     // Note: hardcoded link by name: @todo: make this a pugin param
     this->atlas.initialPose = this->atlas.pinLink->GetWorldPose();
 
+    // resolve feet once, used by cheats and robot modes
+    this->atlas.lFootLink = this->atlas.model->GetLink("l_foot");
+    if (!this->atlas.lFootLink)
+      ROS_WARN("atlas robot l_foot link not found.");
+    this->atlas.rFootLink = this->atlas.model->GetLink("r_foot");
+    if (!this->atlas.rFootLink)
+      ROS_WARN("atlas robot r_foot link not found.");
+
     // initialize atlas command controller
     this->atlasCommandController.InitModel(this->atlas.model);
 
+    // settle into a saved snapshot instead of running the startup sequence,
+    // hold the robot until AtlasPlugin is up to take its controller state.
+    if (!this->startupSnapshotFile.empty())
+    {
+      {
+        boost::mutex::scoped_lock lock(this->snapshotJobMutex);
+        this->startupSnapshotPending = true;
+      }
+      this->PinAtlas(false);
+      this->startupSnapshotThread = boost::thread(
+        boost::bind(&VRCPlugin::RestoreStartupSnapshot, this));
+    }
+
     this->atlas.startupSequence = Robot::INIT_MODEL_SUCCESS;
   }
   else if (this->atlas.startupSequence == Robot::INIT_MODEL_SUCCESS)
@@ -977,7 +1558,18 @@ void VRCPlugin::UpdateStates()
 
     std::string startInVehicleName = "robot_start_in_vehicle";
     bool startInVehicle = false;
-    if (this->rosNode->getParam(startInVehicleName, startInVehicle) &&
+    bool snapshotPending;
+    {
+      boost::mutex::scoped_lock lock(this->snapshotJobMutex);
+      snapshotPending = this->startupSnapshotPending;
+    }
+    if (snapshotPending)
+    {
+      // RestoreStartupSnapshot completes startup, or clears the flag and
+      // falls back to the sequences below if the snapshot fails to load.
+    }
+    else if (!this->atlas.restartAfterFastTravel &&
+        this->rosNode->getParam(startInVehicleName, startInVehicle) &&
                                                             startInVehicle)
     {
       gzdbg << "Starting robot in vehicle." << std::endl;
@@ -1082,9 +1674,19 @@ void VRCPlugin::UpdateStates()
     // should not be here
   }
 
+  this->UpdateSnapshotJob();
+
+  if (this->cheatsEnabled)
+    this->UpdateFastTravel();
+
   if (curTime > this->lastUpdateTime)
   {
     this->CheckThreadStart();
+    if (this->drcFireHose.isInitialized)
+    {
+      this->drcFireHose.UpdateReducedOrder(this->atlas.model,
+                                           this->world->GetSimTime());
+    }
 
     double dt = curTime - this->lastUpdateTime;
 
@@ -1121,76 +1723,81 @@ void VRCPlugin::UpdateStates()
 
   if ((this->atlas.startupSequence == Robot::INITIALIZED) &&
       this->cheatsEnabled)
-  {
-    // publish fake AtlasSimInterfaceState via this->pubFakeASIS
-    atlas_msgs::AtlasSimInterfaceState asis;
-    asis.error_code = atlas_msgs::AtlasSimInterfaceState::NO_ERRORS;
-    asis.current_behavior = this->atlas.currentBehavior;
-    asis.desired_behavior = this->atlas.currentBehavior;
-    for (size_t i=0; i<asis.f_out.size(); i++)
-      asis.f_out[i] = 0.0;
-    math::Pose cur_pose = this->atlas.pinLink->GetWorldPose();
-    asis.pos_est.position.x = cur_pose.pos.x;
-    asis.pos_est.position.y = cur_pose.pos.y;
-    asis.pos_est.position.z = cur_pose.pos.z;
-    math::Vector3 cur_vel = this->atlas.pinLink->GetWorldLinearVel();
-    asis.pos_est.velocity.x = cur_vel.x;
-    asis.pos_est.velocity.y = cur_vel.y;
-    asis.pos_est.velocity.z = cur_vel.z;
-    physics::LinkPtr l_foot_link = this->atlas.model->GetLink("l_foot");
-    if (!l_foot_link)
-      ROS_WARN("Couldn't find l_foot link when publishing fake behavior data.");
-    else
+    this->PublishFakeASIS();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void VRCPlugin::PublishFakeASIS()
+{
+  common::Time curTime = this->world->GetSimTime();
+  if (this->atlas.fakeASISRate > 0.0 &&
+      curTime >= this->atlas.lastFakeASISTime &&
+      (curTime - this->atlas.lastFakeASISTime).Double() <
+      1.0 / this->atlas.fakeASISRate)
+    return;
+  this->atlas.lastFakeASISTime = curTime;
+
+  // publish fake AtlasSimInterfaceState via this->pubFakeASIS
+  atlas_msgs::AtlasSimInterfaceState asis;
+  asis.error_code = atlas_msgs::AtlasSimInterfaceState::NO_ERRORS;
+  asis.current_behavior = this->atlas.currentBehavior;
+  asis.desired_behavior = this->atlas.currentBehavior;
+  for (size_t i=0; i<asis.f_out.size(); i++)
+    asis.f_out[i] = 0.0;
+  math::Pose cur_pose = this->atlas.pinLink->GetWorldPose();
+  asis.pos_est.position.x = cur_pose.pos.x;
+  asis.pos_est.position.y = cur_pose.pos.y;
+  asis.pos_est.position.z = cur_pose.pos.z;
+  math::Vector3 cur_vel = this->atlas.pinLink->GetWorldLinearVel();
+  asis.pos_est.velocity.x = cur_vel.x;
+  asis.pos_est.velocity.y = cur_vel.y;
+  asis.pos_est.velocity.z = cur_vel.z;
+  if (this->atlas.lFootLink)
+  {
+    math::Pose l_foot_pose = this->atlas.lFootLink->GetWorldPose();
+    asis.foot_pos_est[0].position.x = l_foot_pose.pos.x;
+    asis.foot_pos_est[0].position.y = l_foot_pose.pos.y;
+    asis.foot_pos_est[0].position.z = l_foot_pose.pos.z;
+    asis.foot_pos_est[0].orientation.w = l_foot_pose.rot.w;
+    asis.foot_pos_est[0].orientation.x = l_foot_pose.rot.x;
+    asis.foot_pos_est[0].orientation.y = l_foot_pose.rot.y;
+    asis.foot_pos_est[0].orientation.z = l_foot_pose.rot.z;
+  }
+  if (this->atlas.rFootLink)
+  {
+    math::Pose r_foot_pose = this->atlas.rFootLink->GetWorldPose();
+    asis.foot_pos_est[1].position.x = r_foot_pose.pos.x;
+    asis.foot_pos_est[1].position.y = r_foot_pose.pos.y;
+    asis.foot_pos_est[1].position.z = r_foot_pose.pos.z;
+    asis.foot_pos_est[1].orientation.w = r_foot_pose.rot.w;
+    asis.foot_pos_est[1].orientation.x = r_foot_pose.rot.x;
+    asis.foot_pos_est[1].orientation.y = r_foot_pose.rot.y;
+    asis.foot_pos_est[1].orientation.z = r_foot_pose.rot.z;
+  }
+  for (size_t i=0; i<asis.k_effort.size(); i++)
+    asis.k_effort[i] = 0;
+
+  // Do what we can for the behavior-specific feedback data
+  if (asis.current_behavior == atlas_msgs::AtlasSimInterfaceCommand::WALK)
+  {
+    double time_remaining = (this->warpRobotStopTime - curTime).Double();
+    if (time_remaining > 0.0)
     {
-      math::Pose l_foot_pose = l_foot_link->GetWorldPose();
-      asis.foot_pos_est[0].position.x = l_foot_pose.pos.x;
-      asis.foot_pos_est[0].position.y = l_foot_pose.pos.y;
-      asis.foot_pos_est[0].position.z = l_foot_pose.pos.z;
-      asis.foot_pos_est[0].orientation.w = l_foot_pose.rot.w;
-      asis.foot_pos_est[0].orientation.x = l_foot_pose.rot.x;
-      asis.foot_pos_est[0].orientation.y = l_foot_pose.rot.y;
-      asis.foot_pos_est[0].orientation.z = l_foot_pose.rot.z;
+      // Assuming that t_step_rem should be in milliseconds
+      asis.walk_feedback.t_step_rem = time_remaining * 1e3;
+      asis.walk_feedback.current_step_index = this->atlas.currentStepIndex;
     }
-    physics::LinkPtr r_foot_link = this->atlas.model->GetLink("r_foot");
-    if (!l_foot_link)
-      ROS_WARN("Couldn't find l_foot link when publishing fake behavior data.");
     else
     {
-      math::Pose r_foot_pose = r_foot_link->GetWorldPose();
-      asis.foot_pos_est[1].position.x = r_foot_pose.pos.x;
-      asis.foot_pos_est[1].position.y = r_foot_pose.pos.y;
-      asis.foot_pos_est[1].position.z = r_foot_pose.pos.z;
-      asis.foot_pos_est[1].orientation.w = r_foot_pose.rot.w;
-      asis.foot_pos_est[1].orientation.x = r_foot_pose.rot.x;
-      asis.foot_pos_est[1].orientation.y = r_foot_pose.rot.y;
-      asis.foot_pos_est[1].orientation.z = r_foot_pose.rot.z;
+      asis.walk_feedback.t_step_rem = 0.0;
+      asis.walk_feedback.current_step_index = this->atlas.lastStepIndex;
     }
-    for (size_t i=0; i<asis.k_effort.size(); i++)
-      asis.k_effort[i] = 0;
-
-    // Do what we can for the behavior-specific feedback data
-    if (asis.current_behavior == atlas_msgs::AtlasSimInterfaceCommand::WALK)
-    {
-      double time_remaining =
-        (this->warpRobotStopTime - this->world->GetSimTime()).Double();
-      if (time_remaining > 0.0)
-      {
-        // Assuming that t_step_rem should be in milliseconds
-        asis.walk_feedback.t_step_rem = time_remaining * 1e3;
-        asis.walk_feedback.current_step_index = this->atlas.currentStepIndex;
-      }
-      else
-      {
-        asis.walk_feedback.t_step_rem = 0.0;
-        asis.walk_feedback.current_step_index = this->atlas.lastStepIndex;
-      }
-      asis.walk_feedback.next_step_index_needed = this->atlas.lastStepIndex+1;
-      //asis.walk_feedback.status_flags
-      //asis.walk_feedback.step_queue_saturated
-    }
-
-    this->atlas.pubFakeASIS.publish(asis);
+    asis.walk_feedback.next_step_index_needed = this->atlas.lastStepIndex+1;
+    //asis.walk_feedback.status_flags
+    //asis.walk_feedback.step_queue_saturated
   }
+
+  this->atlas.pubFakeASISQueue->push(asis, this->atlas.pubFakeASIS);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1208,6 +1815,8 @@ void VRCPlugin::ROSQueueThread()
 void VRCPlugin::FireHose::Load(physics::WorldPtr _world, sdf::ElementPtr _sdf)
 {
   this->isInitialized = false;
+  this->reducedOrder = false;
+  this->reducedOrderDistance = 0.0;
 
   sdf::ElementPtr sdf = _sdf->GetElement("drc_fire_hose");
   // Get special coupling links (on the firehose side)
@@ -1247,47 +1856,19 @@ void VRCPlugin::FireHose::Load(physics::WorldPtr _world, sdf::ElementPtr _sdf)
     return;
   }
 
-  // Get spout link
-  std::string spoutLinkName = sdf->Get<std::string>("spout_link");
-  this->spoutLink = this->standpipeModel->GetLink(spoutLinkName);
-  if (!this->spoutLink)
+  // Spout, valve and coupling geometry are shared with VRCScoringPlugin,
+  // which finds them by world name
+  this->coupling.reset(new VRCFireHoseCoupling());
+  if (!this->coupling->Load(_world, sdf))
   {
-    ROS_ERROR("VRCPlugin: spout link [%s] not found",
-      spoutLinkName.c_str());
+    ROS_ERROR("VRCPlugin: fire hose coupling not loaded, threading disabled.");
+    this->coupling.reset();
     return;
   }
+  VRCFireHoseCoupling::Register(_world->GetName(), this->coupling);
 
-  // Get the valve model and its joint
-  std::string valveModelName;
-  if (sdf->HasElement("valve_model"))
-    valveModelName = sdf->Get<std::string>("valve_model");
-  else
-    valveModelName = "valve";
-  this->valveModel = _world->GetModel(valveModelName);
-  if (!this->valveModel)
-  {
-    ROS_WARN("VRCPlugin: valve model [%s] not found, scoring will be wrong",
-      valveModelName.c_str());
-  }
-  else
-  {
-    std::string valveJointName;
-    if (sdf->HasElement("valve_joint"))
-      valveJointName = sdf->Get<std::string>("valve_joint");
-    else
-      valveJointName = "valve";
-    this->valveJoint = this->valveModel->GetJoint(valveJointName);
-    if (!this->valveJoint)
-    {
-      ROS_WARN("VRCPlugin: valve joint [%s] not found, scoring will be wrong",
-        valveJointName.c_str());
-    }
-  }
-
-  this->threadPitch = sdf->Get<double>("thread_pitch");
-
-  this->couplingRelativePose =
-    sdf->Get<gazebo::math::Pose>("coupling_relative_pose");
+  if (sdf->HasElement("reduced_order_distance"))
+    this->reducedOrderDistance = sdf->Get<double>("reduced_order_distance");
 
   // Set initial configuration
   this->SetInitialConfiguration();
@@ -1310,91 +1891,129 @@ void VRCPlugin::FireHose::SetInitialConfiguration()
   }
 }
 
-void VRCPlugin::CheckThreadStart()
+////////////////////////////////////////////////////////////////////////////////
+void VRCPlugin::FireHose::UpdateReducedOrder(physics::ModelPtr _robot,
+  const common::Time &_simTime)
 {
-  if (!this->drcFireHose.isInitialized)
+  if (this->reducedOrderDistance <= 0.0)
     return;
 
-  // gzerr << "coupling [" << this->couplingLink->GetWorldPose() << "]\n";
-  // gzerr << "spout [" << this->spoutLink->GetWorldPose() << "]\n"
-  math::Pose connectPose(this->drcFireHose.couplingRelativePose);
-
-  // surface of the coupling cylinder is -0.135m from link origin
-  physics::CollisionPtr col =
-    this->drcFireHose.couplingLink->GetCollision("attachment_col");
-  double collisionSurfaceZOffset =
-    col->GetRelativePose().pos.x -
-    boost::dynamic_pointer_cast<physics::CylinderShape>(
-    col->GetShape())->GetLength()/2;
-
-  math::Pose relativePose =
-    (math::Pose(collisionSurfaceZOffset, 0, 0, 0, 0, 0) +
-     this->drcFireHose.couplingLink->GetWorldPose()) -
-    this->drcFireHose.spoutLink->GetWorldPose();
-
-  double posErrInsert = relativePose.pos.z - connectPose.pos.z +
-    collisionSurfaceZOffset;
-  double posErrCenter = fabs(relativePose.pos.x - connectPose.pos.x) +
-                        fabs(relativePose.pos.y - connectPose.pos.y);
-  double rotErr = (relativePose.rot.GetXAxis() -
-                   connectPose.rot.GetXAxis()).GetLength();
-  double valveAng = 0;
-  if (this->drcFireHose.valveJoint)
-    valveAng = this->drcFireHose.valveJoint->GetAngle(0).Radian();
-
-  /* uncomment for debugging
-  gzdbg << " connectPose [" << connectPose
-        << "] [" << connectPose.rot.GetXAxis()
-        << "] [" << connectPose.rot.GetYAxis()
-        << "] [" << connectPose.rot.GetZAxis() << "]\n";
-  gzerr << "<coupling_relative_pose>"
-        << relativePose + math::Pose(0, 0, collisionSurfaceZOffset, 0, 0, 0)
-        << "</coupling_relative_pose>\n";
-  gzdbg << "relativePose axis [" << relativePose.rot.GetXAxis()  // bingo
-        << "] [" << relativePose.rot.GetYAxis()
-        << "] [" << relativePose.rot.GetZAxis() << "]\n";
-  gzdbg << "offset [" << relativePose - connectPose << "]\n";
-  gzwarn << "insert [" << posErrInsert
-         << "] center [" << posErrCenter
-         << "] rpy [" << rotErr
-         << "] valve [" << valveAng
-         << "]\n";
-  */
-
-  if (!this->drcFireHose.screwJoint)
-  {
-    // Check that the hose coupler is positioned within tolerance
-    // and that the valve is not opened, because the water rushing out
-    // would prevent you from attaching a hose.  This check also
-    // prevents out-of-order execution that would confuse scoring in
-    // VRCScoringPlugin.
-    if (posErrInsert > 0.0 && posErrCenter < 0.003 &&
-        rotErr < 0.05 && valveAng > -0.1)
+  // Nearest point of the robot, by link origin, to the hose
+  double robotDistance = GZ_DBL_MAX;
+  if (_robot)
+  {
+    math::Box box = this->reducedOrder ? this->reducedOrderBox :
+      this->fireHoseModel->GetBoundingBox();
+    physics::Link_V links = _robot->GetLinks();
+    for (physics::Link_V::iterator li = links.begin(); li != links.end(); ++li)
     {
-      this->drcFireHose.screwJoint =
-        this->AddJoint(this->world, this->drcFireHose.fireHoseModel,
-                       this->drcFireHose.spoutLink,
-                       this->drcFireHose.couplingLink,
-                       "screw",
-                       math::Vector3(0, 0, 0),
-                       math::Vector3(0, -1, 0),
-                       20, -0.5, false);
-
-      this->drcFireHose.screwJoint->SetParam("thread_pitch", 0,
-        this->drcFireHose.threadPitch);
-
-      // name of the joint
-      // gzerr << this->drcFireHose.screwJoint->GetScopedName() << "\n";
+      math::Vector3 pos = (*li)->GetWorldPose().pos;
+      double dx = std::max(box.min.x - pos.x, pos.x - box.max.x);
+      double dy = std::max(box.min.y - pos.y, pos.y - box.max.y);
+      double dz = std::max(box.min.z - pos.z, pos.z - box.max.z);
+      math::Vector3 d(std::max(dx, 0.0), std::max(dy, 0.0), std::max(dz, 0.0));
+      robotDistance = std::min(robotDistance, d.GetLength());
     }
   }
-  else
+
+  if (this->reducedOrder)
+  {
+    // Something else may have knocked the hose awake
+    bool awake = false;
+    for (physics::Link_V::iterator li = this->fireHoseLinks.begin();
+         li != this->fireHoseLinks.end() && !awake; ++li)
+    {
+      awake = (*li)->GetEnabled();
+    }
+
+    if (awake || robotDistance < this->reducedOrderDistance)
+    {
+      ROS_DEBUG("VRCPlugin: robot near the fire hose, simulating full chain");
+      this->SetReducedOrder(false);
+    }
+    return;
+  }
+
+  // Check once a second, with some hysteresis, that the robot is away and
+  // the hose is at rest and free.
+  if (_simTime >= this->restCheckTime &&
+      (_simTime - this->restCheckTime).Double() < 1.0)
+    return;
+  this->restCheckTime = _simTime;
+
+  if (robotDistance < 1.5 * this->reducedOrderDistance || this->screwJoint ||
+      this->coupling->IsThreaded())
+    return;
+
+  for (physics::Link_V::iterator li = this->fireHoseLinks.begin();
+       li != this->fireHoseLinks.end(); ++li)
   {
-    // check joint position to disconnect
-    double position = this->drcFireHose.screwJoint->GetAngle(0).Radian();
-    // gzdbg << "unscrew if [" <<  position << "] < -0.003\n";
-    if (position < -0.0003)
-      this->RemoveJoint(this->drcFireHose.screwJoint);
+    if ((*li)->GetWorldLinearVel().GetLength() > 0.01 ||
+        (*li)->GetWorldAngularVel().GetLength() > 0.05)
+      return;
   }
+
+  ROS_DEBUG("VRCPlugin: fire hose at rest, freezing it");
+  this->SetReducedOrder(true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void VRCPlugin::FireHose::SetReducedOrder(bool _reduced)
+{
+  if (_reduced == this->reducedOrder)
+    return;
+
+  // A disabled body keeps its pose and isn't stepped, and joints between
+  // disabled bodies aren't solved.  The physics engine enables it again
+  // if something that is being simulated touches it.
+  if (_reduced)
+    this->reducedOrderBox = this->fireHoseModel->GetBoundingBox();
+  for (physics::Link_V::iterator li = this->fireHoseLinks.begin();
+       li != this->fireHoseLinks.end(); ++li)
+  {
+    (*li)->SetLinearVel(math::Vector3::Zero);
+    (*li)->SetAngularVel(math::Vector3::Zero);
+    (*li)->SetEnabled(!_reduced);
+  }
+  this->reducedOrder = _reduced;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void VRCPlugin::CheckThreadStart()
+{
+  if (!this->drcFireHose.isInitialized)
+    return;
+
+  // Cheap unless the coupling is close to the spout; the screw joint is
+  // made and removed in OnFireHoseThreadChanged.
+  this->drcFireHose.coupling->Update(this->world->GetSimTime());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void VRCPlugin::OnFireHoseThreadChanged(bool _threaded)
+{
+  if (_threaded)
+  {
+    if (this->drcFireHose.screwJoint)
+      return;
+
+    this->drcFireHose.screwJoint =
+      this->AddJoint(this->world, this->drcFireHose.fireHoseModel,
+                     this->drcFireHose.coupling->GetSpoutLink(),
+                     this->drcFireHose.couplingLink,
+                     "screw",
+                     math::Vector3(0, 0, 0),
+                     math::Vector3(0, -1, 0),
+                     20, -0.5, false);
+
+    this->drcFireHose.screwJoint->SetParam("thread_pitch", 0,
+      this->drcFireHose.coupling->GetThreadPitch());
+
+    // the coupling unscrews on the joint position from now on
+    this->drcFireHose.coupling->SetScrewJoint(this->drcFireHose.screwJoint);
+  }
+  else if (this->drcFireHose.screwJoint)
+    this->RemoveJoint(this->drcFireHose.screwJoint);
 }
 
 
@@ -1457,7 +2076,8 @@ VRCPlugin::Robot::Robot()
   this->startupStandPrepDuration = 2.0;
   this->startupNominal = this->startupStandPrepDuration + 2.0;
   this->startupStand = this->startupNominal + 0.1;
-
+  this->restartAfterFastTravel = false;
+  this->fakeASISRate = 0.0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1598,6 +2218,38 @@ void VRCPlugin::LoadVRCROSAPI()
       boost::bind(&VRCPlugin::RobotReleaseLink, this, _1),
       ros::VoidPtr(), &this->rosQueue);
     this->subRobotRelease = this->rosNode->subscribe(robot_release_so);
+
+    // ros services
+    ros::AdvertiseServiceOptions save_snapshot_aso =
+      ros::AdvertiseServiceOptions::create<atlas_msgs::SaveSnapshot>(
+      "drc_world/save_snapshot", boost::bind(
+        &VRCPlugin::SaveSnapshot, this, _1, _2),
+      ros::VoidPtr(), &this->rosQueue);
+    this->saveSnapshotService =
+      this->rosNode->advertiseService(save_snapshot_aso);
+
+    ros::AdvertiseServiceOptions restore_snapshot_aso =
+      ros::AdvertiseServiceOptions::create<atlas_msgs::RestoreSnapshot>(
+      "drc_world/restore_snapshot", boost::bind(
+        &VRCPlugin::RestoreSnapshot, this, _1, _2),
+      ros::VoidPtr(), &this->rosQueue);
+    this->restoreSnapshotService =
+      this->rosNode->advertiseService(restore_snapshot_aso);
+  }
+
+  // snapshots need AtlasPlugin controller internals
+  this->getControllerStateClient =
+    this->rosNode->serviceClient<atlas_msgs::GetAtlasControllerState>(
+    "atlas/get_controller_state");
+  this->setControllerStateClient =
+    this->rosNode->serviceClient<atlas_msgs::SetAtlasControllerState>(
+    "atlas/set_controller_state");
+
+  if (this->rosNode->getParam("drc_world/startup_snapshot",
+    this->startupSnapshotFile) && !this->startupSnapshotFile.empty())
+  {
+    ROS_INFO("Starting robot from snapshot [%s]",
+      this->startupSnapshotFile.c_str());
   }
 }
 
@@ -1674,10 +2326,28 @@ void VRCPlugin::LoadRobotROSAPI()
       ros::VoidPtr(), &this->rosQueue);
     this->atlas.subFakeASIC = this->rosNode->subscribe(fake_asic_so);
 
+    std::string fast_travel_topic_name = "atlas/fast_travel";
+    ros::SubscribeOptions fast_travel_so =
+      ros::SubscribeOptions::create<geometry_msgs::PoseArray>(
+      fast_travel_topic_name, 100,
+      boost::bind(&VRCPlugin::SetRobotFastTravel, this, _1),
+      ros::VoidPtr(), &this->rosQueue);
+    this->atlas.subFastTravel = this->rosNode->subscribe(fast_travel_so);
+
+    this->rosNode->param("atlas/fast_travel/speed", this->fastTravelSpeed,
+      0.5);
+    this->rosNode->param("atlas/fast_travel/real_time_multiple",
+      this->fastTravelRealTimeMultiple, 20.0);
+
     // ros advertisement
+    this->atlas.pubFakeASISQueue =
+      this->pmq->addPub<atlas_msgs::AtlasSimInterfaceState>();
     this->atlas.pubFakeASIS =
       this->rosNode->advertise<atlas_msgs::AtlasSimInterfaceState>(
       "atlas/fake/atlas_sim_interface_state", 1, true);
+    // every update by default, as before the rate was configurable
+    this->rosNode->param("atlas/fake/atlas_sim_interface_state_rate",
+      this->atlas.fakeASISRate, 0.0);
   }
 }
 
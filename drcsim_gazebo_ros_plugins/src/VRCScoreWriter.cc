@@ -0,0 +1,252 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <gazebo/common/common.hh>
+#include "drcsim_gazebo_ros_plugins/VRCScoreWriter.hh"
+
+#include <boost/cstdint.hpp>
+#include <algorithm>
+#include <iomanip>
+#include <string>
+#include <time.h>
+
+using namespace gazebo;
+
+/////////////////////////////////////////////////
+VRCScoreWriter::VRCScoreWriter()
+  : running(false), droppedCount(0), unflushedCount(0)
+{
+}
+
+/////////////////////////////////////////////////
+VRCScoreWriter::~VRCScoreWriter()
+{
+  this->Close();
+}
+
+/////////////////////////////////////////////////
+bool VRCScoreWriter::Open(const boost::filesystem::path &_scorePath,
+                          const std::string &_worldName,
+                          const common::Time &_runStartTimeWall,
+                          const std::string &_eventLogPath)
+{
+  this->scoreFilePath = _scorePath;
+
+  // Create the score directory if needed
+  if (!boost::filesystem::exists(this->scoreFilePath.parent_path()))
+    boost::filesystem::create_directories(this->scoreFilePath.parent_path());
+  // Open the score file for writing
+  this->scoreFileStream.open(this->scoreFilePath.string().c_str(),
+                             std::fstream::out);
+  if (!this->scoreFileStream.is_open())
+  {
+    gzerr << "Failed to open score file :" << this->scoreFilePath <<
+      std::endl;
+    return false;
+  }
+  gzlog << "Writing score data to " << this->scoreFilePath << std::endl;
+
+  this->scoreFileStream << "# Score data for world " <<
+    _worldName << std::endl;
+  const time_t timeSec = _runStartTimeWall.sec;
+  this->scoreFileStream << "# Started at: " <<
+    std::fixed << std::setprecision(3) <<
+    _runStartTimeWall.Double() << "; " <<
+    ctime(&timeSec);
+  this->scoreFileStream << "# Format: " << std::endl;
+  this->scoreFileStream << "# wallTime(sec),simTime(sec),"
+    "wallTimeElapsed(sec),simTimeElapsed(sec),completionScore(count),"
+    "falls(count)" << std::endl;
+
+  if (!_eventLogPath.empty())
+  {
+    this->eventLogStream.open(_eventLogPath.c_str(),
+                              std::fstream::out | std::fstream::binary);
+    if (!this->eventLogStream.is_open())
+    {
+      gzerr << "Failed to open score event log :" << _eventLogPath <<
+        std::endl;
+      this->scoreFileStream.close();
+      return false;
+    }
+    this->eventLogStream.write("VRCEVT1\n", 8);
+    this->eventLogStream.flush();
+    gzlog << "Writing score events to " << _eventLogPath << std::endl;
+  }
+
+  this->lastFlushTime = common::Time::GetWallTime();
+  this->running = true;
+  this->writerThread =
+    boost::thread(boost::bind(&VRCScoreWriter::Run, this));
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool VRCScoreWriter::IsOpen() const
+{
+  return this->scoreFileStream.is_open();
+}
+
+/////////////////////////////////////////////////
+void VRCScoreWriter::SetForceCallback(
+  const boost::function<void()> &_callback)
+{
+  boost::mutex::scoped_lock lock(this->queueMutex);
+  this->forceCallback = _callback;
+}
+
+/////////////////////////////////////////////////
+bool VRCScoreWriter::Push(const Record &_record)
+{
+  {
+    boost::mutex::scoped_lock lock(this->queueMutex);
+    if (!this->running)
+      return false;
+    if (!_record.force && this->queue.size() >= maxQueueSize)
+    {
+      if (this->droppedCount++ == 0)
+        gzwarn << "Score writer can't keep up, dropping periodic records"
+               << std::endl;
+      return false;
+    }
+    this->queue.push_back(_record);
+  }
+  this->queueCondition.notify_one();
+  return true;
+}
+
+/////////////////////////////////////////////////
+void VRCScoreWriter::Close()
+{
+  {
+    boost::mutex::scoped_lock lock(this->queueMutex);
+    this->running = false;
+  }
+  this->queueCondition.notify_one();
+  if (this->writerThread.joinable())
+    this->writerThread.join();
+
+  // The writer thread drains the queue before it exits, so this only
+  // matters if it never got to run.
+  while (!this->queue.empty())
+  {
+    this->Write(this->queue.front());
+    this->queue.pop_front();
+  }
+
+  if (this->droppedCount > 0)
+  {
+    gzwarn << "Score writer dropped " << this->droppedCount
+           << " periodic records" << std::endl;
+    this->droppedCount = 0;
+  }
+
+  if (this->scoreFileStream.is_open())
+  {
+    this->scoreFileStream.flush();
+    this->scoreFileStream.close();
+  }
+  if (this->eventLogStream.is_open())
+  {
+    this->eventLogStream.flush();
+    this->eventLogStream.close();
+  }
+}
+
+/////////////////////////////////////////////////
+void VRCScoreWriter::Run()
+{
+  std::deque<Record> batch;
+  boost::function<void()> callback;
+  bool keepRunning = true;
+  while (keepRunning)
+  {
+    {
+      boost::mutex::scoped_lock lock(this->queueMutex);
+      // Wake up at least once a second, to flush the tail of a batch
+      if (this->running && this->queue.empty())
+      {
+        this->queueCondition.timed_wait(lock,
+          boost::posix_time::seconds(1));
+      }
+      batch.swap(this->queue);
+      keepRunning = this->running;
+      callback = this->forceCallback;
+    }
+
+    bool forced = false;
+    for (std::deque<Record>::const_iterator it = batch.begin();
+         it != batch.end(); ++it)
+    {
+      this->Write(*it);
+      forced = forced || it->force;
+    }
+    batch.clear();
+
+    // Forced records mean that something interesting happened; get them
+    // on disk right away.  Periodic records are flushed in batches, and at
+    // least once a second.
+    common::Time now = common::Time::GetWallTime();
+    if (this->unflushedCount > 0 &&
+        (forced || !keepRunning ||
+         this->unflushedCount >= flushBatchSize ||
+         (now - this->lastFlushTime).Double() >= 1.0))
+    {
+      this->scoreFileStream.flush();
+      if (this->eventLogStream.is_open())
+        this->eventLogStream.flush();
+      this->unflushedCount = 0;
+      this->lastFlushTime = now;
+    }
+
+    if (forced && callback)
+      callback();
+  }
+}
+
+/////////////////////////////////////////////////
+void VRCScoreWriter::Write(const Record &_record)
+{
+  if (!this->scoreFileStream.is_open())
+    return;
+
+  this->scoreFileStream << std::fixed << std::setprecision(3)
+    << _record.wallTime.Double() << ","
+    << _record.simTime.Double() << ","
+    << _record.wallTimeElapsed.Double() << ","
+    << _record.simTimeElapsed.Double() << ","
+    << _record.completionScore << ","
+    << _record.falls << ",\"" << _record.msg << "\"\n";
+  ++this->unflushedCount;
+
+  if (!this->eventLogStream.is_open() || !_record.force)
+    return;
+
+  double times[4] = {_record.wallTime.Double(), _record.simTime.Double(),
+                     _record.wallTimeElapsed.Double(),
+                     _record.simTimeElapsed.Double()};
+  boost::int32_t counts[2] = {_record.completionScore, _record.falls};
+  boost::uint16_t msgLength = static_cast<boost::uint16_t>(
+    std::min(_record.msg.size(), static_cast<size_t>(0xffff)));
+  this->eventLogStream.write(reinterpret_cast<const char *>(times),
+                             sizeof(times));
+  this->eventLogStream.write(reinterpret_cast<const char *>(counts),
+                             sizeof(counts));
+  this->eventLogStream.write(reinterpret_cast<const char *>(&msgLength),
+                             sizeof(msgLength));
+  this->eventLogStream.write(_record.msg.data(), msgLength);
+}
@@ -0,0 +1,922 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <gazebo/common/common.hh>
+#include <gazebo/physics/physics.hh>
+#include "drcsim_gazebo_ros_plugins/VRCScoringEngine.hh"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace gazebo;
+
+namespace
+{
+  typedef VRCScoringEngine Engine;
+
+  /// \brief A GATE rule with this count covers every gate not claimed by
+  /// an earlier rule of the task.
+  const int ALL_GATES = -1;
+
+  /// \brief One row of a rule table.
+  struct RuleSpec
+  {
+    /// \brief What to check
+    Engine::RuleType type;
+
+    /// \brief How many times to repeat the row; only meaningful for gates
+    int count;
+
+    /// \brief Engine::RuleAction flags
+    unsigned int actions;
+  };
+
+  /// \brief Rules that must be met one after the other.  If stopClock is
+  /// set, meeting the last scoring rule of the sequence stops the clock.
+  struct SequenceSpec
+  {
+    const RuleSpec *rules;
+    unsigned int size;
+    bool stopClock;
+  };
+
+  /// \brief The rule table of a task.  Sequences are checked in order on
+  /// every update, independently of each other.
+  struct TaskSpec
+  {
+    const char *worldName;
+    Engine::WorldType type;
+    const SequenceSpec *sequences;
+    unsigned int size;
+  };
+
+  // Qual 1, 3 and 4: each gate counts.
+  const RuleSpec qualGateRules[] =
+  {
+    {Engine::GATE, ALL_GATES, Engine::SCORE}
+  };
+  const SequenceSpec qualGateTask[] =
+  {
+    {qualGateRules, 1, false}
+  };
+
+  // Qual 2: put the drill in the bin.
+  const RuleSpec qual2Rules[] =
+  {
+    {Engine::DRILL_IN_BIN, 1, Engine::SCORE}
+  };
+  const SequenceSpec qual2Task[] =
+  {
+    {qual2Rules, 1, false}
+  };
+
+  // VRC 1: the first gate doesn't count but starts the clock.  Then get the
+  // pelvis in the car and drive through the remaining gates.
+  const RuleSpec vrc1Rules[] =
+  {
+    {Engine::GATE, 1, Engine::START_CLOCK | Engine::FORCE_LOG},
+    {Engine::ATLAS_IN_VEHICLE, 1, Engine::SCORE},
+    {Engine::GATE, ALL_GATES, Engine::SCORE}
+  };
+  const SequenceSpec vrc1Task[] =
+  {
+    {vrc1Rules, 3, true}
+  };
+
+  // VRC 2: the first gate doesn't count but starts the clock.  Then walk
+  // through the remaining gates.
+  const RuleSpec vrc2Rules[] =
+  {
+    {Engine::GATE, 1, Engine::START_CLOCK | Engine::FORCE_LOG},
+    {Engine::GATE, ALL_GATES, Engine::SCORE}
+  };
+  const SequenceSpec vrc2Task[] =
+  {
+    {vrc2Rules, 2, true}
+  };
+
+  // VRC 3: passing the gate doesn't affect score, but we need to latch sim
+  // and wall time of that event.  The hose and valve steps count.
+  const RuleSpec vrc3GateRules[] =
+  {
+    {Engine::GATE, ALL_GATES, Engine::START_CLOCK | Engine::FORCE_LOG}
+  };
+  const RuleSpec vrc3HoseRules[] =
+  {
+    {Engine::HOSE_OFF_TABLE, 1, Engine::SCORE},
+    {Engine::HOSE_ALIGNED, 1, Engine::SCORE},
+    {Engine::HOSE_CONNECTED, 1, Engine::SCORE},
+    {Engine::VALVE_OPEN, 1, Engine::SCORE}
+  };
+  const SequenceSpec vrc3Task[] =
+  {
+    {vrc3GateRules, 1, false},
+    {vrc3HoseRules, 4, true}
+  };
+
+  const TaskSpec tasks[] =
+  {
+    {"qual_task_1", Engine::QUAL_1, qualGateTask, 1},
+    {"qual_task_2", Engine::QUAL_2, qual2Task, 1},
+    {"qual_task_3", Engine::QUAL_3, qualGateTask, 1},
+    {"qual_task_4", Engine::QUAL_4, qualGateTask, 1},
+    {"vrc_task_1", Engine::VRC_1, vrc1Task, 1},
+    {"vrc_task_2", Engine::VRC_2, vrc2Task, 1},
+    {"vrc_task_3", Engine::VRC_3, vrc3Task, 2}
+  };
+}
+
+/////////////////////////////////////////////////
+VRCScoringEngine::VRCScoringEngine()
+  : worldType(UNKNOWN), isHoseAligned(false), isHoseConnected(false),
+    isHoseThreaded(false), completionScore(0), fallAccelThreshold(1000.0),
+    falls(0), postCompletionQuietTime(5.0)
+{
+}
+
+/////////////////////////////////////////////////
+VRCScoringEngine::~VRCScoringEngine()
+{
+}
+
+/////////////////////////////////////////////////
+bool VRCScoringEngine::Load(physics::WorldPtr _world, sdf::ElementPtr _sdf)
+{
+  // Which type of world are we scoring?
+  this->world = _world;
+  const TaskSpec *task = NULL;
+  for (unsigned int i = 0; i < sizeof(tasks) / sizeof(tasks[0]); ++i)
+  {
+    if (this->world->GetName() == tasks[i].worldName)
+    {
+      task = &tasks[i];
+      break;
+    }
+  }
+  if (!task)
+  {
+    gzerr << "VRCScoringPlugin: unknown world name \"" <<
+      this->world->GetName() << "\"; not scoring.";
+    return false;
+  }
+  this->worldType = task->type;
+
+  // Find only the entities that the rules refer to
+  bool needGates = false;
+  bool needDrill = false;
+  bool needVehicle = false;
+  bool needHose = false;
+  bool needValve = false;
+  for (unsigned int s = 0; s < task->size; ++s)
+  {
+    const SequenceSpec &seqSpec = task->sequences[s];
+    for (unsigned int r = 0; r < seqSpec.size; ++r)
+    {
+      switch (seqSpec.rules[r].type)
+      {
+        case GATE:
+          needGates = true;
+          break;
+        case ATLAS_IN_VEHICLE:
+          needVehicle = true;
+          break;
+        case DRILL_IN_BIN:
+          needDrill = true;
+          break;
+        case VALVE_OPEN:
+          needValve = true;
+          needHose = true;
+          break;
+        default:
+          needHose = true;
+      }
+    }
+  }
+
+  if (needDrill && !this->FindDrillAndBin())
+    return false;
+  if (needVehicle && !this->FindVehicle())
+    return false;
+  if (needHose && !this->FindHose())
+    return false;
+  if (needValve && !this->FindValve())
+    return false;
+  if (needGates && !this->FindGates())
+    return false;
+
+  // Compile the rule table: expand the gate rows into one rule per gate,
+  // and flag the rule that stops the clock.
+  unsigned int gateCount = 0;
+  for (unsigned int s = 0; s < task->size; ++s)
+  {
+    const SequenceSpec &seqSpec = task->sequences[s];
+    Sequence seq;
+    for (unsigned int r = 0; r < seqSpec.size; ++r)
+    {
+      const RuleSpec &ruleSpec = seqSpec.rules[r];
+      if (ruleSpec.type == GATE)
+      {
+        for (int n = 0; (ruleSpec.count == ALL_GATES || n < ruleSpec.count) &&
+             gateCount < this->gates.size(); ++n)
+        {
+          seq.rules.push_back(Rule(GATE, ruleSpec.actions, gateCount++));
+        }
+      }
+      else
+      {
+        for (int n = 0; n < ruleSpec.count; ++n)
+          seq.rules.push_back(Rule(ruleSpec.type, ruleSpec.actions));
+        if (ruleSpec.type == HOSE_ALIGNED ||
+            ruleSpec.type == HOSE_CONNECTED ||
+            ruleSpec.type == VALVE_OPEN)
+          seq.tracksHose = true;
+      }
+    }
+
+    if (seqSpec.stopClock)
+    {
+      for (std::vector<Rule>::reverse_iterator it = seq.rules.rbegin();
+           it != seq.rules.rend(); ++it)
+      {
+        if (it->actions & SCORE)
+        {
+          it->actions |= STOP_CLOCK;
+          break;
+        }
+      }
+    }
+    this->sequences.push_back(seq);
+  }
+
+  this->fallDetector.Reset();
+  this->completionScore = 0;
+  this->falls = 0;
+
+  if (_sdf && _sdf->HasElement("fall_accel_threshold"))
+    this->fallAccelThreshold = _sdf->Get<double>("fall_accel_threshold");
+  this->fallDetector.SetThreshold(this->fallAccelThreshold);
+
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool VRCScoringEngine::SetRobot(physics::ModelPtr _atlas)
+{
+  this->atlasHead = _atlas->GetLink("head");
+  if (!this->atlasHead)
+  {
+    gzerr << "Unable to find head for scoring falls" << std::endl;
+    return false;
+  }
+  this->atlas = _atlas;
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool VRCScoringEngine::InferHoseAlignment(sdf::ElementPtr _sdf)
+{
+  this->coupling.reset(new VRCFireHoseCoupling());
+  if (!this->coupling->Load(this->world, _sdf))
+  {
+    this->coupling.reset();
+    gzerr << "Unable to infer hose alignment" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////
+VRCScoringEngine::WorldType VRCScoringEngine::GetWorldType() const
+{
+  return this->worldType;
+}
+
+/////////////////////////////////////////////////
+int VRCScoringEngine::GetCompletionScore() const
+{
+  return this->completionScore;
+}
+
+/////////////////////////////////////////////////
+int VRCScoringEngine::GetFalls() const
+{
+  return this->falls;
+}
+
+/////////////////////////////////////////////////
+void VRCScoringEngine::GetElapsedTime(const common::Time &_simTime,
+                                      const common::Time &_wallTime,
+                                      common::Time &_elapsedSim,
+                                      common::Time &_elapsedWall) const
+{
+  _elapsedSim = common::Time::Zero;
+  if (this->stopTimeSim != common::Time::Zero)
+    _elapsedSim = this->stopTimeSim - this->startTimeSim;
+  else if (this->startTimeSim != common::Time::Zero)
+    _elapsedSim = _simTime - this->startTimeSim;
+
+  _elapsedWall = common::Time::Zero;
+  if (this->stopTimeWall != common::Time::Zero)
+    _elapsedWall = this->stopTimeWall - this->startTimeWall;
+  else if (this->startTimeWall != common::Time::Zero)
+    _elapsedWall = _wallTime - this->startTimeWall;
+}
+
+/////////////////////////////////////////////////
+bool VRCScoringEngine::Update(const common::Time &_simTime,
+                              const common::Time &_wallTime,
+                              std::string &_msg)
+{
+  if (!this->atlas)
+    return false;
+
+  int prevScore = this->completionScore;
+  int prevFalls = this->falls;
+  bool forceLogScore = false;
+
+  for (std::vector<Sequence>::iterator seq = this->sequences.begin();
+       seq != this->sequences.end(); ++seq)
+  {
+    if (seq->tracksHose)
+      this->UpdateHose(_simTime, _msg);
+
+    // Only the next rule of the sequence can be met
+    if (seq->next >= seq->rules.size())
+      continue;
+    const Rule &rule = seq->rules[seq->next];
+    if (!this->CheckRule(*seq, rule, _msg))
+      continue;
+
+    ++seq->next;
+    if (rule.actions & SCORE)
+      this->completionScore += 1;
+    if (rule.actions & START_CLOCK)
+      this->StartClock(_simTime, _wallTime, _msg);
+    if (rule.actions & STOP_CLOCK)
+      this->StopClock(_simTime, _wallTime, _msg);
+    // Force score output so that this event appears in the log
+    if (rule.actions & FORCE_LOG)
+      forceLogScore = true;
+  }
+
+  // Did we fall?
+  if (this->CheckFall(_simTime, _msg))
+    this->falls += 1;
+
+  return forceLogScore ||
+    (prevScore != this->completionScore) ||
+    (prevFalls != this->falls);
+}
+
+/////////////////////////////////////////////////
+bool VRCScoringEngine::CheckRule(Sequence &_seq, const Rule &_rule,
+                                 std::string &_msg)
+{
+  switch (_rule.type)
+  {
+    case GATE:
+      return this->CheckGate(_seq, this->gates[_rule.gate], _msg);
+    case ATLAS_IN_VEHICLE:
+      return this->CheckAtlasInVehicle(_msg);
+    case DRILL_IN_BIN:
+      return this->CheckDrillInBin(_msg);
+    case HOSE_OFF_TABLE:
+      return this->CheckHoseOffTable(_msg);
+    case HOSE_ALIGNED:
+      return this->isHoseAligned;
+    case HOSE_CONNECTED:
+      return this->isHoseThreaded;
+    case VALVE_OPEN:
+      return this->CheckValveOpen(_msg);
+    default:
+      GZ_ASSERT(false, "Unknown rule type");
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////
+void VRCScoringEngine::StartClock(const common::Time &_simTime,
+                                  const common::Time &_wallTime,
+                                  std::string &_msg)
+{
+  this->startTimeSim = _simTime;
+  this->startTimeWall = _wallTime;
+  std::stringstream ss;
+  ss << "Starting clock. ";
+  gzlog << ss.str() << std::endl;
+  _msg += ss.str();
+}
+
+/////////////////////////////////////////////////
+void VRCScoringEngine::StopClock(const common::Time &_simTime,
+                                 const common::Time &_wallTime,
+                                 std::string &_msg)
+{
+  this->stopTimeSim = _simTime;
+  this->stopTimeWall = _wallTime;
+  std::stringstream ss;
+  ss << "Stopping clock. ";
+  gzlog << ss.str() << std::endl;
+  _msg += ss.str();
+}
+
+/////////////////////////////////////////////////
+int VRCScoringEngine::IsPoseInGate(const math::Pose& _robotWorldPose,
+                                   const Gate &_gate) const
+{
+  // Transform to gate frame
+  math::Vector3 robotLocalPosition =
+    _gate.invRot.RotateVector(_robotWorldPose.pos - _gate.pose.pos);
+
+  // Are we within the width?
+  if (fabs(robotLocalPosition.y) <= _gate.halfWidth)
+    return (robotLocalPosition.x >= 0.0) ? 1 : -1;
+  else
+    return 0;
+}
+
+/////////////////////////////////////////////////
+bool VRCScoringEngine::CheckGate(Sequence &_seq, const Gate &_gate,
+                                 std::string &_msg)
+{
+  // Get the pose of the robot or the vehicle, depending on the type of the
+  // gate.
+  math::Pose pose;
+  std::string tmpString;
+  switch (_gate.type)
+  {
+    case Gate::PEDESTRIAN:
+      // We require that Atlas is NOT in the vehicle when it crosses this gate
+      if (this->CheckAtlasInVehicle(tmpString))
+        return false;
+      pose = this->atlas->GetWorldPose();
+      break;
+    case Gate::VEHICLE:
+      // We require that Atlas is in the vehicle when it crosses this gate
+      if (!this->CheckAtlasInVehicle(tmpString))
+        return false;
+      pose = this->vehicle->GetWorldPose();
+      break;
+    default:
+      GZ_ASSERT(false, "Unknown gate type");
+  }
+  // Figure whether we're positioned before (-1), after (1), or
+  // neither (0), with respect to the gate.
+  int gateSide = this->IsPoseInGate(pose, _gate);
+  // Did we go forward through the gate?
+  if ((_seq.gateSide < 0) && (gateSide > 0))
+  {
+    // Log it
+    std::stringstream ss;
+    ss << "Successfully passed through gate " <<
+      (_gate.number+1) << ". ";
+    gzlog << ss.str() << std::endl;
+    _msg += ss.str();
+
+    // Update state to look for the next gate
+    _seq.gateSide = 0;
+    return true;
+  }
+  else
+  {
+    // Just checking: did we go backward through the gate?
+    if ((_seq.gateSide > 0) && (gateSide < 0))
+    {
+      gzlog << "Went backward through gate " <<
+        (_gate.number+1) << std::endl;
+    }
+    // Remember which side we're on now (which might be 0)
+    _seq.gateSide = gateSide;
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////
+bool VRCScoringEngine::CheckAtlasInVehicle(std::string &_msg)
+{
+  // If we don't know anything about the vehicle (e.g., if this world doesn't
+  // contain a vehicle), then just say no.
+  if (!this->vehicleSeat)
+    return false;
+
+  // Where is Atlas?
+  math::Vector3 robotPosition = this->atlas->GetWorldPose().pos;
+  // Construct bounding box above the seat, using the footprint of the "seat"
+  // and the height of the "seat_back"
+  math::Box seatBox = this->vehicleSeat->GetBoundingBox();
+  math::Box seatBackBox = this->vehicleSeatBack->GetBoundingBox();
+  // Extrude by the height of the seat back
+  seatBox.min.z = seatBackBox.min.z;
+  seatBox.max.z = seatBackBox.max.z;
+
+  // Check whether Atlas is in the target zone
+  if ((robotPosition.x >= seatBox.min.x) &&
+      (robotPosition.x <= seatBox.max.x) &&
+      (robotPosition.y >= seatBox.min.y) &&
+      (robotPosition.y <= seatBox.max.y) &&
+      (robotPosition.z >= seatBox.min.z) &&
+      (robotPosition.z <= seatBox.max.z))
+  {
+    std::stringstream ss;
+    ss << "Successfully moved Atlas into vehicle. ";
+    _msg += ss.str();
+    gzlog << ss.str() << std::endl;
+    return true;
+  }
+  else
+    return false;
+}
+
+/////////////////////////////////////////////////
+bool VRCScoringEngine::CheckDrillInBin(std::string &_msg)
+{
+  math::Vector3 drillPosition = this->drill->GetWorldPose().pos;
+  if ((drillPosition.x >= this->bin.min.x) &&
+      (drillPosition.x <= this->bin.max.x) &&
+      (drillPosition.y >= this->bin.min.y) &&
+      (drillPosition.y <= this->bin.max.y) &&
+      (drillPosition.z >= this->bin.min.z) &&
+      (drillPosition.z <= this->bin.max.z))
+  {
+    std::stringstream ss;
+    ss << "Successfully placed drill in bin. ";
+    _msg += ss.str();
+    gzlog << ss.str() << std::endl;
+    return true;
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////
+bool VRCScoringEngine::CheckFall(const common::Time &_simTime,
+  std::string &_msg)
+{
+  // Don't count falls after task completion + quiet time
+  if (this->stopTimeSim != common::Time::Zero &&
+      (_simTime - this->stopTimeSim) >= this->postCompletionQuietTime)
+    return false;
+
+  // Get head velocity
+  math::Vector3 currVel = this->atlasHead->GetWorldLinearVel();
+
+  // Falls right after another aren't counted.  This also handles initial
+  // conditions, which currently include dropping the robot onto the ground
+  // at t=10
+  if (this->fallDetector.Update(_simTime.Double(), currVel.z))
+  {
+    std::stringstream ss;
+    ss << "Damaging fall detected, acceleration of: " <<
+      this->fallDetector.GetAcceleration() << " m/s^2. ";
+    gzlog << ss.str() << std::endl;
+    _msg += ss.str();
+    return true;
+  }
+  else
+    return false;
+}
+
+/////////////////////////////////////////////////
+bool VRCScoringEngine::CheckHoseOffTable(std::string &_msg)
+{
+  // Check that the height of the hose couple is within a few cm
+  // of the standpipe.
+  math::Vector3 standpipePosition = this->standpipe->GetWorldPose().pos;
+  math::Vector3 hoseCouplerPosition = this->hoseCoupler->GetWorldPose().pos;
+  if (hoseCouplerPosition.z >= (standpipePosition.z - 0.05))
+  {
+    std::stringstream ss;
+    ss << "Successfully picked hose up off table. ";
+    gzlog << ss.str() << std::endl;
+    _msg += ss.str();
+    return true;
+  }
+  else
+    return false;
+}
+
+/////////////////////////////////////////////////
+void VRCScoringEngine::UpdateHose(const common::Time &_simTime,
+                                  std::string &_msg)
+{
+  // Check that the screw joint between the hose coupler and standpipe exists.
+  // That's true only when they're aligned (handled in VRCPlugin.cpp).
+  // VRCPlugin shares the coupling state, which is evaluated once per time
+  // step by whichever of us gets there first.  Without it, we check
+  // indirectly by looking for a non-empty set of child links attached
+  // to the standpipe.
+  if (!this->coupling)
+    this->coupling = VRCFireHoseCoupling::Find(this->world->GetName());
+  bool screwJoint;
+  if (this->coupling)
+    screwJoint = this->coupling->Update(_simTime);
+  else
+    screwJoint = !this->standpipe->GetChildJointsLinks().empty();
+  if (screwJoint)
+  {
+    // If we were not previously aligned, latch the current pose for later
+    // comparison to determine that rotation has succeeded.
+    if (!this->isHoseAligned)
+    {
+      std::stringstream ss;
+      ss << "Successfully aligned the hose with the standpipe. ";
+      gzlog << ss.str() << std::endl;
+      _msg += ss.str();
+      this->hoseCouplerAlignedPose = this->hoseCoupler->GetWorldPose();
+      this->isHoseAligned = true;
+      this->isHoseConnected = false;
+    }
+  }
+  else
+  {
+    if (this->isHoseAligned)
+    {
+      gzlog << "Unaligned the hose from the standpipe" << std::endl;
+      this->isHoseAligned = false;
+      this->isHoseConnected = false;
+    }
+  }
+
+  // Must be aligned (i.e., the screw joint must exist) to be connected
+  this->isHoseThreaded = false;
+  if (!this->isHoseAligned)
+    return;
+
+  // Check for a sufficient change in coupler position along its X axis,
+  // which indicates that the hose coupler has threaded on to the standpipe
+  // screw joint.
+
+  // Transform current position into frame of initial aligned pose; the
+  // coupling has done that already if we have it.
+  double dist;
+  if (this->coupling)
+    dist = this->coupling->GetThreadTravel();
+  else
+  {
+    math::Vector3 couplerWorldPosition = this->hoseCoupler->GetWorldPose().pos;
+    math::Vector3 couplerLocalPosition =
+      this->hoseCouplerAlignedPose.rot.GetInverse().RotateVector(
+        couplerWorldPosition - this->hoseCouplerAlignedPose.pos);
+    dist = couplerLocalPosition.x;
+  }
+  // Maximum depth is 2cm; let's get most of the way there.
+  if (dist <= -0.015)
+  {
+    if (!this->isHoseConnected)
+    {
+      std::stringstream ss;
+      ss << "Successfully connected the hose to the standpipe. ";
+      gzlog << ss.str() << std::endl;
+      _msg += ss.str();
+      this->isHoseConnected = true;
+    }
+    this->isHoseThreaded = true;
+  }
+  else
+  {
+    // per issue #314:
+    // allow for a little bit (2mm) of hysteresis after connection
+    if (this->isHoseConnected && dist > -0.013)
+    {
+      gzlog << "Disconnected the hose to the standpipe" << std::endl;
+      this->isHoseConnected = false;
+    }
+  }
+}
+
+/////////////////////////////////////////////////
+bool VRCScoringEngine::CheckValveOpen(std::string &_msg)
+{
+  // Doesn't count unless the hose is connected.  This check doesn't
+  // prevent out-of-order task execution; that should be done in
+  // the VRCPlugin, which should not allow alignment when the valve is open.
+  if (!this->isHoseConnected)
+    return false;
+
+  // The valve starts at 0 and can be turned CCW several rotations.
+  // We check that it's been turned at least one rotation.
+  if (this->valve->GetAngle(0) < math::Angle(-2.0*M_PI))
+  {
+    std::stringstream ss;
+    ss << "Successfully opened valve. ";
+    gzlog << ss.str() << std::endl;
+    _msg += ss.str();
+    return true;
+  }
+  else
+    return false;
+}
+
+/////////////////////////////////////////////////
+bool VRCScoringEngine::FindDrillAndBin()
+{
+  this->drill = this->world->GetModel("drill");
+  if (!this->drill)
+  {
+    gzerr << "Failed to find drill" << std::endl;
+    return false;
+  }
+  physics::ModelPtr binModel = this->world->GetModel("bin");
+  if (!binModel)
+  {
+    gzerr << "Failed to find bin" << std::endl;
+    return false;
+  }
+
+  // Determine the bbox we need the drill to be within
+  physics::LinkPtr binLink = binModel->GetLink("link");
+  if (!binLink)
+  {
+    gzerr << "Failed to find bin link" << std::endl;
+    return false;
+  }
+  physics::CollisionPtr bottomCollision =
+    binLink->GetCollision("bottom_collision");
+  if (!bottomCollision)
+  {
+    gzerr << "Failed to find bin bottom collision" << std::endl;
+    return false;
+  }
+  math::Box bottomBbox = bottomCollision->GetBoundingBox();
+  physics::CollisionPtr side1Collision =
+    binLink->GetCollision("side1_collision");
+  if (!side1Collision)
+  {
+    gzerr << "Failed to find bin side1 collision" << std::endl;
+    return false;
+  }
+  math::Box side1Bbox = side1Collision->GetBoundingBox();
+
+  this->bin.min.x = bottomBbox.min.x;
+  this->bin.min.y = bottomBbox.min.y;
+  // Give a bit of tolerance for possible offset in origin of drill
+  this->bin.min.z = bottomBbox.min.z - 0.15;
+  this->bin.max.x = bottomBbox.max.x;
+  this->bin.max.y = bottomBbox.max.y;
+  this->bin.max.z = side1Bbox.max.z;
+
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool VRCScoringEngine::FindVehicle()
+{
+  this->vehicle = this->world->GetModel("drc_vehicle");
+  if (!this->vehicle)
+  {
+    gzerr << "Failed to find vehicle" << std::endl;
+    return false;
+  }
+  physics::LinkPtr chassisLink =
+    this->vehicle->GetLink("polaris_ranger_ev::chassis");
+  if (!chassisLink)
+  {
+    gzerr << "Failed to find chassis link" << std::endl;
+    return false;
+  }
+  this->vehicleSeat = chassisLink->GetCollision("seat");
+  if (!this->vehicleSeat)
+  {
+    gzerr << "Failed to find vehicle seat collision" << std::endl;
+    return false;
+  }
+  this->vehicleSeatBack = chassisLink->GetCollision("seat_back");
+  if (!this->vehicleSeatBack)
+  {
+    gzerr << "Failed to find vehicle seat back collision" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool VRCScoringEngine::FindHose()
+{
+  physics::ModelPtr hose = this->world->GetModel("vrc_firehose_long");
+  if (!hose)
+  {
+    gzerr << "Failed to find hose" << std::endl;
+    return false;
+  }
+  this->hoseCoupler = hose->GetLink("coupling");
+  if (!this->hoseCoupler)
+  {
+    gzerr << "Failed to find hose coupler" << std::endl;
+    return false;
+  }
+
+  physics::ModelPtr standpipeModel = this->world->GetModel("standpipe");
+  if (!standpipeModel)
+  {
+    gzerr << "Failed to find standpipe model" << std::endl;
+    return false;
+  }
+  this->standpipe = standpipeModel->GetLink("standpipe");
+  if (!this->standpipe)
+  {
+    gzerr << "Failed to find standpipe link" << std::endl;
+    return false;
+  }
+
+  this->isHoseAligned = false;
+  this->isHoseConnected = false;
+  this->isHoseThreaded = false;
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool VRCScoringEngine::FindValve()
+{
+  physics::ModelPtr valveModel = this->world->GetModel("valve");
+  if (!valveModel)
+  {
+    gzerr << "Failed to find valve model" << std::endl;
+    return false;
+  }
+  this->valve = valveModel->GetJoint("valve");
+  if (!this->valve)
+  {
+    gzerr << "Failed to find valve joint" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool VRCScoringEngine::FindGates()
+{
+  // Walk through the world and accumulate the things that appear to be gates.
+  physics::Model_V models = this->world->GetModels();
+  for (physics::Model_V::const_iterator it = models.begin();
+       it != models.end();
+       ++it)
+  {
+    // Parse the name, assuming that gates are named '[vehicle]gate_<int>'
+    physics::ModelPtr model = *it;
+    std::string name = model->GetName();
+    std::vector<std::string> parts;
+    boost::split(parts, name, boost::is_any_of("_"));
+    if (parts.size() == 2 &&
+        ((parts[0] == "gate") || (parts[0] == "vehiclegate")))
+    {
+      // Parse out the number; skip if it fails
+      unsigned int gateNum;
+      try
+      {
+        gateNum = boost::lexical_cast<unsigned int>(parts[1]);
+      }
+      catch (const boost::bad_lexical_cast &_e)
+      {
+        gzwarn << "Ignoring gate name that failed to parse: " << name <<
+          std::endl;
+        continue;
+      }
+      // Determine width of gate; it's the larger of the X and Y dimensions of
+      // the bounding box of the gate.
+      math::Box bbox = model->GetBoundingBox();
+      math::Vector3 bboxSize = bbox.GetSize();
+      double gateWidth = std::max(bboxSize.x, bboxSize.y);
+
+      Gate::GateType gateType;
+      if (parts[0] == "vehiclegate")
+        gateType = Gate::VEHICLE;
+      else
+        gateType = Gate::PEDESTRIAN;
+
+      // Store this gate
+      Gate g(name, gateType, gateNum, model->GetWorldPose(), gateWidth);
+      this->gates.push_back(g);
+      gzlog << "Stored gate named " << g.name << " of type " << g.type
+        << " with index " << g.number << " at pose " << g.pose
+        << " and width " << g.width << std::endl;
+    }
+  }
+
+  if (this->gates.empty())
+  {
+    gzerr << "Found no gates." << std::endl;
+    return false;
+  }
+
+  // Sort in order of increasing gate number (in case we encountered them
+  // out-of-order in the list of models).
+  std::stable_sort(this->gates.begin(), this->gates.end());
+
+  return true;
+}
@@ -0,0 +1,246 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <gazebo/common/common.hh>
+#include "drcsim_gazebo_ros_plugins/VRCStateLogReader.hh"
+
+#include <boost/archive/iterators/binary_from_base64.hpp>
+#include <boost/archive/iterators/transform_width.hpp>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/filter/bzip2.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/range/iterator_range.hpp>
+#include <iterator>
+#include <string>
+
+using namespace gazebo;
+
+namespace
+{
+  typedef boost::archive::iterators::transform_width<
+    boost::archive::iterators::binary_from_base64<
+      std::string::const_iterator>, 8, 6> Base64Decoder;
+
+  /// \brief How much of the file to read at a time
+  const std::streamsize readSize = 1 << 20;
+
+  /// \brief Decode the contents of a <chunk>, the way LogRecord encoded it.
+  /// \param[in] _encoding The chunk's encoding attribute.
+  /// \param[in] _raw The CDATA of the chunk.
+  /// \param[out] _data The decoded data.
+  /// \return false if the encoding is unknown or the data is corrupt.
+  bool DecodeChunk(const std::string &_encoding, const std::string &_raw,
+                   std::string &_data)
+  {
+    if (_encoding == "txt")
+    {
+      _data = _raw;
+      return true;
+    }
+
+    if (_encoding != "zlib" && _encoding != "bz2")
+    {
+      gzerr << "Unknown log chunk encoding [" << _encoding << "]" << std::endl;
+      return false;
+    }
+
+    // Base64, padded with '='
+    std::string base64;
+    base64.reserve(_raw.size());
+    size_t padding = 0;
+    for (std::string::const_iterator it = _raw.begin(); it != _raw.end(); ++it)
+    {
+      if (*it == '=')
+      {
+        base64 += 'A';
+        ++padding;
+      }
+      else if (!isspace(*it))
+        base64 += *it;
+    }
+
+    try
+    {
+      std::string compressed(Base64Decoder(base64.begin()),
+                             Base64Decoder(base64.end()));
+      compressed.erase(compressed.size() - std::min(padding,
+        compressed.size()));
+
+      boost::iostreams::filtering_istream in;
+      if (_encoding == "zlib")
+        in.push(boost::iostreams::zlib_decompressor());
+      else
+        in.push(boost::iostreams::bzip2_decompressor());
+      in.push(boost::make_iterator_range(compressed));
+
+      _data.clear();
+      boost::iostreams::copy(in, std::back_inserter(_data));
+    }
+    catch(std::exception &_e)
+    {
+      gzerr << "Corrupt log chunk: " << _e.what() << std::endl;
+      return false;
+    }
+    return true;
+  }
+}
+
+/////////////////////////////////////////////////
+VRCStateLogReader::VRCStateLogReader()
+  : chunkPos(0)
+{
+}
+
+/////////////////////////////////////////////////
+VRCStateLogReader::~VRCStateLogReader()
+{
+}
+
+/////////////////////////////////////////////////
+bool VRCStateLogReader::Open(const std::string &_filename)
+{
+  this->file.close();
+  this->file.clear();
+  this->buffer.clear();
+  this->world.clear();
+  this->chunk.clear();
+  this->chunkPos = 0;
+
+  this->file.open(_filename.c_str(), std::ios::in | std::ios::binary);
+  if (!this->file.is_open())
+  {
+    gzerr << "Unable to open log file [" << _filename << "]" << std::endl;
+    return false;
+  }
+
+  // The first chunk describes the world
+  if (!this->NextChunk(this->world) ||
+      this->world.find("<world") == std::string::npos)
+  {
+    gzerr << "Log file [" << _filename << "] doesn't start with a world"
+          << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////
+const std::string &VRCStateLogReader::GetWorld() const
+{
+  return this->world;
+}
+
+/////////////////////////////////////////////////
+bool VRCStateLogReader::Next(std::string &_data)
+{
+  while (true)
+  {
+    // A chunk holds all the states recorded since the previous one
+    size_t start = this->chunk.find("<state", this->chunkPos);
+    if (start != std::string::npos)
+    {
+      size_t end = this->chunk.find("</state>", start);
+      if (end != std::string::npos)
+      {
+        end += std::string("</state>").size();
+        _data = this->sdfTag + this->chunk.substr(start, end - start) +
+          "</sdf>";
+        this->chunkPos = end;
+        return true;
+      }
+    }
+
+    if (!this->NextChunk(this->chunk))
+      return false;
+    this->chunkPos = 0;
+
+    size_t sdfStart = this->chunk.find("<sdf");
+    size_t sdfEnd = this->chunk.find('>', sdfStart);
+    if (sdfStart != std::string::npos && sdfEnd != std::string::npos)
+      this->sdfTag = this->chunk.substr(sdfStart, sdfEnd - sdfStart + 1);
+    else
+      this->sdfTag = std::string("<sdf version='") + SDF_VERSION + "'>";
+  }
+}
+
+/////////////////////////////////////////////////
+bool VRCStateLogReader::NextChunk(std::string &_data)
+{
+  static const std::string cdataOpen = "<![CDATA[";
+  static const std::string cdataClose = "]]>";
+
+  while (true)
+  {
+    size_t start = this->buffer.find("<chunk");
+    if (start == std::string::npos)
+    {
+      // Nothing but header or whitespace so far; keep a tail in case the
+      // tag was cut in two.
+      if (this->buffer.size() > 16)
+        this->buffer.erase(0, this->buffer.size() - 16);
+    }
+    else
+    {
+      size_t tagEnd = this->buffer.find('>', start);
+      size_t dataStart = std::string::npos;
+      size_t dataEnd = std::string::npos;
+      if (tagEnd != std::string::npos)
+        dataStart = this->buffer.find(cdataOpen, tagEnd);
+      if (dataStart != std::string::npos)
+        dataEnd = this->buffer.find(cdataClose, dataStart + cdataOpen.size());
+
+      if (dataEnd != std::string::npos)
+      {
+        std::string tag = this->buffer.substr(start, tagEnd - start);
+        std::string encoding = "txt";
+        size_t attr = tag.find("encoding=");
+        if (attr != std::string::npos && attr + 10 < tag.size())
+        {
+          char quote = tag[attr + 9];
+          size_t attrEnd = tag.find(quote, attr + 10);
+          encoding = tag.substr(attr + 10, attrEnd - attr - 10);
+        }
+
+        dataStart += cdataOpen.size();
+        std::string raw = this->buffer.substr(dataStart, dataEnd - dataStart);
+        this->buffer.erase(0, dataEnd + cdataClose.size());
+
+        if (DecodeChunk(encoding, raw, _data))
+          return true;
+        // Skip chunks that can't be decoded
+        continue;
+      }
+    }
+
+    if (!this->Fill())
+      return false;
+  }
+}
+
+/////////////////////////////////////////////////
+bool VRCStateLogReader::Fill()
+{
+  if (!this->file.good())
+    return false;
+
+  size_t oldSize = this->buffer.size();
+  this->buffer.resize(oldSize + readSize);
+  this->file.read(&this->buffer[oldSize], readSize);
+  this->buffer.resize(oldSize + this->file.gcount());
+  return this->file.gcount() > 0;
+}
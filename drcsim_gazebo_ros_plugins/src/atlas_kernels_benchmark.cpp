@@ -0,0 +1,539 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+// Time the per tick computations of AtlasPlugin, without gazebo.
+//
+//   atlas_kernels_benchmark [-n ticks] [-i atlas_state.csv]
+//                           [-b baseline] [-w baseline] [-t ratio]
+//
+// The joint states are read from a recording made with
+//   rostopic echo -p /atlas/atlas_state > atlas_state.csv
+// or, without -i, are a swinging motion of every joint.  For each kernel
+// the time and the number of heap allocations per tick are printed.
+//
+// -w writes the results to a baseline file.  -b compares the results with
+// a baseline, and fails if a kernel is more than <ratio> (1.25) times
+// slower, or allocates more, than it did.
+
+#include <stdint.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "AtlasSimInterface.h"
+#include "drcsim_gazebo_ros_plugins/AtlasControlKernels.hh"
+
+namespace
+{
+  /// \brief Heap allocations so far
+  uint64_t allocations = 0;
+
+  /// \brief Keeps results alive, so that the kernels aren't optimized away
+  volatile double sink = 0;
+
+  /// \brief Recorded joint states
+  struct Recording
+  {
+    /// \brief Positions of each sample
+    std::vector<std::vector<float> > position;
+
+    /// \brief Velocities of each sample
+    std::vector<std::vector<float> > velocity;
+  };
+
+  /// \brief Time and allocations of a kernel
+  struct Result
+  {
+    Result() : nsPerTick(0), allocsPerTick(0) {}
+
+    double nsPerTick;
+    double allocsPerTick;
+  };
+}
+
+/////////////////////////////////////////////////
+// Count heap allocations
+void *operator new(size_t _size)
+{
+  ++allocations;
+  void *p = malloc(_size == 0 ? 1 : _size);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+/////////////////////////////////////////////////
+void *operator new[](size_t _size)
+{
+  return operator new(_size);
+}
+
+/////////////////////////////////////////////////
+void operator delete(void *_p)
+{
+  free(_p);
+}
+
+/////////////////////////////////////////////////
+void operator delete[](void *_p)
+{
+  free(_p);
+}
+
+/////////////////////////////////////////////////
+void Usage()
+{
+  std::cerr << "Usage: atlas_kernels_benchmark [-n ticks] "
+            << "[-i atlas_state.csv] [-b baseline] [-w baseline] [-t ratio]"
+            << std::endl;
+}
+
+/////////////////////////////////////////////////
+/// \brief Monotonic time in ns
+double Now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/////////////////////////////////////////////////
+/// \brief Split a line of comma separated values.
+std::vector<std::string> Split(const std::string &_line)
+{
+  std::vector<std::string> fields;
+  std::istringstream stream(_line);
+  std::string field;
+  while (std::getline(stream, field, ','))
+    fields.push_back(field);
+  return fields;
+}
+
+/////////////////////////////////////////////////
+/// \brief Read the positions and velocities of a rostopic echo -p
+/// recording of AtlasState.
+/// \return false if the file has no joint states
+bool ReadRecording(const std::string &_path, Recording &_recording)
+{
+  std::ifstream file(_path.c_str());
+  std::string line;
+  if (!std::getline(file, line))
+  {
+    std::cerr << "Unable to read [" << _path << "]" << std::endl;
+    return false;
+  }
+
+  std::vector<int> positionColumns(Atlas::NUM_JOINTS, -1);
+  std::vector<int> velocityColumns(Atlas::NUM_JOINTS, -1);
+  std::vector<std::string> header = Split(line);
+  for (unsigned int c = 0; c < header.size(); ++c)
+  {
+    for (int i = 0; i < Atlas::NUM_JOINTS; ++i)
+    {
+      std::ostringstream index;
+      index << i;
+      if (header[c] == "field.position" + index.str())
+        positionColumns[i] = c;
+      else if (header[c] == "field.velocity" + index.str())
+        velocityColumns[i] = c;
+    }
+  }
+  for (int i = 0; i < Atlas::NUM_JOINTS; ++i)
+  {
+    if (positionColumns[i] < 0 || velocityColumns[i] < 0)
+    {
+      std::cerr << "[" << _path << "] has no state of joint " << i
+                << std::endl;
+      return false;
+    }
+  }
+
+  while (std::getline(file, line))
+  {
+    std::vector<std::string> fields = Split(line);
+    if (fields.size() != header.size())
+      continue;
+    std::vector<float> position(Atlas::NUM_JOINTS);
+    std::vector<float> velocity(Atlas::NUM_JOINTS);
+    for (int i = 0; i < Atlas::NUM_JOINTS; ++i)
+    {
+      position[i] = atof(fields[positionColumns[i]].c_str());
+      velocity[i] = atof(fields[velocityColumns[i]].c_str());
+    }
+    _recording.position.push_back(position);
+    _recording.velocity.push_back(velocity);
+  }
+  return !_recording.position.empty();
+}
+
+/////////////////////////////////////////////////
+/// \brief Two seconds of every joint swinging at 1 Hz, sampled at 1 kHz.
+void SwingRecording(Recording &_recording)
+{
+  for (unsigned int t = 0; t < 2000; ++t)
+  {
+    std::vector<float> position(Atlas::NUM_JOINTS);
+    std::vector<float> velocity(Atlas::NUM_JOINTS);
+    for (int i = 0; i < Atlas::NUM_JOINTS; ++i)
+    {
+      double phase = 2 * M_PI * t * 0.001 + i;
+      position[i] = 0.5 * sin(phase);
+      velocity[i] = M_PI * cos(phase);
+    }
+    _recording.position.push_back(position);
+    _recording.velocity.push_back(velocity);
+  }
+}
+
+/////////////////////////////////////////////////
+/// \brief Base class of the kernels, each runs one tick at a time.
+class Kernel
+{
+  public: virtual ~Kernel() {}
+
+  /// \brief Run one tick on a recorded sample.
+  public: virtual void Tick(const std::vector<float> &_position,
+                            const std::vector<float> &_velocity) = 0;
+};
+
+/////////////////////////////////////////////////
+/// \brief AtlasPlugin::UpdatePIDControl, holding every joint at zero.
+class PIDKernel : public Kernel
+{
+  public: PIDKernel() : terms(Atlas::NUM_JOINTS), in(Atlas::NUM_JOINTS)
+  {
+    for (int i = 0; i < Atlas::NUM_JOINTS; ++i)
+    {
+      this->in[i].kpPosition = 1000;
+      this->in[i].kiPosition = 10;
+      this->in[i].kdPosition = 5;
+      this->in[i].kpVelocity = 2;
+      this->in[i].iEffortMin = -10;
+      this->in[i].iEffortMax = 10;
+      this->in[i].kEffort = 1;
+      this->in[i].effortLimit = 200;
+      this->in[i].dampingModel = 0.1;
+      this->in[i].dampingMax = 10;
+    }
+  }
+
+  public: virtual void Tick(const std::vector<float> &_position,
+                            const std::vector<float> &_velocity)
+  {
+    for (int i = 0; i < Atlas::NUM_JOINTS; ++i)
+    {
+      this->in[i].position = _position[i];
+      this->in[i].velocity = _velocity[i];
+      double damping;
+      sink = sink + gazebo::AtlasPIDUpdate(this->in[i], 0.001,
+                                           this->terms[i], damping);
+    }
+  }
+
+  private: std::vector<gazebo::AtlasPIDErrorTerms> terms;
+  private: std::vector<gazebo::AtlasPIDInput> in;
+};
+
+/////////////////////////////////////////////////
+/// \brief AtlasPlugin::Filter of the positions and the velocities.
+class FilterKernel : public Kernel
+{
+  public: FilterKernel()
+    : positionIn(Atlas::NUM_JOINTS, std::vector<double>(FIL_N_STEPS, 0)),
+      positionOut(Atlas::NUM_JOINTS, std::vector<double>(FIL_N_STEPS, 0)),
+      velocityIn(Atlas::NUM_JOINTS, std::vector<double>(FIL_N_STEPS, 0)),
+      velocityOut(Atlas::NUM_JOINTS, std::vector<double>(FIL_N_STEPS, 0)),
+      aState(Atlas::NUM_JOINTS), jState(Atlas::NUM_JOINTS)
+  {
+    // AtlasPlugin::InitFilter
+    this->coefA[0] = 1.0;
+    this->coefA[1] = -0.924390491658207;
+    this->coefB[0] = 0.037804754170897;
+    this->coefB[1] = 0.037804754170897;
+  }
+
+  public: virtual void Tick(const std::vector<float> &_position,
+                            const std::vector<float> &_velocity)
+  {
+    this->aState = _position;
+    gazebo::AtlasFilterJoints(this->coefA, this->coefB, this->positionIn,
+                              this->positionOut, this->aState, this->jState);
+    sink = sink + this->jState[0];
+    this->aState = _velocity;
+    gazebo::AtlasFilterJoints(this->coefA, this->coefB, this->velocityIn,
+                              this->velocityOut, this->aState, this->jState);
+    sink = sink + this->jState[0];
+  }
+
+  private: double coefA[FIL_MAX_FILT_COEFF];
+  private: double coefB[FIL_MAX_FILT_COEFF];
+  private: std::vector<std::vector<double> > positionIn;
+  private: std::vector<std::vector<double> > positionOut;
+  private: std::vector<std::vector<double> > velocityIn;
+  private: std::vector<std::vector<double> > velocityOut;
+  private: std::vector<float> aState;
+  private: std::vector<double> jState;
+};
+
+/////////////////////////////////////////////////
+/// \brief AtlasPlugin::CalculateControllerStatistics with a 1 s window.
+class StatisticsKernel : public Kernel
+{
+  public: StatisticsKernel()
+  {
+    this->statistics.Init(1000);
+  }
+
+  public: virtual void Tick(const std::vector<float> &_position,
+                            const std::vector<float> &/*_velocity*/)
+  {
+    // Some age in the order of milliseconds
+    this->statistics.Update(0.002 + 0.001 * _position[0]);
+    sink = sink + this->statistics.GetMean();
+  }
+
+  private: gazebo::AtlasCommandAgeStatistics statistics;
+};
+
+/////////////////////////////////////////////////
+/// \brief The latency histograms of AtlasPlugin, summarized every 1000
+/// ticks as CalculateControllerStatistics does with a 1 s window.
+class HistogramKernel : public Kernel
+{
+  public: HistogramKernel() : ticks(0) {}
+
+  public: virtual void Tick(const std::vector<float> &_position,
+                            const std::vector<float> &/*_velocity*/)
+  {
+    this->histogram.Record(0.002 + 0.001 * _position[0]);
+    if (++this->ticks % 1000 == 0)
+    {
+      sink = sink + this->histogram.GetPercentile(99.9);
+      this->histogram.Reset();
+    }
+  }
+
+  private: gazebo::AtlasLatencyHistogram histogram;
+  private: unsigned int ticks;
+};
+
+/////////////////////////////////////////////////
+/// \brief AtlasSimInterface::process_control_input, in user mode.
+class ASIKernel : public Kernel
+{
+  public: ASIKernel()
+  {
+    this->asi = create_atlas_sim_interface();
+    this->state.t = 0;
+    for (int i = 0; i < Atlas::NUM_JOINTS; ++i)
+    {
+      this->input.jparams[i].k_q_p = 1000;
+      this->input.jparams[i].k_q_i = 10;
+      this->input.jparams[i].k_qd_p = 5;
+    }
+  }
+
+  public: virtual ~ASIKernel()
+  {
+    destroy_atlas_sim_interface();
+  }
+
+  public: virtual void Tick(const std::vector<float> &_position,
+                            const std::vector<float> &_velocity)
+  {
+    this->state.t += 0.001;
+    for (int i = 0; i < Atlas::NUM_JOINTS; ++i)
+    {
+      this->state.j[i].q = _position[i];
+      this->state.j[i].qd = _velocity[i];
+    }
+    this->asi->process_control_input(this->input, this->state,
+                                     this->output);
+    sink = sink + this->output.f_out[0];
+  }
+
+  private: AtlasSimInterface *asi;
+  private: AtlasControlInput input;
+  private: AtlasRobotState state;
+  private: AtlasControlOutput output;
+};
+
+/////////////////////////////////////////////////
+/// \brief Run a kernel over the recording, from the start, repeating the
+/// recording as needed.
+Result Run(Kernel &_kernel, const Recording &_recording, unsigned int _ticks)
+{
+  // Warm up caches and lazily allocated state
+  unsigned int warmup = std::min(_ticks, 1000u);
+  for (unsigned int t = 0; t < warmup; ++t)
+  {
+    unsigned int s = t % _recording.position.size();
+    _kernel.Tick(_recording.position[s], _recording.velocity[s]);
+  }
+
+  uint64_t startAllocations = allocations;
+  double start = Now();
+  for (unsigned int t = 0; t < _ticks; ++t)
+  {
+    unsigned int s = t % _recording.position.size();
+    _kernel.Tick(_recording.position[s], _recording.velocity[s]);
+  }
+
+  Result result;
+  result.nsPerTick = (Now() - start) / _ticks;
+  result.allocsPerTick =
+    static_cast<double>(allocations - startAllocations) / _ticks;
+  return result;
+}
+
+/////////////////////////////////////////////////
+/// \brief Read a baseline written with -w.
+bool ReadBaseline(const std::string &_path,
+                  std::map<std::string, Result> &_baseline)
+{
+  std::ifstream file(_path.c_str());
+  if (!file.is_open())
+  {
+    std::cerr << "Unable to read baseline [" << _path << "]" << std::endl;
+    return false;
+  }
+
+  std::string name;
+  Result result;
+  while (file >> name >> result.nsPerTick >> result.allocsPerTick)
+    _baseline[name] = result;
+  return true;
+}
+
+/////////////////////////////////////////////////
+int main(int _argc, char **_argv)
+{
+  unsigned int ticks = 1000000;
+  std::string recordingPath;
+  std::string baselinePath;
+  std::string outPath;
+  double ratio = 1.25;
+
+  for (int i = 1; i < _argc; ++i)
+  {
+    std::string arg = _argv[i];
+    if (arg == "-n" && i + 1 < _argc)
+      ticks = atoi(_argv[++i]);
+    else if (arg == "-i" && i + 1 < _argc)
+      recordingPath = _argv[++i];
+    else if (arg == "-b" && i + 1 < _argc)
+      baselinePath = _argv[++i];
+    else if (arg == "-w" && i + 1 < _argc)
+      outPath = _argv[++i];
+    else if (arg == "-t" && i + 1 < _argc)
+      ratio = atof(_argv[++i]);
+    else
+    {
+      Usage();
+      return arg == "-h" || arg == "--help" ? 0 : 1;
+    }
+  }
+  if (ticks == 0)
+  {
+    Usage();
+    return 1;
+  }
+
+  Recording recording;
+  if (recordingPath.empty())
+    SwingRecording(recording);
+  else if (!ReadRecording(recordingPath, recording))
+    return 1;
+
+  std::map<std::string, Result> baseline;
+  if (!baselinePath.empty() && !ReadBaseline(baselinePath, baseline))
+    return 1;
+
+  std::vector<std::pair<std::string, Kernel *> > kernels;
+  kernels.push_back(std::make_pair("pid", new PIDKernel()));
+  kernels.push_back(std::make_pair("filter", new FilterKernel()));
+  kernels.push_back(std::make_pair("command_age_statistics",
+      new StatisticsKernel()));
+  kernels.push_back(std::make_pair("latency_histogram",
+      new HistogramKernel()));
+  kernels.push_back(std::make_pair("asi_process_control_input",
+      new ASIKernel()));
+
+  std::ofstream out;
+  if (!outPath.empty())
+    out.open(outPath.c_str());
+
+  std::cout << recording.position.size() << " samples, " << ticks
+            << " ticks" << std::endl
+            << std::setw(28) << std::left << "kernel"
+            << std::setw(12) << std::right << "ns/tick"
+            << std::setw(14) << "allocs/tick" << std::endl;
+
+  unsigned int regressions = 0;
+  for (unsigned int k = 0; k < kernels.size(); ++k)
+  {
+    const std::string &name = kernels[k].first;
+    Result result = Run(*kernels[k].second, recording, ticks);
+    delete kernels[k].second;
+
+    std::cout << std::setw(28) << std::left << name
+              << std::setw(12) << std::right << std::fixed
+              << std::setprecision(1) << result.nsPerTick
+              << std::setw(14) << std::setprecision(3)
+              << result.allocsPerTick;
+
+    std::map<std::string, Result>::iterator base = baseline.find(name);
+    if (base != baseline.end())
+    {
+      bool slower = result.nsPerTick > base->second.nsPerTick * ratio;
+      // Allocations are deterministic, but the warm up may leave some
+      bool allocates = result.allocsPerTick >
+        base->second.allocsPerTick + 1e-3;
+      if (slower || allocates)
+      {
+        ++regressions;
+        std::cout << "  REGRESSION (baseline " << base->second.nsPerTick
+                  << " ns, " << base->second.allocsPerTick << " allocs)";
+      }
+    }
+    std::cout << std::endl;
+
+    if (out.is_open())
+    {
+      out << name << " " << result.nsPerTick << " " << result.allocsPerTick
+          << std::endl;
+    }
+  }
+
+  if (regressions > 0)
+  {
+    std::cerr << regressions << " kernels regressed beyond " << ratio
+              << " times the baseline" << std::endl;
+    return 1;
+  }
+  return 0;
+}
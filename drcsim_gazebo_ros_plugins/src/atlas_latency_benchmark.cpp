@@ -0,0 +1,304 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+// End to end benchmark of a simulated atlas controller.
+//
+// A synthetic controller answers every AtlasState with an AtlasCommand
+// carrying the state's stamp, like pub_atlas_command_fast.  AtlasPlugin
+// reports the age of the command it is using on
+// /atlas/controller_statistics each step, so the round trip of a command,
+// from the state it answers to the step that first uses it, is the first
+// age reported for its stamp.
+//
+// Recorded, after the sim time reaches ~start_time, for ~duration wall
+// seconds:
+//   rtf            real time factor of each ~rtf_period wall seconds
+//   round_trip     sim ms from a state to the first step using its command
+//   command_age    sim ms, age of the command used at each step
+//   controller     wall ms from receiving a state to publishing a command
+//
+// The report is written as JSON to ~report, or to stdout.
+//
+// Parameters:
+//   ~start_time (5.0), ~duration (30.0), ~rtf_period (1.0),
+//   ~work_us (0), simulated controller work per state,
+//   ~desired_controller_period_ms (0), see AtlasCommand,
+//   ~k_effort (0), so that by default atlas keeps standing under the BDI
+//     controller while its commands are timed,
+//   ~report ("")
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <ros/subscribe_options.h>
+#include <atlas_msgs/AtlasCommand.h>
+#include <atlas_msgs/AtlasState.h>
+#include <atlas_msgs/ControllerStatistics.h>
+
+#include "drcsim_gazebo_ros_plugins/BenchmarkSamples.h"
+
+/// \brief The synthetic controller and the measurements.
+class LatencyBenchmark
+{
+  /// \brief Constructor, reads the parameters and connects to atlas.
+  public: LatencyBenchmark()
+    : pnh("~"), started(false), done(false), states(0), statistics(0),
+      lastAgeMean(0), lastAgeVariance(0)
+  {
+    this->pnh.param("start_time", this->startTime, 5.0);
+    this->pnh.param("duration", this->duration, 30.0);
+    this->pnh.param("rtf_period", this->rtfPeriod, 1.0);
+    this->pnh.param("work_us", this->workUs, 0);
+    this->pnh.param("desired_controller_period_ms", this->controllerPeriodMs,
+      0);
+    this->pnh.param("k_effort", this->kEffort, 0);
+    this->pnh.param("report", this->reportPath, std::string());
+
+    ros::SubscribeOptions atlasStateSo =
+      ros::SubscribeOptions::create<atlas_msgs::AtlasState>(
+      "atlas/atlas_state", 100,
+      boost::bind(&LatencyBenchmark::OnAtlasState, this, _1),
+      ros::VoidPtr(), this->nh.getCallbackQueue());
+    atlasStateSo.transport_hints =
+      ros::TransportHints().reliable().tcpNoDelay(true);
+    this->subAtlasState = this->nh.subscribe(atlasStateSo);
+
+    ros::SubscribeOptions statisticsSo =
+      ros::SubscribeOptions::create<atlas_msgs::ControllerStatistics>(
+      "atlas/controller_statistics", 1000,
+      boost::bind(&LatencyBenchmark::OnControllerStatistics, this, _1),
+      ros::VoidPtr(), this->nh.getCallbackQueue());
+    statisticsSo.transport_hints =
+      ros::TransportHints().reliable().tcpNoDelay(true);
+    this->subStatistics = this->nh.subscribe(statisticsSo);
+
+    this->pubAtlasCommand = this->nh.advertise<atlas_msgs::AtlasCommand>(
+      "atlas/atlas_command", 100, true);
+
+    this->rtfTimer = this->nh.createWallTimer(ros::WallDuration(
+      this->rtfPeriod), &LatencyBenchmark::OnRtfTimer, this);
+  }
+
+  /// \brief Whether the measurements are complete.
+  public: bool IsDone() const
+  {
+    return this->done;
+  }
+
+  /// \brief Answer a state with a command echoing its stamp.
+  private: void OnAtlasState(const atlas_msgs::AtlasState::ConstPtr &_state)
+  {
+    ros::WallTime received = ros::WallTime::now();
+    if (!this->started && _state->header.stamp.toSec() >= this->startTime)
+      this->Start();
+
+    // Hold the current position, with the gains atlas was started with
+    unsigned int joints = _state->position.size();
+    this->command.header.stamp = _state->header.stamp;
+    this->command.position.resize(joints);
+    this->command.k_effort.resize(joints);
+    for (unsigned int i = 0; i < joints; ++i)
+    {
+      this->command.position[i] = _state->position[i];
+      this->command.k_effort[i] = this->kEffort;
+    }
+    this->command.desired_controller_period_ms = this->controllerPeriodMs;
+
+    // simulate working
+    if (this->workUs > 0)
+      ros::WallDuration(this->workUs * 1e-6).sleep();
+
+    this->pubAtlasCommand.publish(this->command);
+
+    if (!this->started || this->done)
+      return;
+    ++this->states;
+    this->pending[Key(_state->header.stamp.toSec())] = true;
+    this->controllerMs.Add((ros::WallTime::now() - received).toSec() * 1e3);
+  }
+
+  /// \brief Record the command age atlas observed, and the round trip of
+  /// the command the first time atlas uses it.
+  private: void OnControllerStatistics(
+    const atlas_msgs::ControllerStatistics::ConstPtr &_msg)
+  {
+    if (!this->started || this->done)
+      return;
+    ++this->statistics;
+    this->commandAgeMs.Add(_msg->command_age * 1e3);
+    this->lastAgeMean = _msg->command_age_mean;
+    this->lastAgeVariance = _msg->command_age_variance;
+
+    // The stamp of the command in use
+    int64_t key = Key(_msg->header.stamp.toSec() - _msg->command_age);
+    std::map<int64_t, bool>::iterator iter = this->pending.find(key);
+    if (iter == this->pending.end())
+      return;
+    this->roundTripMs.Add(_msg->command_age * 1e3);
+    // Older commands were replaced before atlas used them
+    this->pending.erase(this->pending.begin(), ++iter);
+  }
+
+  /// \brief Sample the real time factor, and finish after duration.
+  private: void OnRtfTimer(const ros::WallTimerEvent &/*_event*/)
+  {
+    if (!this->started || this->done)
+      return;
+
+    ros::WallTime wall = ros::WallTime::now();
+    ros::Time sim = ros::Time::now();
+    double wallElapsed = (wall - this->lastRtfWall).toSec();
+    if (wallElapsed > 0)
+      this->rtf.Add((sim - this->lastRtfSim).toSec() / wallElapsed);
+    this->lastRtfWall = wall;
+    this->lastRtfSim = sim;
+
+    if ((wall - this->startWall).toSec() >= this->duration)
+    {
+      this->endSim = sim;
+      this->done = true;
+      this->Report();
+    }
+  }
+
+  /// \brief Start measuring.
+  private: void Start()
+  {
+    this->started = true;
+    this->startWall = this->lastRtfWall = ros::WallTime::now();
+    this->startSim = this->lastRtfSim = ros::Time::now();
+    ROS_INFO("Measuring for %f wall seconds", this->duration);
+  }
+
+  /// \brief Write the report.
+  private: void Report()
+  {
+    std::ostringstream out;
+    out << "{" << std::endl
+        << "  \"wall_time\": " << this->duration << "," << std::endl
+        << "  \"sim_time\": " << (this->endSim - this->startSim).toSec()
+        << "," << std::endl
+        << "  \"work_us\": " << this->workUs << "," << std::endl
+        << "  \"desired_controller_period_ms\": " << this->controllerPeriodMs
+        << "," << std::endl
+        << "  \"states\": " << this->states << "," << std::endl
+        << "  \"statistics\": " << this->statistics << "," << std::endl
+        << "  \"rtf\": {";
+    this->rtf.Write(out);
+    out << ", \"samples\": [";
+    for (unsigned int i = 0; i < this->rtf.values.size(); ++i)
+      out << (i > 0 ? ", " : "") << this->rtf.values[i];
+    out << "]}," << std::endl
+        << "  \"round_trip_ms\": {";
+    this->roundTripMs.Write(out);
+    out << "}," << std::endl
+        << "  \"command_age_ms\": {";
+    this->commandAgeMs.Write(out);
+    out << ", \"window_mean\": " << this->lastAgeMean * 1e3
+        << ", \"window_variance\": " << this->lastAgeVariance * 1e6
+        << "}," << std::endl
+        << "  \"controller_ms\": {";
+    this->controllerMs.Write(out);
+    out << "}" << std::endl << "}" << std::endl;
+
+    if (this->reportPath.empty())
+      std::cout << out.str();
+    else
+    {
+      std::ofstream file(this->reportPath.c_str());
+      file << out.str();
+      if (!file)
+        ROS_ERROR("Unable to write report [%s]", this->reportPath.c_str());
+      else
+        ROS_INFO("Wrote report [%s]", this->reportPath.c_str());
+    }
+  }
+
+  /// \brief Stamps in microseconds, to match stamps after the round trip
+  /// through command_age.
+  private: static int64_t Key(double _stamp)
+  {
+    return static_cast<int64_t>(floor(_stamp * 1e6 + 0.5));
+  }
+
+  private: ros::NodeHandle nh;
+  private: ros::NodeHandle pnh;
+  private: ros::Subscriber subAtlasState;
+  private: ros::Subscriber subStatistics;
+  private: ros::Publisher pubAtlasCommand;
+  private: ros::WallTimer rtfTimer;
+
+  /// \brief Parameters
+  private: double startTime;
+  private: double duration;
+  private: double rtfPeriod;
+  private: int workUs;
+  private: int controllerPeriodMs;
+  private: int kEffort;
+  private: std::string reportPath;
+
+  /// \brief The command, reused
+  private: atlas_msgs::AtlasCommand command;
+
+  private: bool started;
+  private: bool done;
+  private: ros::WallTime startWall;
+  private: ros::Time startSim;
+  private: ros::Time endSim;
+  private: ros::WallTime lastRtfWall;
+  private: ros::Time lastRtfSim;
+
+  /// \brief Stamps of the commands atlas hasn't used yet
+  private: std::map<int64_t, bool> pending;
+
+  private: unsigned int states;
+  private: unsigned int statistics;
+  private: double lastAgeMean;
+  private: double lastAgeVariance;
+  private: BenchmarkSamples rtf;
+  private: BenchmarkSamples roundTripMs;
+  private: BenchmarkSamples commandAgeMs;
+  private: BenchmarkSamples controllerMs;
+};
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "atlas_latency_benchmark");
+  ros::NodeHandle nh;
+
+  // this wait is needed to ensure this ros node has gotten
+  // simulation published /clock message, containing
+  // simulation time.
+  while (ros::ok() && ros::Time::now().toSec() <= 0)
+    ros::WallDuration(0.01).sleep();
+
+  LatencyBenchmark benchmark;
+  while (ros::ok() && !benchmark.IsDone())
+    ros::getGlobalCallbackQueue()->callAvailable(ros::WallDuration(0.01));
+
+  return benchmark.IsDone() ? 0 : 1;
+}
@@ -0,0 +1,632 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+// Closed loop load generator for the controller synchronization of
+// AtlasPlugin, see AtlasCommand::desired_controller_period_ms and
+// AtlasPlugin::EnforceSynchronizationDelay.
+//
+// Emulates ~controllers controllers, each on its own thread, like
+// pub_atlas_command_fast.  Each answers the latest AtlasState, at most once
+// every ~controller_period_ms of sim time, with a command carrying the
+// state's stamp, after computing for a random time.  Commands go to
+// /atlas/atlas_command, or to /atlas/joint_commands, which does not set
+// desired_controller_period_ms.  AtlasSimInterfaceCommand can also be sent
+// on /atlas/atlas_sim_interface_command at ~asi_rate.
+//
+// Recorded, after the sim time reaches ~start_time, for ~duration wall
+// seconds, from /atlas/synchronization_statistics and
+// /atlas/controller_statistics:
+//   rtf               real time factor of each second
+//   delay_in_step_ms  wait of each step for the controllers
+//   window_delay_ms   total wait of each delay window
+//   command_age_ms    age of the command used at each step
+//   compute_ms        emulated compute time of each command
+//   counts of steps and windows that used up their delay budget, and of
+//   steps without a new command.
+// The report is written as JSON to ~report, or to stdout, with the delay
+// settings in use, so that runs with different atlas/delay_max_per_step,
+// atlas/delay_max_per_window and atlas/delay_window_size can be compared.
+//
+// Parameters:
+//   ~controllers (1)
+//   ~command_topic ("atlas_command"), or "joint_commands"
+//   ~controller_period_ms (2), 0 to answer every state
+//   ~desired_controller_period_ms (~controller_period_ms)
+//   ~compute_distribution ("constant"), "uniform", "normal" or
+//     "exponential", with mean ~compute_us (500) and standard deviation
+//     ~compute_stddev_us (0), except exponential whose deviation is its mean
+//   ~jitter_us (0), uniform delay before publishing, after computing
+//   ~drop_probability (0), chance of computing a command but not sending it
+//   ~burst_period (0, none), ~burst_duration (0.1), wall seconds: for
+//     ~burst_duration of every ~burst_period, computing takes
+//     ~burst_compute_us (20000)
+//   ~asi_rate (0, none), ~asi_behavior (3, STAND)
+//   ~k_effort (0), so that atlas keeps standing under the BDI controller
+//   ~start_time (5.0), ~duration (30.0), ~report (""), ~seed (0)
+
+#include <math.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <ros/subscribe_options.h>
+#include <atlas_msgs/AtlasCommand.h>
+#include <atlas_msgs/AtlasSimInterfaceCommand.h>
+#include <atlas_msgs/AtlasState.h>
+#include <atlas_msgs/ControllerStatistics.h>
+#include <atlas_msgs/SynchronizationStatistics.h>
+#include <osrf_msgs/JointCommands.h>
+
+#include "drcsim_gazebo_ros_plugins/BenchmarkSamples.h"
+
+/// \brief Settings shared by the emulated controllers
+class ControllerSettings
+{
+  /// \brief Read the parameters.
+  /// \param[in] _pnh Private node handle.
+  public: explicit ControllerSettings(ros::NodeHandle &_pnh)
+  {
+    _pnh.param("command_topic", this->commandTopic,
+      std::string("atlas_command"));
+    _pnh.param("controller_period_ms", this->periodMs, 2);
+    _pnh.param("desired_controller_period_ms", this->desiredPeriodMs,
+      this->periodMs);
+    _pnh.param("compute_distribution", this->distribution,
+      std::string("constant"));
+    _pnh.param("compute_us", this->computeUs, 500.0);
+    _pnh.param("compute_stddev_us", this->computeStddevUs, 0.0);
+    _pnh.param("jitter_us", this->jitterUs, 0.0);
+    _pnh.param("drop_probability", this->dropProbability, 0.0);
+    _pnh.param("burst_period", this->burstPeriod, 0.0);
+    _pnh.param("burst_duration", this->burstDuration, 0.1);
+    _pnh.param("burst_compute_us", this->burstComputeUs, 20000.0);
+    _pnh.param("k_effort", this->kEffort, 0);
+    _pnh.param("seed", this->seed, 0);
+    this->start = ros::WallTime::now();
+  }
+
+  /// \brief Whether a wall time is within a burst.
+  public: bool InBurst(const ros::WallTime &_time) const
+  {
+    if (this->burstPeriod <= 0)
+      return false;
+    return fmod((_time - this->start).toSec(), this->burstPeriod) <
+      this->burstDuration;
+  }
+
+  public: std::string commandTopic;
+  public: int periodMs;
+  public: int desiredPeriodMs;
+  public: std::string distribution;
+  public: double computeUs;
+  public: double computeStddevUs;
+  public: double jitterUs;
+  public: double dropProbability;
+  public: double burstPeriod;
+  public: double burstDuration;
+  public: double burstComputeUs;
+  public: int kEffort;
+  public: int seed;
+
+  /// \brief Reference of the bursts
+  public: ros::WallTime start;
+};
+
+/// \brief An emulated controller, answering states on its own thread.
+class EmulatedController
+{
+  /// \brief Constructor, subscribes to the state and starts the thread.
+  /// \param[in] _settings Shared settings, must outlive the controller.
+  /// \param[in] _index Index of the controller, to seed its generator.
+  public: EmulatedController(const ControllerSettings &_settings,
+                             unsigned int _index)
+    : settings(_settings), spinner(1, &this->queue), measuring(false),
+      answered(0), dropped(0)
+  {
+    this->generator.seed(static_cast<uint32_t>(
+      this->settings.seed * 1000 + _index + 1));
+
+    // Like a real controller, only the latest state matters
+    ros::SubscribeOptions atlasStateSo =
+      ros::SubscribeOptions::create<atlas_msgs::AtlasState>(
+      "atlas/atlas_state", 1,
+      boost::bind(&EmulatedController::OnAtlasState, this, _1),
+      ros::VoidPtr(), &this->queue);
+    atlasStateSo.transport_hints =
+      ros::TransportHints().reliable().tcpNoDelay(true);
+    this->subAtlasState = this->nh.subscribe(atlasStateSo);
+
+    if (this->settings.commandTopic == "joint_commands")
+      this->pubCommand = this->nh.advertise<osrf_msgs::JointCommands>(
+        "atlas/joint_commands", 100, true);
+    else
+      this->pubCommand = this->nh.advertise<atlas_msgs::AtlasCommand>(
+        "atlas/atlas_command", 100, true);
+
+    this->spinner.start();
+  }
+
+  /// \brief Destructor
+  public: ~EmulatedController()
+  {
+    this->Stop();
+  }
+
+  /// \brief Start or stop recording.
+  public: void Measure(bool _measuring)
+  {
+    boost::mutex::scoped_lock lock(this->mutex);
+    this->measuring = _measuring;
+  }
+
+  /// \brief Stop answering.
+  public: void Stop()
+  {
+    this->spinner.stop();
+    this->subAtlasState.shutdown();
+  }
+
+  /// \brief Answer a state, if the last answer is old enough.
+  private: void OnAtlasState(const atlas_msgs::AtlasState::ConstPtr &_state)
+  {
+    if (!this->lastAnswered.isZero() &&
+        (_state->header.stamp - this->lastAnswered).toSec() * 1000 <
+        this->settings.periodMs)
+      return;
+    this->lastAnswered = _state->header.stamp;
+
+    double computeUs = this->SampleComputeUs(ros::WallTime::now());
+    if (computeUs > 0)
+      ros::WallDuration(computeUs * 1e-6).sleep();
+
+    bool drop = this->Uniform() < this->settings.dropProbability;
+    if (!drop)
+    {
+      if (this->settings.jitterUs > 0)
+        ros::WallDuration(this->Uniform() * this->settings.jitterUs *
+          1e-6).sleep();
+      this->Publish(*_state);
+    }
+
+    boost::mutex::scoped_lock lock(this->mutex);
+    if (!this->measuring)
+      return;
+    ++this->answered;
+    if (drop)
+      ++this->dropped;
+    this->computeMs.Add(computeUs * 1e-3);
+  }
+
+  /// \brief Hold the current position, with the gains atlas was started
+  /// with, and echo the stamp of the state.
+  private: void Publish(const atlas_msgs::AtlasState &_state)
+  {
+    unsigned int joints = _state.position.size();
+    if (this->settings.commandTopic == "joint_commands")
+    {
+      this->jointCommands.header.stamp = _state.header.stamp;
+      this->jointCommands.position.assign(_state.position.begin(),
+        _state.position.end());
+      this->pubCommand.publish(this->jointCommands);
+      return;
+    }
+
+    this->command.header.stamp = _state.header.stamp;
+    this->command.position.resize(joints);
+    this->command.k_effort.resize(joints);
+    for (unsigned int i = 0; i < joints; ++i)
+    {
+      this->command.position[i] = _state.position[i];
+      this->command.k_effort[i] = this->settings.kEffort;
+    }
+    this->command.desired_controller_period_ms =
+      this->settings.desiredPeriodMs;
+    this->pubCommand.publish(this->command);
+  }
+
+  /// \brief Draw the compute time of a command.
+  /// \param[in] _now Wall time, to tell bursts.
+  /// \return Microseconds, not negative.
+  private: double SampleComputeUs(const ros::WallTime &_now)
+  {
+    if (this->settings.InBurst(_now))
+      return this->settings.burstComputeUs;
+
+    const std::string &dist = this->settings.distribution;
+    double mean = this->settings.computeUs;
+    double stddev = this->settings.computeStddevUs;
+    double value = mean;
+    if (dist == "uniform")
+      value = mean + (2 * this->Uniform() - 1) * sqrt(3.0) * stddev;
+    else if (dist == "normal")
+    {
+      // Box-Muller
+      double u1 = std::max(this->Uniform(), 1e-12);
+      double u2 = this->Uniform();
+      value = mean + stddev * sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+    }
+    else if (dist == "exponential")
+      value = -mean * log(std::max(1 - this->Uniform(), 1e-12));
+    return std::max(value, 0.0);
+  }
+
+  /// \brief Uniform number in [0, 1).
+  private: double Uniform()
+  {
+    return this->generator() / 4294967296.0;
+  }
+
+  private: const ControllerSettings &settings;
+  private: ros::NodeHandle nh;
+  private: ros::CallbackQueue queue;
+  private: ros::AsyncSpinner spinner;
+  private: ros::Subscriber subAtlasState;
+  private: ros::Publisher pubCommand;
+
+  /// \brief The commands, reused
+  private: atlas_msgs::AtlasCommand command;
+  private: osrf_msgs::JointCommands jointCommands;
+
+  /// \brief Stamp of the last state answered
+  private: ros::Time lastAnswered;
+
+  private: boost::mt19937 generator;
+
+  /// \brief Protects the measures, read by the main thread
+  public: boost::mutex mutex;
+  private: bool measuring;
+  public: unsigned int answered;
+  public: unsigned int dropped;
+  public: BenchmarkSamples computeMs;
+};
+
+typedef boost::shared_ptr<EmulatedController> EmulatedControllerPtr;
+
+/// \brief The controllers, the AtlasSimInterfaceCommand traffic and the
+/// measurements.
+class LoadGenerator
+{
+  /// \brief Constructor, reads the parameters and starts the controllers.
+  public: LoadGenerator()
+    : pnh("~"), settings(pnh), started(false), done(false), steps(0),
+      budgetSteps(0), windows(0), budgetWindows(0), windowDelay(0),
+      windowRemain(0), firstStaleTicks(-1), lastStaleTicks(0), asiSent(0)
+  {
+    int controllers;
+    this->pnh.param("controllers", controllers, 1);
+    this->pnh.param("asi_rate", this->asiRate, 0.0);
+    this->pnh.param("asi_behavior", this->asiBehavior,
+      static_cast<int>(atlas_msgs::AtlasSimInterfaceCommand::STAND));
+    this->pnh.param("start_time", this->startTime, 5.0);
+    this->pnh.param("duration", this->duration, 30.0);
+    this->pnh.param("report", this->reportPath, std::string());
+
+    // Defaults of AtlasPlugin::AtlasPlugin
+    this->nh.param("atlas/delay_window_size", this->delayWindowSize, 5.0);
+    this->nh.param("atlas/delay_max_per_window", this->delayMaxPerWindow,
+      0.25);
+    this->nh.param("atlas/delay_max_per_step", this->delayMaxPerStep, 0.025);
+
+    ros::SubscribeOptions delaySo =
+      ros::SubscribeOptions::create<atlas_msgs::SynchronizationStatistics>(
+      "atlas/synchronization_statistics", 1000,
+      boost::bind(&LoadGenerator::OnSynchronizationStatistics, this, _1),
+      ros::VoidPtr(), this->nh.getCallbackQueue());
+    delaySo.transport_hints =
+      ros::TransportHints().reliable().tcpNoDelay(true);
+    this->subDelay = this->nh.subscribe(delaySo);
+
+    ros::SubscribeOptions statisticsSo =
+      ros::SubscribeOptions::create<atlas_msgs::ControllerStatistics>(
+      "atlas/controller_statistics", 1000,
+      boost::bind(&LoadGenerator::OnControllerStatistics, this, _1),
+      ros::VoidPtr(), this->nh.getCallbackQueue());
+    statisticsSo.transport_hints =
+      ros::TransportHints().reliable().tcpNoDelay(true);
+    this->subStatistics = this->nh.subscribe(statisticsSo);
+
+    if (this->asiRate > 0)
+    {
+      this->pubASICommand =
+        this->nh.advertise<atlas_msgs::AtlasSimInterfaceCommand>(
+        "atlas/atlas_sim_interface_command", 100, true);
+      this->asiCommand.behavior = this->asiBehavior;
+      this->asiTimer = this->nh.createWallTimer(ros::WallDuration(
+        1.0 / this->asiRate), &LoadGenerator::OnASITimer, this);
+    }
+
+    this->rtfTimer = this->nh.createWallTimer(ros::WallDuration(1.0),
+      &LoadGenerator::OnRtfTimer, this);
+
+    for (int i = 0; i < controllers; ++i)
+    {
+      this->controllers.push_back(EmulatedControllerPtr(
+        new EmulatedController(this->settings, i)));
+    }
+    ROS_INFO("Started %d emulated controllers", controllers);
+  }
+
+  /// \brief Whether the measurements are complete.
+  public: bool IsDone() const
+  {
+    return this->done;
+  }
+
+  /// \brief Record the delay of a step, and of its window once it ends.
+  private: void OnSynchronizationStatistics(
+    const atlas_msgs::SynchronizationStatistics::ConstPtr &_msg)
+  {
+    if (!this->started && ros::Time::now().toSec() >= this->startTime)
+      this->Start();
+    if (!this->started || this->done)
+      return;
+
+    // The remaining time grows back when a new window starts
+    if (_msg->delay_window_remain > this->windowRemain && this->steps > 0)
+    {
+      ++this->windows;
+      this->windowDelayMs.Add(this->windowDelay * 1e3);
+      if (this->windowDelay >= this->delayMaxPerWindow)
+        ++this->budgetWindows;
+    }
+    this->windowRemain = _msg->delay_window_remain;
+    this->windowDelay = _msg->delay_in_window;
+
+    ++this->steps;
+    this->delayInStepMs.Add(_msg->delay_in_step * 1e3);
+    if (_msg->delay_in_step >= this->delayMaxPerStep)
+      ++this->budgetSteps;
+  }
+
+  /// \brief Record the age of the command used at each step.
+  private: void OnControllerStatistics(
+    const atlas_msgs::ControllerStatistics::ConstPtr &_msg)
+  {
+    if (!this->started && ros::Time::now().toSec() >= this->startTime)
+      this->Start();
+    if (!this->started || this->done)
+      return;
+
+    this->commandAgeMs.Add(_msg->command_age * 1e3);
+    if (this->firstStaleTicks < 0)
+      this->firstStaleTicks = _msg->stale_ticks;
+    this->lastStaleTicks = _msg->stale_ticks;
+    this->lastStatistics = *_msg;
+  }
+
+  /// \brief Send an AtlasSimInterfaceCommand.
+  private: void OnASITimer(const ros::WallTimerEvent &/*_event*/)
+  {
+    // k_effort is left empty, so that AtlasPlugin keeps the one of the
+    // commands
+    this->asiCommand.header.stamp = ros::Time::now();
+    this->pubASICommand.publish(this->asiCommand);
+    if (this->started && !this->done)
+      ++this->asiSent;
+  }
+
+  /// \brief Sample the real time factor, and finish after duration.
+  private: void OnRtfTimer(const ros::WallTimerEvent &/*_event*/)
+  {
+    if (!this->started || this->done)
+      return;
+
+    ros::WallTime wall = ros::WallTime::now();
+    ros::Time sim = ros::Time::now();
+    double wallElapsed = (wall - this->lastRtfWall).toSec();
+    if (wallElapsed > 0)
+      this->rtf.Add((sim - this->lastRtfSim).toSec() / wallElapsed);
+    this->lastRtfWall = wall;
+    this->lastRtfSim = sim;
+
+    if ((wall - this->startWall).toSec() >= this->duration)
+    {
+      this->endSim = sim;
+      this->done = true;
+      for (unsigned int i = 0; i < this->controllers.size(); ++i)
+        this->controllers[i]->Measure(false);
+      this->Report();
+    }
+  }
+
+  /// \brief Start measuring.
+  private: void Start()
+  {
+    this->started = true;
+    this->startWall = this->lastRtfWall = ros::WallTime::now();
+    this->startSim = this->lastRtfSim = ros::Time::now();
+    for (unsigned int i = 0; i < this->controllers.size(); ++i)
+      this->controllers[i]->Measure(true);
+    ROS_INFO("Measuring for %f wall seconds", this->duration);
+  }
+
+  /// \brief Write the report.
+  private: void Report()
+  {
+    unsigned int answered = 0;
+    unsigned int dropped = 0;
+    BenchmarkSamples computeMs;
+    for (unsigned int i = 0; i < this->controllers.size(); ++i)
+    {
+      EmulatedController &c = *this->controllers[i];
+      boost::mutex::scoped_lock lock(c.mutex);
+      answered += c.answered;
+      dropped += c.dropped;
+      computeMs.values.insert(computeMs.values.end(),
+        c.computeMs.values.begin(), c.computeMs.values.end());
+    }
+
+    const atlas_msgs::ControllerStatistics &last = this->lastStatistics;
+    std::ostringstream out;
+    out << "{" << std::endl
+        << "  \"wall_time\": " << this->duration << "," << std::endl
+        << "  \"sim_time\": " << (this->endSim - this->startSim).toSec()
+        << "," << std::endl
+        << "  \"settings\": {"
+        << "\"controllers\": " << this->controllers.size()
+        << ", \"command_topic\": \"" << this->settings.commandTopic << "\""
+        << ", \"controller_period_ms\": " << this->settings.periodMs
+        << ", \"desired_controller_period_ms\": "
+        << this->settings.desiredPeriodMs
+        << ", \"compute_distribution\": \"" << this->settings.distribution
+        << "\""
+        << ", \"compute_us\": " << this->settings.computeUs
+        << ", \"compute_stddev_us\": " << this->settings.computeStddevUs
+        << ", \"jitter_us\": " << this->settings.jitterUs
+        << ", \"drop_probability\": " << this->settings.dropProbability
+        << ", \"burst_period\": " << this->settings.burstPeriod
+        << ", \"burst_duration\": " << this->settings.burstDuration
+        << ", \"burst_compute_us\": " << this->settings.burstComputeUs
+        << ", \"asi_rate\": " << this->asiRate
+        << ", \"delay_window_size\": " << this->delayWindowSize
+        << ", \"delay_max_per_window\": " << this->delayMaxPerWindow
+        << ", \"delay_max_per_step\": " << this->delayMaxPerStep
+        << "}," << std::endl
+        << "  \"commands\": {\"answered\": " << answered
+        << ", \"dropped\": " << dropped
+        << ", \"asi_sent\": " << this->asiSent << "}," << std::endl
+        << "  \"steps\": {\"synchronized\": " << this->steps
+        << ", \"step_budget_used_up\": " << this->budgetSteps
+        << ", \"without_new_command\": "
+        << (this->firstStaleTicks < 0 ? 0 :
+            this->lastStaleTicks - this->firstStaleTicks)
+        << "}," << std::endl
+        << "  \"windows\": {\"count\": " << this->windows
+        << ", \"window_budget_used_up\": " << this->budgetWindows
+        << "}," << std::endl
+        << "  \"rtf\": {";
+    this->rtf.Write(out);
+    out << "}," << std::endl
+        << "  \"delay_in_step_ms\": {";
+    this->delayInStepMs.Write(out);
+    out << ", \"last_window_p99\": "
+        << last.synchronization_delay_p99 * 1e3
+        << ", \"last_window_max\": "
+        << last.synchronization_delay_max * 1e3
+        << "}," << std::endl
+        << "  \"window_delay_ms\": {";
+    this->windowDelayMs.Write(out);
+    out << "}," << std::endl
+        << "  \"command_age_ms\": {";
+    this->commandAgeMs.Write(out);
+    out << "}," << std::endl
+        << "  \"compute_ms\": {";
+    computeMs.Write(out);
+    out << "}" << std::endl << "}" << std::endl;
+
+    if (this->reportPath.empty())
+      std::cout << out.str();
+    else
+    {
+      std::ofstream file(this->reportPath.c_str());
+      file << out.str();
+      if (!file)
+        ROS_ERROR("Unable to write report [%s]", this->reportPath.c_str());
+      else
+        ROS_INFO("Wrote report [%s]", this->reportPath.c_str());
+    }
+  }
+
+  private: ros::NodeHandle nh;
+  private: ros::NodeHandle pnh;
+  private: ros::Subscriber subDelay;
+  private: ros::Subscriber subStatistics;
+  private: ros::Publisher pubASICommand;
+  private: ros::WallTimer asiTimer;
+  private: ros::WallTimer rtfTimer;
+
+  /// \brief Parameters
+  private: ControllerSettings settings;
+  private: double asiRate;
+  private: int asiBehavior;
+  private: double startTime;
+  private: double duration;
+  private: std::string reportPath;
+  private: double delayWindowSize;
+  private: double delayMaxPerWindow;
+  private: double delayMaxPerStep;
+
+  private: std::vector<EmulatedControllerPtr> controllers;
+
+  /// \brief The AtlasSimInterfaceCommand, reused
+  private: atlas_msgs::AtlasSimInterfaceCommand asiCommand;
+
+  private: bool started;
+  private: bool done;
+  private: ros::WallTime startWall;
+  private: ros::Time startSim;
+  private: ros::Time endSim;
+  private: ros::WallTime lastRtfWall;
+  private: ros::Time lastRtfSim;
+
+  /// \brief Steps with synchronization, and those that waited for the
+  /// whole delay_max_per_step
+  private: unsigned int steps;
+  private: unsigned int budgetSteps;
+
+  /// \brief Delay windows ended, and those that used up
+  /// delay_max_per_window
+  private: unsigned int windows;
+  private: unsigned int budgetWindows;
+
+  /// \brief Delay so far, and time left, of the current window
+  private: double windowDelay;
+  private: double windowRemain;
+
+  /// \brief ControllerStatistics::stale_ticks at start and now
+  private: int64_t firstStaleTicks;
+  private: int64_t lastStaleTicks;
+
+  /// \brief Latest controller statistics
+  private: atlas_msgs::ControllerStatistics lastStatistics;
+
+  private: unsigned int asiSent;
+  private: BenchmarkSamples rtf;
+  private: BenchmarkSamples delayInStepMs;
+  private: BenchmarkSamples windowDelayMs;
+  private: BenchmarkSamples commandAgeMs;
+};
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "atlas_load_generator");
+  ros::NodeHandle nh;
+
+  // this wait is needed to ensure this ros node has gotten
+  // simulation published /clock message, containing
+  // simulation time.
+  while (ros::ok() && ros::Time::now().toSec() <= 0)
+    ros::WallDuration(0.01).sleep();
+
+  LoadGenerator generator;
+  while (ros::ok() && !generator.IsDone())
+    ros::getGlobalCallbackQueue()->callAvailable(ros::WallDuration(0.01));
+
+  return generator.IsDone() ? 0 : 1;
+}
@@ -0,0 +1,342 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+// Compare the contact traffic of a two hand grasp when each contact
+// consumer has its own contact manager filter, the way the contact plugins
+// used to subscribe, with the traffic when they share a ContactDemux.
+//
+//   contact_demux_benchmark [-n steps]
+//
+// Each hand has a palm and three fingers pinching a box that rests on a
+// table.  Every hand has two consumers, like SandiaHandPlugin (all of its
+// collisions) and a ContactModelPlugin (its fingertips).
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <gazebo/gazebo.hh>
+#include <gazebo/physics/physics.hh>
+#include <gazebo/physics/ContactManager.hh>
+#include <gazebo/transport/transport.hh>
+#include <gazebo/common/common.hh>
+#if GAZEBO_MAJOR_VERSION <= 2
+#include <gazebo/Master.hh>
+#endif
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "drcsim_gazebo_ros_plugins/ContactDemux.hh"
+
+using namespace gazebo;
+
+namespace
+{
+  /// \brief Contact traffic seen by the consumers of one setup
+  struct Traffic
+  {
+    Traffic() : messages(0), bytes(0), contacts(0) {}
+
+    /// \brief Contacts messages received
+    unsigned int messages;
+
+    /// \brief Serialized size of the messages received
+    unsigned int bytes;
+
+    /// \brief Contacts handed to consumers
+    unsigned int contacts;
+  };
+
+  /// \brief Protects the traffic counters and lastMsg
+  boost::mutex trafficMutex;
+
+  /// \brief Last message seen from the demux, so that a message shared by
+  /// several consumers is counted once
+  ConstContactsPtr lastMsg;
+}
+
+/////////////////////////////////////////////////
+void Usage()
+{
+  std::cerr << "Usage: contact_demux_benchmark [-n steps]" << std::endl;
+}
+
+/////////////////////////////////////////////////
+/// \brief SDF for a box collision.
+std::string Box(const std::string &_name, const math::Pose &_pose,
+                const math::Vector3 &_size)
+{
+  std::ostringstream stream;
+  stream << "<collision name='" << _name << "'>"
+         << "<pose>" << _pose << "</pose>"
+         << "<geometry><box><size>" << _size << "</size></box></geometry>"
+         << "</collision>";
+  return stream.str();
+}
+
+/////////////////////////////////////////////////
+/// \brief SDF for a static hand on one side of the object, with its
+/// fingers pressed against the object.
+/// \param[in] _side +1 or -1, the side of the object along x.
+std::string Hand(const std::string &_name, double _side)
+{
+  std::ostringstream stream;
+  stream << "<model name='" << _name << "'><static>true</static>"
+         << "<pose>" << _side * 0.1 << " 0 0.85 0 0 0</pose>"
+         << "<link name='palm'>"
+         << Box("palm", math::Pose(_side * 0.02, 0, 0, 0, 0, 0),
+                math::Vector3(0.02, 0.1, 0.1));
+  for (int f = 0; f < 3; ++f)
+  {
+    std::string finger = "f" + boost::lexical_cast<std::string>(f);
+    double y = (f - 1) * 0.035;
+    // The fingertips overlap the object by 1 mm
+    stream << Box(finger + "_1", math::Pose(-_side * 0.016, y, -0.03, 0, 0, 0),
+                  math::Vector3(0.05, 0.02, 0.02))
+           << Box(finger + "_2", math::Pose(-_side * 0.046, y, -0.03, 0, 0, 0),
+                  math::Vector3(0.01, 0.02, 0.03));
+  }
+  stream << "</link></model>";
+  return stream.str();
+}
+
+/////////////////////////////////////////////////
+/// \brief The grasp world.
+std::string GraspWorld()
+{
+  std::ostringstream stream;
+  stream << "<sdf version='" << SDF_VERSION << "'>"
+         << "<world name='contact_demux_benchmark'>"
+         << "<model name='table'><static>true</static><link name='link'>"
+         << Box("top", math::Pose(0, 0, 0.375, 0, 0, 0),
+                math::Vector3(1, 1, 0.75))
+         << "</link></model>"
+         << "<model name='object'><pose>0 0 0.8 0 0 0</pose><link name='link'>"
+         << "<inertial><mass>0.5</mass></inertial>"
+         << Box("box", math::Pose(), math::Vector3(0.1, 0.12, 0.1))
+         << "</link></model>"
+         << Hand("left_hand", -1) << Hand("right_hand", 1)
+         << "</world></sdf>";
+  return stream.str();
+}
+
+/////////////////////////////////////////////////
+/// \brief Scoped names of the collisions of a hand.
+/// \param[in] _tips Only the fingertips
+std::vector<std::string> HandCollisions(const std::string &_hand, bool _tips)
+{
+  std::vector<std::string> collisions;
+  if (!_tips)
+    collisions.push_back(_hand + "::palm::palm");
+  for (int f = 0; f < 3; ++f)
+  {
+    std::string finger = _hand + "::palm::f" +
+      boost::lexical_cast<std::string>(f);
+    if (!_tips)
+      collisions.push_back(finger + "_1");
+    collisions.push_back(finger + "_2");
+  }
+  return collisions;
+}
+
+/////////////////////////////////////////////////
+/// \brief Count a message from a contact manager filter.
+void OnFilterContacts(ConstContactsPtr &_msg, Traffic *_traffic)
+{
+  boost::mutex::scoped_lock lock(trafficMutex);
+  ++_traffic->messages;
+  _traffic->bytes += _msg->ByteSize();
+  _traffic->contacts += _msg->contact_size();
+}
+
+/////////////////////////////////////////////////
+/// \brief Count a view from the contact demux.
+void OnDemuxContacts(const ContactView &_view, Traffic *_traffic)
+{
+  boost::mutex::scoped_lock lock(trafficMutex);
+  // The demux hands out views of one message to all consumers in turn
+  if (_view.GetMessage() != lastMsg)
+  {
+    lastMsg = _view.GetMessage();
+    ++_traffic->messages;
+    _traffic->bytes += lastMsg->ByteSize();
+  }
+  _traffic->contacts += _view.GetContactCount();
+}
+
+/////////////////////////////////////////////////
+/// \brief Step the world, then let the transport threads catch up.
+void Run(physics::WorldPtr _world, unsigned int _steps)
+{
+  _world->Step(_steps);
+  // Deliver the last contacts
+  common::Time::MSleep(500);
+  _world->Step(1);
+}
+
+/////////////////////////////////////////////////
+/// \brief Run the grasp with one filter per consumer, then with the demux.
+/// \return true on success
+bool Benchmark(unsigned int _steps)
+{
+  sdf::SDFPtr worldDoc(new sdf::SDF);
+  sdf::init(worldDoc);
+  if (!sdf::readString(GraspWorld(), worldDoc))
+  {
+    gzerr << "Unable to parse the benchmark world" << std::endl;
+    return false;
+  }
+  sdf::ElementPtr worldSdf = worldDoc->root->GetElement("world");
+
+  physics::WorldPtr world =
+    physics::create_world(worldSdf->Get<std::string>("name"));
+  physics::load_world(world, worldSdf);
+  physics::init_world(world);
+
+  std::vector<std::vector<std::string> > consumers;
+  const std::string hands[] = {"left_hand", "right_hand"};
+  for (unsigned int h = 0; h < 2; ++h)
+  {
+    consumers.push_back(HandCollisions(hands[h], false));
+    consumers.push_back(HandCollisions(hands[h], true));
+  }
+
+  // Settle the object into the grasp, without counting
+  world->Step(100);
+
+  // One contact manager filter per consumer
+  Traffic filtered;
+  {
+    transport::NodePtr node(new transport::Node());
+    node->Init(world->GetName());
+    physics::ContactManager *mgr =
+      world->GetPhysicsEngine()->GetContactManager();
+
+    std::vector<transport::SubscriberPtr> subs;
+    std::vector<std::string> filters;
+    for (unsigned int i = 0; i < consumers.size(); ++i)
+    {
+      filters.push_back("contact_demux_benchmark_" +
+          boost::lexical_cast<std::string>(i));
+      std::string topic = mgr->CreateFilter(filters.back(), consumers[i]);
+      subs.push_back(node->Subscribe(topic,
+          boost::function<void (ConstContactsPtr &)>(
+          boost::bind(&OnFilterContacts, _1, &filtered))));
+    }
+
+    Run(world, _steps);
+
+    subs.clear();
+#if GAZEBO_MAJOR_VERSION >= 2
+    for (unsigned int i = 0; i < filters.size(); ++i)
+      mgr->RemoveFilter(filters[i]);
+#endif
+  }
+
+  // The same consumers on the demux
+  Traffic demuxed;
+  unsigned int demuxMessages = 0;
+  {
+    ContactDemuxPtr demux = ContactDemux::Get(world);
+    std::vector<unsigned int> ids;
+    for (unsigned int i = 0; i < consumers.size(); ++i)
+    {
+      ids.push_back(demux->Connect(consumers[i],
+          boost::bind(&OnDemuxContacts, _1, &demuxed)));
+    }
+
+    // The filter is created at the first update
+    world->Step(1);
+    unsigned int startMessages = demux->GetMessageCount();
+    Run(world, _steps);
+    demuxMessages = demux->GetMessageCount() - startMessages;
+
+    for (unsigned int i = 0; i < ids.size(); ++i)
+      demux->Disconnect(ids[i]);
+    lastMsg.reset();
+  }
+
+  std::cout << "Two hand grasp, " << consumers.size() << " consumers, "
+            << _steps << " steps" << std::endl
+            << "  filter per consumer: " << filtered.messages
+            << " messages, " << filtered.bytes << " bytes, "
+            << filtered.contacts << " contacts" << std::endl
+            << "  contact demux:       " << demuxed.messages
+            << " messages (" << demuxMessages << " received), "
+            << demuxed.bytes << " bytes, " << demuxed.contacts
+            << " contacts" << std::endl;
+  if (filtered.bytes > 0)
+  {
+    std::cout << "  demux bytes / filter bytes: "
+              << static_cast<double>(demuxed.bytes) / filtered.bytes
+              << std::endl;
+  }
+  return filtered.contacts > 0 && demuxed.contacts > 0;
+}
+
+/////////////////////////////////////////////////
+int main(int _argc, char **_argv)
+{
+  unsigned int steps = 1000;
+  for (int i = 1; i < _argc; ++i)
+  {
+    std::string arg = _argv[i];
+    if (arg == "-n" && i + 1 < _argc)
+      steps = atoi(_argv[++i]);
+    else
+    {
+      Usage();
+      return arg == "-h" || arg == "--help" ? 0 : 1;
+    }
+  }
+
+#if GAZEBO_MAJOR_VERSION > 2
+  if (!gazebo::setupServer())
+    return 1;
+#else
+  gazebo::Master *master = new gazebo::Master();
+  master->Init(11345);
+  master->RunThread();
+  if (!gazebo::load() || !gazebo::init())
+    return 1;
+  physics::load();
+#endif
+
+  bool result = false;
+  try
+  {
+    result = Benchmark(steps);
+  }
+  catch(common::Exception &_e)
+  {
+    gzerr << "Benchmark failed: " << _e << std::endl;
+  }
+
+#if GAZEBO_MAJOR_VERSION > 2
+  gazebo::shutdown();
+#else
+  gazebo::fini();
+  master->Stop();
+  master->Fini();
+  delete master;
+#endif
+  return result ? 0 : 1;
+}
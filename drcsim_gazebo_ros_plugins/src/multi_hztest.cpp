@@ -0,0 +1,424 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+// rostest that checks the publication rate of many topics in one launch,
+// instead of one rostest/hztest per topic, each relaunching the simulation.
+//
+// All the topics are measured at the same time, over the same
+// ~test_duration sim seconds, once every topic published something or
+// ~wait_time wall seconds passed.  Like hztest, receipts are stamped with
+// ROS time, which is sim time, so rates don't depend on the real time
+// factor.  For each topic:
+//   hz       (count - 1) / (last - first receipt)
+//   jitter   standard deviation of the ROS time between messages
+//   max_gap  longest ROS time between messages
+//   latency  mean ROS time from header.stamp to receipt, for messages
+//            that start with a Header
+//
+// Private parameters:
+//   ~topics, list of
+//     topic        name
+//     hz           expected rate, 0 to expect no message
+//     hzerror      allowed error of the rate
+//     max_jitter   optional bound of jitter, seconds
+//     max_latency  optional bound of latency, seconds
+//   ~wait_time (20.0)
+//   ~test_duration (10.0)
+//
+// The measures of every topic are also recorded as properties of the test
+// in its result file.
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <gtest/gtest.h>
+
+#include <ros/ros.h>
+#include <topic_tools/shape_shifter.h>
+
+/// \brief Expectations and measures of a topic
+class TopicRate
+{
+  /// \brief Constructor
+  /// \param[in] _topic Name of the topic.
+  public: explicit TopicRate(const std::string &_topic)
+    : topic(_topic), hz(0), hzError(0), maxJitter(-1), maxLatency(-1),
+      measuring(false), stamped(-1)
+  {
+    this->Reset();
+  }
+
+  /// \brief Start receiving messages.
+  /// \param[in] _nh Node handle to subscribe with.
+  public: void Subscribe(ros::NodeHandle &_nh)
+  {
+    this->sub = _nh.subscribe(this->topic, 100, &TopicRate::OnMessage, this,
+      ros::TransportHints().tcpNoDelay());
+  }
+
+  /// \brief Stop receiving messages.
+  public: void Unsubscribe()
+  {
+    this->sub.shutdown();
+  }
+
+  /// \brief Whether a message was received since the last Reset.
+  public: bool Received()
+  {
+    boost::mutex::scoped_lock lock(this->mutex);
+    return this->count > 0;
+  }
+
+  /// \brief Forget the messages received so far, and start or stop
+  /// measuring the next ones.
+  /// \param[in] _measuring True to measure.
+  public: void Reset(bool _measuring = false)
+  {
+    boost::mutex::scoped_lock lock(this->mutex);
+    this->measuring = _measuring;
+    this->count = 0;
+    this->gapSum = 0;
+    this->gapSumSq = 0;
+    this->maxGap = 0;
+    this->latencyCount = 0;
+    this->latencySum = 0;
+    this->latencyMax = 0;
+  }
+
+  /// \brief Measured rate in Hz, 0 with less than 2 messages.
+  public: double GetHz() const
+  {
+    double span = (this->last - this->first).toSec();
+    if (this->count < 2 || span <= 0)
+      return 0.0;
+    return (this->count - 1) / span;
+  }
+
+  /// \brief Standard deviation of the time between messages.
+  public: double GetJitter() const
+  {
+    if (this->count < 2)
+      return 0.0;
+    double n = this->count - 1;
+    double mean = this->gapSum / n;
+    return std::sqrt(std::max(this->gapSumSq / n - mean * mean, 0.0));
+  }
+
+  /// \brief Mean latency, 0 if the messages have no header.
+  public: double GetLatency() const
+  {
+    if (this->latencyCount == 0)
+      return 0.0;
+    return this->latencySum / this->latencyCount;
+  }
+
+  /// \brief Callback for every message on the topic.
+  /// \param[in] _event The message and its receipt time.
+  private: void OnMessage(
+    const ros::MessageEvent<topic_tools::ShapeShifter const> &_event)
+  {
+    ros::Time now = ros::Time::now();
+    const topic_tools::ShapeShifter &msg = *_event.getMessage();
+
+    boost::mutex::scoped_lock lock(this->mutex);
+
+    // the type is only known once the first message is received
+    if (this->stamped < 0)
+      this->stamped = HasHeader(msg.getMessageDefinition()) ? 1 : 0;
+
+    if (this->count > 0)
+    {
+      double gap = (now - this->last).toSec();
+      this->gapSum += gap;
+      this->gapSumSq += gap * gap;
+      this->maxGap = std::max(this->maxGap, gap);
+    }
+    else
+      this->first = now;
+    this->last = now;
+    ++this->count;
+
+    if (!this->measuring || this->stamped == 0 || msg.size() < 12)
+      return;
+
+    // seq, then stamp, are the first fields of a Header
+    this->buffer.resize(msg.size());
+    ros::serialization::OStream out(&this->buffer[0], this->buffer.size());
+    msg.write(out);
+    ros::serialization::IStream in(&this->buffer[0], this->buffer.size());
+    uint32_t seq;
+    ros::Time stamp;
+    in >> seq >> stamp;
+
+    double latency = (_event.getReceiptTime() - stamp).toSec();
+    this->latencySum += latency;
+    this->latencyMax = std::max(this->latencyMax, latency);
+    ++this->latencyCount;
+  }
+
+  /// \brief Whether the first field of a message is a Header.
+  /// \param[in] _definition Full text definition of the message.
+  private: static bool HasHeader(const std::string &_definition)
+  {
+    std::string::size_type start = 0;
+    while (start < _definition.size())
+    {
+      std::string::size_type end = _definition.find('\n', start);
+      if (end == std::string::npos)
+        end = _definition.size();
+      std::string line = _definition.substr(start, end - start);
+      start = end + 1;
+
+      std::istringstream fields(line);
+      std::string type, name;
+      if (!(fields >> type >> name) || type[0] == '#')
+        continue;
+
+      return name == "header" &&
+        (type == "Header" || type == "std_msgs/Header");
+    }
+    return false;
+  }
+
+  /// \brief Name of the topic
+  public: std::string topic;
+
+  /// \brief Expected rate
+  public: double hz;
+
+  /// \brief Allowed error of the rate
+  public: double hzError;
+
+  /// \brief Bound of the jitter, negative for none
+  public: double maxJitter;
+
+  /// \brief Bound of the mean latency, negative for none
+  public: double maxLatency;
+
+  /// \brief Messages received
+  public: unsigned int count;
+
+  /// \brief Receipt of the first and last messages
+  public: ros::Time first;
+  public: ros::Time last;
+
+  /// \brief Sums of the times between messages, and of their squares
+  public: double gapSum;
+  public: double gapSumSq;
+
+  /// \brief Longest time between messages
+  public: double maxGap;
+
+  /// \brief Messages whose latency was measured
+  public: unsigned int latencyCount;
+
+  /// \brief Sum and max of the latencies
+  public: double latencySum;
+  public: double latencyMax;
+
+  /// \brief Whether latency is measured
+  private: bool measuring;
+
+  /// \brief 1 if the messages have a header, 0 if not, -1 if unknown yet
+  private: int stamped;
+
+  /// \brief Serialized message, reused
+  private: std::vector<uint8_t> buffer;
+
+  /// \brief Protects the measures, updated by the spinner threads
+  private: boost::mutex mutex;
+
+  /// \brief Subscriber to the topic
+  private: ros::Subscriber sub;
+};
+
+typedef boost::shared_ptr<TopicRate> TopicRatePtr;
+
+/////////////////////////////////////////////////
+/// \brief Value of a number in a parameter, int or double.
+double ToDouble(XmlRpc::XmlRpcValue &_value)
+{
+  if (_value.getType() == XmlRpc::XmlRpcValue::TypeInt)
+    return static_cast<int>(_value);
+  return static_cast<double>(_value);
+}
+
+/////////////////////////////////////////////////
+/// \brief Read ~topics.
+bool LoadTopics(ros::NodeHandle &_pnh, std::vector<TopicRatePtr> &_topics)
+{
+  XmlRpc::XmlRpcValue topics;
+  if (!_pnh.getParam("topics", topics) ||
+      topics.getType() != XmlRpc::XmlRpcValue::TypeArray)
+  {
+    ROS_ERROR("~topics must be a list");
+    return false;
+  }
+
+  try
+  {
+    for (int i = 0; i < topics.size(); ++i)
+    {
+      XmlRpc::XmlRpcValue &t = topics[i];
+      if (!t.hasMember("topic") || !t.hasMember("hz") ||
+          !t.hasMember("hzerror"))
+      {
+        ROS_ERROR("entry %d of ~topics needs a topic, hz and hzerror", i);
+        return false;
+      }
+
+      TopicRatePtr rate(new TopicRate(static_cast<std::string>(t["topic"])));
+      rate->hz = ToDouble(t["hz"]);
+      rate->hzError = ToDouble(t["hzerror"]);
+      if (t.hasMember("max_jitter"))
+        rate->maxJitter = ToDouble(t["max_jitter"]);
+      if (t.hasMember("max_latency"))
+        rate->maxLatency = ToDouble(t["max_latency"]);
+      _topics.push_back(rate);
+    }
+  }
+  catch(XmlRpc::XmlRpcException &_e)
+  {
+    ROS_ERROR("malformed ~topics: %s", _e.getMessage().c_str());
+    return false;
+  }
+  return !_topics.empty();
+}
+
+/////////////////////////////////////////////////
+/// \brief Property name for a measure of a topic, /atlas/imu -> atlas_imu_hz
+std::string PropertyName(const std::string &_topic, const std::string &_what)
+{
+  std::string name = _topic.substr(_topic.find_first_not_of('/')) + "_" +
+    _what;
+  for (unsigned int i = 0; i < name.size(); ++i)
+  {
+    if (name[i] == '/')
+      name[i] = '_';
+  }
+  return name;
+}
+
+/////////////////////////////////////////////////
+TEST(MultiHzTest, Rates)
+{
+  ros::NodeHandle nh;
+  ros::NodeHandle pnh("~");
+
+  double waitTime, testDuration;
+  pnh.param("wait_time", waitTime, 20.0);
+  pnh.param("test_duration", testDuration, 10.0);
+
+  std::vector<TopicRatePtr> topics;
+  ASSERT_TRUE(LoadTopics(pnh, topics));
+
+  ros::AsyncSpinner spinner(0);
+  spinner.start();
+
+  for (unsigned int i = 0; i < topics.size(); ++i)
+    topics[i]->Subscribe(nh);
+
+  // wait for the first message of every topic that should publish
+  ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(waitTime);
+  bool ready = false;
+  while (!ready && ros::ok() && ros::WallTime::now() < deadline)
+  {
+    ready = true;
+    for (unsigned int i = 0; i < topics.size() && ready; ++i)
+      ready = topics[i]->hz <= 0 || topics[i]->Received();
+    if (!ready)
+      ros::WallDuration(0.1).sleep();
+  }
+
+  // measure every topic over the same time
+  for (unsigned int i = 0; i < topics.size(); ++i)
+    topics[i]->Reset(true);
+  ros::Duration(testDuration).sleep();
+
+  spinner.stop();
+  for (unsigned int i = 0; i < topics.size(); ++i)
+    topics[i]->Unsubscribe();
+
+  ROS_INFO("%-48s %10s %10s %10s %10s", "topic", "hz", "jitter_ms",
+           "max_gap_ms", "latency_ms");
+  for (unsigned int i = 0; i < topics.size(); ++i)
+  {
+    const TopicRate &t = *topics[i];
+    double hz = t.GetHz();
+    ROS_INFO("%-48s %10.2f %10.3f %10.3f %10.3f", t.topic.c_str(), hz,
+             t.GetJitter() * 1000, t.maxGap * 1000, t.GetLatency() * 1000);
+
+    ::testing::Test::RecordProperty(PropertyName(t.topic, "hz").c_str(),
+      boost::lexical_cast<std::string>(hz).c_str());
+    ::testing::Test::RecordProperty(PropertyName(t.topic, "jitter").c_str(),
+      boost::lexical_cast<std::string>(t.GetJitter()).c_str());
+    ::testing::Test::RecordProperty(PropertyName(t.topic, "max_gap").c_str(),
+      boost::lexical_cast<std::string>(t.maxGap).c_str());
+    if (t.latencyCount > 0)
+    {
+      ::testing::Test::RecordProperty(
+        PropertyName(t.topic, "latency").c_str(),
+        boost::lexical_cast<std::string>(t.GetLatency()).c_str());
+      ::testing::Test::RecordProperty(
+        PropertyName(t.topic, "max_latency").c_str(),
+        boost::lexical_cast<std::string>(t.latencyMax).c_str());
+    }
+
+    if (t.hz <= 0)
+    {
+      EXPECT_EQ(t.count, 0u) << t.topic << " should not publish";
+      continue;
+    }
+
+    EXPECT_GE(t.count, 2u) << t.topic << " did not publish";
+    EXPECT_NEAR(hz, t.hz, t.hzError) << t.topic;
+    if (t.maxJitter >= 0)
+      EXPECT_LE(t.GetJitter(), t.maxJitter) << t.topic;
+    if (t.maxLatency >= 0)
+    {
+      EXPECT_GT(t.latencyCount, 0u) << t.topic << " has no header";
+      EXPECT_LE(t.GetLatency(), t.maxLatency) << t.topic;
+    }
+  }
+}
+
+/////////////////////////////////////////////////
+int main(int _argc, char **_argv)
+{
+  testing::InitGoogleTest(&_argc, _argv);
+  ros::init(_argc, _argv, "multi_hztest");
+
+  // Wait until /clock is being published; this can take an unpredictable
+  // amount of time when we're downloading models.
+  ros::NodeHandle nh;
+  while (ros::ok() && ros::Time::now().isZero())
+  {
+    ROS_INFO("Waiting for Gazebo to start...");
+    ros::WallDuration(1.0).sleep();
+  }
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,448 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+// Re-score recorded VRC runs from their gazebo state logs, using the same
+// rules as VRCScoringPlugin, without running physics.
+//
+//   vrc_rescore [-j jobs] [-o outdir] state.log [state.log ...]
+//
+// Each log is scored in its own process, up to <jobs> at a time.  The
+// score is written next to the log as <log>.score, or to
+// <outdir>/<absolute path of the log, with '/' as '_'>.score, so that logs
+// named the same in different directories don't overwrite each other.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+
+#include <gazebo/gazebo.hh>
+#include <gazebo/physics/physics.hh>
+#include <gazebo/common/common.hh>
+#if GAZEBO_MAJOR_VERSION <= 2
+#include <gazebo/Master.hh>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "drcsim_gazebo_ros_plugins/VRCScoringEngine.hh"
+#include "drcsim_gazebo_ros_plugins/VRCScoreWriter.hh"
+#include "drcsim_gazebo_ros_plugins/VRCStateLogReader.hh"
+
+using namespace gazebo;
+
+/////////////////////////////////////////////////
+void Usage()
+{
+  std::cerr << "Usage: vrc_rescore [-j jobs] [-o outdir] "
+            << "state.log [state.log ...]" << std::endl;
+}
+
+/////////////////////////////////////////////////
+/// \brief Remove plugins and sensors from a world, so that loading it
+/// doesn't start controllers, ROS or rendering.  The scoring plugin's
+/// element and VRCPlugin's <drc_fire_hose> element are kept aside.
+void StripWorld(sdf::ElementPtr _elem, sdf::ElementPtr &_scoringSdf,
+                sdf::ElementPtr &_fireHoseSdf)
+{
+  std::vector<sdf::ElementPtr> removed;
+  for (sdf::ElementPtr child = _elem->GetFirstElement(); child;
+       child = child->GetNextElement())
+  {
+    if (child->GetName() == "plugin")
+    {
+      std::string filename = child->Get<std::string>("filename");
+      if (filename.find("VRCScoringPlugin") != std::string::npos)
+        _scoringSdf = child->Clone();
+      else if (child->HasElement("drc_fire_hose"))
+        _fireHoseSdf = child->GetElement("drc_fire_hose")->Clone();
+      removed.push_back(child);
+    }
+    else if (child->GetName() == "sensor")
+      removed.push_back(child);
+    else
+      StripWorld(child, _scoringSdf, _fireHoseSdf);
+  }
+
+  for (std::vector<sdf::ElementPtr>::iterator iter = removed.begin();
+       iter != removed.end(); ++iter)
+  {
+    _elem->RemoveChild(*iter);
+  }
+}
+
+/////////////////////////////////////////////////
+/// \brief Read a state from the log into a <state> element.  Insertions
+/// and deletions are left out; models are added up front by AddInsertions.
+sdf::ElementPtr ReadState(std::string _data)
+{
+  const std::string tags[] = {"insertions", "deletions"};
+  for (unsigned int i = 0; i < 2; ++i)
+  {
+    size_t start = _data.find("<" + tags[i] + ">");
+    size_t end = _data.find("</" + tags[i] + ">", start);
+    if (start != std::string::npos && end != std::string::npos)
+      _data.erase(start, end + tags[i].size() + 3 - start);
+  }
+
+  sdf::ElementPtr sdf(new sdf::Element);
+  if (!sdf::initFile("state.sdf", sdf) || !sdf::readString(_data, sdf))
+    return sdf::ElementPtr();
+  return sdf;
+}
+
+/////////////////////////////////////////////////
+/// \brief Add the models that were spawned during the run, e.g. atlas,
+/// to the world description.
+/// \return Number of models added.
+unsigned int AddInsertions(const std::string &_logPath,
+                           sdf::ElementPtr _worldSdf)
+{
+  VRCStateLogReader reader;
+  if (!reader.Open(_logPath))
+    return 0;
+
+  unsigned int count = 0;
+  std::string data;
+  while (reader.Next(data))
+  {
+    if (data.find("<insertions>") == std::string::npos)
+      continue;
+
+    sdf::ElementPtr stateSdf(new sdf::Element);
+    if (!sdf::initFile("state.sdf", stateSdf) ||
+        !sdf::readString(data, stateSdf) ||
+        !stateSdf->HasElement("insertions"))
+      continue;
+
+    sdf::ElementPtr insertions = stateSdf->GetElement("insertions");
+    for (sdf::ElementPtr model = insertions->GetElement("model"); model;
+         model = model->GetNextElement("model"))
+    {
+      std::string name = model->Get<std::string>("name");
+      bool exists = false;
+      if (_worldSdf->HasElement("model"))
+      {
+        for (sdf::ElementPtr other = _worldSdf->GetElement("model"); other;
+             other = other->GetNextElement("model"))
+        {
+          if (other->Get<std::string>("name") == name)
+          {
+            exists = true;
+            break;
+          }
+        }
+      }
+      if (!exists)
+      {
+        _worldSdf->InsertElement(model->Clone());
+        ++count;
+      }
+    }
+  }
+  return count;
+}
+
+/////////////////////////////////////////////////
+/// \brief Score one log.
+/// \return true on success
+bool Rescore(const std::string &_logPath,
+             const boost::filesystem::path &_scorePath)
+{
+  VRCStateLogReader reader;
+  if (!reader.Open(_logPath))
+    return false;
+
+  sdf::SDFPtr worldDoc(new sdf::SDF);
+  sdf::init(worldDoc);
+  if (!sdf::readString(reader.GetWorld(), worldDoc) ||
+      !worldDoc->root->HasElement("world"))
+  {
+    gzerr << "Unable to parse the world in [" << _logPath << "]" << std::endl;
+    return false;
+  }
+  sdf::ElementPtr worldSdf = worldDoc->root->GetElement("world");
+
+  sdf::ElementPtr scoringSdf;
+  sdf::ElementPtr fireHoseSdf;
+  StripWorld(worldSdf, scoringSdf, fireHoseSdf);
+  AddInsertions(_logPath, worldSdf);
+
+  physics::WorldPtr world =
+    physics::create_world(worldSdf->Get<std::string>("name"));
+  physics::load_world(world, worldSdf);
+  physics::init_world(world);
+
+  VRCScoringEngine engine;
+  if (!engine.Load(world, scoringSdf))
+    return false;
+  if (fireHoseSdf && engine.GetWorldType() == VRCScoringEngine::VRC_3 &&
+      !engine.InferHoseAlignment(fireHoseSdf))
+    return false;
+  if (!engine.SetRobot(world->GetModel("atlas")))
+  {
+    gzerr << "No atlas in [" << _logPath << "]" << std::endl;
+    return false;
+  }
+
+  VRCScoreWriter writer;
+  common::Time runStartTimeWall;
+  common::Time prevScoreTime;
+  unsigned int states = 0;
+  std::string data;
+  while (reader.Next(data))
+  {
+    sdf::ElementPtr stateSdf = ReadState(data);
+    if (!stateSdf)
+    {
+      gzwarn << "Skipping unreadable state in [" << _logPath << "]"
+             << std::endl;
+      continue;
+    }
+
+    physics::WorldState state;
+    state.Load(stateSdf);
+    world->SetState(state);
+
+    common::Time simTime = state.GetSimTime();
+    common::Time wallTime = state.GetWallTime();
+
+    // The score file is relative to the start of the run
+    if (states++ == 0)
+    {
+      runStartTimeWall = wallTime;
+      if (!writer.Open(_scorePath, world->GetName(), runStartTimeWall))
+        return false;
+    }
+
+    std::string msg;
+    bool force = engine.Update(simTime, wallTime, msg);
+
+    // Same 1Hz throttle as VRCScoringPlugin::WriteScore
+    if (!force && (simTime - prevScoreTime).Double() < 1.0)
+      continue;
+
+    common::Time elapsedTimeSim;
+    common::Time elapsedTimeWall;
+    engine.GetElapsedTime(simTime, wallTime, elapsedTimeSim, elapsedTimeWall);
+
+    VRCScoreWriter::Record record;
+    record.wallTime = wallTime - runStartTimeWall;
+    record.simTime = simTime;
+    record.wallTimeElapsed = elapsedTimeWall;
+    record.simTimeElapsed = elapsedTimeSim;
+    record.completionScore = engine.GetCompletionScore();
+    record.falls = engine.GetFalls();
+    record.msg = msg;
+    record.force = force;
+    // Don't drop records when we're reading faster than the disk
+    while (!writer.Push(record) && writer.IsOpen())
+      common::Time::MSleep(1);
+
+    prevScoreTime = simTime;
+  }
+  writer.Close();
+
+  std::cout << _logPath << ": " << states << " states, completion score "
+            << engine.GetCompletionScore() << ", falls " << engine.GetFalls()
+            << " -> " << _scorePath.string() << std::endl;
+  return states > 0;
+}
+
+/////////////////////////////////////////////////
+/// \brief Find a free local TCP port, by letting the kernel pick one.
+/// \return The port, 0 on failure.
+uint16_t FreePort()
+{
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  if (sock < 0)
+    return 0;
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  socklen_t len = sizeof(addr);
+  uint16_t port = 0;
+  if (bind(sock, reinterpret_cast<struct sockaddr *>(&addr), len) == 0 &&
+      getsockname(sock, reinterpret_cast<struct sockaddr *>(&addr), &len) == 0)
+  {
+    port = ntohs(addr.sin_port);
+  }
+  close(sock);
+  return port;
+}
+
+/////////////////////////////////////////////////
+/// \brief Run gazebo in this process and score one log.
+/// \return Exit status for the child process
+int RescoreProcess(const std::string &_logPath,
+                   const boost::filesystem::path &_scorePath)
+{
+  // Each process gets its own master, so that they don't see each other.
+  // Another process may take the port between FreePort and the master
+  // listening on it, so try a few.
+  static const unsigned int attempts = 5;
+  uint16_t port = 0;
+  bool started = false;
+  for (unsigned int i = 0; i < attempts && !started; ++i)
+  {
+    port = FreePort();
+    if (port == 0)
+      continue;
+    setenv("GAZEBO_MASTER_URI", ("http://localhost:" +
+      boost::lexical_cast<std::string>(port)).c_str(), 1);
+#if GAZEBO_MAJOR_VERSION > 2
+    started = gazebo::setupServer();
+#else
+    started = true;
+#endif
+  }
+  if (!started)
+  {
+    std::cerr << "Unable to start gazebo for [" << _logPath << "]"
+              << std::endl;
+    return 1;
+  }
+
+#if GAZEBO_MAJOR_VERSION <= 2
+  gazebo::Master *master = new gazebo::Master();
+  master->Init(port);
+  master->RunThread();
+  if (!gazebo::load() || !gazebo::init())
+    return 1;
+  physics::load();
+#endif
+
+  bool result = false;
+  try
+  {
+    result = Rescore(_logPath, _scorePath);
+  }
+  catch(common::Exception &_e)
+  {
+    gzerr << "Failed to score [" << _logPath << "]: " << _e << std::endl;
+  }
+
+#if GAZEBO_MAJOR_VERSION > 2
+  gazebo::shutdown();
+#else
+  gazebo::fini();
+  master->Stop();
+  master->Fini();
+  delete master;
+#endif
+  return result ? 0 : 1;
+}
+
+/////////////////////////////////////////////////
+int main(int _argc, char **_argv)
+{
+  unsigned int jobs = boost::thread::hardware_concurrency();
+  boost::filesystem::path outDir;
+  std::vector<std::string> logs;
+
+  for (int i = 1; i < _argc; ++i)
+  {
+    std::string arg = _argv[i];
+    if (arg == "-j" && i + 1 < _argc)
+      jobs = atoi(_argv[++i]);
+    else if (arg == "-o" && i + 1 < _argc)
+      outDir = _argv[++i];
+    else if (arg == "-h" || arg == "--help")
+    {
+      Usage();
+      return 0;
+    }
+    else if (arg[0] == '-')
+    {
+      Usage();
+      return 1;
+    }
+    else
+      logs.push_back(arg);
+  }
+
+  if (logs.empty())
+  {
+    Usage();
+    return 1;
+  }
+  if (jobs == 0)
+    jobs = 1;
+
+  unsigned int next = 0;
+  unsigned int running = 0;
+  unsigned int failures = 0;
+  while (next < logs.size() || running > 0)
+  {
+    if (next < logs.size() && running < jobs)
+    {
+      boost::filesystem::path logPath(logs[next++]);
+      boost::filesystem::path scorePath;
+      if (outDir.empty())
+        scorePath = logPath.string() + ".score";
+      else
+      {
+        std::string name =
+          boost::filesystem::absolute(logPath).string().substr(1);
+        std::replace(name.begin(), name.end(), '/', '_');
+        scorePath = outDir / (name + ".score");
+      }
+
+      pid_t pid = fork();
+      if (pid == 0)
+        _exit(RescoreProcess(logPath.string(), scorePath));
+      else if (pid < 0)
+      {
+        std::cerr << "Unable to start a process for [" << logPath.string()
+                  << "]" << std::endl;
+        ++failures;
+      }
+      else
+        ++running;
+      continue;
+    }
+
+    int status;
+    if (wait(&status) > 0)
+    {
+      --running;
+      if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        ++failures;
+    }
+    else
+      running = 0;
+  }
+
+  if (failures > 0)
+    std::cerr << failures << " of " << logs.size() << " logs failed"
+              << std::endl;
+  return failures > 0 ? 1 : 0;
+}
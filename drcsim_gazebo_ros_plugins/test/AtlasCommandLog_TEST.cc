@@ -0,0 +1,273 @@
+/*
+ * Copyright 2012 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <atlas_msgs/AtlasCommand.h>
+#include <atlas_msgs/AtlasSimInterfaceCommand.h>
+
+#include "drcsim_gazebo_ros_plugins/AtlasCommandLog.hh"
+
+using namespace gazebo;
+
+/// \brief Serialize a message the way AtlasCommandLog::Push does.
+template<typename M>
+static std::vector<uint8_t> Serialize(const M &_msg)
+{
+  std::vector<uint8_t> data(ros::serialization::serializationLength(_msg));
+  ros::serialization::OStream stream(&data[0], data.size());
+  ros::serialization::serialize(stream, _msg);
+  return data;
+}
+
+/// \brief Read a whole file.
+static std::vector<uint8_t> ReadFile(const std::string &_path)
+{
+  std::ifstream in(_path.c_str(), std::ios::binary);
+  return std::vector<uint8_t>((std::istreambuf_iterator<char>(in)),
+                              std::istreambuf_iterator<char>());
+}
+
+/// \brief Read a value in host byte order from a file's bytes.
+template<typename T>
+static T ReadValue(const std::vector<uint8_t> &_bytes, size_t &_offset)
+{
+  T value = 0;
+  if (_offset + sizeof(value) <= _bytes.size())
+    memcpy(&value, &_bytes[_offset], sizeof(value));
+  _offset += sizeof(value);
+  return value;
+}
+
+/// \brief Gives each test a file to record to, removed after the test.
+class AtlasCommandLogTest : public testing::Test
+{
+  protected: virtual void SetUp()
+  {
+    char path[] = "/tmp/atlas_command_log_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    this->path = path;
+
+    // An AtlasCommand with every kind of field set
+    this->command.header.stamp = ros::Time(1, 500);
+    this->command.header.frame_id = "pelvis";
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+      this->command.position.push_back(0.1 * i);
+      this->command.velocity.push_back(-0.2 * i);
+      this->command.effort.push_back(10.0 + i);
+      this->command.kp_position.push_back(100.0f * i);
+      this->command.k_effort.push_back(255 - i);
+    }
+    this->command.desired_controller_period_ms = 5;
+
+    this->asiCommand.header.stamp = ros::Time(2, 0);
+    this->asiCommand.behavior = atlas_msgs::AtlasSimInterfaceCommand::WALK;
+    this->asiCommand.k_effort.assign(28, 0);
+    this->asiCommand.k_effort[3] = 255;
+    this->asiCommand.position.assign(28, 0.25);
+  }
+
+  protected: virtual void TearDown()
+  {
+    unlink(this->path.c_str());
+  }
+
+  /// \brief Replace the file with just a recording header.
+  /// \param[in] _magic Magic to write, 8 characters for the real one.
+  /// \param[in] _version Format version to write.
+  protected: void WriteHeader(const char *_magic, uint32_t _version)
+  {
+    std::ofstream out(this->path.c_str(), std::ios::binary | std::ios::trunc);
+    out.write(_magic, strlen(_magic));
+    out.write(reinterpret_cast<const char *>(&_version), sizeof(_version));
+  }
+
+  /// \brief Recording file
+  protected: std::string path;
+
+  /// \brief Commands recorded
+  protected: atlas_msgs::AtlasCommand command;
+  protected: atlas_msgs::AtlasSimInterfaceCommand asiCommand;
+};
+
+/////////////////////////////////////////////////
+TEST_F(AtlasCommandLogTest, ReplaysWhatWasRecorded)
+{
+  {
+    AtlasCommandLog log;
+    ASSERT_TRUE(log.OpenRecord(this->path));
+    EXPECT_TRUE(log.IsRecording());
+    log.Push(AtlasCommandLog::ATLAS_COMMAND, this->command);
+    log.Flush(ros::Time(1, 500));
+    log.Push(AtlasCommandLog::ASI_COMMAND, this->asiCommand);
+    log.Push(AtlasCommandLog::ATLAS_COMMAND, this->command);
+    log.Flush(ros::Time(2, 0));
+    // not flushed, so not used by any step
+    log.Push(AtlasCommandLog::ASI_COMMAND, this->asiCommand);
+  }
+
+  AtlasCommandLog log;
+  ASSERT_TRUE(log.OpenReplay(this->path));
+  EXPECT_TRUE(log.IsReplaying());
+  EXPECT_FALSE(log.IsRecording());
+
+  AtlasCommandLog::Type type;
+  std::vector<uint8_t> data;
+  EXPECT_FALSE(log.Next(ros::Time(1, 499), type, data));
+
+  ASSERT_TRUE(log.Next(ros::Time(1, 500), type, data));
+  EXPECT_EQ(type, AtlasCommandLog::ATLAS_COMMAND);
+  EXPECT_TRUE(data == Serialize(this->command));
+  atlas_msgs::AtlasCommand command;
+  ASSERT_TRUE(AtlasCommandLog::Deserialize(data, command));
+  EXPECT_EQ(command.header.stamp, this->command.header.stamp);
+  EXPECT_EQ(command.header.frame_id, "pelvis");
+  EXPECT_TRUE(command.position == this->command.position);
+  EXPECT_TRUE(command.k_effort == this->command.k_effort);
+  EXPECT_EQ(command.desired_controller_period_ms, 5);
+
+  EXPECT_FALSE(log.Next(ros::Time(1, 999999999), type, data));
+
+  // both commands of the second step are due at once, in push order
+  ASSERT_TRUE(log.Next(ros::Time(3, 0), type, data));
+  EXPECT_EQ(type, AtlasCommandLog::ASI_COMMAND);
+  EXPECT_TRUE(data == Serialize(this->asiCommand));
+  atlas_msgs::AtlasSimInterfaceCommand asiCommand;
+  ASSERT_TRUE(AtlasCommandLog::Deserialize(data, asiCommand));
+  EXPECT_EQ(asiCommand.behavior, static_cast<int32_t>(
+      atlas_msgs::AtlasSimInterfaceCommand::WALK));
+  EXPECT_TRUE(asiCommand.k_effort == this->asiCommand.k_effort);
+  EXPECT_TRUE(asiCommand.position == this->asiCommand.position);
+
+  ASSERT_TRUE(log.Next(ros::Time(3, 0), type, data));
+  EXPECT_EQ(type, AtlasCommandLog::ATLAS_COMMAND);
+  EXPECT_TRUE(data == Serialize(this->command));
+
+  EXPECT_FALSE(log.Next(ros::Time(100, 0), type, data));
+  EXPECT_TRUE(log.IsReplaying());
+}
+
+/////////////////////////////////////////////////
+TEST_F(AtlasCommandLogTest, WritesTheDocumentedFormat)
+{
+  {
+    AtlasCommandLog log;
+    ASSERT_TRUE(log.OpenRecord(this->path));
+    log.Push(AtlasCommandLog::ATLAS_COMMAND, this->command);
+    log.Flush(ros::Time(1, 500));
+    log.Push(AtlasCommandLog::ASI_COMMAND, this->asiCommand);
+    log.Flush(ros::Time(2, 0));
+  }
+
+  std::vector<uint8_t> bytes = ReadFile(this->path);
+  ASSERT_GE(bytes.size(), 12u);
+  EXPECT_EQ(std::string(bytes.begin(), bytes.begin() + 8), "ATLASCMD");
+  size_t offset = 8;
+  EXPECT_EQ(ReadValue<uint32_t>(bytes, offset), 1u);
+
+  std::vector<uint8_t> payloads[2] =
+    {Serialize(this->command), Serialize(this->asiCommand)};
+  uint32_t secs[2] = {1, 2};
+  uint32_t nsecs[2] = {500, 0};
+  uint8_t types[2] =
+    {AtlasCommandLog::ATLAS_COMMAND, AtlasCommandLog::ASI_COMMAND};
+  for (unsigned int i = 0; i < 2; ++i)
+  {
+    EXPECT_EQ(ReadValue<uint32_t>(bytes, offset), secs[i]);
+    EXPECT_EQ(ReadValue<uint32_t>(bytes, offset), nsecs[i]);
+    EXPECT_EQ(ReadValue<uint8_t>(bytes, offset), types[i]);
+    uint32_t size = ReadValue<uint32_t>(bytes, offset);
+    ASSERT_EQ(size, payloads[i].size());
+    ASSERT_LE(offset + size, bytes.size());
+    EXPECT_TRUE(std::equal(payloads[i].begin(), payloads[i].end(),
+                           bytes.begin() + offset));
+    offset += size;
+  }
+  EXPECT_EQ(offset, bytes.size());
+}
+
+/////////////////////////////////////////////////
+TEST_F(AtlasCommandLogTest, RejectsOtherFiles)
+{
+  AtlasCommandLog log;
+
+  this->WriteHeader("ATLASCMD", 2);
+  EXPECT_FALSE(log.OpenReplay(this->path));
+  EXPECT_FALSE(log.IsReplaying());
+
+  this->WriteHeader("ATLASCMX", 1);
+  EXPECT_FALSE(log.OpenReplay(this->path));
+  EXPECT_FALSE(log.IsReplaying());
+
+  // truncated version
+  {
+    std::ofstream out(this->path.c_str(), std::ios::binary | std::ios::trunc);
+    out.write("ATLASCMD\1", 9);
+  }
+  EXPECT_FALSE(log.OpenReplay(this->path));
+  EXPECT_FALSE(log.IsReplaying());
+
+  EXPECT_FALSE(log.OpenReplay(this->path + ".missing"));
+  EXPECT_FALSE(log.IsReplaying());
+
+  // a recording without commands
+  this->WriteHeader("ATLASCMD", 1);
+  ASSERT_TRUE(log.OpenReplay(this->path));
+  EXPECT_TRUE(log.IsReplaying());
+  AtlasCommandLog::Type type;
+  std::vector<uint8_t> data;
+  EXPECT_FALSE(log.Next(ros::Time(100, 0), type, data));
+}
+
+/////////////////////////////////////////////////
+TEST_F(AtlasCommandLogTest, IgnoresCommandsWhenNotRecording)
+{
+  AtlasCommandLog log;
+  log.Push(AtlasCommandLog::ATLAS_COMMAND, this->command);
+  log.Flush(ros::Time(1, 0));
+
+  ASSERT_TRUE(log.OpenRecord(this->path));
+  log.Flush(ros::Time(2, 0));
+  log.Close();
+  EXPECT_FALSE(log.IsRecording());
+  log.Push(AtlasCommandLog::ATLAS_COMMAND, this->command);
+  log.Flush(ros::Time(3, 0));
+
+  // only the header was written
+  EXPECT_EQ(ReadFile(this->path).size(), 12u);
+}
+
+/////////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}